@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "msa/MethylationSiteTable.h"
+
+namespace msa {
+
+/**
+ * @brief Level 1 溢寫：將已完成變異的位點表格壓縮寫入暫存目錄的排序區段 (run)
+ *
+ * 每個變異只由一個查詢區域產生，區域完成後其變異的表格不再改變，可隨時寫出。每個區段內的變異
+ * 依索引遞增，讀取時以k路合併依變異索引輸出，列順序與全部保留在記憶體時相同。
+ * 暫存目錄於物件解構時刪除。
+ */
+class Level1Spill {
+public:
+    /**
+     * @brief 建構函數 (暫存目錄於寫出第一個區段時建立)
+     * @param tmpDir 暫存目錄的上層目錄，空字串表示系統暫存目錄
+     */
+    explicit Level1Spill(const std::string& tmpDir);
+    
+    /**
+     * @brief 解構函數，刪除暫存目錄
+     */
+    ~Level1Spill();
+    
+    // 禁止複製與賦值 (擁有暫存目錄)
+    Level1Spill(const Level1Spill&) = delete;
+    Level1Spill& operator=(const Level1Spill&) = delete;
+    
+    /**
+     * @brief 登記已完成的變異 (表格仍在記憶體中，等待寫出)
+     * @param first 第一個變異索引
+     * @param last 最後一個變異之後的索引 (不含)
+     * @param bytes 這些變異的表格佔用的位元組數
+     */
+    void variantsFinished(size_t first, size_t last, size_t bytes);
+    
+    /**
+     * @brief 已登記但尚未寫出的位元組數
+     */
+    size_t pendingBytes() const;
+    
+    /**
+     * @brief 將已登記的變異依索引排序後寫成一個區段，並釋放其表格 (可由多個執行緒同時呼叫)
+     *
+     * 寫入失敗時刪除該區段、將變異放回等待清單 (表格仍在記憶體中) 並拋出 std::runtime_error。
+     * @param variantResults 每個變異的位點表格
+     * @return size_t 釋放的位元組數
+     */
+    size_t writeRun(std::vector<MethylationSiteTable>& variantResults);
+    
+    /**
+     * @brief 已寫出的區段數
+     */
+    size_t runs() const;
+    
+    /**
+     * @brief 已寫出的列數
+     */
+    uint64_t rows() const;
+    
+    /**
+     * @brief 已寫出的壓縮位元組數
+     */
+    uint64_t compressedBytes() const;
+    
+    /**
+     * @brief k路合併讀取器：依變異索引遞增逐一取出變異的位點表格
+     */
+    class Reader {
+    public:
+        /**
+         * @brief 建構函數，開啟所有區段
+         * @param spill 溢寫資料 (讀取期間不可再寫出區段)
+         */
+        explicit Reader(const Level1Spill& spill);
+        ~Reader();
+        
+        // 禁止複製與賦值 (持有檔案控制代碼)
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        
+        /**
+         * @brief 取出下一個變異的位點表格
+         * @param block 用於存儲位點表格
+         * @return bool 是否取得 (全部讀完或資料損毀時為false)
+         */
+        bool next(MethylationSiteTable& block);
+        
+        /**
+         * @brief 是否因資料損毀或無法開啟而中止
+         */
+        bool failed() const { return failed_; }
+    
+    private:
+        struct RunCursor;  // 區段游標 (定義於實作檔)
+        
+        /**
+         * @brief 讀取區段的下一筆記錄標頭，有記錄時放入堆積
+         * @param cursor 游標索引
+         */
+        void advance(size_t cursor);
+        
+        std::vector<std::unique_ptr<RunCursor>> cursors_;   // 每個區段的游標
+        std::vector<std::pair<uint64_t, size_t>> heap_;     // (變異索引, 游標索引) 最小堆積
+        std::string buffer_;                                // 讀取緩衝區
+        bool failed_ = false;                               // 是否已中止
+    };
+
+private:
+    std::string parent_dir_;                          // 暫存目錄的上層目錄
+    std::string dir_;                                 // 暫存目錄 (首次寫出時建立)
+    mutable std::mutex mutex_;                        // 保護以下欄位
+    std::vector<std::pair<size_t, size_t>> pending_;  // 等待寫出的變異範圍
+    size_t pending_bytes_ = 0;                        // 等待寫出的位元組數
+    std::vector<std::string> run_paths_;              // 已寫出的區段
+    size_t next_run_ = 0;                             // 下一個區段編號
+    uint64_t rows_ = 0;                               // 已寫出的列數
+    uint64_t compressed_bytes_ = 0;                   // 已寫出的壓縮位元組數
+    
+    /**
+     * @brief 建立暫存目錄 (呼叫時須持有 mutex_)
+     */
+    void createDirectory();
+};
+
+/**
+ * @brief Level 1 位點：全部保留在記憶體的表格，或溢寫至磁碟的排序區段
+ *
+ * 分析與匯出以 forEachBlock 依列順序逐塊讀取，兩種形式輸出的列與順序相同。
+ */
+class Level1Details {
+public:
+    Level1Details() = default;
+    
+    /**
+     * @brief 以記憶體中的表格建立
+     * @param table 位點表格
+     */
+    Level1Details(MethylationSiteTable table) : table_(std::move(table)) {}
+    
+    /**
+     * @brief 以溢寫資料建立
+     * @param spill 溢寫資料
+     */
+    explicit Level1Details(std::shared_ptr<const Level1Spill> spill) : spill_(std::move(spill)) {}
+    
+    /**
+     * @brief 列數
+     */
+    size_t size() const { return spill_ ? static_cast<size_t>(spill_->rows()) : table_.size(); }
+    
+    /**
+     * @brief 是否溢寫至磁碟 (逐塊讀取時區塊只在處理函數內有效)
+     */
+    bool spilled() const { return spill_ != nullptr; }
+    
+    /**
+     * @brief 記憶體中表格佔用的位元組數 (溢寫時為0)
+     */
+    size_t memoryBytes() const { return table_.memoryBytes(); }
+    
+    /**
+     * @brief 依列順序逐塊處理 (記憶體中的表格為單一區塊；溢寫時每個變異為一個區塊)
+     * @param fn 處理函數
+     * @return bool 是否完整讀取 (溢寫資料損毀時為false)
+     */
+    bool forEachBlock(const std::function<void(const MethylationSiteTable&)>& fn) const;
+
+private:
+    MethylationSiteTable table_;                  // 記憶體中的表格
+    std::shared_ptr<const Level1Spill> spill_;    // 溢寫資料
+};
+
+} // namespace msa
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "msa/utils/StringInterner.h"
+
+namespace msa {
+
+/**
+ * @brief 讀段相對於變異的等位基因類型 (無法判定的讀段不會寫入表格)
+ */
+enum class AlleleType : uint8_t {
+    Ref = 0,    // 支持參考等位基因
+    Alt = 1     // 支持變異等位基因
+};
+
+/**
+ * @brief 甲基化狀態分類
+ */
+enum class MethState : uint8_t {
+    Low = 0,    // 低甲基化
+    Mid = 1,    // 中度甲基化
+    High = 2    // 高甲基化
+};
+
+/**
+ * @brief 鏈方向
+ */
+enum class Strand : uint8_t {
+    Unknown = 0,  // 未知 ('.')
+    Plus = 1,     // 正鏈 ('+')
+    Minus = 2     // 反鏈 ('-')
+};
+
+/**
+ * @brief Level 1 甲基化位點的欄式(struct-of-arrays)表格
+ *
+ * 低基數字串欄位 (染色體、變異類型、VCF/BAM來源、單倍型) 以全程序共用字典的ID存放，
+ * 讀段名稱存放於表格自有的名稱池並以64位元偏移量引用，甲基化機率保留原始ML值 (0-255)，
+ * 等位基因類型、鏈方向與甲基化狀態合併為一個位元組。每列約31位元組 (另加名稱池)。
+ */
+class MethylationSiteTable {
+public:
+    using ReadHandle = uint64_t;  // 讀段名稱在名稱池中的偏移量
+    
+    /**
+     * @brief 字典種類
+     */
+    enum class Dictionary {
+        Chrom,        // 染色體 (32位元ID)
+        VariantType,  // 變異類型 (16位元ID)
+        VcfSource,    // VCF來源 (16位元ID)
+        BamSource,    // BAM來源 (16位元ID)
+        Haplotype     // 單倍型標籤 (16位元ID)
+    };
+    
+    /**
+     * @brief 同一讀段在同一變異下所有位點共用的欄位
+     */
+    struct SiteContext {
+        uint32_t chrom = 0;                   // 染色體ID
+        int32_t somatic_pos = 0;              // 體細胞變異位置 (1-based)
+        uint16_t variant_type = 0;            // 變異類型ID
+        uint16_t vcf_source = 0;              // VCF來源ID
+        uint16_t bam_source = 0;              // BAM來源ID
+        uint16_t haplotype = 0;               // 單倍型標籤ID
+        AlleleType allele = AlleleType::Ref;  // 等位基因類型
+        char somatic_base = 'N';              // 讀段在變異位置的鹼基
+        ReadHandle read = 0;                  // 讀段名稱 (由 addReadName 取得)
+    };
+    
+    /**
+     * @brief 獲取全程序共用的字典
+     * @param which 字典種類
+     * @return msa::utils::StringInterner& 字典
+     */
+    static msa::utils::StringInterner& dictionary(Dictionary which);
+    
+    /**
+     * @brief 將讀段名稱加入名稱池 (與上一次加入的名稱相同時直接重用)
+     * @param name 讀段名稱
+     * @return ReadHandle 名稱在此表格中的引用
+     */
+    ReadHandle addReadName(const char* name);
+    
+    /**
+     * @brief 附加一個甲基化位點
+     * @param ctx 共用欄位
+     * @param methyl_pos 甲基化位點位置 (1-based)
+     * @param ml 甲基化機率 (ML值，0-255)
+     * @param state 甲基化狀態
+     * @param strand 鏈方向
+     */
+    void append(const SiteContext& ctx, int32_t methyl_pos, uint8_t ml, MethState state, Strand strand);
+    
+    /**
+     * @brief 將另一個表格的所有列附加到尾端
+     * @param other 來源表格
+     */
+    void append(const MethylationSiteTable& other);
+    
+    /**
+     * @brief 將另一個表格的所有列附加到尾端，並將附加列的VCF來源改為指定來源
+     * @param other 來源表格
+     * @param vcf_source VCF來源ID
+     */
+    void append(const MethylationSiteTable& other, uint16_t vcf_source);
+    
+    /**
+     * @brief 預留列空間
+     * @param rows 列數
+     */
+    void reserve(size_t rows);
+    
+    /**
+     * @brief 清除所有列並釋放記憶體
+     */
+    void clear();
+    
+    /**
+     * @brief 獲取列數
+     * @return size_t 列數
+     */
+    size_t size() const { return methyl_pos_.size(); }
+    
+    /**
+     * @brief 是否沒有任何列
+     * @return bool 是否為空
+     */
+    bool empty() const { return methyl_pos_.empty(); }
+    
+    /**
+     * @brief 估算表格佔用的位元組數 (以容量計)
+     * @return size_t 位元組數
+     */
+    size_t memoryBytes() const;
+    
+    /**
+     * @brief 將表格序列化附加到位元組緩衝區 (欄位依序存放，字典ID只在同一程序內有效，用於溢寫至磁碟)
+     * @param out 輸出緩衝區
+     */
+    void serialize(std::string& out) const;
+    
+    /**
+     * @brief 由 serialize 的輸出還原表格 (取代現有內容)
+     * @param data 序列化資料
+     * @param size 位元組數
+     * @return bool 資料是否完整
+     */
+    bool deserialize(const char* data, size_t size);
+    
+    // 各欄位存取 (i 為列索引)
+    uint32_t chromId(size_t i) const { return chrom_[i]; }
+    int32_t methylPos(size_t i) const { return methyl_pos_[i]; }
+    int32_t somaticPos(size_t i) const { return somatic_pos_[i]; }
+    uint16_t variantTypeId(size_t i) const { return variant_type_[i]; }
+    uint16_t vcfSourceId(size_t i) const { return vcf_source_[i]; }
+    uint16_t bamSourceId(size_t i) const { return bam_source_[i]; }
+    uint16_t haplotypeId(size_t i) const { return haplotype_[i]; }
+    char somaticBase(size_t i) const { return somatic_base_[i]; }
+    uint8_t ml(size_t i) const { return ml_[i]; }
+    AlleleType alleleType(size_t i) const { return static_cast<AlleleType>(flags_[i] & 0x1); }
+    Strand strand(size_t i) const { return static_cast<Strand>((flags_[i] >> 1) & 0x3); }
+    MethState methState(size_t i) const { return static_cast<MethState>((flags_[i] >> 3) & 0x3); }
+    ReadHandle readHandle(size_t i) const { return read_[i]; }
+    const char* readName(size_t i) const { return read_names_.data() + read_[i]; }
+    
+    /**
+     * @brief 甲基化程度 (0-1)，由ML值換算
+     * @param i 列索引
+     * @return float 甲基化程度
+     */
+    float methCall(size_t i) const { return mlToMethCall(ml_[i]); }
+    
+    /**
+     * @brief 將ML值換算為甲基化程度
+     * @param ml ML值 (0-255)
+     * @return float 甲基化程度 (0-1)
+     */
+    static float mlToMethCall(uint8_t ml) { return static_cast<float>(static_cast<double>(ml) / 255.0); }
+    
+    /**
+     * @brief 等位基因類型名稱
+     * @param allele 等位基因類型
+     * @return const char* "ref" 或 "alt"
+     */
+    static const char* alleleTypeName(AlleleType allele);
+    
+    /**
+     * @brief 甲基化狀態名稱
+     * @param state 甲基化狀態
+     * @return const char* "high"、"mid" 或 "low"
+     */
+    static const char* methStateName(MethState state);
+    
+    /**
+     * @brief 鏈方向字元
+     * @param strand 鏈方向
+     * @return char '+'、'-' 或 '.'
+     */
+    static char strandChar(Strand strand);
+
+private:
+    std::vector<uint32_t> chrom_;          // 染色體ID
+    std::vector<int32_t> methyl_pos_;      // 甲基化位點位置 (1-based)
+    std::vector<int32_t> somatic_pos_;     // 體細胞變異位置 (1-based)
+    std::vector<uint16_t> variant_type_;   // 變異類型ID
+    std::vector<uint16_t> vcf_source_;     // VCF來源ID
+    std::vector<uint16_t> bam_source_;     // BAM來源ID
+    std::vector<uint16_t> haplotype_;      // 單倍型標籤ID
+    std::vector<ReadHandle> read_;         // 讀段名稱引用
+    std::vector<uint8_t> ml_;              // 甲基化機率 (ML值)
+    std::vector<uint8_t> flags_;           // bit0: 等位基因類型, bit1-2: 鏈方向, bit3-4: 甲基化狀態
+    std::vector<char> somatic_base_;       // 讀段在變異位置的鹼基
+    
+    std::vector<char> read_names_;         // 讀段名稱池 (以'\0'分隔)
+    ReadHandle last_read_ = 0;             // 最近加入的讀段名稱
+    bool has_last_read_ = false;           // last_read_ 是否有效
+};
+
+} // namespace msa
@@ -5,7 +5,10 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <limits>
 #include <htslib/sam.h>
+#include "msa/MethylationSiteTable.h"
+#include "msa/Level1Details.h"
 
 namespace msa {
 
@@ -26,9 +29,19 @@ struct Config {
     float min_allele = 0.1f;              // 最小等位基因頻率
     int min_strand_reads = 3;             // 每條鏈上要求的最小讀段數
     int threads = 8;                      // 執行緒數
+    int hts_threads = 0;                  // htslib BGZF解壓縮執行緒池大小，0表示停用
+    int prefetch_depth = 0;               // 預取佇列深度(區域批次數)，0表示停用預取管線
+    int reader_threads = 2;               // 預取管線的BAM讀取執行緒數
     bool gzip_output = true;              // 是否壓縮輸出
+    bool summary_only = false;            // 只輸出Level 2/3摘要與全域指標，提取時直接聚合而不保留Level 1位點
     int max_read_depth = 10000;           // 最大讀取深度
     int max_ram_gb = 32;                  // 最大RAM使用量(GB)
+    int read_cache_mb = -1;               // 讀段解析快取容量(MB)，-1表示自動 (多個VCF時為 --max-ram-gb 的 1/10)，0表示停用
+    std::string tmp_dir;                  // Level 1 超過記憶體預算時溢寫區段的暫存目錄，空字串表示系統暫存目錄
+    bool union_vcfs = false;              // 合併所有VCF的變異位點，每個唯一位點只提取一次後分送到各VCF的輸出
+    int region_merge_gap = 1000;          // 相鄰變異窗口合併為同一查詢區域的最大間距(bp)，負值表示停用合併
+    int permutations = 0;                 // Level 3 每組的置換檢定與 bootstrap 重抽樣數，0表示停用
+    std::string scan_mode = "auto";       // BAM讀取模式: auto(依變異密度逐染色體選擇)、indexed(索引隨機存取)、linear(染色體循序掃描)
     std::string log_level = "INFO";       // 日誌級別
     std::string log_file = "msa.log";      // 日誌檔案名稱
     
@@ -65,22 +78,15 @@ struct VcfVariantInfo {
 };
 
 /**
- * @brief 甲基化位點詳細信息結構體
+ * @brief BAM查詢區域結構體 (由一個或多個相鄰變異的窗口合併而成)
  */
-struct MethylationSiteDetail {
-    std::string chrom;                 // 染色體
-    int methyl_pos = 0;                // 甲基化位點位置 (1-based)
-    int somatic_pos = 0;               // 體細胞變異位置 (1-based)
-    std::string variant_type;          // 變異類型
-    std::string vcf_source_id;         // VCF來源ID
-    std::string bam_source_id;         // BAM來源ID
-    std::string somatic_allele_type;   // 體細胞等位基因類型 (ref/alt)
-    std::string somatic_base_at_variant;  // 讀段在變異位置的鹼基
-    std::string haplotype_tag;         // 單倍型標籤
-    float meth_call = 0.0f;            // 甲基化程度 (0-1)
-    std::string meth_state;            // 甲基化狀態 (high/mid/low)
-    char strand = '.';                 // 鏈方向 (+/-)
-    std::string read_id;               // 讀段ID
+struct FetchRegion {
+    std::string chrom;              // 染色體
+    int start = 0;                  // 區域起始位置 (0-based, 含)
+    int end = 0;                    // 區域結束位置 (0-based, 不含)
+    size_t first_variant = 0;       // 區域內第一個變異在排序後變異列表中的索引
+    size_t last_variant = 0;        // 區域內最後一個變異之後的索引 (不含)
+    bool linear_scan = false;       // 是否由染色體循序掃描游標提供讀段 (同染色體區域需依序處理)
 };
 
 /**
@@ -96,10 +102,26 @@ struct SomaticVariantMethylationSummary {
     std::string haplotype_tag;          // 單倍型標籤
     int supporting_read_count = 0;      // 支持該摘要的讀段數量
     int methyl_sites_count = 0;         // 甲基化位點數量
+    int methylated_sites_count = 0;     // 高/中甲基化位點數量 (Level 3 Fisher精確檢定)
     float mean_methylation = 0.0f;      // 平均甲基化程度
     char strand = '.';                  // 主要鏈方向 (+/-/.)
 };
 
+/**
+ * @brief 兩個VCF之間的Level 3檢定結果 (無法計算的統計量為 NaN)
+ */
+struct PairwiseMethylationTest {
+    std::string vcf_a;                  // 第一個VCF來源
+    std::string vcf_b;                  // 第二個VCF來源
+    double difference = 0.0;            // 平均甲基化差異 (vcf_a - vcf_b)
+    double welch_t = 0.0;               // Welch t 統計量
+    double welch_df = 0.0;              // Welch–Satterthwaite 自由度
+    double welch_p = 1.0;               // Welch t 檢定p值
+    double mann_whitney_u = 0.0;        // vcf_a 的 Mann–Whitney U 統計量
+    double mann_whitney_p = 1.0;        // Mann–Whitney U 檢定p值 (常態近似)
+    double fisher_p = 1.0;              // 甲基化/非甲基化位點數的 Fisher 精確檢定p值
+};
+
 /**
  * @brief 聚合單倍型統計結構體
  */
@@ -108,8 +130,13 @@ struct AggregatedHaplotypeStats {
     std::string bam_source;             // BAM來源
     std::string variant_type_group;     // 變異類型組 (SNV/INDEL等)
     std::map<std::string, float> vcf_methylation_means;  // 每個VCF的平均甲基化
-    float difference = 0.0f;            // VCF之間的甲基化差異
-    float p_value = 1.0f;               // 統計顯著性p值
+    float difference = 0.0f;            // 前兩個VCF之間的甲基化差異
+    float p_value = 1.0f;               // 前兩個VCF之間的 Welch t 檢定p值 (無法計算時為1)
+    std::vector<PairwiseMethylationTest> pairwise_tests;  // 所有VCF兩兩比較 (依VCF來源排序的配對順序)
+    double permutation_p = std::numeric_limits<double>::quiet_NaN();        // difference 的雙尾置換檢定p值 (--permutations)
+    uint64_t permutations_run = 0;                                          // 實際執行的置換數 (提前停止時少於 --permutations)
+    double difference_ci_lower = std::numeric_limits<double>::quiet_NaN();  // difference 的 95% bootstrap 信賴區間下限
+    double difference_ci_upper = std::numeric_limits<double>::quiet_NaN();  // difference 的 95% bootstrap 信賴區間上限
 };
 
 /**
@@ -124,7 +151,7 @@ struct GlobalSummaryMetrics {
  * @brief 分析結果結構體
  */
 struct AnalysisResults {
-    std::vector<MethylationSiteDetail> level1_details;                 // Level 1: 原始甲基化詳情
+    Level1Details level1_details;                                      // Level 1: 原始甲基化詳情 (欄式表格或溢寫區段)
     std::vector<SomaticVariantMethylationSummary> level2_summary;      // Level 2: 變異甲基化摘要
     std::vector<AggregatedHaplotypeStats> level3_stats;                // Level 3: 單倍型統計
     GlobalSummaryMetrics global_metrics;                               // 全域摘要指標
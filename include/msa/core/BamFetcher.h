@@ -7,9 +7,24 @@
 #include <functional>
 #include <htslib/sam.h>
 #include "msa/Types.h"
+#include "msa/core/BamResourceRegistry.h"
 
 namespace msa::core {
 
+/**
+ * @brief 由記憶體池管理的BAM讀段智能指針
+ */
+using BamRecordPtr = std::unique_ptr<bam1_t, std::function<void(bam1_t*)>>;
+
+/**
+ * @brief 合併區域的讀段批次：區域內讀段只解碼一次，再依窗口分派給各變異
+ */
+struct RegionReadBatch {
+    std::vector<BamRecordPtr> reads;                 // 區域內的有效讀段 (依座標排序)
+    std::vector<std::vector<size_t>> variant_reads;  // 每個變異所覆蓋的讀段索引 (順序同區域內變異)
+    std::vector<std::vector<uint32_t>> read_variants; // 每個讀段覆蓋的變異 (區域內索引，依位置排序)
+};
+
 /**
  * @brief BAM區域抓取器，用於從BAM檔案中取出指定區域的讀段
  */
@@ -27,13 +42,13 @@ public:
     ~BamFetcher();
     
     /**
-     * @brief 打開腫瘤和正常BAM檔案
+     * @brief 向 BamResourceRegistry 借用腫瘤和正常BAM的檔案控制代碼 (標頭與索引共用)
      * @return bool 是否成功打開
      */
     bool openBamFiles();
     
     /**
-     * @brief 關閉BAM檔案
+     * @brief 歸還BAM檔案控制代碼
      */
     void closeBamFiles();
     
@@ -63,23 +78,101 @@ public:
         int window_size = 0
     );
     
+    /**
+     * @brief 一次抓取合併區域內的讀段，並分派給窗口與讀段重疊的每個變異
+     * @param region 合併後的查詢區域
+     * @param variants 排序後的變異列表 (region 以索引引用其中的變異)
+     * @param isTumor 是否為腫瘤樣本
+     * @param batch 用於存儲區域讀段與變異分派結果
+     * @return bool 是否成功抓取
+     */
+    bool fetchReadsForRegion(
+        const msa::FetchRegion& region,
+        const std::vector<msa::VcfVariantInfo>& variants,
+        bool isTumor,
+        RegionReadBatch& batch
+    );
+    
+    /**
+     * @brief 將排序後的變異窗口合併為BAM查詢區域
+     * @param variants 依染色體與位置排序的變異列表
+     * @param window_size 變異窗口半徑 (bp)
+     * @param merge_gap 相鄰窗口間距不超過此值即合併，負值表示每個變異獨立查詢
+     * @return std::vector<msa::FetchRegion> 查詢區域列表 (依變異順序)
+     */
+    static std::vector<msa::FetchRegion> planFetchRegions(
+        const std::vector<msa::VcfVariantInfo>& variants,
+        int window_size,
+        int merge_gap
+    );
+    
+    /**
+     * @brief 依 --scan-mode 為每條染色體選擇索引查詢或循序掃描，並標記查詢區域
+     * @param regions 查詢區域列表 (依變異順序)
+     * @param config 配置物件
+     * @return size_t 採用循序掃描的染色體數
+     */
+    static size_t selectScanModes(
+        std::vector<msa::FetchRegion>& regions,
+        const msa::Config& config
+    );
+    
+    /**
+     * @brief 以BAM索引估算每個查詢區域的工作量
+     *
+     * 區域在索引中對應的壓縮位元組跨度 (bin/offset) 除以該染色體每個讀段的平均壓縮位元組數，
+     * 得到抓取與解碼的讀段數；提取的讀段數再受每個變異 --max-read-depth 的上限限制。
+     * 無法取得索引統計時以區域涵蓋的鹼基數代替。
+     * @param regions 查詢區域列表 (依變異順序)
+     * @param config 配置物件
+     * @return std::vector<uint64_t> 每個區域的估算工作量 (約當讀段數，至少為1)
+     */
+    static std::vector<uint64_t> estimateRegionCosts(
+        const std::vector<msa::FetchRegion>& regions,
+        const msa::Config& config
+    );
+
 private:
+    /**
+     * @brief 染色體循序掃描游標：一條染色體只建立一次迭代器，依序為該染色體的查詢區域提供讀段
+     */
+    struct ScanCursor {
+        int tid = -1;                        // 目前掃描的染色體ID
+        int last_start = -1;                 // 上一個查詢區域的起始位置
+        hts_itr_t* iter = nullptr;           // 從第一個區域起點到染色體結尾的迭代器
+        std::vector<BamRecordPtr> carry;     // 跨越上一區域末端窗口、可能與下一區域重疊的讀段 (依座標排序)
+        BamRecordPtr lookahead;              // 已讀出但起點位於上一區域之後的讀段
+    };
+    
     const msa::Config& config_;   // 配置物件
     
-    // BAM檔案資源
-    htsFile* tumor_fp_ = nullptr;
-    bam_hdr_t* tumor_hdr_ = nullptr;
-    hts_idx_t* tumor_idx_ = nullptr;
+    // BAM檔案資源 (檔案控制代碼為本物件私有，標頭與索引由 BamResourceRegistry 共用)
+    BamHandle tumor_;
+    BamHandle normal_;
+    
+    // 循序掃描游標 (每個樣本一個)
+    ScanCursor tumor_cursor_;
+    ScanCursor normal_cursor_;
+    
+    /**
+     * @brief 重設循序掃描游標並釋放其持有的讀段
+     * @param cursor 掃描游標
+     */
+    void resetCursor(ScanCursor& cursor);
     
-    htsFile* normal_fp_ = nullptr;
-    bam_hdr_t* normal_hdr_ = nullptr;
-    hts_idx_t* normal_idx_ = nullptr;
+    /**
+     * @brief 確保游標位於查詢區域所在的染色體，必要時重新建立迭代器
+     * @param cursor 掃描游標
+     * @param handle BAM檔案控制代碼
+     * @param tid 染色體ID
+     * @param region 查詢區域
+     * @return bool 是否成功
+     */
+    bool positionCursor(ScanCursor& cursor, const BamHandle& handle, int tid, const msa::FetchRegion& region);
     
     /**
      * @brief 從BAM檔案抓取指定區域的讀段
-     * @param fp BAM檔案指標
-     * @param hdr BAM標頭
-     * @param idx BAM索引
+     * @param handle BAM檔案控制代碼
      * @param chrom 染色體名稱
      * @param start 起始位置 (0-based)
      * @param end 結束位置 (0-based)
@@ -87,22 +180,13 @@ private:
      * @return bool 是否成功抓取
      */
     bool fetchReadsFromRegion(
-        htsFile* fp,
-        bam_hdr_t* hdr,
-        hts_idx_t* idx,
+        const BamHandle& handle,
         const std::string& chrom,
         int start,
         int end,
         std::vector<bam1_t*>& reads
     );
     
-    /**
-     * @brief 獲取BAM索引
-     * @param bamPath BAM檔案路徑
-     * @return hts_idx_t* BAM索引指標
-     */
-    hts_idx_t* getBamIndex(const std::string& bamPath);
-    
     /**
      * @brief 檢查讀段是否符合條件（品質過濾等）
      * @param b BAM讀段
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <htslib/sam.h>
+
+namespace msa::core {
+
+/**
+ * @brief 單一BAM檔案的共用唯讀資源 (標頭、索引與染色體ID表)
+ */
+struct BamResource {
+    std::string path;                                    // BAM檔案路徑
+    bam_hdr_t* hdr = nullptr;                            // BAM標頭 (唯讀共用)
+    hts_idx_t* idx = nullptr;                            // BAM索引 (唯讀共用)
+    std::unordered_map<std::string, int> tid_by_name;    // 染色體名稱到ID的映射 (載入時建立，避免並行查詢標頭)
+    
+    /**
+     * @brief 查詢染色體ID
+     * @param chrom 染色體名稱
+     * @return int 染色體ID，找不到時返回-1
+     */
+    int getTid(const std::string& chrom) const;
+};
+
+/**
+ * @brief 借出的BAM檔案控制代碼：檔案控制代碼為執行緒私有，標頭與索引共用
+ */
+struct BamHandle {
+    htsFile* fp = nullptr;                   // 執行緒私有的檔案控制代碼
+    const BamResource* resource = nullptr;   // 共用的唯讀資源
+    
+    /**
+     * @brief 是否為可用的控制代碼
+     */
+    bool valid() const { return fp && resource && resource->idx; }
+};
+
+/**
+ * @brief BAM資源註冊中心：每個路徑只載入一次標頭與索引，並向各執行緒借出私有檔案控制代碼
+ */
+class BamResourceRegistry {
+public:
+    /**
+     * @brief 獲取BamResourceRegistry單例實例
+     * @return BamResourceRegistry& 單例引用
+     */
+    static BamResourceRegistry& getInstance();
+    
+    /**
+     * @brief 獲取BAM檔案的共用資源，首次呼叫時載入標頭與索引
+     * @param bamPath BAM檔案路徑
+     * @return const BamResource* 共用資源，載入失敗時返回nullptr
+     */
+    const BamResource* getResource(const std::string& bamPath);
+    
+    /**
+     * @brief 借出BAM檔案控制代碼 (優先重用先前歸還的控制代碼)
+     * @param bamPath BAM檔案路徑
+     * @param handle 用於存儲借出的控制代碼
+     * @return bool 是否成功借出
+     */
+    bool acquire(const std::string& bamPath, BamHandle& handle);
+    
+    /**
+     * @brief 歸還BAM檔案控制代碼，供後續借用重用
+     * @param handle 借出的控制代碼 (歸還後清空)
+     */
+    void release(BamHandle& handle);
+    
+    /**
+     * @brief 關閉所有閒置控制代碼並釋放共用標頭與索引，必須在所有控制代碼歸還後呼叫
+     */
+    void releaseAll();
+    
+    /**
+     * @brief 獲取註冊中心統計資訊
+     * @return std::string 統計信息字串
+     */
+    std::string getStats() const;
+    
+private:
+    BamResourceRegistry() = default; // 私有建構函數
+    ~BamResourceRegistry(); // 私有解構函數
+    
+    // 禁止複製與賦值
+    BamResourceRegistry(const BamResourceRegistry&) = delete;
+    BamResourceRegistry& operator=(const BamResourceRegistry&) = delete;
+    
+    // 每個路徑的註冊項目
+    struct Entry {
+        std::once_flag load_once;               // 確保標頭與索引只載入一次
+        bool loaded = false;                    // 是否載入成功
+        BamResource resource;                   // 共用資源
+        std::vector<htsFile*> idle_handles;     // 已歸還的閒置控制代碼
+        size_t opened_handles = 0;              // 已開啟的控制代碼總數
+    };
+    
+    /**
+     * @brief 獲取或建立註冊項目並確保資源已載入
+     * @param bamPath BAM檔案路徑
+     * @return Entry* 註冊項目，載入失敗時返回nullptr
+     */
+    Entry* getLoadedEntry(const std::string& bamPath);
+    
+    /**
+     * @brief 載入BAM標頭與索引
+     * @param entry 註冊項目
+     */
+    void loadEntry(Entry& entry);
+    
+    mutable std::mutex mutex_;                                          // 保護註冊表與閒置控制代碼
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;   // 路徑到註冊項目的映射
+};
+
+} // namespace msa::core
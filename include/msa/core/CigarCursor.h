@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <htslib/sam.h>
+
+namespace msa::core {
+
+/**
+ * @brief CIGAR游標：沿CIGAR操作前進，在讀段座標與參考座標之間轉換
+ *
+ * 不建立逐鹼基的映射表，記憶體為O(1)；以遞增順序查詢時整個讀段只走訪CIGAR一次
+ * (查詢位置小於目前操作時自動從頭開始，因此任意順序仍然正確)。
+ */
+class CigarCursor {
+public:
+    /**
+     * @brief 建構函數
+     * @param read BAM讀段 (游標存續期間必須有效)
+     */
+    explicit CigarCursor(const bam1_t* read)
+        : cigar_(bam_get_cigar(read)),
+          n_cigar_(read->core.n_cigar),
+          read_length_(read->core.l_qseq),
+          start_ref_(static_cast<int64_t>(read->core.pos)) {
+        rewind();
+    }
+
+    /**
+     * @brief 讀段位置轉參考位置
+     * @param read_pos 讀段位置 (0-based)
+     * @return int64_t 參考位置 (1-based)，位於插入/軟剪切或超出讀段時返回-1
+     */
+    int64_t refPosForReadPos(int64_t read_pos) {
+        if (read_pos < 0 || read_pos >= read_length_) {
+            return -1;
+        }
+        if (read_pos < op_read_) {
+            rewind();
+        }
+
+        // 跳過結束於查詢位置之前的操作 (不消耗讀段的操作長度為0，一併跳過)
+        while (index_ < n_cigar_ && read_pos >= op_read_ + readLength(index_)) {
+            advance();
+        }
+        if (index_ >= n_cigar_ || !consumesBoth(index_)) {
+            return -1;
+        }
+        return op_ref_ + (read_pos - op_read_) + 1;
+    }
+
+    /**
+     * @brief 參考位置轉讀段位置
+     * @param ref_pos 參考位置 (0-based)
+     * @return int64_t 讀段位置 (0-based)，位於刪除/跳過區域或讀段未覆蓋時返回-1
+     */
+    int64_t readPosForRefPos(int64_t ref_pos) {
+        if (ref_pos < start_ref_) {
+            return -1;
+        }
+        if (ref_pos < op_ref_) {
+            rewind();
+        }
+
+        // 跳過結束於查詢位置之前的操作 (不消耗參考的操作長度為0，一併跳過)
+        while (index_ < n_cigar_ && ref_pos >= op_ref_ + refLength(index_)) {
+            advance();
+        }
+        if (index_ >= n_cigar_ || !consumesBoth(index_)) {
+            return -1;
+        }
+        return op_read_ + (ref_pos - op_ref_);
+    }
+
+    /**
+     * @brief 參考位置之前已消耗的讀段鹼基數，用於將參考區間轉換為讀段區間
+     * @param ref_pos 參考位置 (0-based)
+     * @return int64_t 讀段位置 (0-based)：比對於 ref_pos 或之後的鹼基皆不小於此值，
+     *         比對於 ref_pos 之前的鹼基皆小於此值
+     */
+    int64_t readOffsetForRefPos(int64_t ref_pos) {
+        if (ref_pos <= start_ref_) {
+            return 0;
+        }
+        if (ref_pos < op_ref_) {
+            rewind();
+        }
+
+        while (index_ < n_cigar_ && ref_pos >= op_ref_ + refLength(index_)) {
+            advance();
+        }
+        if (index_ < n_cigar_ && consumesBoth(index_)) {
+            return op_read_ + (ref_pos - op_ref_);
+        }
+        // 位於刪除/跳過區域或比對結束之後
+        return op_read_;
+    }
+
+private:
+    /**
+     * @brief 回到第一個CIGAR操作
+     */
+    void rewind() {
+        index_ = 0;
+        op_read_ = 0;
+        op_ref_ = start_ref_;
+    }
+
+    /**
+     * @brief 前進到下一個CIGAR操作
+     */
+    void advance() {
+        op_read_ += readLength(index_);
+        op_ref_ += refLength(index_);
+        ++index_;
+    }
+
+    /**
+     * @brief 操作消耗的讀段長度
+     */
+    int64_t readLength(uint32_t i) const {
+        return (bam_cigar_type(bam_cigar_op(cigar_[i])) & 1) ? bam_cigar_oplen(cigar_[i]) : 0;
+    }
+
+    /**
+     * @brief 操作消耗的參考長度
+     */
+    int64_t refLength(uint32_t i) const {
+        return (bam_cigar_type(bam_cigar_op(cigar_[i])) & 2) ? bam_cigar_oplen(cigar_[i]) : 0;
+    }
+
+    /**
+     * @brief 操作是否同時消耗讀段與參考 (M/=/X)
+     */
+    bool consumesBoth(uint32_t i) const {
+        return bam_cigar_type(bam_cigar_op(cigar_[i])) == 3;
+    }
+
+    const uint32_t* cigar_;   // CIGAR操作陣列
+    uint32_t n_cigar_;        // CIGAR操作數
+    int64_t read_length_;     // 讀段長度 (l_qseq)
+    int64_t start_ref_;       // 比對起始參考位置 (0-based)
+
+    uint32_t index_ = 0;      // 目前操作索引
+    int64_t op_read_ = 0;     // 目前操作起始的讀段位置 (0-based)
+    int64_t op_ref_ = 0;      // 目前操作起始的參考位置 (0-based)
+};
+
+} // namespace msa::core
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "msa/Types.h"
+#include "msa/core/BamFetcher.h"
+#include "msa/core/MethylHaploExtractor.h"
+#include "msa/core/MethylationAggregator.h"
+#include "msa/utils/MemoryGovernor.h"
+#include "msa/utils/TimingHistogram.h"
+
+namespace msa::core {
+
+/**
+ * @brief 甲基化提取流程：將變異合併為查詢區域，抓取讀段並提取每個變異周圍的甲基化位點
+ */
+class ExtractionPipeline {
+public:
+    /**
+     * @brief 建構函數
+     * @param config 配置物件
+     */
+    ExtractionPipeline(const msa::Config& config);
+    
+    /**
+     * @brief 對排序後的變異執行甲基化提取
+     *
+     * 設定了 Level 1 預算時，提取期間用量超過預算則將已完成變異的表格溢寫為磁碟上的排序區段，
+     * 結束時其餘表格也寫出，結果為依變異順序合併讀取的區段；否則合併為記憶體中的單一表格，
+     * 不再登記於本流程的 Level 1 用量，由呼叫端自行登記。溢寫失敗時拋出 std::runtime_error。
+     * @param variants 依染色體與位置排序的變異列表
+     * @return msa::Level1Details 依變異順序排列的甲基化位點
+     */
+    msa::Level1Details run(const std::vector<msa::VcfVariantInfo>& variants);
+    
+    /**
+     * @brief 對排序後的變異執行甲基化提取，保留每個變異各自的位點表格
+     *
+     * 表格的記憶體登記於 Level 1 用量，直到本流程解構。
+     * @param variants 依染色體與位置排序的變異列表
+     * @return std::vector<msa::MethylationSiteTable> 每個變異的甲基化位點 (順序同 variants)
+     */
+    std::vector<msa::MethylationSiteTable> runPerVariant(const std::vector<msa::VcfVariantInfo>& variants);
+    
+    /**
+     * @brief 對排序後的變異執行甲基化提取，位點直接送入聚合器而不保留 Level 1 表格 (僅輸出摘要)
+     *
+     * 雙股覆蓋須統計同一CpG的所有位點，因此以互相重疊 (或相接) 的查詢區域為一個群集：群集的
+     * 所有區域提取完成時，其CpG的覆蓋數已完整，由完成最後一個區域的工作執行緒統計覆蓋並送入聚合器，
+     * 隨即釋放表格。同時存在的表格只有尚未完成的群集。
+     * @param variants 依染色體與位置排序的變異列表
+     * @param aggregator 聚合器
+     */
+    void runAggregated(const std::vector<msa::VcfVariantInfo>& variants, MethylationAggregator& aggregator);
+
+private:
+    /**
+     * @brief 一個查詢區域已抓取的讀段 (預取佇列的項目)
+     */
+    struct RegionWork {
+        size_t region_index = 0;          // 查詢區域索引
+        RegionReadBatch tumor;            // 腫瘤樣本讀段
+        RegionReadBatch normal;           // 對照樣本讀段
+        bool use_tumor = false;           // 是否成功抓取腫瘤樣本
+        bool use_normal = false;          // 是否成功抓取對照樣本
+        uint64_t fetch_micros = 0;        // 抓取耗時 (微秒)
+    };
+    
+    /**
+     * @brief 工作單元：同一染色體上連續的查詢區域，由同一執行緒依序抓取與提取
+     *
+     * 索引模式的區域依估算工作量切成連續的基因組區塊 (相鄰區域沿用同一執行緒的BAM控制代碼與
+     * BGZF區塊)；循序模式為同一染色體的所有查詢區域 (共用掃描游標)。
+     */
+    struct ScanUnit {
+        size_t first_region = 0;          // 第一個查詢區域索引
+        size_t last_region = 0;           // 最後一個查詢區域之後的索引 (不含)
+        uint64_t cost = 0;                // 估算工作量 (BamFetcher::estimateRegionCosts 的總和)
+    };
+    
+    /**
+     * @brief 單次提取的耗時統計
+     */
+    struct RunTiming {
+        msa::utils::TimingHistogram variant_micros;        // 每個變異的耗時 (區域耗時平均分攤給區域內的變異)
+        std::atomic<uint64_t> max_unit_micros{0};          // 最長的工作單元耗時
+        std::atomic<int64_t> last_unit_start_micros{-1};   // 最後一個工作單元開始的時間 (相對於 start)
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();  // 提取開始時間
+        
+        /**
+         * @brief 自 start 起經過的微秒數
+         */
+        int64_t elapsedMicros() const;
+        
+        /**
+         * @brief 記錄工作單元的開始 (依領取順序，最後一個單元決定長尾)
+         * @param unit_index 領取順序
+         * @param n_units 工作單元總數
+         */
+        void unitStarted(size_t unit_index, size_t n_units);
+        
+        /**
+         * @brief 記錄工作單元的耗時
+         * @param micros 耗時 (微秒)
+         */
+        void unitFinished(uint64_t micros);
+        
+        /**
+         * @brief 記錄查詢區域的耗時，平均分攤給區域內的變異
+         * @param region 查詢區域
+         * @param micros 耗時 (微秒)
+         */
+        void regionFinished(const msa::FetchRegion& region, uint64_t micros);
+    };
+    
+    /**
+     * @brief 工作執行緒私有的BAM讀取器與提取器 (依排程器的工作執行緒編號存放，首次使用時建立)
+     */
+    struct WorkerContext {
+        BamFetcher bam_fetcher;              // BAM檔案讀取器 (循序掃描游標跨工作單元保留)
+        MethylHaploExtractor meth_extractor; // 甲基化/單倍型提取器
+        bool bam_opened = false;             // 是否已借用BAM檔案控制代碼
+        
+        explicit WorkerContext(const msa::Config& config) : bam_fetcher(config), meth_extractor(config) {}
+    };
+    
+    /**
+     * @brief 取得目前工作執行緒的私有資源
+     * @param contexts 每個工作執行緒的資源 (大小至少為排程器執行緒數)
+     * @param open_bam 首次建立時是否借用BAM檔案控制代碼
+     * @return WorkerContext& 私有資源
+     */
+    WorkerContext& workerContext(std::vector<std::unique_ptr<WorkerContext>>& contexts, bool open_bam);
+    
+    /**
+     * @brief 抓取查詢區域內的腫瘤與對照讀段 (每個BAM只建立一次迭代器)
+     * @param region 查詢區域
+     * @param variants 排序後的變異列表
+     * @param bam_fetcher BAM檔案讀取器
+     * @param work 用於存儲抓取結果
+     */
+    void fetchRegion(
+        const msa::FetchRegion& region,
+        const std::vector<msa::VcfVariantInfo>& variants,
+        BamFetcher& bam_fetcher,
+        RegionWork& work
+    );
+    
+    /**
+     * @brief 為查詢區域內每個變異提取甲基化位點
+     * @param region 查詢區域
+     * @param variants 排序後的變異列表
+     * @param work 已抓取的讀段
+     * @param meth_extractor 甲基化/單倍型提取器
+     * @param variant_results 每個變異的甲基化位點表格 (以變異索引存放)
+     */
+    void extractRegion(
+        const msa::FetchRegion& region,
+        const std::vector<msa::VcfVariantInfo>& variants,
+        const RegionWork& work,
+        MethylHaploExtractor& meth_extractor,
+        std::vector<msa::MethylationSiteTable>& variant_results
+    );
+    
+    /**
+     * @brief 同步模式：每個工作單元為一個排程任務，由工作執行緒依序抓取並提取
+     */
+    void runSynchronous(
+        const std::vector<msa::FetchRegion>& regions,
+        const std::vector<ScanUnit>& units,
+        const std::vector<msa::VcfVariantInfo>& variants,
+        std::vector<msa::MethylationSiteTable>& variant_results,
+        RunTiming& timing
+    );
+    
+    /**
+     * @brief 預取模式：讀取執行緒依序抓取區域讀段放入有界佇列，提取任務並行消費
+     *
+     * 讀取執行緒在抓取區域前依估算工作量登記讀段批次 (超過預算時等待)，抓取後調整為實際大小。
+     * 抓取或提取拋出例外時停止所有讀取執行緒，待提取任務全部結束後重新拋出。
+     */
+    void runPrefetch(
+        const std::vector<msa::FetchRegion>& regions,
+        const std::vector<uint64_t>& region_costs,
+        const std::vector<ScanUnit>& units,
+        const std::vector<msa::VcfVariantInfo>& variants,
+        std::vector<msa::MethylationSiteTable>& variant_results,
+        RunTiming& timing
+    );
+    
+    /**
+     * @brief 將查詢區域分組為工作單元 (循序掃描的染色體必須由同一個讀取者依序處理)
+     * @param regions 查詢區域列表
+     * @param region_costs 每個查詢區域的估算工作量
+     * @param target_units 索引模式區域的目標區塊數 (決定每個區塊的工作量上限)
+     * @return std::vector<ScanUnit> 工作單元列表 (依基因組順序)
+     */
+    static std::vector<ScanUnit> groupScanUnits(
+        const std::vector<msa::FetchRegion>& regions,
+        const std::vector<uint64_t>& region_costs,
+        size_t target_units
+    );
+    
+    /**
+     * @brief 登記查詢區域已完成的變異，Level 1 用量超過預算且累積足夠時寫出一個溢寫區段
+     * @param region 查詢區域
+     * @param table_bytes 區域內變異表格佔用的位元組數
+     * @param variant_results 每個變異的甲基化位點表格
+     */
+    void spillFinishedVariants(
+        const msa::FetchRegion& region,
+        size_t table_bytes,
+        std::vector<msa::MethylationSiteTable>& variant_results
+    );
+    
+    /**
+     * @brief 將查詢區域分為互相重疊或相接的群集 (runAggregated 用)
+     * @param regions 查詢區域列表
+     * @param n_variants 變異數
+     */
+    void planAggregationClusters(const std::vector<msa::FetchRegion>& regions, size_t n_variants);
+    
+    /**
+     * @brief 查詢區域提取完成；所屬群集的區域全部完成時統計覆蓋並將群集的位點送入聚合器
+     * @param region 查詢區域
+     * @param variant_results 每個變異的甲基化位點表格
+     */
+    void aggregateFinishedRegion(const msa::FetchRegion& region, std::vector<msa::MethylationSiteTable>& variant_results);
+    
+    /**
+     * @brief 統計群集的雙股覆蓋並將其位點送入聚合器，隨即釋放表格
+     * @param cluster 群集索引
+     * @param variant_results 每個變異的甲基化位點表格
+     */
+    void aggregateCluster(size_t cluster, std::vector<msa::MethylationSiteTable>& variant_results);
+    
+    /**
+     * @brief 估算讀段批次佔用的位元組數
+     * @param work 已抓取的讀段
+     * @return size_t 位元組數
+     */
+    static size_t estimateBytes(const RegionWork& work);
+    
+    const msa::Config& config_;  // 配置物件
+    
+    // 本流程產生的每個變異位點表格的 Level 1 用量登記 (解構時釋放)
+    msa::utils::MemoryGovernor::Reservation level1_;
+    
+    // run 的 Level 1 溢寫 (未設定預算或 runPerVariant 時為空)
+    std::shared_ptr<msa::Level1Spill> spill_;
+    size_t spill_min_bytes_ = 0;               // 每個溢寫區段至少累積的位元組數
+    std::atomic<bool> spill_disabled_{false};  // 溢寫失敗後停止於提取期間溢寫
+    
+    // runAggregated 的串流聚合 (其他模式為空)
+    MethylationAggregator* aggregator_ = nullptr;
+    std::vector<size_t> variant_cluster_;                        // 每個變異所屬的群集
+    std::vector<std::pair<size_t, size_t>> cluster_variants_;    // 每個群集的變異範圍 [first, last)
+    std::unique_ptr<std::atomic<size_t>[]> cluster_pending_;     // 每個群集尚未完成的區域數
+};
+
+} // namespace msa::core
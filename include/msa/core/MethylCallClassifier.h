@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "msa/MethylationSiteTable.h"
+
+namespace msa::core {
+
+/**
+ * @brief 將ML值批次分類為高/中/低甲基化狀態
+ *
+ * ML只有256種值，建構時以與輸出相同的換算 (MethylationSiteTable::mlToMethCall) 與閾值比較
+ * 求出整數分界，之後的分類只需位元組比較：依CPU於執行期選擇AVX-512BW、AVX2或SSE2核心，
+ * 結果與逐一以浮點數比較完全相同。
+ */
+class MethylCallClassifier {
+public:
+    /**
+     * @brief 分類核心：ml >= high_cut 為高 (2)，ml > low_cut 為中 (1)，其餘為低 (0)
+     */
+    using Kernel = void (*)(const uint8_t* ml, size_t n, uint8_t* states, uint8_t high_cut, uint8_t low_cut);
+    
+    /**
+     * @brief 具名的分類核心
+     */
+    struct NamedKernel {
+        const char* name;   // 核心名稱
+        Kernel kernel;      // 核心函數
+    };
+    
+    /**
+     * @brief 建構函數
+     * @param high_threshold 高甲基化閾值 (甲基化程度 >= 此值為高)
+     * @param low_threshold 低甲基化閾值 (甲基化程度 <= 此值為低)
+     */
+    MethylCallClassifier(float high_threshold, float low_threshold);
+    
+    /**
+     * @brief 分類單一ML值
+     * @param ml ML值 (0-255)
+     * @return msa::MethState 甲基化狀態
+     */
+    msa::MethState classify(uint8_t ml) const { return static_cast<msa::MethState>(lut_[ml]); }
+    
+    /**
+     * @brief 批次分類ML值
+     * @param ml ML值陣列
+     * @param n 數量
+     * @param states 輸出的甲基化狀態 (MethState數值，可與 ml 為同一陣列)
+     */
+    void classify(const uint8_t* ml, size_t n, uint8_t* states) const;
+    
+    /**
+     * @brief 目前CPU選用的向量核心名稱 (用於日誌)
+     * @return const char* 核心名稱
+     */
+    static const char* kernelName();
+    
+    /**
+     * @brief 純量參考核心與目前CPU可執行的所有向量核心 (第一個為純量核心，供測試逐一比對)
+     * @return std::vector<NamedKernel> 核心列表
+     */
+    static std::vector<NamedKernel> kernels();
+
+private:
+    uint8_t lut_[256];          // 逐值分類表 (分界無法以位元組表示時使用)
+    uint8_t high_cut_ = 0;      // 最小的高甲基化ML值
+    uint8_t low_cut_ = 0;       // 最大的低甲基化ML值
+    bool use_kernel_ = false;   // 分界可由向量核心表示
+};
+
+} // namespace msa::core
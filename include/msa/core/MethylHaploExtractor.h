@@ -4,6 +4,11 @@
 #include <vector>
 #include <htslib/sam.h>
 #include "msa/Types.h"
+#include "msa/utils/ScratchArena.h"
+#include "msa/core/CigarCursor.h"
+#include "msa/core/MethylTagParser.h"
+#include "msa/core/MethylCallClassifier.h"
+#include "msa/core/ReadParseCache.h"
 
 namespace msa::core {
 
@@ -18,40 +23,141 @@ public:
      */
     MethylHaploExtractor(const msa::Config& config);
     
+    /**
+     * @brief 解構函數
+     */
+    ~MethylHaploExtractor();
+    
+    // 禁止複製與賦值 (持有執行緒私有的暫存空間與解析緩衝區)
+    MethylHaploExtractor(const MethylHaploExtractor&) = delete;
+    MethylHaploExtractor& operator=(const MethylHaploExtractor&) = delete;
+    
     /**
      * @brief 從讀段中提取甲基化與單倍型信息
      * @param read BAM讀段
      * @param target_variant 目標變異
      * @param bam_source_id BAM來源ID (Tumor/Normal)
-     * @return std::vector<msa::MethylationSiteDetail> 提取的甲基化位點詳情
+     * @return msa::MethylationSiteTable 提取的甲基化位點
      */
-    std::vector<msa::MethylationSiteDetail> extractFromRead(
+    msa::MethylationSiteTable extractFromRead(
         const bam1_t* read,
         const msa::VcfVariantInfo& target_variant,
         const std::string& bam_source_id
     );
     
+    /**
+     * @brief 單次解析讀段的MM/ML與CIGAR，為讀段覆蓋的所有變異提取甲基化位點
+     * @param read BAM讀段
+     * @param variants 排序後的變異列表
+     * @param first_variant 區域內第一個變異在 variants 中的索引
+     * @param active_variants 讀段覆蓋的變異 (相對於 first_variant 的索引，依位置排序)
+     * @param bam_source_id BAM來源ID (Tumor/Normal)
+     * @param variant_results 每個變異的甲基化位點表格 (以變異索引存放，結果附加於尾端)
+     */
+    void extractFromReadForVariants(
+        const bam1_t* read,
+        const std::vector<msa::VcfVariantInfo>& variants,
+        size_t first_variant,
+        const std::vector<uint32_t>& active_variants,
+        const std::string& bam_source_id,
+        std::vector<msa::MethylationSiteTable>& variant_results
+    );
+    
 private:
     const msa::Config& config_;  // 配置物件
     
+    // 單一讀段處理期間的暫存空間 (甲基化記錄、等位基因判定等)，每個讀段開始時重置
+    msa::utils::ScratchArena arena_;
+    
+    // 重複使用的MM/ML解析器 (只解碼變異窗口內的修飾)
+    MethylTagParser tagParser_;
+    
+    // ML值分類器 (閾值分界於建構時求出)
+    MethylCallClassifier classifier_;
+    
+    // 全程序共用的讀段解析快取，與目前讀段的快取結果 (持有至處理下一個讀段)
+    ReadParseCache& readCache_;
+    std::shared_ptr<const CachedReadParse> cachedParse_;
+    
     /**
-     * @brief 從BAM讀段中提取甲基化信息
-     * @param read BAM讀段
-     * @param target_variant 目標變異
+     * @brief 單項字典查詢快取 (相鄰讀段的變異欄位、來源與單倍型通常相同)
+     */
+    struct InternCache {
+        std::string value;   // 上一次查詢的字串
+        uint32_t id = 0;     // 對應的字典ID
+        bool valid = false;  // 快取是否有效
+    };
+    
+    InternCache chromCache_;        // 染色體
+    InternCache variantTypeCache_;  // 變異類型
+    InternCache vcfSourceCache_;    // VCF來源
+    InternCache bamSourceCache_;    // BAM來源
+    InternCache haplotypeCache_;    // 單倍型標籤
+    
+    /**
+     * @brief 建立同一讀段在同一變異下所有位點共用的欄位 (字串欄位轉為字典ID)
+     * @param variant 變異
      * @param bam_source_id BAM來源ID
      * @param haplotype_tag 單倍型標籤
-     * @param somatic_allele_type 等位基因類型
-     * @param details 用於存儲提取的甲基化詳情
+     * @param somatic_allele_type 等位基因類型 (ref/alt)
+     * @param somatic_base 讀段在變異位置的鹼基
+     * @return msa::MethylationSiteTable::SiteContext 共用欄位
      */
-    void extractMethylation(
-        const bam1_t* read,
-        const msa::VcfVariantInfo& target_variant,
+    msa::MethylationSiteTable::SiteContext makeSiteContext(
+        const msa::VcfVariantInfo& variant,
         const std::string& bam_source_id,
         const std::string& haplotype_tag,
         const std::string& somatic_allele_type,
-        const std::string& somatic_base_at_variant,
-        const std::string& read_id,
-        std::vector<msa::MethylationSiteDetail>& details
+        const std::string& somatic_base
+    );
+    
+    /**
+     * @brief 以單項快取查詢字典ID
+     * @param which 字典種類
+     * @param value 字串
+     * @param cache 快取
+     * @return uint32_t 字串ID
+     */
+    uint32_t internCached(msa::MethylationSiteTable::Dictionary which, const std::string& value, InternCache& cache);
+    
+    /**
+     * @brief 取得讀段的甲基化記錄與單倍型標籤
+     *
+     * 未啟用讀段快取時只解碼 [ref_lo, ref_hi] 內的修飾；啟用時解碼整個比對範圍並存入快取，
+     * 同一讀段再次出現 (其他VCF或查詢區域) 時直接重用。
+     * @param read BAM讀段
+     * @param bam_source_id BAM來源ID (Tumor/Normal)
+     * @param ref_lo 需要的參考區間起點 (1-based，含)
+     * @param ref_hi 需要的參考區間終點 (1-based，含)
+     * @param records 用於存儲依參考座標遞增的記錄 (於處理下一個讀段前有效)
+     * @param haplotype_tag 用於存儲單倍型標籤 (無記錄時可能未設定)
+     * @return size_t 記錄數
+     */
+    size_t loadMethylationRecords(
+        const bam1_t* read,
+        const std::string& bam_source_id,
+        int ref_lo,
+        int ref_hi,
+        const MethylationRecord*& records,
+        std::string& haplotype_tag
+    );
+    
+    /**
+     * @brief 將位於變異窗口內的甲基化記錄附加到位點表格
+     * @param records 依參考座標遞增排序的甲基化記錄
+     * @param n_records 記錄數
+     * @param somatic_pos 變異位置 (1-based)
+     * @param ctx 共用欄位
+     * @param read_id 讀段ID
+     * @param sites 用於附加甲基化位點的表格
+     */
+    void appendWindowSites(
+        const MethylationRecord* records,
+        size_t n_records,
+        int somatic_pos,
+        msa::MethylationSiteTable::SiteContext ctx,
+        const char* read_id,
+        msa::MethylationSiteTable& sites
     );
     
     /**
@@ -64,31 +170,18 @@ private:
     /**
      * @brief 確定BAM讀段相對於變異的等位基因類型
      * @param read BAM讀段
+     * @param cigar_cursor 讀段的CIGAR游標 (依變異位置遞增查詢時不需重新走訪CIGAR)
      * @param target_variant 目標變異
      * @param somatic_base 用於存儲變異位點上的鹼基
      * @return std::string 等位基因類型 (ref/alt/unknown)
      */
     std::string determineAlleleType(
         const bam1_t* read,
+        CigarCursor& cigar_cursor,
         const msa::VcfVariantInfo& target_variant,
         std::string& somatic_base
     );
     
-    /**
-     * @brief 將甲基化水平分類為高、中、低或未知
-     * @param meth_call 甲基化水平 (0.0-1.0)
-     * @return std::string 甲基化狀態 (high/mid/low/unknown)
-     */
-    std::string classifyMethylationState(float meth_call);
-    
-    /**
-     * @brief 將參考基因組位置轉換為讀段上的位置
-     * @param read BAM讀段
-     * @param ref_pos 參考基因組位置 (0-based)
-     * @return int 讀段上的位置 (-1表示無法映射)
-     */
-    int refPosToReadPos(const bam1_t* read, int ref_pos);
-    
     /**
      * @brief 獲取讀段上指定位置的鹼基
      * @param read BAM讀段
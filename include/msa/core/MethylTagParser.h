@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <htslib/sam.h>
+
+namespace msa::core {
+
+/**
+ * @brief 單一鹼基修飾 (由MM/ML標籤解碼)
+ */
+struct BaseModCall {
+    int32_t read_pos = 0;          // 讀段位置 (0-based，BAM儲存方向)
+    int32_t modified_base = 0;     // 修飾代碼 ('m'、'h'等；ChEBI編號以負值表示，與htslib相同)
+    char canonical_base = 'N';     // MM中的標準鹼基
+    uint8_t ml = 0;                // 修飾機率 (ML值，0-255)
+    bool opposite_strand = false;  // MM中以'-'標示 (修飾位於互補鏈)
+};
+
+/**
+ * @brief MM/ML鹼基修飾標籤解析器，只解碼指定讀段區間內的修飾
+ *
+ * MM的間隔值以原始讀段方向計數標準鹼基；區間之前的項目只累加間隔值與ML索引而不走訪序列，
+ * 區間之後的項目只計算逗號數量以推進ML索引。結果依讀段位置遞增排列，同一位置依MM中的順序，
+ * 與 bam_next_basemod 的輸出順序相同。每個工作執行緒持有一個實例，內部緩衝區重複使用。
+ */
+class MethylTagParser {
+public:
+    /**
+     * @brief 解析讀段的MM/ML標籤
+     * @param read BAM讀段
+     * @param read_begin 區間起點 (讀段位置，0-based，含)
+     * @param read_end 區間終點 (讀段位置，0-based，不含)
+     * @return bool 是否成功解析 (無MM標籤、MN長度不符、ML值不足或格式錯誤時返回false)
+     */
+    bool parse(const bam1_t* read, int64_t read_begin, int64_t read_end);
+    
+    /**
+     * @brief 獲取上一次解析的修飾 (依讀段位置遞增)
+     * @return const std::vector<BaseModCall>& 修飾列表，於下一次解析前有效
+     */
+    const std::vector<BaseModCall>& calls() const { return calls_; }
+
+private:
+    std::vector<BaseModCall> calls_;    // 合併後的修飾
+    std::vector<BaseModCall> group_;    // 單一修飾組的修飾
+    std::vector<BaseModCall> merged_;   // 合併用暫存
+};
+
+} // namespace msa::core
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "msa/Types.h"
+#include "msa/utils/MemoryGovernor.h"
+
+namespace msa::core {
+
+/**
+ * @brief Level 2 摘要與全域指標的增量聚合器
+ *
+ * 以 consume 逐批累計甲基化位點，每個工作執行緒累計到各自的部分狀態，finalize 時合併。
+ * 每組只保留計數、鏈方向計數、甲基化程度的定點總和與讀段名稱雜湊集合，記憶體與組數
+ * (及每組的讀段數) 成正比，與位點數無關。分組鍵打包為128位元整數，存放於依鍵雜湊分區的
+ * 開放定址雜湊表，finalize 時各分區並行合併。所有累計值皆為整數，合併順序不影響結果，
+ * 因此並行累計的輸出與依列順序單次掃描相同。
+ */
+class MethylationAggregator {
+public:
+    /**
+     * @brief 位點 (染色體ID, 甲基化位置, BAM來源ID) 的雙股覆蓋篩選
+     *
+     * add 以並行基數排序將區塊各列依位點排列，線性掃描每個位點的連續區段合併為唯一位點的正反鏈讀段數，
+     * 再附加到依位點排序的計數表 (附加的部分累積到與已合併部分同樣多時才重新排序合併，攤銷為線性時間)；
+     * build 只保留正反鏈都達到門檻的位點；keepFlags 以二分搜尋為區塊各列生成保留旗標。
+     * 常駐記憶體與唯一位點數成正比而非列數 (溢寫的 Level 1 也不建立每列的結構)，登記於 Level 1 子系統；
+     * 篩選結果與執行緒數及區塊切分無關。
+     */
+    class StrandCoverage {
+    public:
+        /**
+         * @brief 建構函數
+         * @param parallel 是否以排程器並行處理 (在提取任務內使用時必須為 false：提取任務不可等待其他任務)
+         */
+        explicit StrandCoverage(bool parallel = true)
+            : reservation_(msa::utils::MemoryGovernor::Subsystem::Level1), parallel_(parallel) {}
+        
+        /**
+         * @brief 累計區塊內所有列的正反鏈讀段數
+         * @param batch 甲基化位點區塊
+         */
+        void add(const msa::MethylationSiteTable& batch);
+        
+        /**
+         * @brief 合併所有計數並只保留正反鏈都達到門檻的位點 (之後不再接受 add)
+         * @param min_strand_reads 每條鏈要求的最小讀段數
+         */
+        void build(int min_strand_reads);
+        
+        /**
+         * @brief 生成區塊各列的保留旗標 (1: 正反鏈都達到門檻)，必須在 build 之後呼叫
+         * @param batch 甲基化位點區塊
+         * @param flags 輸出旗標 (調整為區塊列數)
+         */
+        void keepFlags(const msa::MethylationSiteTable& batch, std::vector<uint8_t>& flags) const;
+        
+        /**
+         * @brief 目前保存的唯一位點數
+         */
+        size_t sites() const { return sites_.size(); }
+        
+        /**
+         * @brief 釋放所有位點並退回登記的用量
+         */
+        void clear();
+    
+    private:
+        /**
+         * @brief 位點的正反鏈讀段數
+         */
+        struct Site {
+            uint64_t locus = 0;    // 染色體ID (高32位元) | 甲基化位置 (低32位元)
+            uint32_t plus = 0;     // 正鏈讀段數
+            uint32_t minus = 0;    // 反鏈讀段數
+            uint16_t bam = 0;      // BAM來源ID
+        };
+        
+        /**
+         * @brief 將 [0, n) 分段處理 (依 parallel_ 選擇並行或依序)
+         * @param n 元素數
+         * @param body 處理 [begin, end) 的函數
+         */
+        void forEachRange(size_t n, const std::function<void(size_t, size_t)>& body) const;
+        
+        /**
+         * @brief 依位點排序並合併相同位點的計數
+         * @param sites 位點計數 (原地處理)
+         */
+        void sortAndCombine(std::vector<Site>& sites) const;
+        
+        /**
+         * @brief 重新排序合併附加的計數
+         */
+        void merge();
+        
+        /**
+         * @brief 將登記的用量更新為計數表的容量
+         */
+        void charge() { reservation_.set(sites_.capacity() * sizeof(Site)); }
+        
+        std::vector<Site> sites_;                              // 位點計數 (前 merged_ 項依位點排序且唯一)
+        size_t merged_ = 0;                                    // 已排序合併的項目數
+        msa::utils::MemoryGovernor::Reservation reservation_;  // 計數表與暫存區的用量
+        bool parallel_;                                        // 是否以排程器並行處理
+    };
+    
+    /**
+     * @brief 全域指標的累計值 (不經雙股覆蓋篩選)
+     */
+    struct GlobalTally {
+        std::map<uint16_t, uint64_t> sites_by_vcf;                                 // [vcf_source_id] = 位點數
+        std::set<std::tuple<uint16_t, uint32_t, int32_t, uint16_t>> variant_keys;  // (vcf, chrom, pos, variant_type)
+        std::map<uint16_t, std::array<uint64_t, 3>> meth_by_bam;                   // [bam_source_id] = {高/中甲基化位點數, 其甲基化程度定點總和, 總位點數}
+    };
+    
+    /**
+     * @brief 聚合結果
+     */
+    struct Result {
+        std::vector<msa::SomaticVariantMethylationSummary> level2_summary;  // Level 2 摘要 (依文字分組鍵排序)
+        GlobalTally global;                                                 // 全域指標的累計值
+        uint64_t kept_sites = 0;                                            // 雙股覆蓋篩選後保留的位點數
+    };
+    
+    /**
+     * @brief 建構函數
+     * @param config 配置物件 (雙股覆蓋門檻)
+     */
+    explicit MethylationAggregator(const msa::Config& config);
+    ~MethylationAggregator();
+    
+    // 禁止複製與賦值 (部分狀態以工作執行緒編號存放)
+    MethylationAggregator(const MethylationAggregator&) = delete;
+    MethylationAggregator& operator=(const MethylationAggregator&) = delete;
+    
+    /**
+     * @brief 是否需要雙股覆蓋篩選 (min_strand_reads > 0)
+     */
+    bool filtersStrandCoverage() const { return min_strand_reads_ > 0; }
+    
+    /**
+     * @brief 累計區塊內 [begin, end) 的位點，可由多個工作執行緒同時呼叫 (各自累計到執行緒私有的部分狀態)
+     * @param batch 甲基化位點區塊 (呼叫返回後不再引用)
+     * @param keep 區塊各列的雙股覆蓋保留旗標 (StrandCoverage::keepFlags 生成，不需篩選時為 nullptr)
+     * @param begin 第一列
+     * @param end 最後一列之後 (不含)
+     */
+    void consume(const msa::MethylationSiteTable& batch, const uint8_t* keep, size_t begin, size_t end);
+    
+    /**
+     * @brief 累計區塊內所有位點
+     * @param batch 甲基化位點區塊
+     * @param keep 區塊各列的雙股覆蓋保留旗標 (不需篩選時為 nullptr)
+     */
+    void consume(const msa::MethylationSiteTable& batch, const uint8_t* keep) {
+        consume(batch, keep, 0, batch.size());
+    }
+    
+    /**
+     * @brief 合併各執行緒的部分狀態並生成結果，之後聚合器回到空狀態
+     * @return Result 聚合結果
+     */
+    Result finalize();
+    
+    /**
+     * @brief 甲基化程度的定點總和換算為總和
+     * @param units 定點總和
+     * @return double 甲基化程度總和
+     */
+    static double unitsToMeth(uint64_t units);
+
+private:
+    struct Partial;  // 執行緒私有的部分狀態 (定義於實作檔)
+    
+    /**
+     * @brief 取得目前工作執行緒的部分狀態
+     */
+    Partial& partial();
+    
+    int min_strand_reads_;                            // 雙股覆蓋門檻
+    std::vector<std::unique_ptr<Partial>> partials_;  // 每個工作執行緒的部分狀態
+};
+
+} // namespace msa::core
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <htslib/sam.h>
+#include "msa/MethylationSiteTable.h"
+
+namespace msa::core {
+
+/**
+ * @brief 單一讀段解析出的甲基化記錄
+ */
+struct MethylationRecord {
+    int refPos;            // 1-based 參考座標
+    uint8_t ml;            // 甲基化機率 (ML原始值，0~255)
+    msa::MethState state;  // 甲基化狀態 (解析完成後批次分類)
+    msa::Strand strand;    // 鏈方向
+};
+
+/**
+ * @brief 快取的讀段解析結果：整個比對範圍內的甲基化記錄與單倍型標籤
+ */
+struct CachedReadParse {
+    std::vector<MethylationRecord> records;  // 甲基化記錄 (依參考座標遞增)
+    std::string haplotype;                   // 單倍型標籤
+};
+
+/**
+ * @brief 讀段快取鍵：BAM來源、QNAME、染色體、位置、旗標與序列長度
+ */
+struct ReadCacheKey {
+    std::string name;     // BAM來源與QNAME ("<來源>\0<QNAME>")
+    int32_t tid = -1;     // 染色體ID
+    int64_t pos = -1;     // 比對起始位置 (0-based)
+    uint16_t flag = 0;    // SAM旗標
+    int32_t l_qseq = 0;   // 序列長度
+    uint64_t hash = 0;    // 雜湊值 (建立時計算)
+    
+    bool operator==(const ReadCacheKey& other) const {
+        return hash == other.hash && tid == other.tid && pos == other.pos && flag == other.flag &&
+               l_qseq == other.l_qseq && name == other.name;
+    }
+};
+
+/**
+ * @brief 分片LRU讀段解析快取 (全程序共用)
+ *
+ * 同一讀段會被多個VCF的分析與跨越多個查詢區域時重複處理，快取其完整的MM/ML解碼結果與單倍型，
+ * 避免重複解碼。鍵的雜湊決定分片，每個分片以獨立的互斥鎖保護並各自依LRU淘汰，
+ * 取出的結果以 shared_ptr 共用，被淘汰後仍可安全使用。
+ */
+class ReadParseCache {
+public:
+    /**
+     * @brief 獲取ReadParseCache單例實例
+     * @return ReadParseCache& 單例引用
+     */
+    static ReadParseCache& getInstance();
+    
+    /**
+     * @brief 設定快取容量並清除現有內容，必須在工作執行緒開始前呼叫
+     * @param capacityBytes 容量 (位元組)，0表示停用
+     */
+    void configure(size_t capacityBytes);
+    
+    /**
+     * @brief 快取是否啟用
+     */
+    bool enabled() const { return capacity_ > 0; }
+    
+    /**
+     * @brief 建立讀段的快取鍵
+     * @param read BAM讀段
+     * @param bamSource BAM來源ID (Tumor/Normal)
+     * @return ReadCacheKey 快取鍵
+     */
+    static ReadCacheKey makeKey(const bam1_t* read, const std::string& bamSource);
+    
+    /**
+     * @brief 查詢快取，命中時更新為最近使用
+     * @param key 快取鍵
+     * @return std::shared_ptr<const CachedReadParse> 解析結果，未命中時返回nullptr
+     */
+    std::shared_ptr<const CachedReadParse> lookup(const ReadCacheKey& key);
+    
+    /**
+     * @brief 加入解析結果，分片超出容量時淘汰最久未使用的項目
+     * @param key 快取鍵
+     * @param parse 解析結果
+     */
+    void insert(const ReadCacheKey& key, std::shared_ptr<const CachedReadParse> parse);
+    
+    /**
+     * @brief 獲取快取統計資訊 (命中、未命中、淘汰數與目前用量)
+     * @return std::string 統計信息字串
+     */
+    std::string getStats() const;
+
+private:
+    ReadParseCache() = default; // 私有建構函數
+    ~ReadParseCache() = default; // 私有解構函數
+    
+    // 禁止複製與賦值
+    ReadParseCache(const ReadParseCache&) = delete;
+    ReadParseCache& operator=(const ReadParseCache&) = delete;
+    
+    // 分片數 (2的冪次)
+    static constexpr size_t kShards = 64;
+    
+    /**
+     * @brief 鍵的雜湊函數
+     */
+    struct KeyHash {
+        size_t operator()(const ReadCacheKey& key) const { return static_cast<size_t>(key.hash); }
+    };
+    
+    /**
+     * @brief 快取項目
+     */
+    struct Entry {
+        ReadCacheKey key;                               // 快取鍵
+        std::shared_ptr<const CachedReadParse> parse;   // 解析結果
+        size_t bytes = 0;                               // 估算佔用的位元組數
+    };
+    
+    /**
+     * @brief 快取分片
+     */
+    struct Shard {
+        mutable std::mutex mutex;                                                  // 保護分片內容
+        std::list<Entry> lru;                                                      // 依使用順序排列 (最近使用在前)
+        std::unordered_map<ReadCacheKey, std::list<Entry>::iterator, KeyHash> map;  // 鍵到項目的映射
+        size_t bytes = 0;                                                          // 目前用量
+    };
+    
+    /**
+     * @brief 估算項目佔用的位元組數
+     * @param key 快取鍵
+     * @param parse 解析結果
+     * @return size_t 位元組數
+     */
+    static size_t entryBytes(const ReadCacheKey& key, const CachedReadParse& parse);
+    
+    /**
+     * @brief 依雜湊值選擇分片
+     */
+    Shard& shardFor(const ReadCacheKey& key) { return shards_[(key.hash >> 32) & (kShards - 1)]; }
+    
+    Shard shards_[kShards];                    // 快取分片
+    size_t capacity_ = 0;                      // 總容量 (位元組)
+    size_t shard_capacity_ = 0;                // 每個分片的容量 (位元組)
+    
+    // 統計計數
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> insertions_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
+
+} // namespace msa::core
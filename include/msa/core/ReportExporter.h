@@ -24,7 +24,7 @@ public:
      * @return bool 匯出成功與否
      */
     bool exportResults(const msa::AnalysisResults& results, const std::string& vcf_source_id);
-    
+
 private:
     /**
      * @brief 匯出全域摘要指標
@@ -36,11 +36,11 @@ private:
     
     /**
      * @brief 匯出Level 1原始甲基化詳情
-     * @param details 原始甲基化詳情
+     * @param details 原始甲基化位點 (記憶體中的表格或溢寫區段)
      * @param outputDir 輸出目錄
      * @return bool 匯出成功與否
      */
-    bool exportLevel1Details(const std::vector<msa::MethylationSiteDetail>& details, const std::string& outputDir);
+    bool exportLevel1Details(const msa::Level1Details& details, const std::string& outputDir);
     
     /**
      * @brief 匯出Level 2變異甲基化摘要
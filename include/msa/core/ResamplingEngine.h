@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace msa::core {
+
+/**
+ * @brief Level 3 甲基化差異的置換檢定與 bootstrap 信賴區間
+ *
+ * 每次置換或重抽樣使用各自的 Philox 串流 (鍵由種子與分組編號決定，計數器由重抽樣編號決定)，
+ * 重抽樣以批次並行執行，結果與執行緒數及排程順序無關。置換檢定採 Besag–Clifford 序列停止：
+ * 超過觀測差異的置換數達到門檻即停止，明顯不顯著的分組只需少量置換。
+ * bootstrap 以固定大小的區段計算，只保留百分位數所需的兩側尾端 (各約為重抽樣數的 2.5%)。
+ */
+class ResamplingEngine {
+public:
+    /**
+     * @brief 重抽樣結果 (無法計算時p值與信賴區間為 NaN)
+     */
+    struct Result {
+        double permutation_p;       // 雙尾置換檢定p值
+        uint64_t permutations;      // 實際執行的置換數 (提前停止時少於設定值)
+        double ci_lower;            // 差異 (a - b) 的 95% bootstrap 百分位信賴區間下限
+        double ci_upper;            // 差異 (a - b) 的 95% bootstrap 百分位信賴區間上限
+    };
+    
+    /**
+     * @brief 建構函數
+     * @param permutations 每組的置換數與 bootstrap 重抽樣數
+     * @param seed 亂數種子
+     */
+    explicit ResamplingEngine(int permutations, uint64_t seed = kDefaultSeed);
+    
+    /**
+     * @brief 比較兩組數值的平均差異
+     * @param a 第一組數值
+     * @param b 第二組數值
+     * @param group 分組編號 (決定亂數串流，相同輸入與編號的結果固定)
+     * @return Result 置換檢定p值與 bootstrap 信賴區間
+     */
+    Result compare(const std::vector<float>& a, const std::vector<float>& b, uint64_t group) const;
+    
+    static constexpr uint64_t kDefaultSeed = 0x4D534131u;  // 預設種子
+
+private:
+    /**
+     * @brief 雙尾置換檢定
+     * @param a 第一組數值
+     * @param b 第二組數值
+     * @param key 亂數鍵
+     * @param result 寫入p值與置換數
+     */
+    void permutationTest(const std::vector<float>& a, const std::vector<float>& b, uint64_t key, Result& result) const;
+    
+    /**
+     * @brief bootstrap 百分位信賴區間
+     * @param a 第一組數值
+     * @param b 第二組數值
+     * @param key 亂數鍵
+     * @param result 寫入信賴區間
+     */
+    void bootstrap(const std::vector<float>& a, const std::vector<float>& b, uint64_t key, Result& result) const;
+    
+    uint64_t permutations_;  // 置換數與 bootstrap 重抽樣數
+    uint64_t seed_;          // 亂數種子
+};
+
+} // namespace msa::core
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <string>
 #include <map>
 #include <set>
 #include "msa/Types.h"
+#include "msa/core/MethylationAggregator.h"
 
 namespace msa::core {
 
@@ -21,30 +23,43 @@ public:
     
     /**
      * @brief 分析甲基化位點數據
-     * @param sites 甲基化位點詳情
+     *
+     * 位點依區塊逐一掃描 (溢寫至磁碟時每個變異為一個區塊)，不需要將全部位點載入記憶體。
+     * 溢寫資料無法讀取時拋出 std::runtime_error。
+     * @param level1 甲基化位點 (移入分析結果作為Level 1詳情)
      * @return msa::AnalysisResults 分析結果
      */
-    msa::AnalysisResults analyze(const std::vector<msa::MethylationSiteDetail>& sites);
+    msa::AnalysisResults analyze(msa::Level1Details level1);
     
-private:
     /**
-     * @brief 根據雙股覆蓋條件過濾甲基化位點
-     * @param sites 原始甲基化位點詳情
-     * @return std::vector<msa::MethylationSiteDetail> 過濾後的位點
+     * @brief 依列順序逐塊提供位點的掃描函數 (每次呼叫都以相同順序提供相同的區塊)
      */
-    std::vector<msa::MethylationSiteDetail> filterSitesByStrandCoverage(
-        const std::vector<msa::MethylationSiteDetail>& sites);
+    using BlockScan = std::function<void(const std::function<void(const msa::MethylationSiteTable&)>&)>;
     
     /**
-     * @brief 生成Level 2甲基化摘要
-     * @param sites 甲基化位點詳情
-     * @return std::vector<msa::SomaticVariantMethylationSummary> Level 2摘要
+     * @brief 將掃描函數提供的位點經雙股覆蓋篩選後送入聚合器
+     *
+     * 需要篩選時掃描兩次：第一次統計各唯一位點的正反鏈覆蓋，第二次逐塊生成保留旗標並並行累計。
+     * @param scan 掃描函數
+     * @param aggregator 聚合器
      */
-    std::vector<msa::SomaticVariantMethylationSummary> generateLevel2Summary(
-        const std::vector<msa::MethylationSiteDetail>& sites);
+    void accumulate(const BlockScan& scan, MethylationAggregator& aggregator);
     
+    /**
+     * @brief 由聚合器的累計值生成分析結果 (Level 2/3 摘要與全域指標，不含Level 1詳情)
+     *
+     * 僅輸出摘要時，提取流程將位點直接送入聚合器，不保留Level 1表格。
+     * @param aggregator 已累計所有位點的聚合器 (結果取出後回到空狀態)
+     * @return msa::AnalysisResults 分析結果
+     */
+    msa::AnalysisResults summarize(MethylationAggregator& aggregator);
+
+private:
     /**
      * @brief 生成Level 3甲基化統計
+     *
+     * 每個分組內所有VCF兩兩比較 (Welch t、Mann–Whitney U 與 Fisher 精確檢定)，
+     * 每個VCF的樣本只整理一次，各分組並行處理。
      * @param level2Summary Level 2摘要
      * @return std::vector<msa::AggregatedHaplotypeStats> Level 3統計
      */
@@ -53,22 +68,14 @@ private:
     
     /**
      * @brief 計算全域指標
-     * @param sites 原始甲基化位點詳情
+     * @param tally 全域指標的累計值
      * @param level2Summary Level 2摘要
      * @return msa::GlobalSummaryMetrics 全域指標
      */
     msa::GlobalSummaryMetrics calculateGlobalMetrics(
-        const std::vector<msa::MethylationSiteDetail>& sites,
+        const MethylationAggregator::GlobalTally& tally,
         const std::vector<msa::SomaticVariantMethylationSummary>& level2Summary);
     
-    /**
-     * @brief 計算統計p值
-     * @param group1 第一組數據
-     * @param group2 第二組數據
-     * @return float p值
-     */
-    float calculatePValue(const std::vector<float>& group1, const std::vector<float>& group2);
-    
     // 配置物件
     const msa::Config& config_;
 };
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace msa::core {
+
+/**
+ * @brief Level 3 的雙樣本檢定 (Welch t、Mann–Whitney U、Fisher精確檢定)
+ *
+ * 每組樣本只需以 prepare 整理一次 (動差與排序後的數值)，之後與任意其他樣本比較都不需重新掃描。
+ * 無法計算的統計量與p值為 NaN (樣本太小、變異數為0或所有數值相同)。所有p值皆為雙尾。
+ */
+class TwoSampleTests {
+public:
+    /**
+     * @brief 樣本的動差
+     */
+    struct Moments {
+        size_t n = 0;         // 樣本數
+        double mean = 0.0;    // 平均值
+        double m2 = 0.0;      // 與平均值差的平方和
+        
+        /**
+         * @brief 樣本變異數 (n-1 為分母)，n < 2 時為 NaN
+         */
+        double variance() const;
+    };
+    
+    /**
+     * @brief 整理後的樣本
+     */
+    struct Sample {
+        Moments moments;             // 動差
+        std::vector<float> sorted;   // 遞增排序的數值 (Mann–Whitney U 的秩)
+        uint64_t methylated = 0;     // 甲基化位點數 (Fisher精確檢定)
+        uint64_t unmethylated = 0;   // 非甲基化位點數 (Fisher精確檢定)
+    };
+    
+    /**
+     * @brief 檢定結果
+     */
+    struct Result {
+        double statistic;   // 檢定統計量
+        double df;          // 自由度 (無自由度的檢定為 NaN)
+        double p_value;     // 雙尾p值
+    };
+    
+    /**
+     * @brief 整理樣本：計算動差並排序數值
+     * @param values 數值 (移入樣本)
+     * @param methylated 甲基化位點數
+     * @param unmethylated 非甲基化位點數
+     * @return Sample 整理後的樣本
+     */
+    static Sample prepare(std::vector<float> values, uint64_t methylated, uint64_t unmethylated);
+    
+    /**
+     * @brief 計算動差 (以四條獨立累加通道求和，可由編譯器向量化)
+     * @param values 數值
+     * @param n 數量
+     * @return Moments 動差
+     */
+    static Moments moments(const float* values, size_t n);
+    
+    /**
+     * @brief Welch t 檢定 (Welch–Satterthwaite 自由度，p值以正規化不完全 beta 函數計算)
+     * @param a 第一組動差
+     * @param b 第二組動差
+     * @return Result t 統計量 (a - b)、自由度與p值
+     */
+    static Result welch(const Moments& a, const Moments& b);
+    
+    /**
+     * @brief Mann–Whitney U 檢定 (常態近似，含同分校正與連續性校正)
+     * @param a 第一組遞增排序的數值
+     * @param b 第二組遞增排序的數值
+     * @return Result 第一組的 U 統計量與p值
+     */
+    static Result mannWhitney(const std::vector<float>& a, const std::vector<float>& b);
+    
+    /**
+     * @brief 2x2 列聯表的 Fisher 精確檢定 (雙尾：機率不大於觀測表的所有表機率總和)
+     * @param a 第一組甲基化位點數
+     * @param b 第一組非甲基化位點數
+     * @param c 第二組甲基化位點數
+     * @param d 第二組非甲基化位點數
+     * @return double p值
+     */
+    static double fisherExact(uint64_t a, uint64_t b, uint64_t c, uint64_t d);
+    
+    /**
+     * @brief 正規化不完全 beta 函數 I_x(a, b)
+     * @param a 參數 a (> 0)
+     * @param b 參數 b (> 0)
+     * @param x 積分上限 (0 ~ 1)
+     * @return double 函數值
+     */
+    static double incompleteBeta(double a, double b, double x);
+};
+
+} // namespace msa::core
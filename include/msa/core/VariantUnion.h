@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "msa/Types.h"
+#include "msa/Level1Details.h"
+#include "msa/MethylationSiteTable.h"
+
+namespace msa::core {
+
+/**
+ * @brief 多個VCF的變異聯集
+ *
+ * 依 (染色體, 位置, REF, ALT, 變異類型) 合併所有VCF的變異，每個唯一位點只提取一次，
+ * 並記錄每個位點出現於哪些VCF。提取完成後依各VCF原本的變異順序組出其位點表格，
+ * VCF來源欄位改為該VCF，結果與單獨處理該VCF相同。
+ */
+class VariantUnion {
+public:
+    /**
+     * @brief 建立變異聯集
+     * @param per_vcf 每個VCF載入的變異 (各自排序)
+     * @return VariantUnion 變異聯集
+     */
+    static VariantUnion build(const std::vector<std::vector<msa::VcfVariantInfo>>& per_vcf);
+    
+    /**
+     * @brief 依染色體與位置排序的唯一位點
+     */
+    const std::vector<msa::VcfVariantInfo>& loci() const { return loci_; }
+    
+    /**
+     * @brief 位點出現的VCF (VCF索引，遞增)
+     * @param locus 位點索引
+     */
+    const std::vector<uint32_t>& sources(size_t locus) const { return loci_sources_[locus]; }
+    
+    /**
+     * @brief 出現於兩個以上VCF的位點數
+     */
+    size_t sharedLoci() const;
+    
+    /**
+     * @brief 組出單一VCF的甲基化位點表格
+     * @param vcf_index VCF索引
+     * @param locus_tables 每個位點的甲基化位點表格 (順序同 loci())
+     * @param vcf_source_id VCF來源ID
+     * @return msa::MethylationSiteTable 依該VCF變異順序排列的位點表格
+     */
+    msa::MethylationSiteTable fanOut(
+        size_t vcf_index,
+        const std::vector<msa::MethylationSiteTable>& locus_tables,
+        const std::string& vcf_source_id
+    ) const;
+    
+    /**
+     * @brief 組出單一VCF的 Level 1 位點
+     *
+     * 組出的表格能容納於 Level 1 預算時與 fanOut 相同；超過時依變異順序逐塊組出，每累積預算的 1/8
+     * 即寫成一個溢寫區段並釋放，分析與匯出讀到的列與順序不變。共用的位點表格由所有VCF引用，不溢寫。
+     * @param vcf_index VCF索引
+     * @param locus_tables 每個位點的甲基化位點表格 (順序同 loci())
+     * @param vcf_source_id VCF來源ID
+     * @param tmp_dir 溢寫暫存目錄的上層目錄 (空字串表示系統暫存目錄)
+     * @return msa::Level1Details 依該VCF變異順序排列的位點
+     */
+    msa::Level1Details fanOutLevel1(
+        size_t vcf_index,
+        const std::vector<msa::MethylationSiteTable>& locus_tables,
+        const std::string& vcf_source_id,
+        const std::string& tmp_dir
+    ) const;
+    
+    /**
+     * @brief 依單一VCF的變異順序逐塊組出位點表格 (相鄰變異併入同一區塊直到達到目標列數)
+     * @param vcf_index VCF索引
+     * @param locus_tables 每個位點的甲基化位點表格 (順序同 loci())
+     * @param vcf_source_id VCF來源ID
+     * @param block_rows 每個區塊的目標列數 (單一變異超過時區塊只含該變異)
+     * @param fn 處理函數 (可移走區塊內容，返回後區塊清空)
+     */
+    void forEachBlock(
+        size_t vcf_index,
+        const std::vector<msa::MethylationSiteTable>& locus_tables,
+        const std::string& vcf_source_id,
+        size_t block_rows,
+        const std::function<void(msa::MethylationSiteTable&)>& fn
+    ) const;
+    
+private:
+    std::vector<msa::VcfVariantInfo> loci_;            // 唯一位點
+    std::vector<std::vector<uint32_t>> loci_sources_;  // 每個位點出現的VCF
+    std::vector<std::vector<uint32_t>> vcf_loci_;      // 每個VCF的變異對應的位點索引 (保留原順序與重複)
+};
+
+} // namespace msa::core
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace msa::utils {
+
+/**
+ * @brief 64位元整數的雜湊混合函數 (splitmix64 終結步驟)，使低位元與高位元皆均勻分布
+ * @param x 輸入值
+ * @return uint64_t 混合後的值
+ */
+inline uint64_t mixHash64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * @brief 開放定址 (線性探測) 雜湊表，鍵與值分別連續存放
+ *
+ * 只支援插入與查詢 (不支援刪除)；容量為2的冪次，負載超過 3/4 時加倍。
+ * 呼叫端可傳入預先計算的雜湊值，以便同一雜湊值同時用於分區與表內定址。
+ * @tparam Key 鍵類型 (需支援 ==)
+ * @tparam Value 值類型 (需可預設建構與移動)
+ * @tparam Hash 雜湊函數物件，返回 uint64_t
+ */
+template <typename Key, typename Value, typename Hash>
+class FlatHashMap {
+public:
+    /**
+     * @brief 查詢鍵對應的值，不存在時插入預設值
+     * @param key 鍵
+     * @return Value& 值 (下一次插入新鍵前有效)
+     */
+    Value& operator[](const Key& key) { return findOrInsert(key, Hash()(key)); }
+    
+    /**
+     * @brief 以預先計算的雜湊值查詢，不存在時插入預設值
+     * @param key 鍵
+     * @param hash Hash()(key) 的值
+     * @return Value& 值 (下一次插入新鍵前有效)
+     */
+    Value& findOrInsert(const Key& key, uint64_t hash) {
+        if ((size_ + 1) * 4 > capacity() * 3) {
+            grow();
+        }
+        size_t mask = capacity() - 1;
+        for (size_t slot = static_cast<size_t>(hash) & mask;; slot = (slot + 1) & mask) {
+            if (!used_[slot]) {
+                used_[slot] = 1;
+                keys_[slot] = key;
+                ++size_;
+                return values_[slot];
+            }
+            if (keys_[slot] == key) {
+                return values_[slot];
+            }
+        }
+    }
+    
+    /**
+     * @brief 依存放位置逐項處理
+     * @param fn 處理函數 fn(const Key&, Value&)
+     */
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        for (size_t slot = 0; slot < used_.size(); ++slot) {
+            if (used_[slot]) {
+                fn(keys_[slot], values_[slot]);
+            }
+        }
+    }
+    
+    /**
+     * @brief 獲取項目數量
+     * @return size_t 項目數量
+     */
+    size_t size() const { return size_; }
+    
+    /**
+     * @brief 清除所有項目並釋放記憶體
+     */
+    void clear() {
+        std::vector<uint8_t>().swap(used_);
+        std::vector<Key>().swap(keys_);
+        std::vector<Value>().swap(values_);
+        size_ = 0;
+    }
+
+private:
+    size_t capacity() const { return used_.size(); }
+    
+    /**
+     * @brief 容量加倍並重新放置所有項目
+     */
+    void grow() {
+        std::vector<uint8_t> used(capacity() ? capacity() * 2 : 16, 0);
+        std::vector<Key> keys(used.size());
+        std::vector<Value> values(used.size());
+        size_t mask = used.size() - 1;
+        for (size_t old = 0; old < used_.size(); ++old) {
+            if (!used_[old]) {
+                continue;
+            }
+            size_t slot = static_cast<size_t>(Hash()(keys_[old])) & mask;
+            while (used[slot]) {
+                slot = (slot + 1) & mask;
+            }
+            used[slot] = 1;
+            keys[slot] = std::move(keys_[old]);
+            values[slot] = std::move(values_[old]);
+        }
+        used_.swap(used);
+        keys_.swap(keys);
+        values_.swap(values);
+    }
+    
+    std::vector<uint8_t> used_;   // 每個位置是否有項目
+    std::vector<Key> keys_;       // 鍵
+    std::vector<Value> values_;   // 值
+    size_t size_ = 0;             // 項目數量
+};
+
+/**
+ * @brief 64位元值的開放定址集合 (線性探測)，以0表示空位，值0另以旗標記錄
+ *
+ * 適合存放雜湊值等均勻分布的鍵；每項只佔8位元組 (負載上限 3/4)。
+ */
+class FlatHashSet64 {
+public:
+    /**
+     * @brief 插入值
+     * @param value 值
+     * @return bool 是否為新值
+     */
+    bool insert(uint64_t value) {
+        if (value == 0) {
+            bool inserted = !has_zero_;
+            has_zero_ = true;
+            return inserted;
+        }
+        if ((stored_ + 1) * 4 > slots_.size() * 3) {
+            grow();
+        }
+        if (!place(slots_, value)) {
+            return false;
+        }
+        ++stored_;
+        return true;
+    }
+    
+    /**
+     * @brief 插入另一個集合的所有值
+     * @param other 來源集合
+     */
+    void merge(const FlatHashSet64& other) {
+        if (other.has_zero_) {
+            has_zero_ = true;
+        }
+        for (uint64_t value : other.slots_) {
+            if (value != 0) {
+                insert(value);
+            }
+        }
+    }
+    
+    /**
+     * @brief 交換內容
+     * @param other 另一個集合
+     */
+    void swap(FlatHashSet64& other) noexcept {
+        slots_.swap(other.slots_);
+        std::swap(stored_, other.stored_);
+        std::swap(has_zero_, other.has_zero_);
+    }
+    
+    /**
+     * @brief 獲取值的數量
+     * @return size_t 值的數量
+     */
+    size_t size() const { return stored_ + (has_zero_ ? 1 : 0); }
+
+private:
+    /**
+     * @brief 將非零值放入表格
+     * @param slots 表格 (容量為2的冪次)
+     * @param value 值
+     * @return bool 是否為新值
+     */
+    static bool place(std::vector<uint64_t>& slots, uint64_t value) {
+        size_t mask = slots.size() - 1;
+        for (size_t slot = static_cast<size_t>(mixHash64(value)) & mask;; slot = (slot + 1) & mask) {
+            if (slots[slot] == 0) {
+                slots[slot] = value;
+                return true;
+            }
+            if (slots[slot] == value) {
+                return false;
+            }
+        }
+    }
+    
+    /**
+     * @brief 容量加倍並重新放置所有值
+     */
+    void grow() {
+        std::vector<uint64_t> slots(slots_.empty() ? 8 : slots_.size() * 2, 0);
+        for (uint64_t value : slots_) {
+            if (value != 0) {
+                place(slots, value);
+            }
+        }
+        slots_.swap(slots);
+    }
+    
+    std::vector<uint64_t> slots_;  // 開放定址表格 (0 為空位)
+    size_t stored_ = 0;            // 表格中的值數量
+    bool has_zero_ = false;        // 是否含值0
+};
+
+} // namespace msa::utils
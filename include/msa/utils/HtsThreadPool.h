@@ -0,0 +1,59 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <htslib/hts.h>
+#include <htslib/thread_pool.h>
+
+namespace msa::utils {
+
+/**
+ * @brief 全程序共用的htslib執行緒池，供所有BAM檔案的BGZF解壓縮使用
+ */
+class HtsThreadPool {
+public:
+    /**
+     * @brief 獲取HtsThreadPool單例實例
+     * @return HtsThreadPool& 單例引用
+     */
+    static HtsThreadPool& getInstance();
+
+    /**
+     * @brief 建立執行緒池
+     * @param numThreads 解壓縮執行緒數，0表示停用 (BGZF在呼叫執行緒上解壓縮)
+     * @return bool 是否成功 (停用時亦返回true)
+     */
+    bool initialize(int numThreads);
+
+    /**
+     * @brief 將htsFile掛載到共用執行緒池
+     * @param fp 已開啟的htsFile
+     * @return bool 是否已掛載 (執行緒池停用時返回false)
+     */
+    bool attach(htsFile* fp);
+
+    /**
+     * @brief 銷毀執行緒池，必須在所有掛載的htsFile關閉後呼叫
+     */
+    void shutdown();
+
+    /**
+     * @brief 獲取執行緒池大小
+     * @return int 執行緒數，0表示停用
+     */
+    int size() const;
+
+private:
+    HtsThreadPool(); // 私有建構函數
+    ~HtsThreadPool(); // 私有解構函數
+
+    // 禁止複製與賦值
+    HtsThreadPool(const HtsThreadPool&) = delete;
+    HtsThreadPool& operator=(const HtsThreadPool&) = delete;
+
+    mutable std::mutex mutex_;      // 保護執行緒池的建立與銷毀
+    htsThreadPool pool_;            // htslib執行緒池描述
+    int numThreads_ = 0;            // 執行緒數
+};
+
+} // namespace msa::utils
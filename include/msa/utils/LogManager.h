@@ -47,6 +47,13 @@ public:
      */
     void log(LogLevel level, const std::string& module, const std::string& message);
 
+    /**
+     * @brief 檢查日誌級別是否會被記錄 (供巨集在組裝訊息前判斷)
+     * @param level 日誌級別
+     * @return bool 是否會被記錄
+     */
+    bool isEnabled(LogLevel level) const { return level >= currentLevel_; }
+
     /**
      * @brief 關閉日誌系統
      */
@@ -88,11 +95,20 @@ private:
 };
 
 // 便利巨集，用於簡化日誌呼叫
-#define LOG_TRACE(module, message) msa::utils::LogManager::getInstance().log(msa::utils::LogLevel::TRACE_Level, module, message)
-#define LOG_DEBUG(module, message) msa::utils::LogManager::getInstance().log(msa::utils::LogLevel::DEBUG_Level, module, message)
-#define LOG_INFO(module, message)  msa::utils::LogManager::getInstance().log(msa::utils::LogLevel::INFO_Level, module, message)
-#define LOG_WARN(module, message)  msa::utils::LogManager::getInstance().log(msa::utils::LogLevel::WARN_Level, module, message)
-#define LOG_ERROR(module, message) msa::utils::LogManager::getInstance().log(msa::utils::LogLevel::ERROR_Level, module, message)
-#define LOG_FATAL(module, message) msa::utils::LogManager::getInstance().log(msa::utils::LogLevel::FATAL_Level, module, message)
+// 未啟用的級別不會組裝訊息字串，熱路徑中的除錯日誌不產生配置
+#define MSA_LOG_AT(level, module, message) \
+    do { \
+        auto& msa_log_manager_ = msa::utils::LogManager::getInstance(); \
+        if (msa_log_manager_.isEnabled(level)) { \
+            msa_log_manager_.log(level, module, message); \
+        } \
+    } while (0)
+
+#define LOG_TRACE(module, message) MSA_LOG_AT(msa::utils::LogLevel::TRACE_Level, module, message)
+#define LOG_DEBUG(module, message) MSA_LOG_AT(msa::utils::LogLevel::DEBUG_Level, module, message)
+#define LOG_INFO(module, message)  MSA_LOG_AT(msa::utils::LogLevel::INFO_Level, module, message)
+#define LOG_WARN(module, message)  MSA_LOG_AT(msa::utils::LogLevel::WARN_Level, module, message)
+#define LOG_ERROR(module, message) MSA_LOG_AT(msa::utils::LogLevel::ERROR_Level, module, message)
+#define LOG_FATAL(module, message) MSA_LOG_AT(msa::utils::LogLevel::FATAL_Level, module, message)
 
 } // namespace msa::utils 
\ No newline at end of file
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace msa::utils {
+
+/**
+ * @brief 全程序記憶體預算 (--max-ram-gb)：依子系統分配預算並即時統計用量
+ *
+ * 各子系統以 Reservation 登記持有的位元組數，超過預算時由呼叫端施加背壓：預取的讀取執行緒在
+ * acquire 阻塞直到提取任務釋放讀段批次；VCF 的提取在 Level 1 預算不足時延後開始。
+ * 用量為各子系統回報的估算值 (不含程式碼、htslib 內部緩衝區等)，結束時與實際常駐記憶體一併記錄。
+ */
+class MemoryGovernor {
+public:
+    /**
+     * @brief 子系統
+     */
+    enum class Subsystem : int {
+        BamPool = 0,    // 記憶體池閒置 bam1_t 保留的資料緩衝區
+        ReadBatches,    // 已抓取、尚未提取的讀段批次
+        Level1,         // Level 1 甲基化位點表格
+        ReadCache,      // 讀段解析快取
+        Count
+    };
+    
+    /**
+     * @brief 子系統用量登記 (解構時釋放)，可由多個執行緒同時增減
+     */
+    class Reservation {
+    public:
+        /**
+         * @brief 建構函數
+         * @param subsystem 所屬子系統
+         */
+        explicit Reservation(Subsystem subsystem) : subsystem_(subsystem) {}
+        ~Reservation() { reset(); }
+        
+        // 禁止複製與賦值 (登記的位元組數只能釋放一次)
+        Reservation(const Reservation&) = delete;
+        Reservation& operator=(const Reservation&) = delete;
+        
+        /**
+         * @brief 登記用量 (不阻塞)
+         * @param bytes 位元組數
+         */
+        void add(size_t bytes);
+        
+        /**
+         * @brief 釋放用量
+         * @param bytes 位元組數 (不超過已登記的用量)
+         */
+        void release(size_t bytes);
+        
+        /**
+         * @brief 登記用量，子系統超過預算時阻塞直到其他登記釋放；本登記沒有用量時不等待，
+         *        確保持有者的消費端總有工作可做而不會互相等待
+         * @param bytes 位元組數
+         */
+        void acquire(size_t bytes);
+        
+        /**
+         * @brief 將用量調整為指定值 (比較交換；與其他執行緒同時 add/release 時，結果為其中一種先後順序)
+         * @param bytes 位元組數
+         */
+        void set(size_t bytes);
+        
+        /**
+         * @brief 釋放全部用量
+         */
+        void reset() { set(0); }
+        
+        /**
+         * @brief 目前用量
+         */
+        size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+        
+        /**
+         * @brief 曾達到的最大用量
+         */
+        size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+    
+    private:
+        friend class MemoryGovernor;
+        
+        Subsystem subsystem_;              // 所屬子系統
+        std::atomic<size_t> bytes_{0};     // 目前用量
+        std::atomic<size_t> peak_{0};      // 最大用量
+    };
+    
+    /**
+     * @brief 獲取MemoryGovernor單例實例
+     * @return MemoryGovernor& 單例引用
+     */
+    static MemoryGovernor& getInstance();
+    
+    /**
+     * @brief 依總上限分配各子系統預算，必須在工作執行緒開始前呼叫
+     *
+     * 記憶體池 1/8、讀段批次 1/4、讀段解析快取為指定容量，其餘歸 Level 1 表格 (至少 1/8)。
+     * @param limitBytes 總上限 (位元組)
+     * @param readCacheBytes 讀段解析快取容量 (位元組)
+     */
+    void configure(size_t limitBytes, size_t readCacheBytes);
+    
+    /**
+     * @brief 總上限 (位元組)，0表示未設定
+     */
+    size_t limit() const { return limit_; }
+    
+    /**
+     * @brief 子系統預算 (位元組)，0表示不限制
+     * @param subsystem 子系統
+     */
+    size_t budget(Subsystem subsystem) const { return budgets_[static_cast<int>(subsystem)]; }
+    
+    /**
+     * @brief 子系統目前用量 (位元組)
+     * @param subsystem 子系統
+     */
+    size_t usage(Subsystem subsystem) const {
+        return static_cast<size_t>(std::max<long long>(0, usage_[static_cast<int>(subsystem)].load(std::memory_order_relaxed)));
+    }
+    
+    /**
+     * @brief 子系統在目前用量之外是否還能容納指定位元組數
+     * @param subsystem 子系統
+     * @param bytes 位元組數
+     * @return bool 未設定預算或容納後不超過預算時為true
+     */
+    bool hasHeadroom(Subsystem subsystem, size_t bytes) const;
+    
+    /**
+     * @brief 增減子系統用量 (不阻塞)，用量減少時喚醒等待中的登記
+     * @param subsystem 子系統
+     * @param delta 位元組差額
+     */
+    void charge(Subsystem subsystem, long long delta);
+    
+    /**
+     * @brief 目前程序的常駐記憶體 (位元組)
+     * @return size_t 位元組數，無法取得時為0
+     */
+    static size_t residentBytes();
+    
+    /**
+     * @brief 獲取記憶體統計資訊 (各子系統用量、峰值與預算，背壓等待次數與常駐記憶體)
+     * @return std::string 統計信息字串
+     */
+    std::string getStats() const;
+
+private:
+    MemoryGovernor() = default; // 私有建構函數
+    ~MemoryGovernor() = default; // 私有解構函數
+    
+    // 禁止複製與賦值
+    MemoryGovernor(const MemoryGovernor&) = delete;
+    MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+    
+    static constexpr int kSubsystems = static_cast<int>(Subsystem::Count);
+    
+    /**
+     * @brief 子系統名稱
+     */
+    static const char* subsystemName(Subsystem subsystem);
+    
+    /**
+     * @brief 為登記增加用量，子系統超過預算且登記已有用量時阻塞
+     * @param reservation 登記
+     * @param bytes 位元組數
+     */
+    void acquire(Reservation& reservation, size_t bytes);
+    
+    size_t limit_ = 0;                                // 總上限
+    size_t budgets_[kSubsystems] = {};                // 各子系統預算
+    std::atomic<long long> usage_[kSubsystems] = {};  // 各子系統用量
+    std::atomic<long long> peak_[kSubsystems] = {};   // 各子系統峰值
+    std::atomic<long long> total_{0};                 // 總用量
+    std::atomic<long long> total_peak_{0};            // 總用量峰值
+    
+    std::mutex wait_mutex_;                 // 背壓等待用
+    std::condition_variable released_cv_;   // 用量減少時喚醒
+    std::atomic<int> waiters_{0};           // 等待中的登記數
+    std::atomic<uint64_t> waits_{0};        // 背壓等待次數
+    std::atomic<uint64_t> wait_micros_{0};  // 背壓等待總時間 (微秒)
+};
+
+} // namespace msa::utils
@@ -3,17 +3,19 @@
 #include <memory>
 #include <mutex>
 #include <vector>
-#include <queue>
+#include <string>
 #include <htslib/sam.h>
-#include <thread>
 #include <condition_variable>
 #include <atomic>
-#include <unordered_map>
+#include "msa/utils/MpmcRing.h"
 
 namespace msa::utils {
 
 /**
  * @brief 記憶體池，用於管理bam1_t物件的生命週期，減少頻繁分配與釋放
+ *
+ * 每個執行緒以 thread_local 彈匣緩存物件，常見路徑不需任何鎖；彈匣溢出或用盡時
+ * 以整批物件與無鎖全域倉庫交換。
  */
 class MemoryPool {
 public:
@@ -43,6 +45,19 @@ public:
      */
     void returnBam1(bam1_t* b);
 
+    /**
+     * @brief 將目前執行緒彈匣內的閒置物件全部交回全域倉庫
+     *
+     * 阻塞等待 (waitIfEmpty) 的執行緒只能從全域倉庫取得物件，執行緒閒置前呼叫可避免物件滯留於彈匣。
+     */
+    void flushThreadCache();
+
+    /**
+     * @brief 設定閒置物件可保留的資料緩衝區總位元組數，超過時歸還的緩衝區會被釋放
+     * @param maxBytes 位元組上限，0表示無限制
+     */
+    void setRetainedBytesLimit(size_t maxBytes);
+
     /**
      * @brief 釋放所有記憶體池中的物件
      */
@@ -59,15 +74,17 @@ public:
      * @return std::string 統計信息字串
      */
     std::string getStats() const;
+
+private:
+    struct ThreadCache;  // 執行緒本地彈匣 (定義於實作檔)
     
     /**
-     * @brief 獲取執行緒本地的bam1_t緩存
-     * @param capacity 每個執行緒的初始容量
-     * @return std::vector<bam1_t*>& 執行緒本地的bam1_t緩存
+     * @brief 全域倉庫中的一批物件
      */
-    std::vector<bam1_t*>& getThreadLocalCache(size_t capacity = 20);
+    struct Magazine {
+        std::vector<bam1_t*> items;   // 閒置物件
+    };
 
-private:
     MemoryPool(); // 私有建構函數
     ~MemoryPool(); // 私有解構函數
 
@@ -84,23 +101,77 @@ private:
         }
     };
 
-    mutable std::mutex mutex_;                  // 互斥鎖保護共享資源
+    mutable std::mutex mutex_;                  // 保護初始化與阻塞等待
     std::condition_variable availableCondition_; // 用於阻塞等待
-    std::queue<bam1_t*> availableBam1ts_;       // 可用的bam1_t物件隊列
+    MpmcRing<Magazine*> depot_;                 // 無鎖全域倉庫 (整批物件)
+    std::atomic<size_t> depotObjects_{0};       // 倉庫中的物件數
     size_t maxCapacity_;                        // 最大容量
     std::atomic<size_t> totalAllocated_;        // 已分配物件總數
-    std::atomic<size_t> currentlyInUse_;        // 當前使用中的物件數
-    bool initialized_ = false;                  // 初始化狀態
+    std::atomic<long long> retiredInUse_{0};    // 已結束執行緒的借出/歸還差額
+    std::atomic<bool> initialized_{false};      // 初始化狀態
+    std::atomic<int> waiters_{0};               // 阻塞等待中的執行緒數
+    
+    // 資料緩衝區保留與位元組統計
+    std::atomic<long long> retainedBytes_{0};   // 閒置物件保留的資料緩衝區位元組數 (各執行緒批次回報，為近似值)
+    std::atomic<size_t> trimmedBuffers_{0};     // 因超過保留上限而釋放的緩衝區數
+    size_t retainedBytesLimit_ = 0;             // 保留位元組上限，0表示無限制
     
-    // 執行緒本地緩存管理
-    mutable std::mutex thread_cache_mutex_;    // 保護執行緒本地緩存映射
-    std::unordered_map<std::thread::id, std::vector<bam1_t*>> thread_caches_; // 執行緒ID到其本地緩存的映射
+    // 執行緒本地彈匣登記 (僅在執行緒首次使用與結束時加鎖)
+    mutable std::mutex thread_cache_mutex_;     // 保護彈匣登記表
+    std::vector<ThreadCache*> thread_caches_;   // 存活執行緒的彈匣
 
     /**
      * @brief 建立一個新的bam1_t物件
      * @return bam1_t* 新建的bam1_t物件指標
      */
     bam1_t* createNewBam1();
+    
+    /**
+     * @brief 獲取目前執行緒的彈匣，首次使用時登記
+     * @return ThreadCache& 執行緒本地彈匣
+     */
+    ThreadCache& localCache();
+    
+    /**
+     * @brief 執行緒結束時將彈匣內物件交回倉庫並取消登記
+     * @param cache 執行緒本地彈匣
+     */
+    void retireThreadCache(ThreadCache& cache);
+    
+    /**
+     * @brief 將彈匣中最舊的一批物件移入全域倉庫
+     * @param cache 執行緒本地彈匣
+     * @param count 移動的物件數
+     */
+    void flushToDepot(ThreadCache& cache, size_t count);
+    
+    /**
+     * @brief 從全域倉庫取回一批物件放入彈匣
+     * @param cache 執行緒本地彈匣
+     * @return bool 是否取得物件
+     */
+    bool refillFromDepot(ThreadCache& cache);
+    
+    /**
+     * @brief 重置借出物件的讀段內容，保留既有緩衝區 (不預先擴充)
+     * @param cache 執行緒本地彈匣 (用於位元組統計)
+     * @param b bam1_t物件指標
+     */
+    void prepareBam1(ThreadCache& cache, bam1_t* b);
+    
+    /**
+     * @brief 將歸還物件的緩衝區計入保留位元組，超過保留上限時釋放其緩衝區
+     * @param cache 執行緒本地彈匣 (用於位元組統計)
+     * @param b bam1_t物件指標
+     */
+    void retainBuffer(ThreadCache& cache, bam1_t* b);
+    
+    /**
+     * @brief 將執行緒累積的位元組差額回報到全域統計
+     * @param cache 執行緒本地彈匣
+     * @param force 是否不論差額大小都回報
+     */
+    void publishBytes(ThreadCache& cache, bool force);
 };
 
 } // namespace msa::utils 
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace msa::utils {
+
+/**
+ * @brief 無鎖有界多生產者/多消費者環形佇列 (以每格序號協調，無ABA問題)
+ * @tparam T 項目類型 (建議為指標等可廉價複製的類型)
+ */
+template <typename T>
+class MpmcRing {
+public:
+    /**
+     * @brief 建構函數
+     * @param capacity 容量，會向上取整為2的冪次 (至少為2)
+     */
+    explicit MpmcRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    // 禁止複製與賦值
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+    
+    /**
+     * @brief 嘗試放入項目，不阻塞
+     * @param item 項目
+     * @return bool 是否成功放入 (佇列已滿時返回false)
+     */
+    bool tryPush(const T& item) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    
+    /**
+     * @brief 嘗試取出項目，不阻塞
+     * @param item 用於存儲取出的項目
+     * @return bool 是否取得項目 (佇列為空時返回false)
+     */
+    bool tryPop(T& item) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+    
+    /**
+     * @brief 獲取近似項目數 (並行修改時僅供統計)
+     * @return size_t 項目數
+     */
+    size_t sizeApprox() const {
+        size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+        size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+    
+    /**
+     * @brief 獲取容量
+     * @return size_t 容量
+     */
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;   // 格序號：等於寫入位置表示可寫，等於位置+1表示可讀
+        T data;                         // 項目
+    };
+    
+    std::unique_ptr<Cell[]> cells_;                   // 環形緩衝區
+    size_t mask_ = 0;                                 // 容量-1
+    alignas(64) std::atomic<size_t> enqueuePos_{0};   // 寫入位置 (獨立快取行避免偽共享)
+    alignas(64) std::atomic<size_t> dequeuePos_{0};   // 讀取位置
+};
+
+} // namespace msa::utils
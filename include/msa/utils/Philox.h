@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace msa::utils {
+
+/**
+ * @brief Philox4x32-10 計數器式亂數產生器
+ *
+ * 輸出只由 (鍵, 計數器) 決定，不保存狀態：以固定的鍵與不同的計數器區分各個串流，
+ * 同一串流在任何執行緒、任何執行順序下產生相同的序列，因此並行重抽樣的結果與執行緒數無關。
+ */
+class Philox4x32 {
+public:
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+    
+    /**
+     * @brief 計算一個區塊 (10回合)
+     * @param counter 計數器
+     * @param key 鍵
+     * @return Counter 4個32位元亂數
+     */
+    static Counter block(Counter counter, Key key) {
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = static_cast<uint64_t>(kMul0) * counter[0];
+            uint64_t p1 = static_cast<uint64_t>(kMul1) * counter[2];
+            counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+                       static_cast<uint32_t>(p1),
+                       static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+                       static_cast<uint32_t>(p0)};
+            key[0] += kWeyl0;
+            key[1] += kWeyl1;
+        }
+        return counter;
+    }
+
+private:
+    static constexpr uint32_t kMul0 = 0xD2511F53;
+    static constexpr uint32_t kMul1 = 0xCD9E8D57;
+    static constexpr uint32_t kWeyl0 = 0x9E3779B9;
+    static constexpr uint32_t kWeyl1 = 0xBB67AE85;
+};
+
+/**
+ * @brief 由 (鍵, 64位元串流編號) 決定的 Philox 亂數串流
+ *
+ * 計數器高64位元為串流編號，低64位元為串流內的區塊索引。
+ */
+class PhiloxStream {
+public:
+    /**
+     * @brief 建構函數
+     * @param key 64位元鍵
+     * @param stream 串流編號
+     */
+    PhiloxStream(uint64_t key, uint64_t stream)
+        : key_{static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)},
+          stream_(stream) {
+    }
+    
+    /**
+     * @brief 下一個32位元亂數
+     */
+    uint32_t next() {
+        if (used_ == 4) {
+            buffer_ = Philox4x32::block({static_cast<uint32_t>(index_), static_cast<uint32_t>(index_ >> 32),
+                                         static_cast<uint32_t>(stream_), static_cast<uint32_t>(stream_ >> 32)}, key_);
+            ++index_;
+            used_ = 0;
+        }
+        return buffer_[used_++];
+    }
+    
+    /**
+     * @brief [0, bound) 範圍內的整數 (乘法映射，偏差約為 bound / 2^32)
+     * @param bound 上限 (不含)
+     */
+    uint32_t below(uint32_t bound) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(next()) * bound) >> 32);
+    }
+
+private:
+    Philox4x32::Key key_;          // 鍵
+    uint64_t stream_;              // 串流編號
+    uint64_t index_ = 0;           // 下一個區塊索引
+    Philox4x32::Counter buffer_{}; // 目前區塊的亂數
+    int used_ = 4;                 // 目前區塊已使用的亂數數
+};
+
+} // namespace msa::utils
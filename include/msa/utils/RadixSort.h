@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+#include "msa/utils/TaskScheduler.h"
+
+namespace msa::utils {
+
+/**
+ * @brief 穩定的並行LSD基數排序 (每回合8位元)
+ *
+ * 鍵由多個64位元字組組成 (字組0最不重要)，每個字組只排序指定的低位元組數；所有項目
+ * 在某位元組相同的回合直接略過。每回合將項目分為固定大小的區段，各區段並行統計直方圖，
+ * 依區段順序計算偏移後並行分派，因此結果與執行緒數無關。不可等待其他任務的呼叫者
+ * (例如提取任務) 以 parallel = false 在呼叫執行緒上依序處理各區段，結果相同。
+ * @tparam T 項目類型 (需可複製)
+ * @tparam KeyFn 鍵函數 key(const T&, size_t word) 返回 uint64_t
+ * @param items 項目 (原地排序)
+ * @param wordBytes 每個字組需排序的位元組數 (由字組0開始)
+ * @param key 鍵函數
+ * @param parallel 是否以排程器並行處理各區段 (false: 不提交任務、不等待)
+ */
+template <typename T, typename KeyFn>
+void parallelRadixSort(std::vector<T>& items, std::initializer_list<int> wordBytes, KeyFn key, bool parallel = true) {
+    static constexpr size_t kRadixGrain = 1 << 16;  // 每個區段的項目數
+
+    const size_t n = items.size();
+    if (n < 2) {
+        return;
+    }
+    const size_t chunks = (n + kRadixGrain - 1) / kRadixGrain;
+    auto forEachChunk = [&](const std::function<void(size_t, size_t)>& body) {
+        if (parallel) {
+            TaskScheduler::getInstance().parallelFor(chunks, 1, body);
+        } else {
+            body(0, chunks);
+        }
+    };
+    std::vector<T> buffer(n);
+    std::vector<std::array<size_t, 256>> counts(chunks);
+
+    size_t word = 0;
+    for (int bytes : wordBytes) {
+        for (int byte = 0; byte < bytes; ++byte) {
+            const int shift = byte * 8;
+
+            // 各區段的直方圖
+            forEachChunk([&](size_t first, size_t last) {
+                for (size_t c = first; c < last; ++c) {
+                    auto& count = counts[c];
+                    count.fill(0);
+                    size_t end = std::min(n, (c + 1) * kRadixGrain);
+                    for (size_t i = c * kRadixGrain; i < end; ++i) {
+                        count[(key(items[i], word) >> shift) & 0xff]++;
+                    }
+                }
+            });
+
+            // 所有項目落在同一個桶時此回合不改變順序
+            std::array<size_t, 256> total{};
+            for (const auto& count : counts) {
+                for (size_t b = 0; b < 256; ++b) {
+                    total[b] += count[b];
+                }
+            }
+            bool uniform = false;
+            for (size_t b = 0; b < 256; ++b) {
+                if (total[b] == n) {
+                    uniform = true;
+                    break;
+                }
+            }
+            if (uniform) {
+                continue;
+            }
+
+            // 依 (桶, 區段) 順序計算各區段的起始偏移，保持穩定
+            size_t offset = 0;
+            for (size_t b = 0; b < 256; ++b) {
+                for (auto& count : counts) {
+                    size_t c = count[b];
+                    count[b] = offset;
+                    offset += c;
+                }
+            }
+
+            forEachChunk([&](size_t first, size_t last) {
+                for (size_t c = first; c < last; ++c) {
+                    auto& next = counts[c];
+                    size_t end = std::min(n, (c + 1) * kRadixGrain);
+                    for (size_t i = c * kRadixGrain; i < end; ++i) {
+                        buffer[next[(key(items[i], word) >> shift) & 0xff]++] = items[i];
+                    }
+                }
+            });
+            items.swap(buffer);
+        }
+        ++word;
+    }
+}
+
+} // namespace msa::utils
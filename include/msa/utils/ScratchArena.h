@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <new>
+
+namespace msa::utils {
+
+/**
+ * @brief 線性(bump)暫存配置器：配置只移動指標，釋放為no-op，reset()一次回收全部空間
+ *
+ * 每個工作執行緒擁有一個實例，用於單一讀段處理期間的暫存資料；
+ * reset() 後若曾溢出到額外區塊，會合併為一個足以容納峰值的區塊，穩定後不再呼叫malloc。
+ */
+class ScratchArena {
+public:
+    /**
+     * @brief 建構函數
+     * @param blockSize 初始區塊大小 (位元組)
+     */
+    explicit ScratchArena(size_t blockSize = 64 * 1024);
+
+    /**
+     * @brief 解構函數
+     */
+    ~ScratchArena();
+
+    // 禁止複製與賦值
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    /**
+     * @brief 配置記憶體
+     * @param bytes 位元組數
+     * @param alignment 對齊 (2的冪次)
+     * @return void* 配置的記憶體，於下一次 reset() 前有效
+     */
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * @brief 配置未初始化的陣列
+     * @tparam T 元素類型 (須為trivially destructible，arena不會呼叫解構函數)
+     * @param count 元素數量
+     * @return T* 陣列指標
+     */
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * @brief 回收所有配置，保留 (或合併) 已配置的區塊
+     */
+    void reset();
+
+    /**
+     * @brief 獲取目前已配置的位元組數
+     * @return size_t 位元組數
+     */
+    size_t bytesUsed() const { return used_; }
+
+    /**
+     * @brief 獲取歷次 reset() 之間的最大配置位元組數
+     * @return size_t 位元組數
+     */
+    size_t peakBytes() const { return peak_; }
+
+private:
+    struct Block {
+        char* data;   // 區塊記憶體
+        size_t size;  // 區塊大小
+    };
+
+    /**
+     * @brief 新增一個至少能容納指定位元組數的區塊
+     * @param minBytes 最小位元組數
+     */
+    void addBlock(size_t minBytes);
+
+    std::vector<Block> blocks_;   // 已配置的區塊
+    size_t current_ = 0;          // 目前使用的區塊索引
+    size_t offset_ = 0;           // 目前區塊內的偏移
+    size_t blockSize_;            // 新區塊的最小大小
+    size_t used_ = 0;             // 目前已配置的位元組數
+    size_t peak_ = 0;             // 配置位元組數峰值
+};
+
+/**
+ * @brief 以 ScratchArena 為後端的STL配置器 (deallocate 為no-op)
+ * @tparam T 元素類型
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(ScratchArena& arena) noexcept : arena_(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena_(other.arena()) {}
+
+    T* allocate(size_t count) {
+        return arena_->allocateArray<T>(count);
+    }
+
+    void deallocate(T*, size_t) noexcept {
+    }
+
+    ScratchArena* arena() const noexcept { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena_ == other.arena(); }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena_ != other.arena(); }
+
+private:
+    ScratchArena* arena_;  // 後端arena
+};
+
+/**
+ * @brief 以 ScratchArena 為後端的向量
+ */
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace msa::utils
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace msa::utils {
+
+/**
+ * @brief 執行緒安全的字串字典：每個不同字串只存一份，以連續整數ID表示
+ *
+ * ID 依首次出現順序由0開始配置，配置後永不改變；已存在的字串只需共享鎖即可查詢。
+ */
+class StringInterner {
+public:
+    /**
+     * @brief 建構函數
+     * @param maxIds 可配置的ID數量上限 (超過時 intern 拋出 std::overflow_error)
+     */
+    explicit StringInterner(uint32_t maxIds = UINT32_MAX);
+    
+    // 禁止複製與賦值
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+    
+    /**
+     * @brief 取得字串的ID，不存在時新增
+     * @param value 字串
+     * @return uint32_t 字串ID
+     */
+    uint32_t intern(std::string_view value);
+    
+    /**
+     * @brief 依ID取得字串
+     * @param id 字串ID (必須由 intern 取得)
+     * @return const std::string& 字串 (於字典生命週期內有效)
+     */
+    const std::string& lookup(uint32_t id) const;
+    
+    /**
+     * @brief 複製目前所有字串 (索引即ID)，供大量查詢時免鎖使用
+     * @return std::vector<std::string> 字串列表
+     */
+    std::vector<std::string> snapshot() const;
+    
+    /**
+     * @brief 獲取已配置的ID數量
+     * @return size_t ID數量
+     */
+    size_t size() const;
+
+private:
+    mutable std::shared_mutex mutex_;                           // 保護字典
+    std::deque<std::string> strings_;                           // 依ID存放的字串 (deque擴充時元素位址不變)
+    std::unordered_map<std::string_view, uint32_t> ids_;        // 字串到ID (鍵指向 strings_ 內的字串)
+    uint32_t maxIds_;                                           // ID數量上限
+};
+
+} // namespace msa::utils
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace msa::utils {
+
+/**
+ * @brief 全程序共用的工作竊取排程器
+ *
+ * VCF載入、變異區域提取、分析與匯出都以任務提交到同一組工作執行緒，執行緒數即 --threads。
+ * 每個工作執行緒擁有一個雙端佇列：自己提交的任務放在尾端並由尾端取出 (LIFO，沿用快取中的資料)，
+ * 閒置的執行緒從其他佇列的前端竊取 (FIFO，取得較大、較早提交的工作)。等待任務群組的執行緒
+ * 不會閒置，而是持續執行佇列中的任務，因此任務內可以再提交子任務並等待，不會形成巢狀執行緒。
+ * 呼叫 initialize 的執行緒成為0號工作執行緒。未初始化時 submit 直接在呼叫執行緒上執行任務。
+ */
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+    
+    /**
+     * @brief 任務群組：記錄尚未完成的任務數，供 wait 等待
+     */
+    class TaskGroup {
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+    
+    private:
+        friend class TaskScheduler;
+        std::atomic<size_t> pending_{0};  // 尚未完成的任務數
+        std::mutex error_mutex_;          // 保護 error_
+        std::exception_ptr error_;        // 第一個任務拋出的例外
+    };
+    
+    /**
+     * @brief 獲取TaskScheduler單例實例
+     * @return TaskScheduler& 單例引用
+     */
+    static TaskScheduler& getInstance();
+    
+    /**
+     * @brief 建立工作執行緒 (呼叫執行緒算作其中一個)
+     * @param numThreads 工作執行緒總數 (至少為1)
+     */
+    void initialize(int numThreads);
+    
+    /**
+     * @brief 停止並回收工作執行緒，必須在所有任務完成後由初始化的執行緒呼叫
+     */
+    void shutdown();
+    
+    /**
+     * @brief 獲取工作執行緒數
+     * @return int 執行緒數，未初始化時為0
+     */
+    int size() const { return static_cast<int>(queues_.size()); }
+    
+    /**
+     * @brief 目前執行緒的工作執行緒編號
+     * @return int 編號 (0 ~ size()-1)，非工作執行緒返回-1
+     */
+    static int workerIndex();
+    
+    /**
+     * @brief 提交任務
+     * @param group 任務所屬群組
+     * @param task 任務
+     */
+    void submit(TaskGroup& group, Task task);
+    
+    /**
+     * @brief 等待群組內所有任務完成，工作執行緒等待期間會執行其他任務
+     *
+     * 任務拋出的第一個例外會在此重新拋出。
+     * @param group 任務群組
+     */
+    void wait(TaskGroup& group);
+    
+    /**
+     * @brief 等待條件成立，工作執行緒等待期間會執行其他任務 (條件以固定間隔重新檢查)
+     * @param ready 條件
+     */
+    void waitUntil(const std::function<bool()>& ready);
+    
+    /**
+     * @brief 將 [0, n) 切分為每段 grain 個元素的任務並等待完成
+     * @param n 元素數
+     * @param grain 每個任務處理的元素數 (至少為1)
+     * @param body 處理 [begin, end) 的函數
+     */
+    void parallelFor(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body);
+    
+    /**
+     * @brief 獲取排程統計資訊 (執行與竊取的任務數)
+     * @return std::string 統計信息字串
+     */
+    std::string getStats() const;
+
+private:
+    TaskScheduler() = default; // 私有建構函數
+    ~TaskScheduler(); // 私有解構函數
+    
+    // 禁止複製與賦值
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    
+    /**
+     * @brief 佇列中的任務與其群組
+     */
+    struct QueuedTask {
+        Task task;                    // 任務
+        TaskGroup* group = nullptr;   // 所屬群組
+    };
+    
+    /**
+     * @brief 工作執行緒的雙端佇列
+     */
+    struct WorkerQueue {
+        std::mutex mutex;               // 保護佇列
+        std::deque<QueuedTask> tasks;   // 任務 (擁有者使用尾端，竊取者使用前端)
+    };
+    
+    /**
+     * @brief 工作執行緒主迴圈
+     * @param index 工作執行緒編號
+     */
+    void workerLoop(int index);
+    
+    /**
+     * @brief 取得一個任務：先取自己佇列的尾端，再依序竊取其他佇列的前端
+     * @param index 工作執行緒編號
+     * @param out 用於存儲取得的任務
+     * @return bool 是否取得任務
+     */
+    bool takeTask(int index, QueuedTask& out);
+    
+    /**
+     * @brief 執行任務並更新群組計數
+     * @param item 任務
+     */
+    void runTask(QueuedTask& item);
+    
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;  // 每個工作執行緒的佇列
+    std::vector<std::thread> threads_;                  // 工作執行緒 (不含0號)
+    
+    std::mutex sleep_mutex_;              // 閒置等待用
+    std::condition_variable sleep_cv_;    // 有新任務或群組完成時喚醒
+    std::atomic<size_t> queued_{0};       // 所有佇列中的任務數
+    std::atomic<size_t> next_queue_{0};   // 非工作執行緒提交任務時輪流選擇的佇列
+    bool stop_ = false;                   // 停止工作執行緒
+    
+    // 統計計數
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> stolen_{0};
+};
+
+} // namespace msa::utils
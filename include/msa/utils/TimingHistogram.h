@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace msa::utils {
+
+/**
+ * @brief 以2的冪次分桶的耗時直方圖 (微秒)，可由多個執行緒同時記錄
+ *
+ * 第 k 個桶涵蓋 [2^(k-1), 2^k) 微秒 (第0個桶為0微秒)，用於在日誌中檢視耗時分佈與長尾。
+ */
+class TimingHistogram {
+public:
+    /**
+     * @brief 記錄耗時
+     * @param micros 耗時 (微秒)
+     * @param count 以此耗時記錄的次數
+     */
+    void record(uint64_t micros, uint64_t count = 1);
+    
+    /**
+     * @brief 記錄次數
+     */
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    
+    /**
+     * @brief 最長耗時 (微秒)
+     */
+    uint64_t maxMicros() const { return max_.load(std::memory_order_relaxed); }
+    
+    /**
+     * @brief 百分位數的上界
+     * @param fraction 百分位 (0~1)
+     * @return uint64_t 該百分位所在桶的上界 (微秒)，不超過最長耗時
+     */
+    uint64_t percentileMicros(double fraction) const;
+    
+    /**
+     * @brief 格式化為日誌字串 (百分位數與各非空桶的次數)
+     * @return std::string 直方圖字串
+     */
+    std::string toString() const;
+    
+    /**
+     * @brief 格式化耗時 (us/ms/s)
+     * @param micros 耗時 (微秒)
+     * @return std::string 耗時字串
+     */
+    static std::string formatMicros(uint64_t micros);
+
+private:
+    static constexpr size_t kBuckets = 40;  // 最大桶約 2^39 微秒 (約6天)
+    
+    std::atomic<uint64_t> buckets_[kBuckets] = {};  // 各桶次數
+    std::atomic<uint64_t> count_{0};                // 總次數
+    std::atomic<uint64_t> max_{0};                  // 最長耗時
+};
+
+} // namespace msa::utils
@@ -1,11 +1,17 @@
 #include "msa/Types.h"
 #include "msa/utils/LogManager.h"
 #include "msa/utils/MemoryPool.h"
+#include "msa/utils/MemoryGovernor.h"
+#include "msa/utils/HtsThreadPool.h"
+#include "msa/utils/TaskScheduler.h"
 #include "msa/core/ConfigParser.h"
 #include "msa/core/BAMValidator.h"
 #include "msa/core/VariantLoader.h"
-#include "msa/core/BamFetcher.h"
-#include "msa/core/MethylHaploExtractor.h"
+#include "msa/core/BamResourceRegistry.h"
+#include "msa/core/ReadParseCache.h"
+#include "msa/core/ExtractionPipeline.h"
+#include "msa/core/MethylationAggregator.h"
+#include "msa/core/VariantUnion.h"
 #include "msa/core/SomaticMethylationAnalyzer.h"
 #include "msa/core/ReportExporter.h"
 
@@ -13,17 +19,14 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <map>
 #include <memory>
 #include <functional>
 
-// 使用預處理器檢查是否編譯時啟用了OpenMP
-#ifdef HAVE_OPENMP
-#include <omp.h>  // 添加OpenMP頭文件
-#endif
-
 // 定義版本信息
 #define MSA_VERSION "1.0.0"
 
@@ -31,8 +34,8 @@ namespace fs = std::filesystem;
 using namespace msa::utils;
 using namespace msa::core;
 
-// 宣告全域變數
-std::vector<std::thread> worker_threads;
+// 聯集模式僅輸出摘要時，每次組出並聚合的位點列數
+static constexpr size_t kUnionSummaryBlockRows = 1 << 20;
 
 /**
  * @brief 顯示程式版本信息
@@ -44,127 +47,216 @@ void showVersion() {
 }
 
 /**
- * @brief 初始化OpenMP環境
+ * @brief 初始化工作竊取排程器 (主執行緒算作其中一個工作執行緒)
  */
-void initializeOpenMP(const msa::Config& config) {
-#ifdef HAVE_OPENMP
-    // 設置執行緒數量
-    omp_set_num_threads(config.threads);
-    
-    // 禁用嵌套並行和動態執行緒
-    omp_set_nested(0);
-    omp_set_dynamic(0);
-    
-    LOG_INFO("Main", "OpenMP初始化完成，執行緒數: " + std::to_string(config.threads));
-#else
-    LOG_WARN("Main", "OpenMP未啟用，將使用單執行緒模式運行");
-#endif
+void initializeScheduler(const msa::Config& config) {
+    // VCF、變異區域、分析與匯出皆為同一排程器的任務，執行緒總數即 --threads
+    TaskScheduler::getInstance().initialize(config.threads);
 }
 
 /**
- * @brief 並行處理單個變異，提取甲基化位點，並返回甲基化位點列表
- * \param variant 變異資訊
- * \param bam_fetcher BAM檔案讀取器
- * \param meth_extractor 甲基化/單倍型提取器
- * \param config 配置
- * \return 甲基化位點列表
+ * @brief 處理中的VCF計數 (任務結束時遞減，包含拋出例外時)
  */
-std::vector<msa::MethylationSiteDetail> processVariant(
-    const msa::VcfVariantInfo& variant,
-    BamFetcher& bam_fetcher,
-    MethylHaploExtractor& meth_extractor,
-    const msa::Config& config) {
-    
-    std::vector<msa::MethylationSiteDetail> variant_sites;
-    
-    LOG_DEBUG("Main", "處理變異: " + variant.chrom + ":" + std::to_string(variant.pos) + " " + variant.variant_type);
-    
-    // 提取腫瘤樣本中的甲基化位點
-    if (!config.tumor_bam.empty() && config.tumor_has_methyl_tags) {
-        std::vector<std::unique_ptr<bam1_t, std::function<void(bam1_t*)>>> tumor_reads = 
-            bam_fetcher.fetchReadsAroundVariant(variant, true, config.window_size);
-        LOG_DEBUG("Main", "腫瘤樣本有 " + std::to_string(tumor_reads.size()) + " 個讀段覆蓋此變異");
-        
-        for (const auto& read : tumor_reads) {
-            auto methyl_sites = meth_extractor.extractFromRead(read.get(), variant, "tumor");
-            variant_sites.insert(variant_sites.end(), methyl_sites.begin(), methyl_sites.end());
-        }
+struct InFlightVcf {
+    std::atomic<int>& count;
+    ~InFlightVcf() { count.fetch_sub(1); }
+};
+
+/**
+ * @brief 等待Level 1記憶體預算足以再開始處理一個VCF，等待期間執行其他任務
+ * \param in_flight 處理中的VCF數
+ * \param largest_vcf 已完成VCF中最大的Level 1用量 (估算下一個VCF的用量)
+ */
+void waitForLevel1Budget(const std::atomic<int>& in_flight, const std::atomic<size_t>& largest_vcf) {
+    auto& governor = MemoryGovernor::getInstance();
+    auto ready = [&]() {
+        return in_flight.load() == 0 || governor.hasHeadroom(MemoryGovernor::Subsystem::Level1, largest_vcf.load());
+    };
+    if (!ready()) {
+        LOG_INFO("Main", "Level 1記憶體預算不足，等待處理中的VCF完成後再開始下一個VCF");
+        TaskScheduler::getInstance().waitUntil(ready);
     }
-    
-    // 提取對照樣本中的甲基化位點
-    if (!config.normal_bam.empty() && config.normal_has_methyl_tags) {
-        std::vector<std::unique_ptr<bam1_t, std::function<void(bam1_t*)>>> normal_reads = 
-            bam_fetcher.fetchReadsAroundVariant(variant, false, config.window_size);
-        LOG_DEBUG("Main", "對照樣本有 " + std::to_string(normal_reads.size()) + " 個讀段覆蓋此變異");
-        
-        for (const auto& read : normal_reads) {
-            auto methyl_sites = meth_extractor.extractFromRead(read.get(), variant, "normal");
-            variant_sites.insert(variant_sites.end(), methyl_sites.begin(), methyl_sites.end());
-        }
+}
+
+/**
+ * @brief 匯出單一VCF的分析結果
+ * \param config 配置物件
+ * \param results 分析結果
+ * \param vcf_base_name VCF基本名稱 (輸出子目錄)
+ */
+void exportAnalysis(const msa::Config& config, const msa::AnalysisResults& results, const std::string& vcf_base_name) {
+    LOG_INFO("Main", "分析完成，生成摘要報告");
+    
+    ReportExporter exporter(config);
+    if (!exporter.exportResults(results, vcf_base_name)) {
+        LOG_ERROR("Main", "匯出結果失敗");
+    } else {
+        LOG_INFO("Main", "已成功匯出結果到 " + config.outdir + "/" + vcf_base_name);
     }
+}
+
+/**
+ * @brief 分析單一VCF的甲基化位點並匯出結果
+ * \param config 配置物件
+ * \param methyl_sites 甲基化位點 (移入分析結果)
+ * \param vcf_base_name VCF基本名稱 (輸出子目錄)
+ * \return 位點表格登記的Level 1用量 (位元組，已溢寫時不含磁碟上的位點)
+ */
+size_t analyzeAndExport(const msa::Config& config, msa::Level1Details methyl_sites, const std::string& vcf_base_name) {
+    LOG_INFO("Main", "共提取 " + std::to_string(methyl_sites.size()) + " 個甲基化位點");
+    
+    // 位點表格於分析與匯出期間登記為Level 1用量
+    MemoryGovernor::Reservation level1(MemoryGovernor::Subsystem::Level1);
+    level1.add(methyl_sites.memoryBytes());
     
-    return variant_sites;
+    // 甲基化分析 (位點表格移入分析結果，不保留副本)
+    SomaticMethylationAnalyzer analyzer(config);
+    msa::AnalysisResults results = analyzer.analyze(std::move(methyl_sites));
+    
+    // 匯出結果
+    exportAnalysis(config, results, vcf_base_name);
+    return level1.peak();
 }
 
 /**
- * @brief 並行處理變異的塊
+ * @brief 分別處理每個VCF：各自載入、提取、分析與匯出
+ * \param config 配置物件
  */
-std::vector<msa::MethylationSiteDetail> processVariantsInParallel(
-    const std::vector<msa::VcfVariantInfo>& variants,
-    const msa::Config& config) {
-    
-    std::vector<msa::MethylationSiteDetail> all_methyl_sites;
-    std::vector<std::vector<msa::MethylationSiteDetail>> thread_results(variants.size());
-    
-    // 使用OpenMP並行處理變異
-#ifdef HAVE_OPENMP
-    #pragma omp parallel
-    {
-        // 每個執行緒獨立開啟BAM檔案
-        BamFetcher bam_fetcher(config);
-        if (!bam_fetcher.openBamFiles()) {
-            LOG_ERROR("Main", "執行緒無法開啟BAM檔案，跳過處理");
-        } else {
-            // 初始化甲基化/單倍型提取器
-            MethylHaploExtractor meth_extractor(config);
+void runSeparateMode(msa::Config& config) {
+    auto& scheduler = TaskScheduler::getInstance();
+    TaskScheduler::TaskGroup group;
+    std::atomic<int> in_flight{0};
+    std::atomic<size_t> largest_vcf{0};
+    
+    // 每個VCF為一個任務，其提取、分析與匯出再提交子任務到同一排程器。
+    // Level 1預算不足以再容納一個VCF時，等待處理中的VCF完成後才提交下一個
+    for (size_t vcf_idx = 0; vcf_idx < config.vcf_files.size(); ++vcf_idx) {
+        waitForLevel1Budget(in_flight, largest_vcf);
+        in_flight.fetch_add(1);
+        scheduler.submit(group, [&config, &in_flight, &largest_vcf, vcf_idx]() {
+            InFlightVcf guard{in_flight};
+            const auto& vcf_file = config.vcf_files[vcf_idx];
+            std::string vcf_base_name = ConfigParser::getBasename(vcf_file);
+            LOG_INFO("Main", "開始處理VCF檔案 [" + std::to_string(vcf_idx+1) + "/" + 
+                     std::to_string(config.vcf_files.size()) + "]: " + vcf_file);
+            
+            // 載入變異信息
+            VariantLoader variant_loader;
+            std::vector<msa::VcfVariantInfo> variants = variant_loader.loadVCFs({vcf_file}, config.bed_file, config);
             
-            // 分配變異給各執行緒
-            #pragma omp for schedule(dynamic)
-            for (size_t i = 0; i < variants.size(); ++i) {
-                // 如果BAM開啟成功，則處理此變異
-                thread_results[i] = processVariant(variants[i], bam_fetcher, meth_extractor, config);
+            if (variants.empty()) {
+                LOG_WARN("Main", "VCF檔案 " + vcf_file + " 未載入任何變異，跳過此檔案");
+                return;
             }
             
-            // 關閉BAM檔案
-            bam_fetcher.closeBamFiles();
-        }
+            LOG_INFO("Main", "已載入 " + std::to_string(variants.size()) + " 個變異");
+            
+            // 並行處理變異
+            ExtractionPipeline pipeline(config);
+            size_t level1_bytes = 0;
+            if (config.summary_only) {
+                // 僅輸出摘要：位點於提取時直接聚合，不保留Level 1表格
+                MethylationAggregator aggregator(config);
+                pipeline.runAggregated(variants, aggregator);
+                SomaticMethylationAnalyzer analyzer(config);
+                exportAnalysis(config, analyzer.summarize(aggregator), vcf_base_name);
+            } else {
+                msa::Level1Details all_methyl_sites = pipeline.run(variants);
+                level1_bytes = analyzeAndExport(config, std::move(all_methyl_sites), vcf_base_name);
+            }
+            size_t largest = largest_vcf.load();
+            while (level1_bytes > largest && !largest_vcf.compare_exchange_weak(largest, level1_bytes)) {
+            }
+            
+            LOG_INFO("Main", "VCF檔案 [" + std::to_string(vcf_idx+1) + "/" + 
+                     std::to_string(config.vcf_files.size()) + "] 處理完成: " + vcf_file);
+        });
     }
-#else
-    // 非OpenMP模式 - 順序處理每個變異
-    BamFetcher bam_fetcher(config);
-    if (!bam_fetcher.openBamFiles()) {
-        LOG_ERROR("Main", "無法開啟BAM檔案，跳過處理");
-        return all_methyl_sites;
+    scheduler.wait(group);
+}
+
+/**
+ * @brief 聯集模式：所有VCF的唯一位點只提取一次，再分送到各VCF分析與匯出
+ * \param config 配置物件
+ */
+void runUnionMode(msa::Config& config) {
+    const size_t n_vcfs = config.vcf_files.size();
+    std::vector<std::vector<msa::VcfVariantInfo>> per_vcf(n_vcfs);
+    auto& scheduler = TaskScheduler::getInstance();
+    
+    // 載入變異信息 (每個VCF一個任務)
+    TaskScheduler::TaskGroup load_group;
+    for (size_t vcf_idx = 0; vcf_idx < n_vcfs; ++vcf_idx) {
+        scheduler.submit(load_group, [&config, &per_vcf, n_vcfs, vcf_idx]() {
+            VariantLoader variant_loader;
+            per_vcf[vcf_idx] = variant_loader.loadVCFs({config.vcf_files[vcf_idx]}, config.bed_file, config);
+            LOG_INFO("Main", "VCF檔案 [" + std::to_string(vcf_idx+1) + "/" + std::to_string(n_vcfs) + "] 已載入 " +
+                     std::to_string(per_vcf[vcf_idx].size()) + " 個變異: " + config.vcf_files[vcf_idx]);
+        });
     }
+    scheduler.wait(load_group);
     
-    // 初始化甲基化/單倍型提取器
-    MethylHaploExtractor meth_extractor(config);
-    
-    // 處理每個變異
-    for (size_t i = 0; i < variants.size(); ++i) {
-        thread_results[i] = processVariant(variants[i], bam_fetcher, meth_extractor, config);
+    VariantUnion variant_union = VariantUnion::build(per_vcf);
+    if (variant_union.loci().empty()) {
+        LOG_WARN("Main", "所有VCF檔案皆未載入任何變異");
+        return;
     }
     
-    // 關閉BAM檔案
-    bam_fetcher.closeBamFiles();
-#endif
+    // 每個唯一位點只提取一次
+    ExtractionPipeline pipeline(config);
+    std::vector<msa::MethylationSiteTable> locus_tables = pipeline.runPerVariant(variant_union.loci());
     
-    // 合併所有執行緒的結果
-    for (const auto& results : thread_results) {
-        all_methyl_sites.insert(all_methyl_sites.end(), results.begin(), results.end());
+    // 共用位點表格由所有VCF引用而無法溢寫，超過Level 1預算時只能警告
+    size_t shared_bytes = 0;
+    for (const auto& table : locus_tables) {
+        shared_bytes += table.memoryBytes();
+    }
+    size_t level1_budget = MemoryGovernor::getInstance().budget(MemoryGovernor::Subsystem::Level1);
+    if (level1_budget > 0 && shared_bytes > level1_budget) {
+        LOG_WARN("Main", "聯集模式共用的位點表格 (" + std::to_string(shared_bytes / (1024 * 1024)) + "MB) 超過Level 1預算 (" +
+                 std::to_string(level1_budget / (1024 * 1024)) + "MB)，共用表格無法溢寫，記憶體用量將超過 --max-ram-gb");
     }
     
-    return all_methyl_sites;
+    // 依各VCF原本的變異順序組出位點後分析與匯出 (每個VCF一個任務)。共用位點表格持續登記於Level 1用量，
+    // 組出的副本超過預算時逐塊溢寫；預算不足時等待處理中的VCF完成後才提交下一個
+    TaskScheduler::TaskGroup export_group;
+    std::atomic<int> in_flight{0};
+    std::atomic<size_t> largest_vcf{0};
+    for (size_t vcf_idx = 0; vcf_idx < n_vcfs; ++vcf_idx) {
+        if (per_vcf[vcf_idx].empty()) {
+            LOG_WARN("Main", "VCF檔案 " + config.vcf_files[vcf_idx] + " 未載入任何變異，跳過此檔案");
+            continue;
+        }
+        
+        waitForLevel1Budget(in_flight, largest_vcf);
+        in_flight.fetch_add(1);
+        scheduler.submit(export_group, [&, vcf_idx]() {
+            InFlightVcf guard{in_flight};
+            const auto& vcf_file = config.vcf_files[vcf_idx];
+            std::string vcf_base_name = ConfigParser::getBasename(vcf_file);
+            size_t level1_bytes = 0;
+            if (config.summary_only) {
+                // 僅輸出摘要：依變異順序逐塊組出位點直接聚合，不組出整個VCF的Level 1表格
+                MethylationAggregator aggregator(config);
+                SomaticMethylationAnalyzer analyzer(config);
+                analyzer.accumulate([&](const std::function<void(const msa::MethylationSiteTable&)>& fn) {
+                    variant_union.forEachBlock(vcf_idx, locus_tables, vcf_base_name, kUnionSummaryBlockRows,
+                                               [&](msa::MethylationSiteTable& block) { fn(block); });
+                }, aggregator);
+                exportAnalysis(config, analyzer.summarize(aggregator), vcf_base_name);
+            } else {
+                level1_bytes = analyzeAndExport(
+                    config, variant_union.fanOutLevel1(vcf_idx, locus_tables, vcf_base_name, config.tmp_dir), vcf_base_name);
+            }
+            size_t largest = largest_vcf.load();
+            while (level1_bytes > largest && !largest_vcf.compare_exchange_weak(largest, level1_bytes)) {
+            }
+            
+            LOG_INFO("Main", "VCF檔案 [" + std::to_string(vcf_idx+1) + "/" + 
+                     std::to_string(n_vcfs) + "] 處理完成: " + vcf_file);
+        });
+    }
+    scheduler.wait(export_group);
 }
 
 /**
@@ -255,59 +347,74 @@ int main(int argc, char** argv) {
     }
     LOG_INFO("Main", "使用 " + std::to_string(config.threads) + " 個執行緒");
     
-    // 初始化OpenMP環境
-    initializeOpenMP(config);
+    // 初始化工作竊取排程器
+    initializeScheduler(config);
+    
+    // 建立所有BAM共用的BGZF解壓縮執行緒池 (大小獨立於 --threads)
+    if (!HtsThreadPool::getInstance().initialize(config.hts_threads)) {
+        LOG_WARN("Main", "htslib執行緒池建立失敗，BGZF將在工作執行緒上解壓縮");
+    }
+    
+    // 每個BAM的標頭與索引只載入一次，由所有工作執行緒與VCF共用
+    auto& bam_registry = BamResourceRegistry::getInstance();
+    for (const auto& bam_path : {config.tumor_bam, config.normal_bam}) {
+        if (!bam_path.empty() && bam_path != "-" && !bam_registry.getResource(bam_path)) {
+            LOG_ERROR("Main", "無法載入BAM標頭或索引: " + bam_path);
+            return 1;
+        }
+    }
+    
+    // 讀段解析快取：多個VCF分析同一BAM時重用讀段的MM/ML解碼結果。自動模式下單一VCF與聯集模式不啟用
+    // (讀段只在跨越查詢區域時重複出現，只解碼窗口內修飾的成本更低)
+    size_t max_ram_bytes = static_cast<size_t>(config.max_ram_gb) * 1024 * 1024 * 1024;
+    size_t read_cache_bytes = 0;
+    if (config.read_cache_mb >= 0) {
+        read_cache_bytes = static_cast<size_t>(config.read_cache_mb) * 1024 * 1024;
+    } else if (config.vcf_files.size() > 1 && !config.union_vcfs) {
+        read_cache_bytes = max_ram_bytes / 10;
+    }
+    
+    // 依 --max-ram-gb 分配記憶體池、讀段批次、Level 1表格與讀段快取的預算
+    auto& governor = MemoryGovernor::getInstance();
+    governor.configure(max_ram_bytes, read_cache_bytes);
     
     // 初始化記憶體池
     auto& mem_pool = MemoryPool::getInstance();
     mem_pool.initialize(100 * config.threads);  // 考慮執行緒數量預分配更多bam1_t物件
+    // 閒置bam1_t保留的資料緩衝區不超過記憶體池預算，超過時歸還的緩衝區直接釋放
+    mem_pool.setRetainedBytesLimit(governor.budget(MemoryGovernor::Subsystem::BamPool));
+    
+    auto& read_cache = ReadParseCache::getInstance();
+    read_cache.configure(read_cache_bytes);
     
     // 為每個VCF檔案執行分析
     LOG_INFO("Main", "共有 " + std::to_string(config.vcf_files.size()) + " 個VCF檔案需要處理");
     
-    // 使用OpenMP並行處理VCF檔案
-#ifdef HAVE_OPENMP
-    #pragma omp parallel for schedule(dynamic) if(config.vcf_files.size() > 1)
-#endif
-    for (size_t vcf_idx = 0; vcf_idx < config.vcf_files.size(); ++vcf_idx) {
-        const auto& vcf_file = config.vcf_files[vcf_idx];
-        std::string vcf_base_name = ConfigParser::getBasename(vcf_file);
-        LOG_INFO("Main", "開始處理VCF檔案 [" + std::to_string(vcf_idx+1) + "/" + 
-                 std::to_string(config.vcf_files.size()) + "]: " + vcf_file);
-        
-        // 載入變異信息
-        VariantLoader variant_loader;
-        std::vector<msa::VcfVariantInfo> variants = variant_loader.loadVCFs({vcf_file}, config.bed_file, config);
-        
-        if (variants.empty()) {
-            LOG_WARN("Main", "VCF檔案 " + vcf_file + " 未載入任何變異，跳過此檔案");
-            continue;
-        }
-        
-        LOG_INFO("Main", "已載入 " + std::to_string(variants.size()) + " 個變異");
-        
-        // 並行處理變異
-        std::vector<msa::MethylationSiteDetail> all_methyl_sites = processVariantsInParallel(variants, config);
-        
-        LOG_INFO("Main", "共提取 " + std::to_string(all_methyl_sites.size()) + " 個甲基化位點");
-        
-        // 甲基化分析
-        SomaticMethylationAnalyzer analyzer(config);
-        msa::AnalysisResults results = analyzer.analyze(all_methyl_sites);
-        
-        LOG_INFO("Main", "分析完成，生成摘要報告");
-        
-        // 匯出結果
-        ReportExporter exporter(config);
-        if (!exporter.exportResults(results, vcf_base_name)) {
-            LOG_ERROR("Main", "匯出結果失敗");
+    // Level 1溢寫失敗 (如暫存目錄空間不足) 時中止
+    try {
+        if (config.union_vcfs) {
+            LOG_INFO("Main", "聯集模式: 共用位點只提取一次");
+            runUnionMode(config);
         } else {
-            LOG_INFO("Main", "已成功匯出結果到 " + config.outdir + "/" + vcf_base_name);
+            runSeparateMode(config);
         }
-        
-        LOG_INFO("Main", "VCF檔案 [" + std::to_string(vcf_idx+1) + "/" + 
-                 std::to_string(config.vcf_files.size()) + "] 處理完成: " + vcf_file);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Main", "處理VCF檔案失敗: " + std::string(e.what()));
+        TaskScheduler::getInstance().shutdown();
+        return 1;
+    }
+    
+    // 回收工作執行緒，關閉共用BAM資源後再釋放解壓縮執行緒池
+    LOG_INFO("Main", TaskScheduler::getInstance().getStats());
+    TaskScheduler::getInstance().shutdown();
+    LOG_INFO("Main", bam_registry.getStats());
+    if (read_cache.enabled()) {
+        LOG_INFO("Main", read_cache.getStats());
+        read_cache.configure(0);  // 釋放快取內容
     }
+    bam_registry.releaseAll();
+    HtsThreadPool::getInstance().shutdown();
+    LOG_INFO("Main", governor.getStats());
     
     // 計算運行時間
     auto end_time = std::chrono::high_resolution_clock::now();
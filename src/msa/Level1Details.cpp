@@ -0,0 +1,306 @@
+#include "msa/Level1Details.h"
+#include "msa/utils/LogManager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace msa {
+
+// 區段的壓縮等級 (暫存資料以速度優先)
+static const char* kRunWriteMode = "wb1";
+
+// gzFile 的內部緩衝區大小
+static constexpr unsigned kRunBufferBytes = 1 << 20;
+
+/**
+ * @brief 區段記錄標頭：變異索引與序列化表格的位元組數
+ */
+struct RunRecordHeader {
+    uint64_t variant_index;
+    uint64_t bytes;
+};
+
+/**
+ * @brief 區段游標
+ */
+struct Level1Spill::Reader::RunCursor {
+    gzFile file = nullptr;          // 區段檔案
+    RunRecordHeader header{};       // 目前記錄的標頭
+    
+    ~RunCursor() {
+        if (file) {
+            gzclose(file);
+        }
+    }
+};
+
+/*
+* 建構函數
+* \param tmpDir 暫存目錄的上層目錄
+*/
+Level1Spill::Level1Spill(const std::string& tmpDir) : parent_dir_(tmpDir) {
+}
+
+/*
+* 解構函數，刪除暫存目錄
+*/
+Level1Spill::~Level1Spill() {
+    if (!dir_.empty()) {
+        std::error_code ec;
+        fs::remove_all(dir_, ec);
+        if (ec) {
+            LOG_WARN("Level1Spill", "無法刪除暫存目錄 " + dir_ + ": " + ec.message());
+        }
+    }
+}
+
+/*
+* 登記已完成的變異
+* \param first 第一個變異索引
+* \param last 最後一個變異之後的索引
+* \param bytes 位元組數
+*/
+void Level1Spill::variantsFinished(size_t first, size_t last, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.emplace_back(first, last);
+    pending_bytes_ += bytes;
+}
+
+/*
+* 已登記但尚未寫出的位元組數
+* \return 位元組數
+*/
+size_t Level1Spill::pendingBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_bytes_;
+}
+
+/*
+* 建立暫存目錄
+*/
+void Level1Spill::createDirectory() {
+    static std::atomic<uint64_t> counter{0};
+    
+    std::error_code ec;
+    fs::path parent = parent_dir_.empty() ? fs::temp_directory_path(ec) : fs::path(parent_dir_);
+    if (ec) {
+        throw std::runtime_error("無法取得系統暫存目錄: " + ec.message());
+    }
+    fs::create_directories(parent, ec);
+    
+    // 以時間與序號命名，已存在時換下一個序號 (多個程序可能共用同一暫存目錄)
+    uint64_t stamp = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        fs::path dir = parent / ("msa_level1_" + std::to_string(stamp) + "_" + std::to_string(counter.fetch_add(1)));
+        if (fs::create_directory(dir, ec)) {
+            dir_ = dir.string();
+            LOG_INFO("Level1Spill", "Level 1 溢寫暫存目錄: " + dir_);
+            return;
+        }
+        if (ec) {
+            break;
+        }
+    }
+    throw std::runtime_error("無法在 " + parent.string() + " 建立Level 1溢寫暫存目錄" + (ec ? ": " + ec.message() : std::string()));
+}
+
+/*
+* 將已登記的變異寫成一個區段
+* \param variantResults 每個變異的位點表格
+* \return 釋放的位元組數
+*/
+size_t Level1Spill::writeRun(std::vector<MethylationSiteTable>& variantResults) {
+    // 取出等待寫出的變異並保留區段編號，寫出期間其他執行緒可繼續登記
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty()) {
+            return 0;
+        }
+        if (dir_.empty()) {
+            createDirectory();
+        }
+        ranges.swap(pending_);
+        pending_bytes_ = 0;
+        path = dir_ + "/run_" + std::to_string(next_run_++) + ".bin.gz";
+    }
+    std::sort(ranges.begin(), ranges.end());
+    
+    // 全部寫入成功後才釋放表格；失敗時刪除區段並將變異放回等待清單，資料仍保留在記憶體
+    size_t bytes = 0;
+    uint64_t rows = 0;
+    gzFile file = gzopen(path.c_str(), kRunWriteMode);
+    bool ok = file != nullptr;
+    if (ok) {
+        gzbuffer(file, kRunBufferBytes);
+        std::string buffer;
+        for (const auto& [first, last] : ranges) {
+            for (size_t v = first; v < last; ++v) {
+                const MethylationSiteTable& table = variantResults[v];
+                bytes += table.memoryBytes();
+                if (table.empty() || !ok) {
+                    continue;
+                }
+                buffer.clear();
+                table.serialize(buffer);
+                RunRecordHeader header{v, buffer.size()};
+                ok = gzwrite(file, &header, sizeof(header)) == static_cast<int>(sizeof(header)) &&
+                     gzwrite(file, buffer.data(), static_cast<unsigned>(buffer.size())) == static_cast<int>(buffer.size());
+                rows += table.size();
+            }
+        }
+        ok = (gzclose(file) == Z_OK) && ok;
+    }
+    
+    std::error_code ec;
+    if (!ok) {
+        fs::remove(path, ec);
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.insert(pending_.end(), ranges.begin(), ranges.end());
+        pending_bytes_ += bytes;
+        throw std::runtime_error("寫入Level 1溢寫檔案失敗 (磁碟空間不足?): " + path);
+    }
+    
+    for (const auto& [first, last] : ranges) {
+        for (size_t v = first; v < last; ++v) {
+            variantResults[v].clear();
+        }
+    }
+    uint64_t compressed = fs::file_size(path, ec);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        run_paths_.push_back(path);
+        rows_ += rows;
+        compressed_bytes_ += ec ? 0 : compressed;
+    }
+    LOG_DEBUG("Level1Spill", "寫出區段 " + path + ": " + std::to_string(rows) + " 列, 釋放 " +
+              std::to_string(bytes / (1024 * 1024)) + "MB, 壓縮後 " + std::to_string(compressed / (1024 * 1024)) + "MB");
+    return bytes;
+}
+
+/*
+* 已寫出的區段數
+* \return 區段數
+*/
+size_t Level1Spill::runs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return run_paths_.size();
+}
+
+/*
+* 已寫出的列數
+* \return 列數
+*/
+uint64_t Level1Spill::rows() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rows_;
+}
+
+/*
+* 已寫出的壓縮位元組數
+* \return 位元組數
+*/
+uint64_t Level1Spill::compressedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compressed_bytes_;
+}
+
+/*
+* 建構函數，開啟所有區段並讀取各自的第一筆記錄
+* \param spill 溢寫資料
+*/
+Level1Spill::Reader::Reader(const Level1Spill& spill) {
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(spill.mutex_);
+        paths = spill.run_paths_;
+    }
+    
+    cursors_.reserve(paths.size());
+    for (const auto& path : paths) {
+        auto cursor = std::make_unique<RunCursor>();
+        cursor->file = gzopen(path.c_str(), "rb");
+        if (!cursor->file) {
+            LOG_ERROR("Level1Spill", "無法開啟Level 1溢寫檔案: " + path);
+            failed_ = true;
+            return;
+        }
+        gzbuffer(cursor->file, kRunBufferBytes);
+        cursors_.push_back(std::move(cursor));
+        advance(cursors_.size() - 1);
+    }
+}
+
+Level1Spill::Reader::~Reader() = default;
+
+/*
+* 讀取區段的下一筆記錄標頭
+* \param cursor 游標索引
+*/
+void Level1Spill::Reader::advance(size_t cursor) {
+    RunCursor& run = *cursors_[cursor];
+    int n = gzread(run.file, &run.header, sizeof(run.header));
+    if (n == 0) {
+        return;  // 區段結束
+    }
+    if (n != static_cast<int>(sizeof(run.header))) {
+        LOG_ERROR("Level1Spill", "Level 1溢寫檔案損毀 (記錄標頭不完整)");
+        failed_ = true;
+        return;
+    }
+    heap_.emplace_back(run.header.variant_index, cursor);
+    std::push_heap(heap_.begin(), heap_.end(), std::greater<>());
+}
+
+/*
+* 取出下一個變異的位點表格
+* \param block 位點表格
+* \return 是否取得
+*/
+bool Level1Spill::Reader::next(MethylationSiteTable& block) {
+    if (failed_ || heap_.empty()) {
+        return false;
+    }
+    std::pop_heap(heap_.begin(), heap_.end(), std::greater<>());
+    size_t cursor = heap_.back().second;
+    heap_.pop_back();
+    
+    RunCursor& run = *cursors_[cursor];
+    buffer_.resize(static_cast<size_t>(run.header.bytes));
+    if (gzread(run.file, &buffer_[0], static_cast<unsigned>(buffer_.size())) != static_cast<int>(buffer_.size()) ||
+        !block.deserialize(buffer_.data(), buffer_.size())) {
+        LOG_ERROR("Level1Spill", "Level 1溢寫檔案損毀 (變異 " + std::to_string(run.header.variant_index) + ")");
+        failed_ = true;
+        return false;
+    }
+    advance(cursor);
+    return !failed_;
+}
+
+/*
+* 依列順序逐塊處理
+* \param fn 處理函數
+* \return 是否完整讀取
+*/
+bool Level1Details::forEachBlock(const std::function<void(const MethylationSiteTable&)>& fn) const {
+    if (!spill_) {
+        fn(table_);
+        return true;
+    }
+    
+    Level1Spill::Reader reader(*spill_);
+    MethylationSiteTable block;
+    while (reader.next(block)) {
+        fn(block);
+    }
+    return !reader.failed();
+}
+
+} // namespace msa
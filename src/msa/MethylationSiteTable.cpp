@@ -0,0 +1,277 @@
+#include "msa/MethylationSiteTable.h"
+#include <algorithm>
+#include <cstring>
+
+namespace msa {
+
+/*
+* 獲取全程序共用的字典
+* \param which 字典種類
+* \return 字典
+*/
+msa::utils::StringInterner& MethylationSiteTable::dictionary(Dictionary which) {
+    // 欄位寬度決定各字典的ID上限
+    static msa::utils::StringInterner chrom_dict(UINT32_MAX);
+    static msa::utils::StringInterner variant_type_dict(UINT16_MAX + 1u);
+    static msa::utils::StringInterner vcf_source_dict(UINT16_MAX + 1u);
+    static msa::utils::StringInterner bam_source_dict(UINT16_MAX + 1u);
+    static msa::utils::StringInterner haplotype_dict(UINT16_MAX + 1u);
+    
+    switch (which) {
+        case Dictionary::Chrom:       return chrom_dict;
+        case Dictionary::VariantType: return variant_type_dict;
+        case Dictionary::VcfSource:   return vcf_source_dict;
+        case Dictionary::BamSource:   return bam_source_dict;
+        case Dictionary::Haplotype:   return haplotype_dict;
+    }
+    return chrom_dict;
+}
+
+/*
+* 將讀段名稱加入名稱池
+* \param name 讀段名稱
+* \return 名稱引用
+*/
+MethylationSiteTable::ReadHandle MethylationSiteTable::addReadName(const char* name) {
+    // 同一讀段的位點連續寫入，重用上一個名稱即可避免重複存放
+    if (has_last_read_ && std::strcmp(read_names_.data() + last_read_, name) == 0) {
+        return last_read_;
+    }
+    
+    ReadHandle handle = read_names_.size();
+    read_names_.insert(read_names_.end(), name, name + std::strlen(name) + 1);
+    last_read_ = handle;
+    has_last_read_ = true;
+    return handle;
+}
+
+/*
+* 附加一個甲基化位點
+* \param ctx 共用欄位
+* \param methyl_pos 甲基化位點位置
+* \param ml ML值
+* \param state 甲基化狀態
+* \param strand 鏈方向
+*/
+void MethylationSiteTable::append(const SiteContext& ctx, int32_t methyl_pos, uint8_t ml, MethState state, Strand strand) {
+    chrom_.push_back(ctx.chrom);
+    methyl_pos_.push_back(methyl_pos);
+    somatic_pos_.push_back(ctx.somatic_pos);
+    variant_type_.push_back(ctx.variant_type);
+    vcf_source_.push_back(ctx.vcf_source);
+    bam_source_.push_back(ctx.bam_source);
+    haplotype_.push_back(ctx.haplotype);
+    read_.push_back(ctx.read);
+    ml_.push_back(ml);
+    flags_.push_back(static_cast<uint8_t>(static_cast<uint8_t>(ctx.allele) |
+                                          (static_cast<uint8_t>(strand) << 1) |
+                                          (static_cast<uint8_t>(state) << 3)));
+    somatic_base_.push_back(ctx.somatic_base);
+}
+
+/*
+* 將另一個表格的所有列附加到尾端
+* \param other 來源表格
+*/
+void MethylationSiteTable::append(const MethylationSiteTable& other) {
+    if (other.empty()) {
+        return;
+    }
+    
+    // 名稱池直接串接，來源列的名稱引用加上偏移量
+    ReadHandle base = read_names_.size();
+    read_names_.insert(read_names_.end(), other.read_names_.begin(), other.read_names_.end());
+    has_last_read_ = false;
+    
+    size_t offset = read_.size();
+    read_.insert(read_.end(), other.read_.begin(), other.read_.end());
+    for (size_t i = offset; i < read_.size(); ++i) {
+        read_[i] += base;
+    }
+    
+    chrom_.insert(chrom_.end(), other.chrom_.begin(), other.chrom_.end());
+    methyl_pos_.insert(methyl_pos_.end(), other.methyl_pos_.begin(), other.methyl_pos_.end());
+    somatic_pos_.insert(somatic_pos_.end(), other.somatic_pos_.begin(), other.somatic_pos_.end());
+    variant_type_.insert(variant_type_.end(), other.variant_type_.begin(), other.variant_type_.end());
+    vcf_source_.insert(vcf_source_.end(), other.vcf_source_.begin(), other.vcf_source_.end());
+    bam_source_.insert(bam_source_.end(), other.bam_source_.begin(), other.bam_source_.end());
+    haplotype_.insert(haplotype_.end(), other.haplotype_.begin(), other.haplotype_.end());
+    ml_.insert(ml_.end(), other.ml_.begin(), other.ml_.end());
+    flags_.insert(flags_.end(), other.flags_.begin(), other.flags_.end());
+    somatic_base_.insert(somatic_base_.end(), other.somatic_base_.begin(), other.somatic_base_.end());
+}
+
+/*
+* 將另一個表格的所有列附加到尾端並改寫VCF來源
+* \param other 來源表格
+* \param vcf_source VCF來源ID
+*/
+void MethylationSiteTable::append(const MethylationSiteTable& other, uint16_t vcf_source) {
+    size_t offset = vcf_source_.size();
+    append(other);
+    std::fill(vcf_source_.begin() + offset, vcf_source_.end(), vcf_source);
+}
+
+/*
+* 預留列空間
+* \param rows 列數
+*/
+void MethylationSiteTable::reserve(size_t rows) {
+    chrom_.reserve(rows);
+    methyl_pos_.reserve(rows);
+    somatic_pos_.reserve(rows);
+    variant_type_.reserve(rows);
+    vcf_source_.reserve(rows);
+    bam_source_.reserve(rows);
+    haplotype_.reserve(rows);
+    read_.reserve(rows);
+    ml_.reserve(rows);
+    flags_.reserve(rows);
+    somatic_base_.reserve(rows);
+}
+
+/*
+* 清除所有列並釋放記憶體
+*/
+void MethylationSiteTable::clear() {
+    *this = MethylationSiteTable();
+}
+
+/*
+* 估算表格佔用的位元組數
+* \return 位元組數
+*/
+size_t MethylationSiteTable::memoryBytes() const {
+    return chrom_.capacity() * sizeof(uint32_t) +
+           methyl_pos_.capacity() * sizeof(int32_t) +
+           somatic_pos_.capacity() * sizeof(int32_t) +
+           (variant_type_.capacity() + vcf_source_.capacity() +
+            bam_source_.capacity() + haplotype_.capacity()) * sizeof(uint16_t) +
+           read_.capacity() * sizeof(ReadHandle) +
+           ml_.capacity() + flags_.capacity() + somatic_base_.capacity() +
+           read_names_.capacity();
+}
+
+/**
+ * @brief 將欄位內容附加到緩衝區
+ * \param out 輸出緩衝區
+ * \param column 欄位
+ */
+template <typename T>
+static void putColumn(std::string& out, const std::vector<T>& column) {
+    out.append(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+}
+
+/**
+ * @brief 由緩衝區讀取欄位內容
+ * \param data 讀取位置 (讀取後前進)
+ * \param end 緩衝區結尾
+ * \param count 元素數
+ * \param column 欄位
+ * \return 資料是否足夠
+ */
+template <typename T>
+static bool getColumn(const char*& data, const char* end, size_t count, std::vector<T>& column) {
+    size_t bytes = count * sizeof(T);
+    if (static_cast<size_t>(end - data) < bytes) {
+        return false;
+    }
+    column.resize(count);
+    std::memcpy(column.data(), data, bytes);
+    data += bytes;
+    return true;
+}
+
+/*
+* 將表格序列化附加到緩衝區
+* \param out 輸出緩衝區
+*/
+void MethylationSiteTable::serialize(std::string& out) const {
+    uint64_t header[2] = {size(), read_names_.size()};
+    out.append(reinterpret_cast<const char*>(header), sizeof(header));
+    putColumn(out, chrom_);
+    putColumn(out, methyl_pos_);
+    putColumn(out, somatic_pos_);
+    putColumn(out, variant_type_);
+    putColumn(out, vcf_source_);
+    putColumn(out, bam_source_);
+    putColumn(out, haplotype_);
+    putColumn(out, read_);
+    putColumn(out, ml_);
+    putColumn(out, flags_);
+    putColumn(out, somatic_base_);
+    putColumn(out, read_names_);
+}
+
+/*
+* 由序列化資料還原表格
+* \param data 序列化資料
+* \param size 位元組數
+* \return 資料是否完整
+*/
+bool MethylationSiteTable::deserialize(const char* data, size_t size) {
+    clear();
+    uint64_t header[2];
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(header, data, sizeof(header));
+    const char* end = data + size;
+    data += sizeof(header);
+    size_t rows = static_cast<size_t>(header[0]);
+    
+    bool ok = getColumn(data, end, rows, chrom_) &&
+              getColumn(data, end, rows, methyl_pos_) &&
+              getColumn(data, end, rows, somatic_pos_) &&
+              getColumn(data, end, rows, variant_type_) &&
+              getColumn(data, end, rows, vcf_source_) &&
+              getColumn(data, end, rows, bam_source_) &&
+              getColumn(data, end, rows, haplotype_) &&
+              getColumn(data, end, rows, read_) &&
+              getColumn(data, end, rows, ml_) &&
+              getColumn(data, end, rows, flags_) &&
+              getColumn(data, end, rows, somatic_base_) &&
+              getColumn(data, end, static_cast<size_t>(header[1]), read_names_) &&
+              data == end;
+    if (!ok) {
+        clear();
+    }
+    return ok;
+}
+
+/*
+* 等位基因類型名稱
+* \param allele 等位基因類型
+* \return 名稱
+*/
+const char* MethylationSiteTable::alleleTypeName(AlleleType allele) {
+    return allele == AlleleType::Alt ? "alt" : "ref";
+}
+
+/*
+* 甲基化狀態名稱
+* \param state 甲基化狀態
+* \return 名稱
+*/
+const char* MethylationSiteTable::methStateName(MethState state) {
+    switch (state) {
+        case MethState::High: return "high";
+        case MethState::Mid:  return "mid";
+        default:              return "low";
+    }
+}
+
+/*
+* 鏈方向字元
+* \param strand 鏈方向
+* \return 字元
+*/
+char MethylationSiteTable::strandChar(Strand strand) {
+    switch (strand) {
+        case Strand::Plus:  return '+';
+        case Strand::Minus: return '-';
+        default:            return '.';
+    }
+}
+
+} // namespace msa
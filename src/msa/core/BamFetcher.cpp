@@ -3,22 +3,28 @@
 #include "msa/utils/MemoryPool.h"
 #include <sstream>
 #include <stdexcept>
-#include <filesystem>
 #include <functional>
+#include <algorithm>
 
 // 使用正確的命名空間
 using namespace msa::utils;
-namespace fs = std::filesystem;
 
 namespace msa::core {
 
+// 合併區域的最大跨度 (bp)，避免高突變區段串成過長的區域而一次持有過多讀段
+static constexpr int kMaxMergedRegionSpan = 250000;
+
+// 自動掃描模式：一次索引查詢 (定位並解壓首個BGZF區塊) 約相當於循序讀取的讀段數
+static constexpr double kSeekCostReads = 32.0;
+
+// 自動掃描模式：無法取得索引統計時，查詢區域覆蓋掃描範圍的比例達此值即改用循序掃描
+static constexpr double kLinearScanSpanFraction = 0.5;
+
 /*
 * 構造函數
 */
 BamFetcher::BamFetcher(const msa::Config& config)
-    : config_(config), tumor_fp_(nullptr), normal_fp_(nullptr),
-      tumor_hdr_(nullptr), normal_hdr_(nullptr),
-      tumor_idx_(nullptr), normal_idx_(nullptr) {
+    : config_(config) {
 }
 
 /*
@@ -29,57 +35,29 @@ BamFetcher::~BamFetcher() {
 }
 
 /*
-* 開啟BAM檔案
+* 借用BAM檔案控制代碼
 * \return 是否成功開啟
 */
 bool BamFetcher::openBamFiles() {
-    // 開啟腫瘤BAM
+    auto& registry = BamResourceRegistry::getInstance();
+    
+    // 借用腫瘤BAM
     if (config_.tumor_bam != "-") {
-        tumor_fp_ = sam_open(config_.tumor_bam.c_str(), "r");
-        if (!tumor_fp_) {
+        if (!registry.acquire(config_.tumor_bam, tumor_)) {
             LOG_ERROR("BamFetcher", "無法開啟腫瘤BAM檔案: " + config_.tumor_bam);
             return false;
         }
-        
-        tumor_hdr_ = sam_hdr_read(tumor_fp_);
-        if (!tumor_hdr_) {
-            LOG_ERROR("BamFetcher", "無法讀取腫瘤BAM標頭: " + config_.tumor_bam);
-            closeBamFiles();
-            return false;
-        }
-        
-        tumor_idx_ = getBamIndex(config_.tumor_bam);
-        if (!tumor_idx_) {
-            LOG_ERROR("BamFetcher", "無法載入腫瘤BAM索引: " + config_.tumor_bam);
-            closeBamFiles();
-            return false;
-        }
     } else {
         LOG_WARN("BamFetcher", "腫瘤BAM指定為標準輸入，無法進行區域查詢");
     }
     
-    // 開啟正常BAM
+    // 借用正常BAM
     if (config_.normal_bam != "-") {
-        normal_fp_ = sam_open(config_.normal_bam.c_str(), "r");
-        if (!normal_fp_) {
+        if (!registry.acquire(config_.normal_bam, normal_)) {
             LOG_ERROR("BamFetcher", "無法開啟正常BAM檔案: " + config_.normal_bam);
             closeBamFiles();
             return false;
         }
-        
-        normal_hdr_ = sam_hdr_read(normal_fp_);
-        if (!normal_hdr_) {
-            LOG_ERROR("BamFetcher", "無法讀取正常BAM標頭: " + config_.normal_bam);
-            closeBamFiles();
-            return false;
-        }
-        
-        normal_idx_ = getBamIndex(config_.normal_bam);
-        if (!normal_idx_) {
-            LOG_ERROR("BamFetcher", "無法載入正常BAM索引: " + config_.normal_bam);
-            closeBamFiles();
-            return false;
-        }
     } else {
         LOG_WARN("BamFetcher", "正常BAM指定為標準輸入，無法進行區域查詢");
     }
@@ -88,40 +66,16 @@ bool BamFetcher::openBamFiles() {
 }
 
 /*
-* 關閉BAM檔案
+* 歸還BAM檔案控制代碼
 */
 void BamFetcher::closeBamFiles() {
-    // 釋放腫瘤BAM資源
-    if (tumor_idx_) {
-        hts_idx_destroy(tumor_idx_);
-        tumor_idx_ = nullptr;
-    }
+    // 游標的迭代器與讀段須在歸還控制代碼前釋放
+    resetCursor(tumor_cursor_);
+    resetCursor(normal_cursor_);
     
-    if (tumor_hdr_) {
-        bam_hdr_destroy(tumor_hdr_);
-        tumor_hdr_ = nullptr;
-    }
-    
-    if (tumor_fp_) {
-        sam_close(tumor_fp_);
-        tumor_fp_ = nullptr;
-    }
-    
-    // 釋放正常BAM資源
-    if (normal_idx_) {
-        hts_idx_destroy(normal_idx_);
-        normal_idx_ = nullptr;
-    }
-    
-    if (normal_hdr_) {
-        bam_hdr_destroy(normal_hdr_);
-        normal_hdr_ = nullptr;
-    }
-    
-    if (normal_fp_) {
-        sam_close(normal_fp_);
-        normal_fp_ = nullptr;
-    }
+    auto& registry = BamResourceRegistry::getInstance();
+    registry.release(tumor_);
+    registry.release(normal_);
 }
 
 /*
@@ -149,9 +103,8 @@ bool BamFetcher::fetchReadsAroundVariant(
              ", 區域: " + variant.chrom + ":" + std::to_string(start+1) + "-" + std::to_string(end+1));
     
     // 獲取腫瘤樣本的讀段
-    if (tumor_fp_ && tumor_hdr_ && tumor_idx_) {
-        if (!fetchReadsFromRegion(tumor_fp_, tumor_hdr_, tumor_idx_, 
-                                variant.chrom, start, end, tumorReads)) {
+    if (tumor_.valid()) {
+        if (!fetchReadsFromRegion(tumor_, variant.chrom, start, end, tumorReads)) {
             LOG_ERROR("BamFetcher", "無法取得腫瘤樣本區域: " + 
                               variant.chrom + ":" + std::to_string(start+1) + "-" + std::to_string(end+1));
             return false;
@@ -159,9 +112,8 @@ bool BamFetcher::fetchReadsAroundVariant(
     }
     
     // 獲取正常樣本的讀段
-    if (normal_fp_ && normal_hdr_ && normal_idx_) {
-        if (!fetchReadsFromRegion(normal_fp_, normal_hdr_, normal_idx_, 
-                                variant.chrom, start, end, normalReads)) {
+    if (normal_.valid()) {
+        if (!fetchReadsFromRegion(normal_, variant.chrom, start, end, normalReads)) {
             LOG_ERROR("BamFetcher", "無法取得正常樣本區域: " + 
                               variant.chrom + ":" + std::to_string(start+1) + "-" + std::to_string(end+1));
             return false;
@@ -180,9 +132,7 @@ bool BamFetcher::fetchReadsAroundVariant(
 
 /*
 * 從指定區域獲取讀段
-* \param fp BAM檔案指針
-* \param hdr BAM標頭指針
-* \param idx BAM索引指針
+* \param handle BAM檔案控制代碼
 * \param chrom 染色體名稱
 * \param start 起始位置
 * \param end 結束位置
@@ -190,23 +140,21 @@ bool BamFetcher::fetchReadsAroundVariant(
 * \return 是否成功獲取
 */
 bool BamFetcher::fetchReadsFromRegion(
-    htsFile* fp,
-    bam_hdr_t* hdr,
-    hts_idx_t* idx,
+    const BamHandle& handle,
     const std::string& chrom,
     int start,
     int end,
     std::vector<bam1_t*>& reads) {
     
     // 獲取染色體ID
-    int tid = bam_name2id(hdr, chrom.c_str());
+    int tid = handle.resource->getTid(chrom);
     if (tid < 0) {
         LOG_ERROR("BamFetcher", "無法找到染色體: " + chrom);
         return false;
     }
     
     // 建立查詢迭代器
-    hts_itr_t* iter = sam_itr_queryi(idx, tid, start, end);
+    hts_itr_t* iter = sam_itr_queryi(handle.resource->idx, tid, start, end);
     if (!iter) {
         LOG_ERROR("BamFetcher", "無法建立迭代器: " + chrom + ":" + 
                           std::to_string(start+1) + "-" + std::to_string(end+1));
@@ -231,7 +179,7 @@ bool BamFetcher::fetchReadsFromRegion(
         bam1_t* b = memPool.getBam1();
         
         // 讀取下一條記錄
-        int ret = sam_itr_next(fp, iter, b);
+        int ret = sam_itr_next(handle.fp, iter, b);
         if (ret < 0) {
             memPool.returnBam1(b);  // 返回記憶體池
             break;  // 讀取完畢或錯誤
@@ -258,31 +206,6 @@ bool BamFetcher::fetchReadsFromRegion(
     return true;
 }
 
-/*
-* 獲取BAM索引
-* \param bamPath BAM檔案路徑
-* \return BAM索引指針
-*/
-hts_idx_t* BamFetcher::getBamIndex(const std::string& bamPath) {
-    hts_idx_t* idx = nullptr;
-    
-    // 如果是標準輸入，無法獲取索引
-    if (bamPath != "-") {
-        // 嘗試尋找 .bai 與 .bam.bai 兩種索引檔案
-        std::string baiPath = bamPath + ".bai";
-        std::string bamBaiPath = fs::path(bamPath).replace_extension(".bam.bai").string();
-        
-        idx = hts_idx_load(bamPath.c_str(), HTS_FMT_BAI);
-        
-        if (!idx) {
-            LOG_ERROR("BamFetcher", "無法載入BAM索引: " + bamPath + 
-                              " (嘗試了 " + baiPath + " 和 " + bamBaiPath + ")");
-        }
-    }
-    
-    return idx;
-}
-
 /*
 * 檢查讀段是否有效
 * \param b 讀段指針
@@ -330,28 +253,26 @@ std::vector<std::unique_ptr<bam1_t, std::function<void(bam1_t*)>>> BamFetcher::f
     int end = pos_0based + window_size;
     
     // 獲取相應的BAM檔案資源
-    htsFile* fp = isTumor ? tumor_fp_ : normal_fp_;
-    bam_hdr_t* hdr = isTumor ? tumor_hdr_ : normal_hdr_;
-    hts_idx_t* idx = isTumor ? tumor_idx_ : normal_idx_;
+    const BamHandle& handle = isTumor ? tumor_ : normal_;
     
     // 創建結果容器
     std::vector<std::unique_ptr<bam1_t, std::function<void(bam1_t*)>>> result;
     
     // 檢查資源是否有效
-    if (!fp || !hdr || !idx) {
+    if (!handle.valid()) {
         LOG_ERROR("BamFetcher", "無效的BAM資源: " + std::string(isTumor ? "腫瘤" : "正常") + " 樣本");
         return result;
     }
     
     // 獲取染色體ID
-    int tid = bam_name2id(hdr, variant.chrom.c_str());
+    int tid = handle.resource->getTid(variant.chrom);
     if (tid < 0) {
         LOG_ERROR("BamFetcher", "無法找到染色體: " + variant.chrom);
         return result;
     }
     
     // 建立查詢迭代器
-    hts_itr_t* iter = sam_itr_queryi(idx, tid, start, end);
+    hts_itr_t* iter = sam_itr_queryi(handle.resource->idx, tid, start, end);
     if (!iter) {
         LOG_ERROR("BamFetcher", "無法建立迭代器: " + variant.chrom + ":" + 
                           std::to_string(start+1) + "-" + std::to_string(end+1));
@@ -381,7 +302,7 @@ std::vector<std::unique_ptr<bam1_t, std::function<void(bam1_t*)>>> BamFetcher::f
         bam1_t* b = memPool.getBam1();
         
         // 讀取下一條記錄
-        int ret = sam_itr_next(fp, iter, b);
+        int ret = sam_itr_next(handle.fp, iter, b);
         if (ret < 0) {
             memPool.returnBam1(b);  // 返回記憶體池
             break;  // 讀取完畢或錯誤
@@ -415,4 +336,444 @@ std::vector<std::unique_ptr<bam1_t, std::function<void(bam1_t*)>>> BamFetcher::f
     return result;
 }
 
+/*
+* 將排序後的變異窗口合併為查詢區域
+* \param variants 排序後的變異列表
+* \param window_size 窗口大小
+* \param merge_gap 合併間距
+* \return 查詢區域列表
+*/
+std::vector<msa::FetchRegion> BamFetcher::planFetchRegions(
+    const std::vector<msa::VcfVariantInfo>& variants,
+    int window_size,
+    int merge_gap) {
+    
+    std::vector<msa::FetchRegion> regions;
+    
+    for (size_t i = 0; i < variants.size(); ++i) {
+        const auto& variant = variants[i];
+        
+        // 與 fetchReadsAroundVariant 相同的窗口 (0-based, 半開區間)
+        int pos_0based = variant.pos - 1;
+        int start = std::max(0, pos_0based - window_size);
+        int end = pos_0based + window_size;
+        
+        // 判斷是否可併入前一個區域：同染色體、間距不超過 merge_gap 且合併後跨度不過大
+        if (merge_gap >= 0 && !regions.empty()) {
+            auto& last = regions.back();
+            if (last.chrom == variant.chrom &&
+                start <= last.end + merge_gap &&
+                std::max(last.end, end) - last.start <= kMaxMergedRegionSpan) {
+                last.end = std::max(last.end, end);
+                last.last_variant = i + 1;
+                continue;
+            }
+        }
+        
+        msa::FetchRegion region;
+        region.chrom = variant.chrom;
+        region.start = start;
+        region.end = end;
+        region.first_variant = i;
+        region.last_variant = i + 1;
+        regions.push_back(region);
+    }
+    
+    return regions;
+}
+
+/*
+* 抓取合併區域內的讀段並分派給各變異
+* \param region 查詢區域
+* \param variants 排序後的變異列表
+* \param isTumor 是否為腫瘤樣本
+* \param batch 讀段批次
+* \return 是否成功抓取
+*/
+bool BamFetcher::fetchReadsForRegion(
+    const msa::FetchRegion& region,
+    const std::vector<msa::VcfVariantInfo>& variants,
+    bool isTumor,
+    RegionReadBatch& batch) {
+    
+    batch.reads.clear();
+    batch.variant_reads.assign(region.last_variant - region.first_variant, {});
+    batch.read_variants.clear();
+    
+    // 獲取相應的BAM檔案資源
+    const BamHandle& handle = isTumor ? tumor_ : normal_;
+    
+    if (!handle.valid()) {
+        LOG_ERROR("BamFetcher", "無效的BAM資源: " + std::string(isTumor ? "腫瘤" : "正常") + " 樣本");
+        return false;
+    }
+    
+    int tid = handle.resource->getTid(region.chrom);
+    if (tid < 0) {
+        LOG_ERROR("BamFetcher", "無法找到染色體: " + region.chrom);
+        return false;
+    }
+    
+    // 讀段來源：索引模式為區域迭代器；循序模式為該染色體的掃描游標
+    ScanCursor* cursor = nullptr;
+    hts_itr_t* iter = nullptr;
+    if (region.linear_scan) {
+        cursor = isTumor ? &tumor_cursor_ : &normal_cursor_;
+        if (!positionCursor(*cursor, handle, tid, region)) {
+            return false;
+        }
+        iter = cursor->iter;
+    } else {
+        iter = sam_itr_queryi(handle.resource->idx, tid, region.start, region.end);
+        if (!iter) {
+            LOG_ERROR("BamFetcher", "無法建立迭代器: " + region.chrom + ":" + 
+                              std::to_string(region.start+1) + "-" + std::to_string(region.end+1));
+            return false;
+        }
+    }
+    
+    // 預先計算區域內每個變異的窗口 (0-based, 半開區間)；變異已排序，窗口起訖皆單調遞增
+    size_t n_variants = region.last_variant - region.first_variant;
+    std::vector<int> win_start(n_variants), win_end(n_variants);
+    for (size_t v = 0; v < n_variants; ++v) {
+        int pos_0based = variants[region.first_variant + v].pos - 1;
+        win_start[v] = std::max(0, pos_0based - config_.window_size);
+        win_end[v] = pos_0based + config_.window_size;
+    }
+    
+    auto& memPool = MemoryPool::getInstance();
+    auto deleter = [&memPool](bam1_t* b) {
+        memPool.returnBam1(b);
+    };
+    
+    // 循序模式：先消耗上一區域留下的跨界讀段與預讀讀段，再繼續從迭代器讀取。
+    // 下一區域的起點不早於本區域最後一個窗口的起點，因此結尾超過該點的讀段須保留給下一區域。
+    std::vector<BamRecordPtr> carried;
+    size_t carried_index = 0;
+    int carry_from = n_variants > 0 ? win_start[n_variants - 1] : region.end;
+    if (cursor) {
+        carried = std::move(cursor->carry);
+        cursor->carry.clear();
+        if (cursor->lookahead) {
+            carried.push_back(std::move(cursor->lookahead));
+        }
+    }
+    
+    // 讀段依起始座標遞增輸出，因此以雙指標維護與目前讀段可能重疊的第一個窗口
+    size_t first_active = 0;
+    size_t depth_capped = 0;
+    
+    while (true) {
+        bam1_t* b = nullptr;
+        if (carried_index < carried.size()) {
+            b = carried[carried_index++].release();
+        } else {
+            b = memPool.getBam1();
+            int ret = sam_itr_next(handle.fp, iter, b);
+            if (ret < 0) {
+                memPool.returnBam1(b);
+                break;
+            }
+        }
+        
+        int read_start = static_cast<int>(b->core.pos);
+        int read_end = static_cast<int>(bam_endpos(b));
+        
+        if (cursor) {
+            // 起點已超出本區域的讀段留待下一區域
+            if (read_start >= region.end) {
+                cursor->lookahead = BamRecordPtr(b, deleter);
+                break;
+            }
+            // 位於區域起點之前且不重疊的讀段 (循序迭代器不做區域過濾)
+            if (read_end <= region.start) {
+                memPool.returnBam1(b);
+                continue;
+            }
+        }
+        
+        if (!isReadValid(b)) {
+            memPool.returnBam1(b);
+            continue;
+        }
+        
+        while (first_active < n_variants && win_end[first_active] <= read_start) {
+            first_active++;
+        }
+        
+        // 將讀段分派給每個窗口與之重疊且尚未達到最大讀取深度的變異 (即讀段的活躍變異集合)
+        size_t read_index = batch.reads.size();
+        std::vector<uint32_t> active_variants;
+        for (size_t v = first_active; v < n_variants && win_start[v] < read_end; ++v) {
+            auto& assigned_reads = batch.variant_reads[v];
+            if (static_cast<int>(assigned_reads.size()) >= config_.max_read_depth) {
+                continue;
+            }
+            assigned_reads.push_back(read_index);
+            if (static_cast<int>(assigned_reads.size()) == config_.max_read_depth) {
+                depth_capped++;
+            }
+            active_variants.push_back(static_cast<uint32_t>(v));
+        }
+        
+        bool keep_for_next = cursor && read_end > carry_from;
+        
+        if (!active_variants.empty()) {
+            if (keep_for_next) {
+                // 批次可能在其他執行緒上被提取，下一區域使用獨立副本
+                bam1_t* copy = memPool.getBam1();
+                bam_copy1(copy, b);
+                cursor->carry.push_back(BamRecordPtr(copy, deleter));
+            }
+            batch.reads.push_back(BamRecordPtr(b, deleter));
+            batch.read_variants.push_back(std::move(active_variants));
+        } else if (keep_for_next) {
+            cursor->carry.push_back(BamRecordPtr(b, deleter));
+        } else {
+            memPool.returnBam1(b);
+        }
+    }
+    
+    if (cursor) {
+        cursor->last_start = region.start;
+    } else {
+        hts_itr_destroy(iter);
+    }
+    
+    if (depth_capped > 0) {
+        LOG_WARN("BamFetcher", "區域 " + region.chrom + ":" + 
+                          std::to_string(region.start+1) + "-" + std::to_string(region.end+1) + 
+                          " 中有 " + std::to_string(depth_capped) + " 個變異已達最大讀取深度: " + 
+                          std::to_string(config_.max_read_depth));
+    }
+    
+    std::ostringstream ss;
+    ss << "區域 " << region.chrom << ":" << (region.start + 1) << "-" << (region.end + 1)
+       << " (" << n_variants << " 個變異) 取得: " << (isTumor ? "腫瘤" : "正常") 
+       << "讀段=" << batch.reads.size();
+    LOG_DEBUG("BamFetcher", ss.str());
+    
+    return true;
+}
+
+/*
+* 重設循序掃描游標
+* \param cursor 掃描游標
+*/
+void BamFetcher::resetCursor(ScanCursor& cursor) {
+    if (cursor.iter) {
+        hts_itr_destroy(cursor.iter);
+        cursor.iter = nullptr;
+    }
+    cursor.carry.clear();
+    cursor.lookahead.reset();
+    cursor.tid = -1;
+    cursor.last_start = -1;
+}
+
+/*
+* 將游標定位到查詢區域所在的染色體
+* \param cursor 掃描游標
+* \param handle BAM檔案控制代碼
+* \param tid 染色體ID
+* \param region 查詢區域
+* \return 是否成功
+*/
+bool BamFetcher::positionCursor(ScanCursor& cursor, const BamHandle& handle, int tid, const msa::FetchRegion& region) {
+    // 同一染色體且區域依序前進時沿用迭代器
+    if (cursor.iter && cursor.tid == tid && region.start >= cursor.last_start) {
+        return true;
+    }
+    
+    resetCursor(cursor);
+    
+    // 只定位一次，之後沿著染色體循序讀取
+    cursor.iter = sam_itr_queryi(handle.resource->idx, tid, region.start, HTS_POS_MAX);
+    if (!cursor.iter) {
+        LOG_ERROR("BamFetcher", "無法建立循序掃描迭代器: " + region.chrom + ":" + std::to_string(region.start + 1));
+        return false;
+    }
+    cursor.tid = tid;
+    
+    LOG_DEBUG("BamFetcher", "循序掃描染色體 " + region.chrom + "，起點 " + std::to_string(region.start + 1));
+    return true;
+}
+
+/*
+* 為每條染色體選擇讀取模式
+* \param regions 查詢區域列表
+* \param config 配置
+* \return 採用循序掃描的染色體數
+*/
+size_t BamFetcher::selectScanModes(std::vector<msa::FetchRegion>& regions, const msa::Config& config) {
+    if (config.scan_mode == "indexed") {
+        return 0;
+    }
+    
+    // 自動模式使用的索引資源 (標準輸入無索引)
+    std::vector<const BamResource*> resources;
+    if (config.scan_mode == "auto") {
+        auto& registry = BamResourceRegistry::getInstance();
+        for (const auto* path : {&config.tumor_bam, &config.normal_bam}) {
+            if (path->empty() || *path == "-") {
+                continue;
+            }
+            const BamResource* resource = registry.getResource(*path);
+            if (resource) {
+                resources.push_back(resource);
+            }
+        }
+    }
+    
+    size_t linear_chroms = 0;
+    size_t i = 0;
+    while (i < regions.size()) {
+        // 變異已排序，同一染色體的查詢區域連續出現
+        size_t j = i;
+        double span = 0.0;
+        while (j < regions.size() && regions[j].chrom == regions[i].chrom) {
+            span += regions[j].end - regions[j].start;
+            ++j;
+        }
+        
+        bool linear = (config.scan_mode == "linear");
+        if (!linear && !resources.empty()) {
+            // 循序模式從第一個區域讀到最後一個區域；索引模式每個區域一次定位
+            double scan_len = std::max(1, regions[j - 1].end - regions[i].start);
+            double n_regions = static_cast<double>(j - i);
+            
+            double linear_reads = 0.0;
+            double indexed_reads = 0.0;
+            bool have_stats = false;
+            for (const auto* resource : resources) {
+                int tid = resource->getTid(regions[i].chrom);
+                if (tid < 0) {
+                    continue;
+                }
+                uint64_t mapped = 0, unmapped = 0;
+                hts_pos_t chrom_len = sam_hdr_tid2len(resource->hdr, tid);
+                if (hts_idx_get_stat(resource->idx, tid, &mapped, &unmapped) < 0 || chrom_len <= 0) {
+                    continue;
+                }
+                have_stats = true;
+                double reads_per_bp = static_cast<double>(mapped) / static_cast<double>(chrom_len);
+                linear_reads += reads_per_bp * scan_len;
+                indexed_reads += reads_per_bp * span + n_regions * kSeekCostReads;
+            }
+            
+            linear = have_stats ? (linear_reads <= indexed_reads)
+                                : (span / scan_len >= kLinearScanSpanFraction);
+            
+            LOG_DEBUG("BamFetcher", "染色體 " + regions[i].chrom + ": " + std::to_string(j - i) + " 個查詢區域，覆蓋比例=" + 
+                      std::to_string(span / scan_len) + "，估計讀段數 循序=" + std::to_string(static_cast<uint64_t>(linear_reads)) + 
+                      " 索引=" + std::to_string(static_cast<uint64_t>(indexed_reads)) + " -> " + (linear ? "linear" : "indexed"));
+        }
+        
+        for (size_t r = i; r < j; ++r) {
+            regions[r].linear_scan = linear;
+        }
+        if (linear) {
+            linear_chroms++;
+        }
+        i = j;
+    }
+    
+    return linear_chroms;
+}
+
+/**
+ * @brief 查詢區間在索引中對應的壓縮位元組跨度
+ * @param idx BAM索引
+ * @param tid 染色體ID
+ * @param beg 起始位置 (0-based)
+ * @param end 結束位置 (不含)
+ * @param n_chunks 用於存儲需定位的區塊數
+ * @return uint64_t 壓縮位元組數
+ */
+static uint64_t indexedBytes(const hts_idx_t* idx, int tid, hts_pos_t beg, hts_pos_t end, int& n_chunks) {
+    n_chunks = 0;
+    hts_itr_t* iter = sam_itr_queryi(idx, tid, beg, end);
+    if (!iter) {
+        return 0;
+    }
+    uint64_t bytes = 0;
+    for (int k = 0; k < iter->n_off; ++k) {
+        // 虛擬位移的高48位元為BGZF區塊的壓縮檔案位移
+        uint64_t u = iter->off[k].u >> 16;
+        uint64_t v = iter->off[k].v >> 16;
+        bytes += v > u ? v - u : 0;
+    }
+    n_chunks = iter->n_off;
+    hts_itr_destroy(iter);
+    return bytes;
+}
+
+/*
+* 以BAM索引估算每個查詢區域的工作量
+* \param regions 查詢區域列表
+* \param config 配置物件
+* \return 每個區域的估算工作量
+*/
+std::vector<uint64_t> BamFetcher::estimateRegionCosts(
+    const std::vector<msa::FetchRegion>& regions,
+    const msa::Config& config) {
+    
+    std::vector<double> costs(regions.size(), 0.0);
+    bool have_estimate = false;
+    
+    auto& registry = BamResourceRegistry::getInstance();
+    for (const auto* path : {&config.tumor_bam, &config.normal_bam}) {
+        if (path->empty() || *path == "-") {
+            continue;
+        }
+        const BamResource* resource = registry.getResource(*path);
+        if (!resource || !resource->idx) {
+            continue;
+        }
+        
+        size_t i = 0;
+        while (i < regions.size()) {
+            size_t j = i;
+            while (j < regions.size() && regions[j].chrom == regions[i].chrom) {
+                ++j;
+            }
+            
+            int tid = resource->getTid(regions[i].chrom);
+            uint64_t mapped = 0, unmapped = 0;
+            hts_pos_t chrom_len = tid >= 0 ? sam_hdr_tid2len(resource->hdr, tid) : 0;
+            if (tid < 0 || chrom_len <= 0 || hts_idx_get_stat(resource->idx, tid, &mapped, &unmapped) < 0 || mapped == 0) {
+                i = j;
+                continue;
+            }
+            
+            // 整條染色體的壓縮位元組跨度換算每個讀段的平均壓縮位元組數
+            int n_chunks = 0;
+            double chrom_bytes = static_cast<double>(indexedBytes(resource->idx, tid, 0, chrom_len, n_chunks));
+            double bytes_per_read = chrom_bytes / static_cast<double>(mapped);
+            double reads_per_bp = static_cast<double>(mapped) / static_cast<double>(chrom_len);
+            
+            for (size_t r = i; r < j; ++r) {
+                const auto& region = regions[r];
+                double bytes = static_cast<double>(indexedBytes(resource->idx, tid, region.start, region.end, n_chunks));
+                // 區域落在單一BGZF區塊內時位元組跨度為0，改以平均深度估算
+                double reads = (bytes > 0.0 && bytes_per_read > 0.0) ? bytes / bytes_per_read
+                                                                     : reads_per_bp * (region.end - region.start);
+                double n_variants = static_cast<double>(region.last_variant - region.first_variant);
+                double extracted = std::min(reads, n_variants * config.max_read_depth);
+                // 抓取與解碼區域內所有讀段、每個區塊一次定位、提取受深度上限限制的讀段
+                costs[r] += reads + n_chunks * kSeekCostReads + extracted;
+            }
+            have_estimate = true;
+            i = j;
+        }
+    }
+    
+    std::vector<uint64_t> result(regions.size());
+    for (size_t r = 0; r < regions.size(); ++r) {
+        double cost = have_estimate ? costs[r] : static_cast<double>(regions[r].end - regions[r].start);
+        result[r] = std::max<uint64_t>(1, static_cast<uint64_t>(cost));
+    }
+    return result;
+}
+
 } // namespace msa::core 
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "msa/core/BamResourceRegistry.h"
+#include "msa/utils/LogManager.h"
+#include "msa/utils/HtsThreadPool.h"
+#include <sstream>
+#include <filesystem>
+
+// 使用正確的命名空間
+using namespace msa::utils;
+namespace fs = std::filesystem;
+
+namespace msa::core {
+
+/*
+* 查詢染色體ID
+* \param chrom 染色體名稱
+* \return 染色體ID
+*/
+int BamResource::getTid(const std::string& chrom) const {
+    auto it = tid_by_name.find(chrom);
+    return it == tid_by_name.end() ? -1 : it->second;
+}
+
+/*
+* 單例實例獲取
+* \return 註冊中心實例
+*/
+BamResourceRegistry& BamResourceRegistry::getInstance() {
+    static BamResourceRegistry instance;
+    return instance;
+}
+
+/*
+* 解構函數
+*/
+BamResourceRegistry::~BamResourceRegistry() {
+    releaseAll();
+}
+
+/*
+* 獲取共用資源
+* \param bamPath BAM檔案路徑
+* \return 共用資源
+*/
+const BamResource* BamResourceRegistry::getResource(const std::string& bamPath) {
+    Entry* entry = getLoadedEntry(bamPath);
+    return entry ? &entry->resource : nullptr;
+}
+
+/*
+* 獲取或建立註冊項目並確保資源已載入
+* \param bamPath BAM檔案路徑
+* \return 註冊項目
+*/
+BamResourceRegistry::Entry* BamResourceRegistry::getLoadedEntry(const std::string& bamPath) {
+    Entry* entry = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& slot = entries_[bamPath];
+        if (!slot) {
+            slot = std::make_unique<Entry>();
+            slot->resource.path = bamPath;
+        }
+        entry = slot.get();
+    }
+    
+    // 載入在鎖外進行，其他路徑的載入不會被阻塞；同一路徑的並行呼叫會等待首次載入完成
+    std::call_once(entry->load_once, [this, entry]() { loadEntry(*entry); });
+    
+    return entry->loaded ? entry : nullptr;
+}
+
+/*
+* 載入BAM標頭與索引
+* \param entry 註冊項目
+*/
+void BamResourceRegistry::loadEntry(Entry& entry) {
+    auto& resource = entry.resource;
+    const std::string& bamPath = resource.path;
+    
+    // 標準輸入無法建立索引查詢
+    if (bamPath == "-") {
+        LOG_WARN("BamResourceRegistry", "BAM指定為標準輸入，無法進行區域查詢");
+        return;
+    }
+    
+    htsFile* fp = sam_open(bamPath.c_str(), "r");
+    if (!fp) {
+        LOG_ERROR("BamResourceRegistry", "無法開啟BAM檔案: " + bamPath);
+        return;
+    }
+    
+    resource.hdr = sam_hdr_read(fp);
+    sam_close(fp);
+    if (!resource.hdr) {
+        LOG_ERROR("BamResourceRegistry", "無法讀取BAM標頭: " + bamPath);
+        return;
+    }
+    
+    resource.idx = hts_idx_load(bamPath.c_str(), HTS_FMT_BAI);
+    if (!resource.idx) {
+        std::string baiPath = bamPath + ".bai";
+        std::string bamBaiPath = fs::path(bamPath).replace_extension(".bam.bai").string();
+        LOG_ERROR("BamResourceRegistry", "無法載入BAM索引: " + bamPath + 
+                  " (嘗試了 " + baiPath + " 和 " + bamBaiPath + ")");
+        bam_hdr_destroy(resource.hdr);
+        resource.hdr = nullptr;
+        return;
+    }
+    
+    // 預先建立染色體ID表，工作執行緒只讀取此表而不觸碰標頭的延遲初始化結構
+    for (int tid = 0; tid < resource.hdr->n_targets; ++tid) {
+        resource.tid_by_name.emplace(resource.hdr->target_name[tid], tid);
+    }
+    
+    entry.loaded = true;
+    LOG_INFO("BamResourceRegistry", "已載入BAM標頭與索引: " + bamPath + 
+             " (" + std::to_string(resource.hdr->n_targets) + " 條參考序列)");
+}
+
+/*
+* 借出BAM檔案控制代碼
+* \param bamPath BAM檔案路徑
+* \param handle 借出的控制代碼
+* \return 是否成功借出
+*/
+bool BamResourceRegistry::acquire(const std::string& bamPath, BamHandle& handle) {
+    Entry* entry = getLoadedEntry(bamPath);
+    if (!entry) {
+        return false;
+    }
+    
+    // 優先重用閒置控制代碼
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!entry->idle_handles.empty()) {
+            handle.fp = entry->idle_handles.back();
+            handle.resource = &entry->resource;
+            entry->idle_handles.pop_back();
+            return true;
+        }
+    }
+    
+    // 開啟新的私有控制代碼；區域查詢由迭代器定位，不需要再次解析標頭
+    htsFile* fp = sam_open(bamPath.c_str(), "r");
+    if (!fp) {
+        LOG_ERROR("BamResourceRegistry", "無法開啟BAM檔案: " + bamPath);
+        return false;
+    }
+    
+    // BGZF解壓縮交由共用執行緒池處理
+    HtsThreadPool::getInstance().attach(fp);
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entry->opened_handles++;
+    }
+    
+    handle.fp = fp;
+    handle.resource = &entry->resource;
+    return true;
+}
+
+/*
+* 歸還BAM檔案控制代碼
+* \param handle 借出的控制代碼
+*/
+void BamResourceRegistry::release(BamHandle& handle) {
+    if (!handle.fp) {
+        handle.resource = nullptr;
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = handle.resource ? entries_.find(handle.resource->path) : entries_.end();
+        if (it != entries_.end()) {
+            it->second->idle_handles.push_back(handle.fp);
+        } else {
+            sam_close(handle.fp);
+        }
+    }
+    
+    handle.fp = nullptr;
+    handle.resource = nullptr;
+}
+
+/*
+* 關閉所有閒置控制代碼並釋放共用資源
+*/
+void BamResourceRegistry::releaseAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    for (auto& [path, entry] : entries_) {
+        size_t outstanding = entry->opened_handles - entry->idle_handles.size();
+        if (outstanding > 0) {
+            LOG_WARN("BamResourceRegistry", "釋放時仍有 " + std::to_string(outstanding) + 
+                     " 個控制代碼未歸還: " + path);
+        }
+        
+        for (htsFile* fp : entry->idle_handles) {
+            sam_close(fp);
+        }
+        entry->idle_handles.clear();
+        
+        if (entry->resource.idx) {
+            hts_idx_destroy(entry->resource.idx);
+            entry->resource.idx = nullptr;
+        }
+        if (entry->resource.hdr) {
+            bam_hdr_destroy(entry->resource.hdr);
+            entry->resource.hdr = nullptr;
+        }
+    }
+    
+    entries_.clear();
+}
+
+/*
+* 獲取統計資訊
+* \return 統計資訊字串
+*/
+std::string BamResourceRegistry::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    size_t loaded = 0, opened = 0, idle = 0;
+    for (const auto& [_, entry] : entries_) {
+        if (entry->loaded) loaded++;
+        opened += entry->opened_handles;
+        idle += entry->idle_handles.size();
+    }
+    
+    std::ostringstream ss;
+    ss << "BamResourceRegistry狀態: 已載入BAM=" << loaded
+       << ", 已開啟控制代碼=" << opened
+       << ", 閒置控制代碼=" << idle;
+    return ss.str();
+}
+
+} // namespace msa::core
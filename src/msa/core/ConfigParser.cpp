@@ -46,12 +46,22 @@ msa::Config ConfigParser::parse(int argc, char** argv) {
         ("log-level", "日誌級別 (trace/debug/info/warn/error/fatal)", cxxopts::value<std::string>()->default_value("info"))
         ("log-file", "日誌檔案名稱", cxxopts::value<std::string>()->default_value("msa.log"))
         ("j,threads", "執行緒數", cxxopts::value<int>()->default_value("0"))
+        ("hts-threads", "所有BAM共用的htslib BGZF解壓縮執行緒數 (0表示停用)", cxxopts::value<int>()->default_value("0"))
+        ("prefetch-depth", "BAM讀取與甲基化提取之間的預取佇列深度 (0表示停用預取管線)", cxxopts::value<int>()->default_value("0"))
+        ("reader-threads", "預取管線的BAM讀取執行緒數", cxxopts::value<int>()->default_value("2"))
         ("o,outdir", "輸出總路徑", cxxopts::value<std::string>()->default_value("./results"))
         ("gzip-output", "是否gzip壓縮Level 1 & 2 TSV輸出", cxxopts::value<std::string>()->default_value("true"))
+        ("summary-only", "只輸出Level 2/3摘要與全域指標 (不保留與匯出Level 1位點，記憶體與摘要組數成正比)")
         ("max-read-depth", "最大讀取深度", cxxopts::value<int>()->default_value("10000"))
         ("max-ram-gb", "最大RAM使用量(GB)", cxxopts::value<int>()->default_value("32"))
+        ("read-cache-mb", "跨VCF與查詢區域共用的讀段解析快取容量(MB)，-1表示自動，0表示停用", cxxopts::value<int>()->default_value("-1"))
+        ("tmp-dir", "Level 1位點超過記憶體預算時溢寫的暫存目錄 (預設為系統暫存目錄)", cxxopts::value<std::string>())
+        ("union-vcfs", "合併所有VCF的變異位點，共用位點只提取一次後分送到各VCF的輸出")
+        ("merge-gap", "相鄰變異窗口間距不超過此值(bp)即合併為同一BAM查詢區域，-1表示停用", cxxopts::value<int>()->default_value("1000"))
+        ("scan-mode", "BAM讀取模式 (auto/indexed/linear)", cxxopts::value<std::string>()->default_value("auto"))
+        ("permutations", "Level 3 每組甲基化差異的置換檢定與 bootstrap 重抽樣數 (0表示停用)", cxxopts::value<int>()->default_value("0"))
         ("h,help", "顯示使用說明");
-
+    
     // 設置需要參數值的選項
     options.positional_help("必要參數: --vcfs --ref --tumor --normal");
     options.show_positional_help();
@@ -135,6 +145,18 @@ msa::Config ConfigParser::parse(int argc, char** argv) {
             }
         }
         
+        if (result.count("hts-threads")) {
+            config.hts_threads = result["hts-threads"].as<int>();
+        }
+        
+        if (result.count("prefetch-depth")) {
+            config.prefetch_depth = result["prefetch-depth"].as<int>();
+        }
+        
+        if (result.count("reader-threads")) {
+            config.reader_threads = result["reader-threads"].as<int>();
+        }
+        
         if (result.count("outdir")) {
             config.outdir = result["outdir"].as<std::string>();
         }
@@ -149,6 +171,10 @@ msa::Config ConfigParser::parse(int argc, char** argv) {
             LOG_INFO("ConfigParser", "設定輸出壓縮: " + std::string(config.gzip_output ? "是" : "否") + " (原始值: " + gzip_value + ")");
         }
         
+        if (result.count("summary-only")) {
+            config.summary_only = true;
+        }
+        
         if (result.count("max-read-depth")) {
             config.max_read_depth = result["max-read-depth"].as<int>();
         }
@@ -157,6 +183,32 @@ msa::Config ConfigParser::parse(int argc, char** argv) {
             config.max_ram_gb = result["max-ram-gb"].as<int>();
         }
         
+        if (result.count("read-cache-mb")) {
+            config.read_cache_mb = result["read-cache-mb"].as<int>();
+        }
+        
+        if (result.count("tmp-dir")) {
+            config.tmp_dir = result["tmp-dir"].as<std::string>();
+        }
+        
+        if (result.count("union-vcfs")) {
+            config.union_vcfs = true;
+        }
+        
+        if (result.count("merge-gap")) {
+            config.region_merge_gap = result["merge-gap"].as<int>();
+        }
+        
+        if (result.count("scan-mode")) {
+            config.scan_mode = result["scan-mode"].as<std::string>();
+            std::transform(config.scan_mode.begin(), config.scan_mode.end(), config.scan_mode.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+        }
+        
+        if (result.count("permutations")) {
+            config.permutations = result["permutations"].as<int>();
+        }
+        
         // 驗證配置是否合法
         validateConfig(config);
         
@@ -178,7 +230,7 @@ msa::Config ConfigParser::parse(int argc, char** argv) {
         } catch (const std::exception& e) {
             throw std::runtime_error("無法創建輸出目錄: " + config.outdir + ", 錯誤: " + e.what());
         }
-        
+    
     } catch (const std::exception& e) {
         throw std::runtime_error("解析參數錯誤: " + std::string(e.what()) + "\n" + getUsage());
     }
@@ -225,6 +277,45 @@ void ConfigParser::validateConfig(msa::Config& config) {
         throw std::runtime_error("max-ram-gb必須在1-1024範圍內");
     }
     
+    // 檢查read-cache-mb
+    if (config.read_cache_mb < -1 || config.read_cache_mb > config.max_ram_gb * 1024) {
+        throw std::runtime_error("read-cache-mb必須在-1到max-ram-gb (" + std::to_string(config.max_ram_gb * 1024) + "MB) 範圍內");
+    }
+    
+    // 檢查tmp-dir (不存在時於首次溢寫時建立)
+    if (!config.tmp_dir.empty() && fs::exists(config.tmp_dir) && !fs::is_directory(config.tmp_dir)) {
+        throw std::runtime_error("tmp-dir不是目錄: " + config.tmp_dir);
+    }
+    
+    // 檢查hts-threads
+    if (config.hts_threads < 0 || config.hts_threads > 1024) {
+        throw std::runtime_error("hts-threads必須在0-1024範圍內");
+    }
+    
+    // 檢查預取管線參數
+    if (config.prefetch_depth < 0 || config.prefetch_depth > 4096) {
+        throw std::runtime_error("prefetch-depth必須在0-4096範圍內");
+    }
+    
+    if (config.reader_threads < 1 || config.reader_threads > 256) {
+        throw std::runtime_error("reader-threads必須在1-256範圍內");
+    }
+    
+    // 檢查merge-gap
+    if (config.region_merge_gap > 1000000) {
+        throw std::runtime_error("merge-gap必須小於等於1000000");
+    }
+    
+    // 檢查scan-mode
+    if (config.scan_mode != "auto" && config.scan_mode != "indexed" && config.scan_mode != "linear") {
+        throw std::runtime_error("無效的scan-mode，必須是auto/indexed/linear之一");
+    }
+    
+    // 檢查permutations (bootstrap 保留的尾端值與重抽樣數的 5% 成正比，每組並行計算)
+    if (config.permutations < 0 || config.permutations > 10000000) {
+        throw std::runtime_error("permutations必須在0-10000000範圍內");
+    }
+    
     // 檢查日誌級別
     std::string level_lower = config.log_level;
     std::transform(level_lower.begin(), level_lower.end(), level_lower.begin(),
@@ -0,0 +1,714 @@
+#include "msa/core/ExtractionPipeline.h"
+#include "msa/core/MethylCallClassifier.h"
+#include "msa/utils/LogManager.h"
+#include "msa/utils/TaskScheduler.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+// 使用正確的命名空間
+using namespace msa::utils;
+
+namespace msa::core {
+
+// 每個工作執行緒的目標區塊數 (區塊越少相鄰區域越能共用BGZF區塊，越多則竊取時越容易平衡負載)
+static constexpr size_t kUnitsPerThread = 8;
+
+// 每個溢寫區段至少累積 Level 1 預算的此比例 (區段越大，合併讀取時同時開啟的檔案越少)
+static constexpr size_t kSpillRunBudgetDivisor = 8;
+
+// 預取模式尚未抓取任何區域時，每單位估算工作量 (約當讀段數) 預先登記的讀段批次位元組數
+static constexpr uint64_t kInitialBytesPerCost = 1024;
+
+/*
+* 構造函數
+* \param config 配置
+*/
+ExtractionPipeline::ExtractionPipeline(const msa::Config& config)
+    : config_(config), level1_(MemoryGovernor::Subsystem::Level1) {
+}
+
+/**
+ * @brief 查詢區域內各變異位點表格佔用的位元組數
+ * \param region 查詢區域
+ * \param variant_results 每個變異的甲基化位點表格
+ * \return 位元組數
+ */
+static size_t regionTableBytes(const msa::FetchRegion& region, const std::vector<msa::MethylationSiteTable>& variant_results) {
+    size_t bytes = 0;
+    for (size_t v = region.first_variant; v < region.last_variant; ++v) {
+        bytes += variant_results[v].memoryBytes();
+    }
+    return bytes;
+}
+
+/*
+* 執行甲基化提取
+* \param variants 排序後的變異列表
+* \return 甲基化位點
+*/
+msa::Level1Details ExtractionPipeline::run(const std::vector<msa::VcfVariantInfo>& variants) {
+    size_t level1_budget = MemoryGovernor::getInstance().budget(MemoryGovernor::Subsystem::Level1);
+    if (level1_budget > 0) {
+        spill_ = std::make_shared<msa::Level1Spill>(config_.tmp_dir);
+        spill_min_bytes_ = level1_budget / kSpillRunBudgetDivisor;
+    }
+    std::vector<msa::MethylationSiteTable> variant_results = runPerVariant(variants);
+    std::shared_ptr<msa::Level1Spill> spill = std::move(spill_);
+    
+    // 提取期間已溢寫時其餘表格也寫出，分析與匯出改為依變異順序合併讀取各區段
+    if (spill && spill->runs() > 0) {
+        level1_.release(spill->writeRun(variant_results));
+        level1_.reset();
+        LOG_INFO("ExtractionPipeline", "Level 1表格超過記憶體預算，已溢寫: " + std::to_string(spill->rows()) + " 列, " +
+                 std::to_string(spill->runs()) + " 個區段, 壓縮後 " + std::to_string(spill->compressedBytes() / (1024 * 1024)) + "MB");
+        return msa::Level1Details(std::shared_ptr<const msa::Level1Spill>(std::move(spill)));
+    }
+    
+    msa::MethylationSiteTable all_methyl_sites;
+    
+    // 依變異順序合併結果，合併後立即釋放各變異的表格以降低峰值記憶體
+    size_t total_rows = 0;
+    for (const auto& results : variant_results) {
+        total_rows += results.size();
+    }
+    all_methyl_sites.reserve(total_rows);
+    level1_.add(all_methyl_sites.memoryBytes());
+    for (auto& results : variant_results) {
+        all_methyl_sites.append(results);
+        level1_.release(results.memoryBytes());
+        results.clear();
+    }
+    
+    // 合併後的表格交由呼叫端登記
+    level1_.reset();
+    
+    LOG_INFO("ExtractionPipeline", "Level 1表格: " + std::to_string(all_methyl_sites.size()) + " 列, " + 
+             std::to_string(all_methyl_sites.memoryBytes() / (1024 * 1024)) + "MB");
+    
+    return msa::Level1Details(std::move(all_methyl_sites));
+}
+
+/*
+* 執行甲基化提取，位點直接送入聚合器
+* \param variants 排序後的變異列表
+* \param aggregator 聚合器
+*/
+void ExtractionPipeline::runAggregated(const std::vector<msa::VcfVariantInfo>& variants, MethylationAggregator& aggregator) {
+    aggregator_ = &aggregator;
+    std::vector<msa::MethylationSiteTable> variant_results = runPerVariant(variants);
+    
+    // 無法開啟BAM的工作執行緒跳過的區域不會完成，其群集的其餘位點於此送入聚合器
+    for (size_t c = 0; c < cluster_variants_.size(); ++c) {
+        if (cluster_pending_[c].load() > 0) {
+            aggregateCluster(c, variant_results);
+        }
+    }
+    aggregator_ = nullptr;
+    level1_.reset();
+    cluster_pending_.reset();
+    variant_cluster_.clear();
+    cluster_variants_.clear();
+}
+
+/*
+* 將查詢區域分為互相重疊或相接的群集
+* \param regions 查詢區域
+* \param n_variants 變異數
+*/
+void ExtractionPipeline::planAggregationClusters(const std::vector<msa::FetchRegion>& regions, size_t n_variants) {
+    // 變異窗口在CpG位置上為閉區間，區域 (半開區間) 相接時兩側的窗口可能共用邊界上的CpG。
+    // 區域依起點排序，與群集內最大終點重疊或相接即併入同一群集
+    variant_cluster_.assign(n_variants, 0);
+    cluster_variants_.clear();
+    std::vector<size_t> cluster_regions;
+    int cluster_end = 0;
+    for (size_t r = 0; r < regions.size(); ++r) {
+        const auto& region = regions[r];
+        if (r == 0 || region.chrom != regions[r - 1].chrom || region.start > cluster_end) {
+            cluster_variants_.emplace_back(region.first_variant, region.last_variant);
+            cluster_regions.push_back(0);
+            cluster_end = region.end;
+        }
+        cluster_variants_.back().second = region.last_variant;
+        cluster_regions.back()++;
+        cluster_end = std::max(cluster_end, region.end);
+        for (size_t v = region.first_variant; v < region.last_variant; ++v) {
+            variant_cluster_[v] = cluster_variants_.size() - 1;
+        }
+    }
+    
+    cluster_pending_ = std::make_unique<std::atomic<size_t>[]>(cluster_regions.size());
+    for (size_t c = 0; c < cluster_regions.size(); ++c) {
+        cluster_pending_[c].store(cluster_regions[c]);
+    }
+    LOG_DEBUG("ExtractionPipeline", "串流聚合: " + std::to_string(regions.size()) + " 個查詢區域分為 " + 
+              std::to_string(cluster_regions.size()) + " 個群集");
+}
+
+/*
+* 查詢區域提取完成，群集完成時送入聚合器
+* \param region 查詢區域
+* \param variant_results 每個變異的甲基化位點表格
+*/
+void ExtractionPipeline::aggregateFinishedRegion(
+    const msa::FetchRegion& region,
+    std::vector<msa::MethylationSiteTable>& variant_results) {
+    
+    // 群集的所有區域皆已完成時 (遞減的順序保證可見其他執行緒寫入的表格)，其CpG的覆蓋數已完整
+    size_t cluster = variant_cluster_[region.first_variant];
+    if (cluster_pending_[cluster].fetch_sub(1) == 1) {
+        aggregateCluster(cluster, variant_results);
+    }
+}
+
+/*
+* 統計群集的雙股覆蓋並將其位點送入聚合器
+* \param cluster 群集索引
+* \param variant_results 每個變異的甲基化位點表格
+*/
+void ExtractionPipeline::aggregateCluster(size_t cluster, std::vector<msa::MethylationSiteTable>& variant_results) {
+    const auto [first, last] = cluster_variants_[cluster];
+    // 在提取任務內執行，不可等待其他任務 (等待期間會執行其他工作單元而共用同一個工作執行緒的提取器)，
+    // 群集的位點數不多，依序排序與篩選
+    MethylationAggregator::StrandCoverage coverage(false);
+    const bool filter = aggregator_->filtersStrandCoverage();
+    if (filter) {
+        for (size_t v = first; v < last; ++v) {
+            coverage.add(variant_results[v]);
+        }
+        coverage.build(config_.min_strand_reads);
+    }
+    
+    size_t freed = 0;
+    std::vector<uint8_t> keep;
+    for (size_t v = first; v < last; ++v) {
+        if (filter) {
+            coverage.keepFlags(variant_results[v], keep);
+        }
+        aggregator_->consume(variant_results[v], filter ? keep.data() : nullptr);
+        freed += variant_results[v].memoryBytes();
+        variant_results[v].clear();
+    }
+    level1_.release(freed);
+}
+
+/*
+* 執行甲基化提取，保留每個變異的表格
+* \param variants 排序後的變異列表
+* \return 每個變異的甲基化位點表格
+*/
+std::vector<msa::MethylationSiteTable> ExtractionPipeline::runPerVariant(const std::vector<msa::VcfVariantInfo>& variants) {
+    std::vector<msa::MethylationSiteTable> variant_results(variants.size());
+    
+    // 將重疊或相近的變異窗口合併為查詢區域，避免重複解壓相同的BGZF區塊
+    std::vector<msa::FetchRegion> regions = BamFetcher::planFetchRegions(
+        variants, config_.window_size, config_.region_merge_gap);
+    LOG_INFO("ExtractionPipeline", std::to_string(variants.size()) + " 個變異合併為 " + 
+             std::to_string(regions.size()) + " 個BAM查詢區域");
+    if (aggregator_) {
+        planAggregationClusters(regions, variants.size());
+    }
+    
+    // 依變異密度選擇索引查詢或染色體循序掃描
+    size_t linear_chroms = BamFetcher::selectScanModes(regions, config_);
+    
+    // 以索引估算工作量切分工作單元，再依工作量由大到小排序 (最長工作優先)，
+    // 避免高深度區域在最後才被領取而拖長單執行緒的尾端
+    std::vector<uint64_t> region_costs = BamFetcher::estimateRegionCosts(regions, config_);
+    std::vector<ScanUnit> units = groupScanUnits(regions, region_costs,
+                                                 kUnitsPerThread * static_cast<size_t>(std::max(1, config_.threads)));
+    std::stable_sort(units.begin(), units.end(), [](const ScanUnit& a, const ScanUnit& b) { return a.cost > b.cost; });
+    
+    uint64_t total_cost = 0;
+    for (const auto& unit : units) {
+        total_cost += unit.cost;
+    }
+    LOG_INFO("ExtractionPipeline", "讀取模式=" + config_.scan_mode + "，循序掃描染色體數=" + 
+             std::to_string(linear_chroms) + "，工作單元數=" + std::to_string(units.size()));
+    if (!units.empty()) {
+        LOG_DEBUG("ExtractionPipeline", "估算總工作量=" + std::to_string(total_cost) + "，最大工作單元=" + 
+                  std::to_string(units.front().cost) + " (千分之" + 
+                  std::to_string(units.front().cost * 1000 / std::max<uint64_t>(1, total_cost)) + ")");
+    }
+    LOG_DEBUG("ExtractionPipeline", std::string("ML分類核心=") + MethylCallClassifier::kernelName());
+    
+    RunTiming timing;
+    if (config_.prefetch_depth > 0) {
+        runPrefetch(regions, region_costs, units, variants, variant_results, timing);
+    } else {
+        runSynchronous(regions, units, variants, variant_results, timing);
+    }
+    
+    // 耗時分佈：長尾為最後一個工作單元開始到全部完成的時間
+    int64_t total_micros = timing.elapsedMicros();
+    int64_t last_start = timing.last_unit_start_micros.load();
+    uint64_t tail_micros = last_start >= 0 ? static_cast<uint64_t>(total_micros - last_start) : 0;
+    LOG_INFO("ExtractionPipeline", "每個變異耗時: " + timing.variant_micros.toString());
+    LOG_INFO("ExtractionPipeline", "提取總耗時=" + TimingHistogram::formatMicros(static_cast<uint64_t>(total_micros)) + 
+             "，最長工作單元=" + TimingHistogram::formatMicros(timing.max_unit_micros.load()) + 
+             "，長尾=" + TimingHistogram::formatMicros(tail_micros));
+    
+    return variant_results;
+}
+
+/*
+* 自提取開始經過的微秒數
+* \return 微秒數
+*/
+int64_t ExtractionPipeline::RunTiming::elapsedMicros() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+* 記錄工作單元的開始
+* \param unit_index 領取順序
+* \param n_units 工作單元總數
+*/
+void ExtractionPipeline::RunTiming::unitStarted(size_t unit_index, size_t n_units) {
+    if (unit_index + 1 == n_units) {
+        last_unit_start_micros.store(elapsedMicros());
+    }
+}
+
+/*
+* 記錄工作單元的耗時
+* \param micros 耗時 (微秒)
+*/
+void ExtractionPipeline::RunTiming::unitFinished(uint64_t micros) {
+    uint64_t current = max_unit_micros.load(std::memory_order_relaxed);
+    while (micros > current && !max_unit_micros.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+    }
+}
+
+/*
+* 記錄查詢區域的耗時
+* \param region 查詢區域
+* \param micros 耗時 (微秒)
+*/
+void ExtractionPipeline::RunTiming::regionFinished(const msa::FetchRegion& region, uint64_t micros) {
+    size_t n_variants = region.last_variant - region.first_variant;
+    if (n_variants > 0) {
+        variant_micros.record(micros / n_variants, n_variants);
+    }
+}
+
+/*
+* 抓取查詢區域內的讀段
+* \param region 查詢區域
+* \param variants 排序後的變異列表
+* \param bam_fetcher BAM檔案讀取器
+* \param work 抓取結果
+*/
+void ExtractionPipeline::fetchRegion(
+    const msa::FetchRegion& region,
+    const std::vector<msa::VcfVariantInfo>& variants,
+    BamFetcher& bam_fetcher,
+    RegionWork& work) {
+    
+    LOG_DEBUG("ExtractionPipeline", "處理區域: " + region.chrom + ":" + std::to_string(region.start + 1) + "-" + 
+              std::to_string(region.end) + " (" + std::to_string(region.last_variant - region.first_variant) + " 個變異)");
+    
+    // 腫瘤與對照樣本各自只建立一次迭代器
+    work.use_tumor = !config_.tumor_bam.empty() && config_.tumor_has_methyl_tags &&
+                     bam_fetcher.fetchReadsForRegion(region, variants, true, work.tumor);
+    work.use_normal = !config_.normal_bam.empty() && config_.normal_has_methyl_tags &&
+                      bam_fetcher.fetchReadsForRegion(region, variants, false, work.normal);
+}
+
+/*
+* 為查詢區域內每個變異提取甲基化位點
+* \param region 查詢區域
+* \param variants 排序後的變異列表
+* \param work 已抓取的讀段
+* \param meth_extractor 甲基化/單倍型提取器
+* \param variant_results 每個變異的甲基化位點表格
+*/
+void ExtractionPipeline::extractRegion(
+    const msa::FetchRegion& region,
+    const std::vector<msa::VcfVariantInfo>& variants,
+    const RegionWork& work,
+    MethylHaploExtractor& meth_extractor,
+    std::vector<msa::MethylationSiteTable>& variant_results) {
+    
+    // 區域內的變異只由此區域寫入，表格增長的容量登記為 Level 1 用量
+    size_t bytes_before = regionTableBytes(region, variant_results);
+    
+    // 掃描線合併：每個讀段只解析一次MM/ML與CIGAR，並為其所有活躍變異輸出位點。
+    // 讀段依擷取順序處理且腫瘤先於對照，因此每個變異的輸出順序與逐變異處理時相同。
+    if (work.use_tumor) {
+        LOG_DEBUG("ExtractionPipeline", "腫瘤樣本區域內有 " + std::to_string(work.tumor.reads.size()) + " 個讀段");
+        for (size_t r = 0; r < work.tumor.reads.size(); ++r) {
+            meth_extractor.extractFromReadForVariants(work.tumor.reads[r].get(), variants, region.first_variant,
+                                                      work.tumor.read_variants[r], "tumor", variant_results);
+        }
+    }
+    
+    if (work.use_normal) {
+        LOG_DEBUG("ExtractionPipeline", "對照樣本區域內有 " + std::to_string(work.normal.reads.size()) + " 個讀段");
+        for (size_t r = 0; r < work.normal.reads.size(); ++r) {
+            meth_extractor.extractFromReadForVariants(work.normal.reads[r].get(), variants, region.first_variant,
+                                                      work.normal.read_variants[r], "normal", variant_results);
+        }
+    }
+    
+    size_t bytes_after = regionTableBytes(region, variant_results);
+    level1_.add(bytes_after - bytes_before);
+    if (aggregator_) {
+        aggregateFinishedRegion(region, variant_results);
+    } else if (spill_) {
+        spillFinishedVariants(region, bytes_after, variant_results);
+    }
+}
+
+/*
+* 登記查詢區域已完成的變異，超過 Level 1 預算時寫出溢寫區段
+* \param region 查詢區域
+* \param table_bytes 區域內變異表格佔用的位元組數
+* \param variant_results 每個變異的甲基化位點表格
+*/
+void ExtractionPipeline::spillFinishedVariants(
+    const msa::FetchRegion& region,
+    size_t table_bytes,
+    std::vector<msa::MethylationSiteTable>& variant_results) {
+    
+    // 區域的變異不會再被寫入，可隨時寫出；Level 1 預算為所有處理中的VCF共用
+    spill_->variantsFinished(region.first_variant, region.last_variant, table_bytes);
+    if (spill_disabled_.load(std::memory_order_relaxed) ||
+        MemoryGovernor::getInstance().hasHeadroom(MemoryGovernor::Subsystem::Level1, 0) ||
+        spill_->pendingBytes() < spill_min_bytes_) {
+        return;
+    }
+    
+    // 寫出失敗時表格仍在記憶體中，停止溢寫並繼續提取 (結束時再嘗試寫出一次)
+    try {
+        level1_.release(spill_->writeRun(variant_results));
+    } catch (const std::exception& e) {
+        LOG_ERROR("ExtractionPipeline", std::string(e.what()) + "，提取期間停止溢寫");
+        spill_disabled_.store(true, std::memory_order_relaxed);
+    }
+}
+
+/*
+* 取得目前工作執行緒的私有資源
+* \param contexts 每個工作執行緒的資源
+* \param open_bam 首次建立時是否借用BAM檔案控制代碼
+* \return 私有資源
+*/
+ExtractionPipeline::WorkerContext& ExtractionPipeline::workerContext(
+    std::vector<std::unique_ptr<WorkerContext>>& contexts,
+    bool open_bam) {
+    
+    // 每個槽位只由對應的工作執行緒存取；非工作執行緒 (排程器未初始化時) 使用0號槽位
+    size_t index = static_cast<size_t>(std::max(0, TaskScheduler::workerIndex()));
+    auto& context = contexts[index];
+    if (!context) {
+        context = std::make_unique<WorkerContext>(config_);
+        if (open_bam) {
+            context->bam_opened = context->bam_fetcher.openBamFiles();
+            if (!context->bam_opened) {
+                LOG_ERROR("ExtractionPipeline", "工作執行緒無法開啟BAM檔案，其工作單元將被跳過");
+            }
+        }
+    }
+    return *context;
+}
+
+/*
+* 同步模式
+* \param regions 查詢區域
+* \param units 工作單元
+* \param variants 排序後的變異列表
+* \param variant_results 每個變異的甲基化位點表格
+* \param timing 耗時統計
+*/
+void ExtractionPipeline::runSynchronous(
+    const std::vector<msa::FetchRegion>& regions,
+    const std::vector<ScanUnit>& units,
+    const std::vector<msa::VcfVariantInfo>& variants,
+    std::vector<msa::MethylationSiteTable>& variant_results,
+    RunTiming& timing) {
+    
+    auto& scheduler = TaskScheduler::getInstance();
+    std::vector<std::unique_ptr<WorkerContext>> contexts(std::max(1, scheduler.size()));
+    
+    // 每個工作單元為一個任務 (循序掃描的染色體由同一任務依序處理)。任務開始時才依序領取下一個
+    // 工作單元，因此無論任務在哪個佇列或被竊取，工作單元都依工作量由大到小開始處理
+    std::atomic<size_t> next_unit{0};
+    MemoryGovernor::Reservation batches(MemoryGovernor::Subsystem::ReadBatches);
+    TaskScheduler::TaskGroup group;
+    for (size_t t = 0; t < units.size(); ++t) {
+        scheduler.submit(group, [&]() {
+            size_t u = next_unit.fetch_add(1);
+            timing.unitStarted(u, units.size());
+            WorkerContext& context = workerContext(contexts, true);
+            if (!context.bam_opened) {
+                return;
+            }
+            int64_t unit_start = timing.elapsedMicros();
+            for (size_t r = units[u].first_region; r < units[u].last_region; ++r) {
+                int64_t region_start = timing.elapsedMicros();
+                RegionWork work;
+                fetchRegion(regions[r], variants, context.bam_fetcher, work);
+                // 排程任務不可阻塞，同步模式的讀段批次只登記用量
+                size_t bytes = estimateBytes(work);
+                batches.add(bytes);
+                extractRegion(regions[r], variants, work, context.meth_extractor, variant_results);
+                work = RegionWork();
+                batches.release(bytes);
+                timing.regionFinished(regions[r], static_cast<uint64_t>(timing.elapsedMicros() - region_start));
+            }
+            timing.unitFinished(static_cast<uint64_t>(timing.elapsedMicros() - unit_start));
+        });
+    }
+    scheduler.wait(group);
+    
+    // 各執行緒的資源於此釋放 (BamFetcher 解構時歸還BAM檔案控制代碼)
+    contexts.clear();
+}
+
+/*
+* 預取模式
+* \param regions 查詢區域
+* \param region_costs 每個查詢區域的估算工作量
+* \param units 工作單元
+* \param variants 排序後的變異列表
+* \param variant_results 每個變異的甲基化位點表格
+* \param timing 耗時統計
+*/
+void ExtractionPipeline::runPrefetch(
+    const std::vector<msa::FetchRegion>& regions,
+    const std::vector<uint64_t>& region_costs,
+    const std::vector<ScanUnit>& units,
+    const std::vector<msa::VcfVariantInfo>& variants,
+    std::vector<msa::MethylationSiteTable>& variant_results,
+    RunTiming& timing) {
+    
+    auto& scheduler = TaskScheduler::getInstance();
+    int num_readers = std::max(1, config_.reader_threads);
+    if (scheduler.size() == 0) {
+        num_readers = 1;  // 排程器未初始化時提取任務在讀取執行緒上直接執行，共用0號槽位的提取器
+    }
+    size_t depth = static_cast<size_t>(config_.prefetch_depth);
+    size_t max_bytes = MemoryGovernor::getInstance().budget(MemoryGovernor::Subsystem::ReadBatches);
+    
+    LOG_INFO("ExtractionPipeline", "預取模式: 讀取執行緒=" + std::to_string(num_readers) + 
+             ", 提取執行緒=" + std::to_string(std::max(1, scheduler.size())) + 
+             ", 佇列深度=" + std::to_string(depth) + 
+             ", 讀段批次記憶體預算=" + (max_bytes == 0 ? std::string("無限制") : std::to_string(max_bytes / (1024 * 1024)) + "MB"));
+    
+    // 每個已抓取的區域批次提交為一個提取任務，排程工作執行緒不會為等待批次而阻塞。
+    // 未完成的提取任務數限制為佇列深度；位元組數由全程序共用的讀段批次預算限制 (同時處理多個VCF時共同分攤)
+    MemoryGovernor::Reservation batches(MemoryGovernor::Subsystem::ReadBatches);
+    std::mutex inflight_mutex;
+    std::condition_variable inflight_cv;
+    size_t inflight = 0;
+    std::atomic<bool> failed{false};
+    
+    std::vector<std::unique_ptr<WorkerContext>> contexts(std::max(1, scheduler.size()));
+    TaskScheduler::TaskGroup group;
+    
+    auto extract = [&](RegionWork& work) {
+        int64_t extract_start = timing.elapsedMicros();
+        MethylHaploExtractor& meth_extractor = workerContext(contexts, false).meth_extractor;
+        extractRegion(regions[work.region_index], variants, work, meth_extractor, variant_results);
+        timing.regionFinished(regions[work.region_index],
+                              work.fetch_micros + static_cast<uint64_t>(timing.elapsedMicros() - extract_start));
+    };
+    
+    // 抓取前依區域的估算工作量乘以已抓取區域的平均位元組數登記讀段批次 (超過預算時在抓取前等待)，
+    // 抓取後再調整為實際大小
+    std::atomic<uint64_t> fetched_cost{0};
+    std::atomic<uint64_t> fetched_bytes{0};
+    auto admitBytes = [&](size_t r) -> size_t {
+        uint64_t cost = fetched_cost.load(std::memory_order_relaxed);
+        uint64_t bytes_per_cost = cost > 0 ? fetched_bytes.load(std::memory_order_relaxed) / cost : kInitialBytesPerCost;
+        return static_cast<size_t>(region_costs[r] * std::max<uint64_t>(1, bytes_per_cost));
+    };
+    
+    // 讀取執行緒依工作單元順序 (工作量由大到小) 領取工作
+    std::atomic<size_t> next_unit{0};
+    std::atomic<int> active_readers{num_readers};
+    std::mutex error_mutex;
+    std::exception_ptr reader_error;
+    
+    auto readUnits = [&](BamFetcher& bam_fetcher, bool opened, size_t& admitted) {
+        while (!failed.load(std::memory_order_relaxed)) {
+            size_t u = next_unit.fetch_add(1);
+            if (u >= units.size()) {
+                break;
+            }
+            timing.unitStarted(u, units.size());
+            
+            int64_t unit_start = timing.elapsedMicros();
+            for (size_t r = units[u].first_region; r < units[u].last_region && !failed.load(std::memory_order_relaxed); ++r) {
+                // 超過預算時等待提取任務釋放讀段批次；本流程沒有待提取的批次時不等待，避免與其他VCF互相等待
+                admitted = admitBytes(r);
+                batches.acquire(admitted);
+                
+                auto work = std::make_shared<RegionWork>();
+                work->region_index = r;
+                if (opened) {
+                    int64_t fetch_start = timing.elapsedMicros();
+                    fetchRegion(regions[r], variants, bam_fetcher, *work);
+                    work->fetch_micros = static_cast<uint64_t>(timing.elapsedMicros() - fetch_start);
+                }
+                
+                // 已放行的批次不再等待，只將登記調整為實際大小
+                size_t bytes = estimateBytes(*work);
+                if (bytes > admitted) {
+                    batches.add(bytes - admitted);
+                } else {
+                    batches.release(admitted - bytes);
+                }
+                admitted = bytes;
+                fetched_cost.fetch_add(region_costs[r], std::memory_order_relaxed);
+                fetched_bytes.fetch_add(bytes, std::memory_order_relaxed);
+                {
+                    std::unique_lock<std::mutex> lock(inflight_mutex);
+                    inflight_cv.wait(lock, [&]() { return inflight < depth || failed.load(std::memory_order_relaxed); });
+                    if (failed.load(std::memory_order_relaxed)) {
+                        break;
+                    }
+                    ++inflight;
+                }
+                
+                admitted = 0;  // 登記的用量由提取任務釋放
+                scheduler.submit(group, [&, work, bytes]() {
+                    std::exception_ptr error;
+                    try {
+                        extract(*work);
+                    } catch (...) {
+                        error = std::current_exception();
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                    // 釋放讀段 (bam1_t歸還記憶體池) 後讓讀取執行緒提交下一個批次
+                    *work = RegionWork();
+                    batches.release(bytes);
+                    {
+                        std::lock_guard<std::mutex> lock(inflight_mutex);
+                        --inflight;
+                    }
+                    inflight_cv.notify_all();
+                    if (error) {
+                        std::rethrow_exception(error);
+                    }
+                });
+            }
+            timing.unitFinished(static_cast<uint64_t>(timing.elapsedMicros() - unit_start));
+        }
+    };
+    
+    auto reader = [&]() {
+        size_t admitted = 0;  // 已登記但尚未交給提取任務的位元組數
+        try {
+            BamFetcher bam_fetcher(config_);
+            bool opened = bam_fetcher.openBamFiles();
+            if (!opened) {
+                LOG_ERROR("ExtractionPipeline", "讀取執行緒無法開啟BAM檔案");
+            }
+            readUnits(bam_fetcher, opened, admitted);
+            bam_fetcher.closeBamFiles();
+        } catch (...) {
+            // 抓取失敗 (含記憶體不足) 時停止所有讀取執行緒，例外在所有執行緒結束後由主執行緒重新拋出
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!reader_error) {
+                    reader_error = std::current_exception();
+                }
+            }
+            failed.store(true, std::memory_order_relaxed);
+        }
+        batches.release(admitted);
+        active_readers.fetch_sub(1);
+        {
+            // 取得一次鎖再通知，等待佇列深度的讀取執行緒不會錯過 failed 的變化
+            std::lock_guard<std::mutex> lock(inflight_mutex);
+        }
+        inflight_cv.notify_all();
+    };
+    
+    // 讀取執行緒專責BAM I/O (數量由 --reader-threads 獨立設定)，提取工作以排程任務執行
+    std::vector<std::thread> readers;
+    readers.reserve(num_readers);
+    for (int i = 0; i < num_readers; ++i) {
+        readers.emplace_back(reader);
+    }
+    
+    // 讀取執行緒仍會提交新任務，不能只等待群組：等待期間執行佇列中的任務，直到所有讀取執行緒結束且提取任務完成
+    scheduler.waitUntil([&]() {
+        if (active_readers.load() > 0) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(inflight_mutex);
+        return inflight == 0;
+    });
+    for (auto& t : readers) {
+        t.join();
+    }
+    scheduler.wait(group);  // 重新拋出提取任務的例外
+    if (reader_error) {
+        std::rethrow_exception(reader_error);
+    }
+}
+
+/*
+* 將查詢區域分組為工作單元
+* \param regions 查詢區域
+* \param region_costs 每個查詢區域的估算工作量
+* \param target_units 索引模式區域的目標區塊數
+* \return 工作單元列表
+*/
+std::vector<ExtractionPipeline::ScanUnit> ExtractionPipeline::groupScanUnits(
+    const std::vector<msa::FetchRegion>& regions,
+    const std::vector<uint64_t>& region_costs,
+    size_t target_units) {
+    
+    uint64_t indexed_cost = 0;
+    for (size_t r = 0; r < regions.size(); ++r) {
+        if (!regions[r].linear_scan) {
+            indexed_cost += region_costs[r];
+        }
+    }
+    uint64_t chunk_cost = std::max<uint64_t>(1, indexed_cost / std::max<size_t>(1, target_units));
+    
+    std::vector<ScanUnit> units;
+    for (size_t r = 0; r < regions.size(); ++r) {
+        uint64_t cost = region_costs[r];
+        if (!units.empty()) {
+            ScanUnit& last = units.back();
+            const auto& prev = regions[last.last_region - 1];
+            if (prev.chrom == regions[r].chrom && prev.linear_scan == regions[r].linear_scan) {
+                // 同一染色體上連續的循序掃描區域共用一個掃描游標，必須由同一執行緒依序抓取；
+                // 索引模式的相鄰區域在區塊工作量未達上限前併入同一區塊
+                if (regions[r].linear_scan || last.cost + cost <= chunk_cost) {
+                    last.last_region = r + 1;
+                    last.cost += cost;
+                    continue;
+                }
+            }
+        }
+        units.push_back({r, r + 1, cost});
+    }
+    return units;
+}
+
+/*
+* 估算讀段批次佔用的位元組數
+* \param work 已抓取的讀段
+* \return 位元組數
+*/
+size_t ExtractionPipeline::estimateBytes(const RegionWork& work) {
+    size_t bytes = 0;
+    for (const auto* batch : {&work.tumor, &work.normal}) {
+        for (const auto& read : batch->reads) {
+            bytes += sizeof(bam1_t) + read->m_data;
+        }
+    }
+    return bytes;
+}
+
+} // namespace msa::core
@@ -0,0 +1,220 @@
+#include "msa/core/MethylCallClassifier.h"
+#include "msa/utils/LogManager.h"
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MSA_ML_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace msa::core {
+
+using ClassifyKernel = MethylCallClassifier::Kernel;
+
+/**
+ * @brief 純量核心 (亦用於向量核心的尾端)
+ */
+static void classifyScalar(const uint8_t* ml, size_t n, uint8_t* states, uint8_t high_cut, uint8_t low_cut) {
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t v = ml[i];
+        states[i] = v >= high_cut ? 2 : static_cast<uint8_t>(v > low_cut);
+    }
+}
+
+#ifdef MSA_ML_KERNEL_X86
+
+/**
+ * @brief SSE2核心，每次16個ML值 (無號位元組比較以 max/min 後比較相等實現)
+ */
+__attribute__((target("sse2")))
+static void classifySse2(const uint8_t* ml, size_t n, uint8_t* states, uint8_t high_cut, uint8_t low_cut) {
+    const __m128i hi = _mm_set1_epi8(static_cast<char>(high_cut));
+    const __m128i lo = _mm_set1_epi8(static_cast<char>(low_cut));
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ml + i));
+        __m128i is_high = _mm_cmpeq_epi8(_mm_max_epu8(v, hi), v);
+        __m128i is_low = _mm_cmpeq_epi8(_mm_min_epu8(v, lo), v);
+        __m128i r = _mm_or_si128(_mm_and_si128(is_high, two),
+                                 _mm_andnot_si128(_mm_or_si128(is_high, is_low), one));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(states + i), r);
+    }
+    classifyScalar(ml + i, n - i, states + i, high_cut, low_cut);
+}
+
+/**
+ * @brief AVX2核心，每次32個ML值
+ */
+__attribute__((target("avx2")))
+static void classifyAvx2(const uint8_t* ml, size_t n, uint8_t* states, uint8_t high_cut, uint8_t low_cut) {
+    const __m256i hi = _mm256_set1_epi8(static_cast<char>(high_cut));
+    const __m256i lo = _mm256_set1_epi8(static_cast<char>(low_cut));
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ml + i));
+        __m256i is_high = _mm256_cmpeq_epi8(_mm256_max_epu8(v, hi), v);
+        __m256i is_low = _mm256_cmpeq_epi8(_mm256_min_epu8(v, lo), v);
+        __m256i r = _mm256_or_si256(_mm256_and_si256(is_high, two),
+                                    _mm256_andnot_si256(_mm256_or_si256(is_high, is_low), one));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(states + i), r);
+    }
+    classifyScalar(ml + i, n - i, states + i, high_cut, low_cut);
+}
+
+/**
+ * @brief AVX-512BW核心，每次64個ML值，尾端以遮罩載入/存放處理
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void classifyAvx512(const uint8_t* ml, size_t n, uint8_t* states, uint8_t high_cut, uint8_t low_cut) {
+    const __m512i hi = _mm512_set1_epi8(static_cast<char>(high_cut));
+    const __m512i lo = _mm512_set1_epi8(static_cast<char>(low_cut));
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i two = _mm512_set1_epi8(2);
+    for (size_t i = 0; i < n; i += 64) {
+        __mmask64 active = (n - i >= 64) ? ~__mmask64(0) : ((__mmask64(1) << (n - i)) - 1);
+        __m512i v = _mm512_maskz_loadu_epi8(active, ml + i);
+        __mmask64 is_high = _mm512_cmpge_epu8_mask(v, hi);
+        __mmask64 is_mid = _mm512_cmpgt_epu8_mask(v, lo);
+        __m512i r = _mm512_mask_mov_epi8(_mm512_maskz_mov_epi8(is_mid, one), is_high, two);
+        _mm512_mask_storeu_epi8(states + i, active, r);
+    }
+}
+
+#endif // MSA_ML_KERNEL_X86
+
+/**
+ * @brief 依CPU功能選擇核心 (全程序只選擇一次)
+ * @param name 用於存儲核心名稱
+ * @return 核心函數
+ */
+static ClassifyKernel selectKernel(const char** name) {
+#ifdef MSA_ML_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        *name = "avx512bw";
+        return classifyAvx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return classifyAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        *name = "sse2";
+        return classifySse2;
+    }
+#endif
+    *name = "scalar";
+    return classifyScalar;
+}
+
+/**
+ * @brief 選定的核心與名稱
+ */
+struct KernelChoice {
+    const char* name = "scalar";
+    ClassifyKernel kernel = classifyScalar;
+    
+    KernelChoice() {
+        kernel = selectKernel(&name);
+    }
+};
+
+/**
+ * @brief 獲取全程序共用的核心
+ */
+static const KernelChoice& kernelChoice() {
+    static const KernelChoice choice;
+    return choice;
+}
+
+/*
+* 建構函數
+* \param high_threshold 高甲基化閾值
+* \param low_threshold 低甲基化閾值
+*/
+MethylCallClassifier::MethylCallClassifier(float high_threshold, float low_threshold) {
+    // 以輸出時的換算與比較方式建立分類表
+    for (int v = 0; v < 256; ++v) {
+        float meth_call = msa::MethylationSiteTable::mlToMethCall(static_cast<uint8_t>(v));
+        msa::MethState state = msa::MethState::Low;
+        if (meth_call >= high_threshold) {
+            state = msa::MethState::High;
+        } else if (meth_call > low_threshold) {
+            state = msa::MethState::Mid;
+        }
+        lut_[v] = static_cast<uint8_t>(state);
+    }
+    
+    // 甲基化程度隨ML遞增，分類表通常可由兩個分界表示；無法表示時 (例如閾值超出0-1) 改用分類表
+    int high_cut = 256;
+    while (high_cut > 0 && lut_[high_cut - 1] == static_cast<uint8_t>(msa::MethState::High)) {
+        --high_cut;
+    }
+    int low_cut = -1;
+    while (low_cut < 255 && lut_[low_cut + 1] == static_cast<uint8_t>(msa::MethState::Low)) {
+        ++low_cut;
+    }
+    if (high_cut <= 255 && low_cut >= 0) {
+        high_cut_ = static_cast<uint8_t>(high_cut);
+        low_cut_ = static_cast<uint8_t>(low_cut);
+        use_kernel_ = true;
+        for (int v = 0; v < 256 && use_kernel_; ++v) {
+            uint8_t expected = v >= high_cut ? 2 : static_cast<uint8_t>(v > low_cut);
+            use_kernel_ = (lut_[v] == expected);
+        }
+    }
+    
+    LOG_DEBUG("MethylCallClassifier", "ML分類分界: high>=" + std::to_string(high_cut) + ", low<=" + std::to_string(low_cut) +
+              (use_kernel_ ? ", 核心: " + std::string(kernelName()) : std::string(", 使用分類表")));
+}
+
+/*
+* 批次分類ML值
+* \param ml ML值陣列
+* \param n 數量
+* \param states 輸出的甲基化狀態
+*/
+void MethylCallClassifier::classify(const uint8_t* ml, size_t n, uint8_t* states) const {
+    if (use_kernel_) {
+        kernelChoice().kernel(ml, n, states, high_cut_, low_cut_);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        states[i] = lut_[ml[i]];
+    }
+}
+
+/*
+* 目前CPU選用的向量核心名稱
+* \return 核心名稱
+*/
+const char* MethylCallClassifier::kernelName() {
+    return kernelChoice().name;
+}
+
+/*
+* 純量參考核心與目前CPU可執行的所有向量核心
+* \return 核心列表
+*/
+std::vector<MethylCallClassifier::NamedKernel> MethylCallClassifier::kernels() {
+    std::vector<NamedKernel> result{{"scalar", classifyScalar}};
+#ifdef MSA_ML_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        result.push_back({"sse2", classifySse2});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        result.push_back({"avx2", classifyAvx2});
+    }
+    if (__builtin_cpu_supports("avx512bw")) {
+        result.push_back({"avx512bw", classifyAvx512});
+    }
+#endif
+    return result;
+}
+
+} // namespace msa::core
@@ -7,238 +7,112 @@
 #include <cmath>
 #include <vector>
 #include <unordered_map>
+#include <climits>
 
+// 使用正確的命名空間
+using msa::utils::ScratchArena;
+using msa::utils::ArenaAllocator;
+using msa::utils::ArenaVector;
 
 namespace msa::core {
 
-// 輔助結構：記錄甲基化信息
-struct MethylationRecord {
-    int refPos;            // 1-based 參考座標
-    double prob;           // 甲基化機率（0~1）
-    int methyl_type;       // 甲基化類型: 1=高, 0=中, -1=低
-    char strand;           // 鏈方向: '+', '-'
-};
-
 /**
- * @brief 從read到reference的位置映射表
+ * @brief 將CIGAR轉為字串 (僅用於日誌)
  * @param aln BAM讀段
- * @return 讀段位置(0-based)到參考位置(1-based)的映射向量，-1表示不可映射
+ * @return CIGAR字串
  */
-static std::vector<int> buildReadToRefMap(const bam1_t *aln) {
-    int readLength = aln->core.l_qseq;
-    std::vector<int> readToRef(readLength, -1);
-    int refPos = aln->core.pos + 1; // 轉為1-based
-    uint32_t *cigar = bam_get_cigar(aln);
-    int nCigar = aln->core.n_cigar;
-    int readPos = 0; // 0-based讀段位置，從0開始
-    
-    // 記錄映射的起始位置，必要時處理非映射區域（如soft clip）
-    std::string cigar_str = "";
-    for (int i = 0; i < nCigar; i++) {
-        int op = bam_cigar_op(cigar[i]);
-        int len = bam_cigar_oplen(cigar[i]);
-        char op_char = "MIDNSHP=X"[op];
-        cigar_str += std::to_string(len) + op_char;
+static std::string cigarToString(const bam1_t *aln) {
+    std::string cigar_str;
+    const uint32_t *cigar = bam_get_cigar(aln);
+    for (uint32_t i = 0; i < aln->core.n_cigar; i++) {
+        cigar_str += std::to_string(bam_cigar_oplen(cigar[i])) + "MIDNSHP=X"[bam_cigar_op(cigar[i])];
     }
-    LOG_DEBUG("MethylHaploExtractor", "讀段 " + std::string(bam_get_qname(aln)) + 
-              " CIGAR: " + cigar_str + ", 讀段長度: " + std::to_string(readLength) + 
-              ", 起始參考位置: " + std::to_string(aln->core.pos));
-    
-    for (int i = 0; i < nCigar; i++) {
-        int op = bam_cigar_op(cigar[i]);
-        int len = bam_cigar_oplen(cigar[i]);
-        char op_char = "MIDNSHP=X"[op];
-        
-        LOG_TRACE("MethylHaploExtractor", "處理CIGAR操作 " + std::string(1, op_char) + 
-                 std::to_string(len) + " 讀段位置: " + std::to_string(readPos) + 
-                 " 參考位置: " + std::to_string(refPos));
-        
-        switch (op) {
-            case BAM_CMATCH:    // M - 序列匹配或不匹配
-            case BAM_CEQUAL:    // = - 序列匹配
-            case BAM_CDIFF:     // X - 序列不匹配
-                // 匹配區域，同時更新讀段和參考座標
-                for (int j = 0; j < len; j++) {
-                    if (readPos < readLength) {
-                        readToRef[readPos] = refPos;
-                    }
-                    readPos++;
-                    refPos++;
-                }
-                break;
-                
-            case BAM_CINS:      // I - 插入到參考
-                // 插入區域，只消耗讀段座標
-                readPos += len;
-                break;
-                
-            case BAM_CSOFT_CLIP: // S - 軟剪切（存在於SEQ中）
-                // 軟剪切區域，只消耗讀段座標，但這些位置沒有對應的參考座標
-                readPos += len;
-                break;
-                
-            case BAM_CDEL:      // D - 從參考中刪除
-            case BAM_CREF_SKIP: // N - 跳過參考（例如內含子）
-                // 刪除或跳過區域，只消耗參考座標
-                refPos += len;
-                break;
-                
-            case BAM_CHARD_CLIP: // H - 硬剪切（不存在於SEQ中）
-                // 硬剪切不影響座標計算，因為這些序列不存在於讀段SEQ中
-                break;
-                
-            case BAM_CPAD:       // P - 填充（無意義，通常不使用）
-                // 填充不影響座標計算
-                break;
-                
-            default:
-                // 其他情況忽略
-                break;
-        }
-    }
-    
-    // 對於調試目的，輸出部分映射情況
-    LOG_TRACE("MethylHaploExtractor", "讀段到參考的映射 (前10個位置):");
-    for (int i = 0; i < std::min(10, readLength); i++) {
-        LOG_TRACE("MethylHaploExtractor", "  讀段位置 " + std::to_string(i) + " -> 參考位置 " + std::to_string(readToRef[i]));
-    }
-    
-    return readToRef;
-}
-
-/**
- * @brief 計算甲基化類型
- * @param prob 甲基化機率
- * @param meth_high_threshold 高甲基化閾值
- * @param meth_low_threshold 低甲基化閾值
- * @return 甲基化類型: 1=高, 0=中, -1=低
- */
-static int calculateMethylType(double prob, float meth_high_threshold, float meth_low_threshold) {
-    if (prob >= meth_high_threshold)
-        return 1;
-    else if (prob <= meth_low_threshold)
-        return -1;
-    else
-        return 0;
+    return cigar_str;
 }
 
 /**
- * @brief 從BAM讀段中解析甲基化記錄
+ * @brief 從BAM讀段中解析參考區間內的甲基化記錄
  * @param aln BAM讀段
- * @param config 配置物件
- * @return 甲基化記錄列表
+ * @param classifier ML值分類器
+ * @param arena 暫存空間 (記錄配置於此，於下一次重置前有效)
+ * @param tagParser 可重複使用的MM/ML解析器
+ * @param ref_lo 參考區間起點 (1-based，含)
+ * @param ref_hi 參考區間終點 (1-based，含)
+ * @return 甲基化記錄列表 (依參考座標遞增)
  */
-static std::vector<MethylationRecord> parseMethylationRecords(const bam1_t *aln, const msa::Config& config) {
-    std::vector<MethylationRecord> records;
-    
-    // 獲取讀段ID以便日誌記錄
-    std::string read_id(bam_get_qname(aln));
-    LOG_DEBUG("MethylHaploExtractor", "開始解析讀段 " + read_id + " 的甲基化數據");
-    
-    // 檢查是否有MM和ML標籤
-    uint8_t* mm_tag = bam_aux_get(aln, "MM");
-    uint8_t* ml_tag = bam_aux_get(aln, "ML");
-    
-    // 如果MM或ML標籤不存在，則嘗試Mm和Ml標籤
-    if (!mm_tag || !ml_tag) {
-        LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 沒有MM/ML標籤，嘗試Mm/Ml標籤");
-        mm_tag = bam_aux_get(aln, "Mm");
-        ml_tag = bam_aux_get(aln, "Ml");
-    }
-    
-    // 檢查是否找到甲基化標籤
-    if (mm_tag) {
-        LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 找到MM標籤: " + 
-                 (mm_tag[0] == 'Z' ? std::string(bam_aux2Z(mm_tag)) : "非字符串類型"));
-    } else {
-        LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 沒有找到MM或Mm標籤");
-    }
-    
-    if (ml_tag) {
-        LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 找到ML標籤，類型: " + 
-                 std::string(1, ml_tag[0]) + ", " + std::string(1, ml_tag[1]));
-    } else {
-        LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 沒有找到ML或Ml標籤");
-    }
-    
-    // 分配甲基化狀態物件
-    hts_base_mod_state *modState = hts_base_mod_state_alloc();
-    if (!modState) {
-        LOG_ERROR("MethylHaploExtractor", "無法分配甲基化狀態物件");
+static ArenaVector<MethylationRecord> parseMethylationRecords(const bam1_t *aln, const MethylCallClassifier& classifier,
+                                                              ScratchArena& arena, MethylTagParser& tagParser,
+                                                              int ref_lo, int ref_hi) {
+    ArenaVector<MethylationRecord> records{ArenaAllocator<MethylationRecord>(arena)};
+    
+    // 讀段ID僅用於日誌記錄
+    const char* read_id = bam_get_qname(aln);
+    LOG_DEBUG("MethylHaploExtractor", "開始解析讀段 " + std::string(read_id) + " 的甲基化數據");
+    
+    // 以CIGAR將參考區間轉換為讀段區間，MM/ML只解碼此區間內的修飾
+    CigarCursor cigarCursor(aln);
+    CigarCursor endCursor(aln);
+    int64_t read_begin = cigarCursor.readOffsetForRefPos(ref_lo - 1);
+    int64_t read_end = endCursor.readOffsetForRefPos(ref_hi);
+    int readLength = aln->core.l_qseq;
+    LOG_DEBUG("MethylHaploExtractor", "讀段 " + std::string(read_id) + " CIGAR: " + cigarToString(aln) + 
+              ", 讀段長度: " + std::to_string(readLength) + ", 起始參考位置: " + std::to_string(aln->core.pos) + 
+              ", 解碼讀段區間: [" + std::to_string(read_begin) + ", " + std::to_string(read_end) + ")");
+    if (read_begin >= read_end) {
         return records;
     }
     
     // 解析讀段中的甲基化信息
-    int ret = bam_parse_basemod(aln, modState);
-    if (ret < 0) {
-        LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 無甲基化標記或解析失敗，返回代碼: " + std::to_string(ret));
-        hts_base_mod_state_free(modState);
+    if (!tagParser.parse(aln, read_begin, read_end)) {
+        LOG_DEBUG("MethylHaploExtractor", "讀段 " + std::string(read_id) + " 沒有可用的MM/ML (或Mm/Ml) 標籤或解析失敗");
         return records;
     }
-    
-    // 建立讀段到參考的映射
-    auto readToRef = buildReadToRefMap(aln);
-    int readLength = aln->core.l_qseq;
+    const auto& mods = tagParser.calls();
+    records.reserve(mods.size());
     
     // 獲取鏈方向
-    char strand = ((aln->core.flag & BAM_FREVERSE) == 0) ? '+' : '-';
-    
-    // 用於存儲甲基化修飾
-    hts_base_mod mods[10]; // 一次獲取最多10個修飾
-    int readPos0;
-    
-    // 逐個獲取甲基化修飾
-    // bam_next_basemod返回的readPos0是讀段上的0-based位置，表示甲基化修飾發生的位置
-    // 這個位置需要通過readToRef映射到參考基因組上的位置
-    int n = bam_next_basemod(aln, modState, mods, 10, &readPos0);
-    LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 第一批甲基化修飾數量: " + std::to_string(n));
-    
-    int total_mods = 0;
-    while (n > 0) {
-        total_mods += n;
-        for (int i = 0; i < n; i++) {
-            // 我們只處理'C'鹼基上的'm'或'h'修飾，即5mC或5hmC
-            if ((mods[i].modified_base == 'm' || mods[i].modified_base == 'h') && 
-                (mods[i].canonical_base == 'C' || mods[i].canonical_base == 'c')) {
-                
-                // 確認修飾在讀段範圍內
-                if (readPos0 >= 0 && readPos0 < readLength) {
-                    // 獲取對應的參考座標
-                    // readPos0是0-based讀段位置，我們從映射表中直接獲取對應的1-based參考位置
-                    int refPos = readToRef[readPos0];
-                    
-                    if (refPos > 0) { // 有效參考座標 (1-based)
-                        // 計算甲基化機率
-                        double prob = static_cast<double>(mods[i].qual) / 255.0;
-                        
-                        // 計算甲基化類型
-                        int methyl_type = calculateMethylType(prob, config.meth_high_threshold, config.meth_low_threshold);
-                        
-                        // 添加甲基化記錄
-                        records.push_back({refPos, prob, methyl_type, strand});
-                        
-                        LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 發現甲基化位點: readPos=" + std::to_string(readPos0) + 
-                                  ", refPos=" + std::to_string(refPos) + 
-                                  ", prob=" + std::to_string(prob) + 
-                                  ", type=" + std::to_string(methyl_type) + 
-                                  ", strand=" + strand +
-                                  ", base=" + std::string(1, mods[i].canonical_base) + 
-                                  ", mod=" + std::string(1, mods[i].modified_base));
-                    } else {
-                        LOG_TRACE("MethylHaploExtractor", "讀段 " + read_id + " 在讀段位置 " + std::to_string(readPos0) + 
-                                 " 的甲基化修飾無法映射到參考座標");
-                    }
-                }
-            }
+    msa::Strand strand = ((aln->core.flag & BAM_FREVERSE) == 0) ? msa::Strand::Plus : msa::Strand::Minus;
+    
+    // 修飾依讀段位置遞增，透過CIGAR游標 (已位於區間起點) 轉換為參考基因組上的位置
+    for (const auto& mod : mods) {
+        // 我們只處理'C'鹼基上的'm'或'h'修飾，即5mC或5hmC
+        if ((mod.modified_base != 'm' && mod.modified_base != 'h') || mod.canonical_base != 'C') {
+            continue;
+        }
+        
+        // 獲取對應的1-based參考座標 (位於插入或軟剪切時為-1)
+        int refPos = static_cast<int>(cigarCursor.refPosForReadPos(mod.read_pos));
+        if (refPos <= 0) {
+            LOG_TRACE("MethylHaploExtractor", "讀段 " + std::string(read_id) + " 在讀段位置 " + std::to_string(mod.read_pos) + 
+                     " 的甲基化修飾無法映射到參考座標");
+            continue;
         }
-        // 獲取下一批修飾
-        n = bam_next_basemod(aln, modState, mods, 10, &readPos0);
+        
+        // 添加甲基化記錄 (保留原始ML值，輸出時再換算；狀態於迴圈後批次分類)
+        records.push_back({refPos, mod.ml, msa::MethState::Low, strand});
+        
+        LOG_DEBUG("MethylHaploExtractor", "讀段 " + std::string(read_id) + " 發現甲基化位點: readPos=" + std::to_string(mod.read_pos) + 
+                  ", refPos=" + std::to_string(refPos) + 
+                  ", ml=" + std::to_string(mod.ml) + 
+                  ", strand=" + msa::MethylationSiteTable::strandChar(strand) +
+                  ", base=" + std::string(1, mod.canonical_base) + 
+                  ", mod=" + std::string(1, static_cast<char>(mod.modified_base)));
     }
     
-    // 釋放甲基化狀態物件
-    hts_base_mod_state_free(modState);
+    // ML值集中為連續陣列後以向量核心一次分類
+    if (!records.empty()) {
+        ArenaVector<uint8_t> states{ArenaAllocator<uint8_t>(arena)};
+        states.resize(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            states[i] = records[i].ml;
+        }
+        classifier.classify(states.data(), states.size(), states.data());
+        for (size_t i = 0; i < records.size(); ++i) {
+            records[i].state = static_cast<msa::MethState>(states[i]);
+        }
+    }
     
-    LOG_DEBUG("MethylHaploExtractor", "讀段 " + read_id + " 解析完成，總共 " + std::to_string(total_mods) + " 個甲基化修飾，提取出 " + std::to_string(records.size()) + " 個甲基化位點");
+    LOG_DEBUG("MethylHaploExtractor", "讀段 " + std::string(read_id) + " 解析完成，區間內共 " + std::to_string(mods.size()) + " 個修飾，提取出 " + std::to_string(records.size()) + " 個甲基化位點");
     return records;
 }
 
@@ -247,21 +121,28 @@ static std::vector<MethylationRecord> parseMethylationRecords(const bam1_t *aln,
 * \param config 配置
 */
 MethylHaploExtractor::MethylHaploExtractor(const msa::Config& config)
-    : config_(config) {
+    : config_(config),
+      classifier_(config.meth_high_threshold, config.meth_low_threshold),
+      readCache_(ReadParseCache::getInstance()) {
 }
 
+/*
+* 析構函數
+*/
+MethylHaploExtractor::~MethylHaploExtractor() = default;
+
 /*
 * 從讀段中提取甲基化記錄
 * \param read 讀段
 * \param target_variant 目標變異
 * \param bam_source_id BAM來源ID
 */
-std::vector<msa::MethylationSiteDetail> MethylHaploExtractor::extractFromRead(
+msa::MethylationSiteTable MethylHaploExtractor::extractFromRead(
     const bam1_t* read,
     const msa::VcfVariantInfo& target_variant,
     const std::string& bam_source_id
 ) {
-    std::vector<msa::MethylationSiteDetail> details;
+    msa::MethylationSiteTable details;
     
     // 檢查是否為有效讀段
     if (read->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP)) {
@@ -270,63 +151,252 @@ std::vector<msa::MethylationSiteDetail> MethylHaploExtractor::extractFromRead(
     }
     
     // 獲取讀段ID (QNAME)
-    std::string read_id(bam_get_qname(read));
-    
-    // 獲取單倍型標籤
-    std::string haplotype_tag = extractHaplotypeTag(read);
+    const char* read_id = bam_get_qname(read);
     
     // 確定對變異的支持 (ref/alt)
+    CigarCursor cigarCursor(read);
     std::string somatic_base;
-    std::string somatic_allele_type = determineAlleleType(read, target_variant, somatic_base);
+    std::string somatic_allele_type = determineAlleleType(read, cigarCursor, target_variant, somatic_base);
     
     // 如果無法確定等位基因類型，跳過
     if (somatic_allele_type == "unknown") {
-        LOG_TRACE("MethylHaploExtractor", "無法確定讀段等位基因類型，跳過: " + read_id);
+        LOG_TRACE("MethylHaploExtractor", "無法確定讀段等位基因類型，跳過: " + std::string(read_id));
         return details;
     }
     
-    // 獲取目標變異的0-based位置
-    int target_pos_0based = target_variant.pos - 1;
-    
-    // 從讀段中提取甲基化記錄
-    std::vector<MethylationRecord> methRecords = parseMethylationRecords(read, config_);
+    // 從讀段中提取甲基化記錄與單倍型標籤 (暫存資料配置於arena，每個讀段重置一次)
+    arena_.reset();
+    const MethylationRecord* methRecords = nullptr;
+    std::string haplotype_tag;
+    size_t n_records = loadMethylationRecords(read, bam_source_id,
+                                              target_variant.pos - config_.window_size,
+                                              target_variant.pos + config_.window_size,
+                                              methRecords, haplotype_tag);
     
     // 如果沒有甲基化記錄，跳過
-    if (methRecords.empty()) {
-        LOG_TRACE("MethylHaploExtractor", "讀段無甲基化記錄，跳過: " + read_id);
+    if (n_records == 0) {
+        LOG_TRACE("MethylHaploExtractor", "讀段無甲基化記錄，跳過: " + std::string(read_id));
         return details;
     }
     
     // 根據window_size篩選符合條件的甲基化記錄
-    for (const auto& rec : methRecords) {
-        int distance = std::abs(rec.refPos - target_variant.pos);
-        
-        // 只處理在window範圍內的甲基化位點
-        if (distance <= config_.window_size) {
-            // 創建甲基化位點詳情
-            msa::MethylationSiteDetail detail;
-            detail.chrom = target_variant.chrom;
-            detail.methyl_pos = rec.refPos;
-            detail.somatic_pos = target_variant.pos;
-            detail.variant_type = target_variant.variant_type;
-            detail.vcf_source_id = target_variant.vcf_source_id;
-            detail.bam_source_id = bam_source_id;
-            detail.somatic_allele_type = somatic_allele_type;
-            detail.somatic_base_at_variant = somatic_base;
-            detail.haplotype_tag = haplotype_tag;
-            detail.meth_call = static_cast<float>(rec.prob);
-            detail.strand = rec.strand;
-            detail.read_id = read_id;
-            
-            // 設定甲基化狀態
-            detail.meth_state = classifyMethylationState(detail.meth_call);
-            
-            // 將甲基化位點詳情添加到結果中
-            details.push_back(detail);
+    msa::MethylationSiteTable::SiteContext ctx = makeSiteContext(target_variant, bam_source_id, haplotype_tag,
+                                                                 somatic_allele_type, somatic_base);
+    appendWindowSites(methRecords, n_records, target_variant.pos, ctx, read_id, details);
+    
+    return details;
+}
+
+/*
+* 單次解析讀段，為讀段覆蓋的所有變異提取甲基化記錄
+* \param read 讀段
+* \param variants 排序後的變異列表
+* \param first_variant 區域內第一個變異的索引
+* \param active_variants 讀段覆蓋的變異 (區域內索引)
+* \param bam_source_id BAM來源ID
+* \param variant_results 每個變異的甲基化位點列表
+*/
+void MethylHaploExtractor::extractFromReadForVariants(
+    const bam1_t* read,
+    const std::vector<msa::VcfVariantInfo>& variants,
+    size_t first_variant,
+    const std::vector<uint32_t>& active_variants,
+    const std::string& bam_source_id,
+    std::vector<msa::MethylationSiteTable>& variant_results
+) {
+    if (active_variants.empty()) {
+        return;
+    }
+    
+    // 檢查是否為有效讀段
+    if (read->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP)) {
+        LOG_TRACE("MethylHaploExtractor", "跳過無效讀段: " + std::string(bam_get_qname(read)));
+        return;
+    }
+    
+    const char* read_id = bam_get_qname(read);
+    
+    // 讀段的所有暫存資料都配置於arena，處理下一個讀段前一次回收
+    arena_.reset();
+    
+    // 先確定讀段對每個活躍變異的支持 (ref/alt)，無任何可判定的變異時不需解析甲基化標籤。
+    // 活躍變異依位置遞增，共用一個CIGAR游標時整個讀段只走訪CIGAR一次
+    CigarCursor cigarCursor(read);
+    ArenaVector<std::string> allele_types(active_variants.size(), std::string(), ArenaAllocator<std::string>(arena_));
+    ArenaVector<std::string> somatic_bases(active_variants.size(), std::string(), ArenaAllocator<std::string>(arena_));
+    bool any_known = false;
+    int window_lo = 0;
+    int window_hi = 0;
+    for (size_t k = 0; k < active_variants.size(); ++k) {
+        const auto& variant = variants[first_variant + active_variants[k]];
+        allele_types[k] = determineAlleleType(read, cigarCursor, variant, somatic_bases[k]);
+        if (allele_types[k] != "unknown") {
+            // 可判定變異的窗口聯集 (變異依位置遞增，首個決定起點)
+            if (!any_known) {
+                window_lo = variant.pos - config_.window_size;
+            }
+            window_hi = variant.pos + config_.window_size;
+            any_known = true;
         }
     }
     
-    return details;
+    if (!any_known) {
+        LOG_TRACE("MethylHaploExtractor", "無法確定讀段等位基因類型，跳過: " + std::string(read_id));
+        return;
+    }
+    
+    // 讀段的MM/ML與CIGAR只解析一次，供所有活躍變異共用
+    const MethylationRecord* methRecords = nullptr;
+    std::string haplotype_tag;
+    size_t n_records = loadMethylationRecords(read, bam_source_id, window_lo, window_hi, methRecords, haplotype_tag);
+    if (n_records == 0) {
+        LOG_TRACE("MethylHaploExtractor", "讀段無甲基化記錄，跳過: " + std::string(read_id));
+        return;
+    }
+    
+    for (size_t k = 0; k < active_variants.size(); ++k) {
+        if (allele_types[k] == "unknown") {
+            continue;
+        }
+        size_t variant_index = first_variant + active_variants[k];
+        const auto& variant = variants[variant_index];
+        msa::MethylationSiteTable::SiteContext ctx = makeSiteContext(variant, bam_source_id, haplotype_tag,
+                                                                     allele_types[k], somatic_bases[k]);
+        appendWindowSites(methRecords, n_records, variant.pos, ctx, read_id, variant_results[variant_index]);
+    }
+}
+
+/*
+* 取得讀段的甲基化記錄與單倍型標籤
+* \param read 讀段
+* \param bam_source_id BAM來源ID
+* \param ref_lo 需要的參考區間起點 (1-based，含)
+* \param ref_hi 需要的參考區間終點 (1-based，含)
+* \param records 用於存儲記錄起點
+* \param haplotype_tag 用於存儲單倍型標籤
+* \return 記錄數
+*/
+size_t MethylHaploExtractor::loadMethylationRecords(
+    const bam1_t* read,
+    const std::string& bam_source_id,
+    int ref_lo,
+    int ref_hi,
+    const MethylationRecord*& records,
+    std::string& haplotype_tag
+) {
+    if (!readCache_.enabled()) {
+        // 未啟用快取：只解碼需要的區間
+        ArenaVector<MethylationRecord> parsed = parseMethylationRecords(read, classifier_, arena_, tagParser_, ref_lo, ref_hi);
+        records = parsed.data();
+        if (!parsed.empty()) {
+            haplotype_tag = extractHaplotypeTag(read);
+        }
+        return parsed.size();
+    }
+    
+    // 啟用快取：其他VCF或查詢區域需要的窗口不同，因此解碼整個比對範圍後存入快取
+    ReadCacheKey key = ReadParseCache::makeKey(read, bam_source_id);
+    cachedParse_ = readCache_.lookup(key);
+    if (!cachedParse_) {
+        auto parse = std::make_shared<CachedReadParse>();
+        ArenaVector<MethylationRecord> parsed = parseMethylationRecords(read, classifier_, arena_, tagParser_, 0, INT_MAX);
+        parse->records.assign(parsed.begin(), parsed.end());
+        parse->haplotype = extractHaplotypeTag(read);
+        readCache_.insert(key, parse);
+        cachedParse_ = std::move(parse);
+    }
+    
+    records = cachedParse_->records.data();
+    haplotype_tag = cachedParse_->haplotype;
+    return cachedParse_->records.size();
+}
+
+/*
+* 建立同一讀段在同一變異下所有位點共用的欄位
+* \param variant 變異
+* \param bam_source_id BAM來源ID
+* \param haplotype_tag 單倍型標籤
+* \param somatic_allele_type 等位基因類型 (ref/alt)
+* \param somatic_base 變異位置的鹼基
+* \return 共用欄位 (讀段名稱由 appendWindowSites 填入)
+*/
+msa::MethylationSiteTable::SiteContext MethylHaploExtractor::makeSiteContext(
+    const msa::VcfVariantInfo& variant,
+    const std::string& bam_source_id,
+    const std::string& haplotype_tag,
+    const std::string& somatic_allele_type,
+    const std::string& somatic_base
+) {
+    using Dictionary = msa::MethylationSiteTable::Dictionary;
+    
+    msa::MethylationSiteTable::SiteContext ctx;
+    ctx.chrom = internCached(Dictionary::Chrom, variant.chrom, chromCache_);
+    ctx.somatic_pos = variant.pos;
+    ctx.variant_type = static_cast<uint16_t>(internCached(Dictionary::VariantType, variant.variant_type, variantTypeCache_));
+    ctx.vcf_source = static_cast<uint16_t>(internCached(Dictionary::VcfSource, variant.vcf_source_id, vcfSourceCache_));
+    ctx.bam_source = static_cast<uint16_t>(internCached(Dictionary::BamSource, bam_source_id, bamSourceCache_));
+    ctx.haplotype = static_cast<uint16_t>(internCached(Dictionary::Haplotype, haplotype_tag, haplotypeCache_));
+    ctx.allele = (somatic_allele_type == "alt") ? msa::AlleleType::Alt : msa::AlleleType::Ref;
+    ctx.somatic_base = somatic_base.empty() ? 'N' : somatic_base[0];
+    return ctx;
+}
+
+/*
+* 以單項快取查詢字典ID
+* \param which 字典種類
+* \param value 字串
+* \param cache 快取
+* \return 字串ID
+*/
+uint32_t MethylHaploExtractor::internCached(
+    msa::MethylationSiteTable::Dictionary which,
+    const std::string& value,
+    InternCache& cache
+) {
+    // 相鄰讀段通常屬於同一染色體/來源/單倍型，命中時不需取得字典的鎖
+    if (!cache.valid || cache.value != value) {
+        cache.id = msa::MethylationSiteTable::dictionary(which).intern(value);
+        cache.value = value;
+        cache.valid = true;
+    }
+    return cache.id;
+}
+
+/*
+* 將位於變異窗口內的甲基化記錄附加到位點表格
+* \param records 甲基化記錄 (依參考座標遞增)
+* \param n_records 記錄數
+* \param somatic_pos 變異位置 (1-based)
+* \param ctx 共用欄位
+* \param read_id 讀段ID
+* \param sites 甲基化位點表格
+*/
+void MethylHaploExtractor::appendWindowSites(
+    const MethylationRecord* records,
+    size_t n_records,
+    int somatic_pos,
+    msa::MethylationSiteTable::SiteContext ctx,
+    const char* read_id,
+    msa::MethylationSiteTable& sites
+) {
+    // 記錄依讀段位置解析，參考座標單調遞增，因此窗口內的記錄為連續區段
+    const MethylationRecord* records_end = records + n_records;
+    auto lower = std::lower_bound(records, records_end, somatic_pos - config_.window_size,
+                                  [](const MethylationRecord& rec, int pos) { return rec.refPos < pos; });
+    auto upper = std::upper_bound(lower, records_end, somatic_pos + config_.window_size,
+                                  [](int pos, const MethylationRecord& rec) { return pos < rec.refPos; });
+    if (lower == upper) {
+        return;
+    }
+    
+    // 讀段名稱每個表格只存放一次，所有位點以引用共用
+    ctx.read = sites.addReadName(read_id);
+    
+    for (auto it = lower; it != upper; ++it) {
+        const auto& rec = *it;
+        
+        sites.append(ctx, rec.refPos, rec.ml, rec.state, rec.strand);
+    }
 }
 
 /*
@@ -395,11 +465,13 @@ std::string MethylHaploExtractor::extractHaplotypeTag(const bam1_t* read) {
 /*
 * 確定等位基因類型
 * \param read 讀段
+* \param cigar_cursor 讀段的CIGAR游標
 * \param target_variant 目標變異
 * \param somatic_base 變異鹼基
 */
 std::string MethylHaploExtractor::determineAlleleType(
     const bam1_t* read,
+    CigarCursor& cigar_cursor,
     const msa::VcfVariantInfo& target_variant,
     std::string& somatic_base
 ) {
@@ -407,7 +479,7 @@ std::string MethylHaploExtractor::determineAlleleType(
     int var_pos_0based = target_variant.pos - 1;
     
     // 將參考位置轉換為讀段位置
-    int read_pos = refPosToReadPos(read, var_pos_0based);
+    int read_pos = static_cast<int>(cigar_cursor.readPosForRefPos(var_pos_0based));
     
     // 無法映射到讀段上
     if (read_pos < 0) {
@@ -429,76 +501,6 @@ std::string MethylHaploExtractor::determineAlleleType(
     }
 }
 
-/*
-* 分類甲基化狀態
-* \param meth_call 甲基化機率
-* \return 甲基化狀態
-*/
-std::string MethylHaploExtractor::classifyMethylationState(float meth_call) {
-    if (meth_call >= config_.meth_high_threshold) {
-        return "high";
-    } else if (meth_call > config_.meth_low_threshold) {
-        return "mid";
-    } else {
-        return "low";
-    }
-}
-
-/*
-* 將參考位置轉換為讀段位置
-* \param read 讀段
-* \param ref_pos 參考位置
-* \return 讀段位置
-*/
-int MethylHaploExtractor::refPosToReadPos(const bam1_t* read, int ref_pos) {
-    // 讀段起始參考位置 (0-based)
-    int start_ref_pos = read->core.pos;
-    
-    // 如果變異位點在讀段開始位置之前，無法映射
-    if (ref_pos < start_ref_pos) {
-        return -1;
-    }
-    
-    // 獲取CIGAR
-    uint32_t* cigar = bam_get_cigar(read);
-    int n_cigar = read->core.n_cigar;
-    
-    int current_ref_pos = start_ref_pos;
-    int current_read_pos = 0;
-    
-    // 遍歷CIGAR操作
-    for (int i = 0; i < n_cigar; ++i) {
-        uint32_t op = bam_cigar_op(cigar[i]);
-        int len = bam_cigar_oplen(cigar[i]);
-        
-        if (op == BAM_CMATCH || op == BAM_CEQUAL || op == BAM_CDIFF) {
-            // 匹配區域，同時移動參考和讀段位置
-            if (ref_pos >= current_ref_pos && ref_pos < current_ref_pos + len) {
-                // 變異位點在當前匹配區域內
-                return current_read_pos + (ref_pos - current_ref_pos);
-            }
-            
-            current_ref_pos += len;
-            current_read_pos += len;
-        } else if (op == BAM_CINS || op == BAM_CSOFT_CLIP) {
-            // 插入或軟剪切，僅移動讀段位置
-            current_read_pos += len;
-        } else if (op == BAM_CDEL || op == BAM_CREF_SKIP) {
-            // 刪除或跳過，僅移動參考位置
-            if (ref_pos >= current_ref_pos && ref_pos < current_ref_pos + len) {
-                // 變異位點在刪除區域內，無法映射
-                return -1;
-            }
-            
-            current_ref_pos += len;
-        }
-        // 硬剪切和填充不影響座標計算
-    }
-    
-    // 無法映射（讀段可能不覆蓋變異位點）
-    return -1;
-}
-
 /*
 * 獲取讀段位置的鹼基
 * \param read 讀段
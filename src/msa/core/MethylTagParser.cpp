@@ -0,0 +1,283 @@
+#include "msa/core/MethylTagParser.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <iterator>
+
+namespace msa::core {
+
+// 單一修飾組可列出的修飾代碼上限 (例如 C+mh 為2個)
+static constexpr int kMaxModCodes = 16;
+
+/**
+ * @brief 標準鹼基轉為nt16編碼
+ * @param base 鹼基字元
+ * @return nt16編碼 (N為15表示任意鹼基，無效字元返回-1)
+ */
+static int baseToNt16(char base) {
+    switch (base) {
+        case 'A': return 1;
+        case 'C': return 2;
+        case 'G': return 4;
+        case 'T':
+        case 'U': return 8;
+        case 'N': return 15;
+        default:  return -1;
+    }
+}
+
+/**
+ * @brief nt16編碼的互補鹼基
+ * @param code nt16編碼
+ * @return 互補鹼基的nt16編碼 (N仍為N)
+ */
+static int complementNt16(int code) {
+    switch (code) {
+        case 1:  return 8;
+        case 2:  return 4;
+        case 4:  return 2;
+        case 8:  return 1;
+        default: return code;
+    }
+}
+
+/**
+ * @brief 解析非負整數並前進指標
+ * @param p 字串指標
+ * @param value 用於存儲解析結果
+ * @return 是否成功
+ */
+static bool parseCount(const char*& p, int64_t& value) {
+    if (!std::isdigit(static_cast<unsigned char>(*p))) {
+        return false;
+    }
+    int64_t v = 0;
+    while (std::isdigit(static_cast<unsigned char>(*p))) {
+        v = v * 10 + (*p - '0');
+        if (v > INT32_MAX) {
+            return false;
+        }
+        ++p;
+    }
+    value = v;
+    return true;
+}
+
+/*
+* 解析讀段的MM/ML標籤
+* \param read BAM讀段
+* \param read_begin 區間起點 (含)
+* \param read_end 區間終點 (不含)
+* \return 是否成功解析
+*/
+bool MethylTagParser::parse(const bam1_t* read, int64_t read_begin, int64_t read_end) {
+    calls_.clear();
+    
+    // 與htslib相同：優先使用MM/ML，不存在時使用舊版的Mm/Ml
+    uint8_t* mm_tag = bam_aux_get(read, "MM");
+    if (!mm_tag) {
+        mm_tag = bam_aux_get(read, "Mm");
+    }
+    if (!mm_tag || bam_aux_type(mm_tag) != 'Z') {
+        return false;
+    }
+    const char* p = bam_aux2Z(mm_tag);
+    
+    uint8_t* ml_tag = bam_aux_get(read, "ML");
+    if (!ml_tag) {
+        ml_tag = bam_aux_get(read, "Ml");
+    }
+    const uint8_t* ml = nullptr;
+    uint32_t ml_len = 0;
+    if (ml_tag && bam_aux_type(ml_tag) == 'B' && (ml_tag[1] == 'C' || ml_tag[1] == 'c')) {
+        ml_len = bam_auxB_len(ml_tag);
+        ml = ml_tag + 6;  // 'B'、子類型與4位元組長度之後為ML值
+    }
+    
+    // MN記錄MM/ML對應的序列長度，與目前序列不符 (例如經硬剪切) 時標籤不可用
+    const int64_t length = read->core.l_qseq;
+    uint8_t* mn_tag = bam_aux_get(read, "MN");
+    if (mn_tag && bam_aux2i(mn_tag) != length) {
+        return false;
+    }
+    
+    // 區間裁切至 [0, length]；裁切後為空時仍解析標籤格式，只是不輸出修飾 (起點超出讀段時不可走訪序列)
+    read_begin = std::min(std::max<int64_t>(read_begin, 0), length);
+    read_end = std::max(std::min<int64_t>(read_end, length), read_begin);
+    
+    // 走訪座標：MM以原始讀段方向計數，反向讀段從儲存序列的尾端往前走訪
+    const bool reverse = (read->core.flag & BAM_FREVERSE) != 0;
+    const uint8_t* seq = bam_get_seq(read);
+    const int64_t walk_begin = reverse ? length - read_end : read_begin;
+    const int64_t walk_end = reverse ? length - read_begin : read_end;
+    auto storedPos = [reverse, length](int64_t w) { return reverse ? length - 1 - w : w; };
+    auto matches = [&](int64_t w, int target) {
+        return target == 15 || bam_seqi(seq, storedPos(w)) == target;
+    };
+    
+    // 區間之前各鹼基的數量，同一鹼基的修飾組 (例如 C+h 與 C+m) 共用
+    int64_t prefix_counts[16];
+    std::fill(prefix_counts, prefix_counts + 16, -1);
+    
+    auto fail = [this]() {
+        calls_.clear();
+        return false;
+    };
+    
+    uint32_t ml_pos = 0;  // 目前修飾組第一個項目的ML索引
+    while (*p) {
+        // 修飾組標頭: <鹼基><+|-><修飾代碼>[.|?]
+        char base = static_cast<char>(std::toupper(static_cast<unsigned char>(*p++)));
+        int base_code = baseToNt16(base);
+        char strand = *p ? *p++ : '\0';
+        if (base_code < 0 || (strand != '+' && strand != '-')) {
+            return fail();
+        }
+        
+        int32_t codes[kMaxModCodes];
+        int n_codes = 0;
+        if (std::isdigit(static_cast<unsigned char>(*p))) {
+            int64_t chebi = 0;
+            parseCount(p, chebi);
+            codes[n_codes++] = -static_cast<int32_t>(chebi);
+        } else {
+            while (std::isalpha(static_cast<unsigned char>(*p))) {
+                if (n_codes == kMaxModCodes) {
+                    return fail();
+                }
+                codes[n_codes++] = *p++;
+            }
+        }
+        if (n_codes == 0) {
+            return fail();
+        }
+        if (*p == '.' || *p == '?') {
+            ++p;
+        }
+        
+        // 互補鏈修飾計數標準鹼基的互補鹼基；反向讀段在儲存序列中再取一次互補
+        int target = (strand == '-') ? complementNt16(base_code) : base_code;
+        if (reverse) {
+            target = complementNt16(target);
+        }
+        
+        group_.clear();
+        int64_t canonical_index = -1;  // 目前項目在走訪方向上的標準鹼基序號
+        int64_t prefix = -1;           // 區間之前的標準鹼基數 (首次需要時計算)
+        int64_t scan = walk_begin;     // 區間內的掃描位置
+        int64_t scan_count = 0;        // scan 之前的標準鹼基數
+        bool past_window = false;
+        
+        while (*p == ',') {
+            if (past_window) {
+                // 區間之後的項目不需解碼，只計算項目數以推進ML索引
+                uint32_t entries = 0;
+                while (*p && *p != ';') {
+                    if (*p == ',') {
+                        ++entries;
+                    }
+                    ++p;
+                }
+                ml_pos += entries * n_codes;
+                break;
+            }
+            
+            ++p;
+            int64_t delta = 0;
+            if (!parseCount(p, delta)) {
+                return fail();
+            }
+            canonical_index += delta + 1;
+            uint32_t entry_ml = ml_pos;
+            ml_pos += n_codes;
+            
+            if (prefix < 0) {
+                if (prefix_counts[target] < 0) {
+                    int64_t count = 0;
+                    if (target == 15) {
+                        count = walk_begin;
+                    } else {
+                        for (int64_t w = 0; w < walk_begin; ++w) {
+                            count += matches(w, target);
+                        }
+                    }
+                    prefix_counts[target] = count;
+                }
+                prefix = prefix_counts[target];
+                scan_count = prefix;
+            }
+            
+            // 區間之前的項目只累加間隔值
+            if (canonical_index < prefix) {
+                continue;
+            }
+            
+            // 在區間內找到第 canonical_index 個標準鹼基
+            while (scan < walk_end) {
+                if (matches(scan, target)) {
+                    if (scan_count == canonical_index) {
+                        break;
+                    }
+                    ++scan_count;
+                }
+                ++scan;
+            }
+            if (scan >= walk_end) {
+                past_window = true;
+                continue;
+            }
+            
+            // 沒有ML值的修飾不輸出 (htslib以-1表示，無法作為甲基化機率)
+            for (int c = 0; c < n_codes && entry_ml + c < ml_len; ++c) {
+                BaseModCall call;
+                call.read_pos = static_cast<int32_t>(storedPos(scan));
+                call.modified_base = codes[c];
+                call.canonical_base = base;
+                call.ml = ml[entry_ml + c];
+                call.opposite_strand = (strand == '-');
+                group_.push_back(call);
+            }
+            ++scan_count;
+            ++scan;
+        }
+        
+        if (*p == ';') {
+            ++p;
+        } else if (*p) {
+            return fail();
+        }
+        
+        // 反向讀段的修飾依儲存位置遞減產生，先反轉為遞增，再恢復同一位置內的修飾代碼順序
+        if (reverse) {
+            std::reverse(group_.begin(), group_.end());
+            if (n_codes > 1) {
+                for (auto run = group_.begin(); run != group_.end();) {
+                    auto run_end = std::find_if(run, group_.end(), [run](const BaseModCall& call) {
+                        return call.read_pos != run->read_pos;
+                    });
+                    std::reverse(run, run_end);
+                    run = run_end;
+                }
+            }
+        }
+        
+        // 與先前的修飾組合併，同一位置時先前的組在前 (與MM中的順序一致)
+        if (calls_.empty()) {
+            calls_.swap(group_);
+        } else if (!group_.empty()) {
+            merged_.clear();
+            std::merge(calls_.begin(), calls_.end(), group_.begin(), group_.end(), std::back_inserter(merged_),
+                       [](const BaseModCall& a, const BaseModCall& b) { return a.read_pos < b.read_pos; });
+            calls_.swap(merged_);
+        }
+    }
+    
+    // ML值少於MM項目數時標籤不完整，與htslib相同視為格式錯誤
+    if (ml && ml_pos > ml_len) {
+        return fail();
+    }
+    
+    return true;
+}
+
+} // namespace msa::core
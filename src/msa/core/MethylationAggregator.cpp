@@ -0,0 +1,500 @@
+#include "msa/core/MethylationAggregator.h"
+#include "msa/utils/FlatHashTable.h"
+#include "msa/utils/RadixSort.h"
+#include "msa/utils/TaskScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <string_view>
+
+// 使用正確的命名空間
+using namespace msa::utils;
+
+namespace msa::core {
+
+// 甲基化程度的定點小數位數：ML換算的float皆為 2^-31 的整數倍 (最小非零值 1/255 > 2^-8，尾數23位元)，
+// 以此定點累加為精確整數運算，與累加順序無關
+static constexpr int kMethFractionBits = 31;
+
+/**
+ * @brief 每個ML值對應的甲基化程度定點值
+ */
+struct MethUnitTable {
+    uint64_t units[256];
+    
+    MethUnitTable() {
+        for (int ml = 0; ml < 256; ++ml) {
+            units[ml] = static_cast<uint64_t>(std::ldexp(static_cast<double>(
+                msa::MethylationSiteTable::mlToMethCall(static_cast<uint8_t>(ml))), kMethFractionBits));
+        }
+    }
+};
+
+static const MethUnitTable kMethUnits;
+
+// 部分狀態的分區數 (以分組鍵雜湊的高位元選擇)，合併與生成摘要時各分區並行處理
+static constexpr int kPartitionBits = 6;
+static constexpr size_t kPartitions = size_t(1) << kPartitionBits;
+
+/**
+ * @brief 128位元打包的分組鍵 (染色體, 變異位置, 變異類型, VCF來源, BAM來源, 等位基因類型, 單倍型)
+ *
+ * hi: 染色體ID (32位元) | 變異位置 (31位元，1-based 不為負) | 等位基因類型 (1位元)
+ * lo: 變異類型ID | VCF來源ID | BAM來源ID | 單倍型ID (各16位元)
+ */
+struct GroupKey {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    
+    bool operator==(const GroupKey& other) const { return hi == other.hi && lo == other.lo; }
+    bool operator!=(const GroupKey& other) const { return !(*this == other); }
+    
+    uint32_t chrom() const { return static_cast<uint32_t>(hi >> 32); }
+    int32_t somaticPos() const { return static_cast<int32_t>((hi >> 1) & 0x7fffffffULL); }
+    msa::AlleleType allele() const { return static_cast<msa::AlleleType>(hi & 0x1); }
+    uint16_t variantType() const { return static_cast<uint16_t>(lo >> 48); }
+    uint16_t vcfSource() const { return static_cast<uint16_t>(lo >> 32); }
+    uint16_t bamSource() const { return static_cast<uint16_t>(lo >> 16); }
+    uint16_t haplotype() const { return static_cast<uint16_t>(lo); }
+};
+
+/**
+ * @brief 打包第 i 列的分組鍵
+ * \param batch 甲基化位點區塊
+ * \param i 列索引
+ * \return 分組鍵
+ */
+static GroupKey packGroupKey(const msa::MethylationSiteTable& batch, size_t i) {
+    GroupKey key;
+    key.hi = (static_cast<uint64_t>(batch.chromId(i)) << 32) |
+             (static_cast<uint64_t>(static_cast<uint32_t>(batch.somaticPos(i)) & 0x7fffffffU) << 1) |
+             static_cast<uint64_t>(batch.alleleType(i));
+    key.lo = (static_cast<uint64_t>(batch.variantTypeId(i)) << 48) |
+             (static_cast<uint64_t>(batch.vcfSourceId(i)) << 32) |
+             (static_cast<uint64_t>(batch.bamSourceId(i)) << 16) |
+             static_cast<uint64_t>(batch.haplotypeId(i));
+    return key;
+}
+
+/**
+ * @brief 分組鍵的雜湊 (高位元選擇分區，低位元用於表內定址)
+ */
+struct GroupKeyHash {
+    uint64_t operator()(const GroupKey& key) const {
+        return msa::utils::mixHash64(key.hi ^ msa::utils::mixHash64(key.lo));
+    }
+};
+
+/**
+ * @brief 每組的累計值
+ */
+struct GroupState {
+    uint64_t sites = 0;                   // 甲基化位點數量
+    uint64_t meth_units = 0;              // 甲基化程度定點總和
+    uint64_t methylated = 0;              // 高/中甲基化位點數
+    uint64_t plus_count = 0;              // 正鏈位點數
+    uint64_t minus_count = 0;             // 反鏈位點數
+    msa::utils::FlatHashSet64 reads;      // 唯一讀段名稱的64位元雜湊 (組內碰撞機率可忽略)
+    
+    /**
+     * @brief 合併另一個部分狀態的同組累計值
+     * \param other 同組累計值
+     */
+    void merge(GroupState&& other) {
+        sites += other.sites;
+        meth_units += other.meth_units;
+        methylated += other.methylated;
+        plus_count += other.plus_count;
+        minus_count += other.minus_count;
+        if (reads.size() < other.reads.size()) {
+            reads.swap(other.reads);
+        }
+        reads.merge(other.reads);
+    }
+};
+
+using GroupTable = msa::utils::FlatHashMap<GroupKey, GroupState, GroupKeyHash>;
+
+/**
+ * @brief 執行緒私有的部分狀態
+ */
+struct MethylationAggregator::Partial {
+    std::vector<GroupTable> groups = std::vector<GroupTable>(kPartitions);  // Level 2 分組 (依鍵雜湊分區)
+    GlobalTally global;                                                     // 全域指標
+    uint64_t kept_sites = 0;                                                // 篩選後保留的位點數
+};
+
+/*
+* 構造函數
+* \param config 配置
+*/
+MethylationAggregator::MethylationAggregator(const msa::Config& config)
+    : min_strand_reads_(config.min_strand_reads),
+      partials_(static_cast<size_t>(std::max(1, TaskScheduler::getInstance().size()))) {
+}
+
+MethylationAggregator::~MethylationAggregator() = default;
+
+/*
+* 取得目前工作執行緒的部分狀態
+* \return 部分狀態
+*/
+MethylationAggregator::Partial& MethylationAggregator::partial() {
+    // 每個槽位只由對應的工作執行緒存取；非工作執行緒 (排程器未初始化時) 使用0號槽位
+    auto& slot = partials_[static_cast<size_t>(std::max(0, TaskScheduler::workerIndex()))];
+    if (!slot) {
+        slot = std::make_unique<Partial>();
+    }
+    return *slot;
+}
+
+// 雙股覆蓋篩選的並行處理粒度 (列數)
+static constexpr size_t kCoverageGrain = 1 << 16;
+
+/*
+* 累計區塊內所有列的正反鏈讀段數
+* \param batch 甲基化位點區塊
+*/
+void MethylationAggregator::StrandCoverage::add(const msa::MethylationSiteTable& batch) {
+    const size_t n = batch.size();
+    if (n == 0) {
+        return;
+    }
+    
+    // 區塊每列一個項目 (連同基數排序的暫存區) 只在合併為唯一位點前存在
+    const size_t scratch = 2 * n * sizeof(Site);
+    reservation_.add(scratch);
+    std::vector<Site> block(n);
+    forEachRange(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Site& site = block[i];
+            site.locus = (static_cast<uint64_t>(batch.chromId(i)) << 32) | static_cast<uint32_t>(batch.methylPos(i));
+            site.bam = batch.bamSourceId(i);
+            site.plus = batch.strand(i) == msa::Strand::Plus ? 1 : 0;
+            site.minus = batch.strand(i) == msa::Strand::Minus ? 1 : 0;
+        }
+    });
+    sortAndCombine(block);
+    sites_.insert(sites_.end(), block.begin(), block.end());
+    block.clear();
+    block.shrink_to_fit();
+    reservation_.release(scratch);
+    
+    // 附加的部分與已合併部分同樣多時才重新合併，每個項目攤銷只經過常數次排序
+    if (sites_.size() - merged_ >= std::max(merged_, kCoverageGrain)) {
+        merge();
+    }
+    charge();
+}
+
+/*
+* 合併所有計數並只保留正反鏈都達到門檻的位點
+* \param min_strand_reads 每條鏈要求的最小讀段數
+*/
+void MethylationAggregator::StrandCoverage::build(int min_strand_reads) {
+    merge();
+    const uint32_t min_reads = static_cast<uint32_t>(std::max(0, min_strand_reads));
+    sites_.erase(std::remove_if(sites_.begin(), sites_.end(), [min_reads](const Site& site) {
+        return site.plus < min_reads || site.minus < min_reads;
+    }), sites_.end());
+    sites_.shrink_to_fit();
+    merged_ = sites_.size();
+    charge();
+}
+
+/*
+* 生成區塊各列的保留旗標
+* \param batch 甲基化位點區塊
+* \param flags 輸出旗標
+*/
+void MethylationAggregator::StrandCoverage::keepFlags(const msa::MethylationSiteTable& batch, std::vector<uint8_t>& flags) const {
+    flags.assign(batch.size(), 0);
+    auto less = [](const Site& a, const Site& b) {
+        return a.locus != b.locus ? a.locus < b.locus : a.bam < b.bam;
+    };
+    forEachRange(batch.size(), [&](size_t begin, size_t end) {
+        Site key;
+        for (size_t i = begin; i < end; ++i) {
+            key.locus = (static_cast<uint64_t>(batch.chromId(i)) << 32) | static_cast<uint32_t>(batch.methylPos(i));
+            key.bam = batch.bamSourceId(i);
+            flags[i] = std::binary_search(sites_.begin(), sites_.end(), key, less) ? 1 : 0;
+        }
+    });
+}
+
+/*
+* 依位點排序並合併相同位點的計數
+* \param sites 位點計數
+*/
+void MethylationAggregator::StrandCoverage::sortAndCombine(std::vector<Site>& sites) const {
+    // 依 (染色體ID, 甲基化位置, BAM來源ID) 排序：字組0為BAM來源ID (2位元組)，字組1為位點 (8位元組)
+    parallelRadixSort(sites, {2, 8}, [](const Site& site, size_t word) -> uint64_t {
+        return word == 0 ? site.bam : site.locus;
+    }, parallel_);
+    
+    // 相同位點的項目相鄰，線性掃描合併為一項
+    size_t out = 0;
+    for (size_t i = 0; i < sites.size(); ++i) {
+        if (out > 0 && sites[out - 1].locus == sites[i].locus && sites[out - 1].bam == sites[i].bam) {
+            sites[out - 1].plus += sites[i].plus;
+            sites[out - 1].minus += sites[i].minus;
+        } else {
+            sites[out++] = sites[i];
+        }
+    }
+    sites.resize(out);
+}
+
+/*
+* 重新排序合併附加的計數
+*/
+void MethylationAggregator::StrandCoverage::merge() {
+    if (merged_ == sites_.size()) {
+        return;
+    }
+    const size_t scratch = sites_.size() * sizeof(Site);
+    reservation_.add(scratch);
+    sortAndCombine(sites_);
+    reservation_.release(scratch);
+    merged_ = sites_.size();
+}
+
+/*
+* 將 [0, n) 分段處理：並行時提交到排程器並等待，否則在呼叫執行緒上依序處理
+* \param n 元素數
+* \param body 處理 [begin, end) 的函數
+*/
+void MethylationAggregator::StrandCoverage::forEachRange(size_t n, const std::function<void(size_t, size_t)>& body) const {
+    if (parallel_) {
+        TaskScheduler::getInstance().parallelFor(n, kCoverageGrain, body);
+    } else {
+        for (size_t begin = 0; begin < n; begin += kCoverageGrain) {
+            body(begin, std::min(n, begin + kCoverageGrain));
+        }
+    }
+}
+
+/*
+* 釋放所有位點並退回登記的用量
+*/
+void MethylationAggregator::StrandCoverage::clear() {
+    sites_.clear();
+    sites_.shrink_to_fit();
+    merged_ = 0;
+    reservation_.reset();
+}
+
+/*
+* 累計區塊內的位點
+* \param batch 甲基化位點區塊
+* \param keep 各列的雙股覆蓋保留旗標 (nullptr: 不篩選)
+* \param begin 第一列
+* \param end 最後一列之後
+*/
+void MethylationAggregator::consume(
+    const msa::MethylationSiteTable& batch,
+    const uint8_t* keep,
+    size_t begin,
+    size_t end) {
+    
+    Partial& state = partial();
+    
+    // 同一讀段在同一變異下的位點相鄰：只在讀段改變時重新計算名稱雜湊，
+    // 分組鍵與上一列相同時沿用上一列的組 (只有插入新鍵會使組的位址失效，而插入前必定先比對到不同的鍵)
+    std::hash<std::string_view> hasher;
+    msa::MethylationSiteTable::ReadHandle last_read = 0;
+    uint64_t read_hash = 0;
+    bool has_read_hash = false;
+    GroupKey last_key;
+    GroupState* group = nullptr;
+    bool read_counted = false;
+    
+    GlobalTally& global = state.global;
+    std::tuple<uint16_t, uint32_t, int32_t, uint16_t> last_variant;
+    bool has_variant = false;
+    for (size_t i = begin; i < end; ++i) {
+        // 全域指標涵蓋所有位點
+        std::tuple<uint16_t, uint32_t, int32_t, uint16_t> variant(batch.vcfSourceId(i), batch.chromId(i), batch.somaticPos(i), batch.variantTypeId(i));
+        if (!has_variant || variant != last_variant) {
+            global.variant_keys.insert(variant);
+            last_variant = variant;
+            has_variant = true;
+        }
+        global.sites_by_vcf[batch.vcfSourceId(i)]++;
+        auto& bam = global.meth_by_bam[batch.bamSourceId(i)];
+        msa::MethState meth_state = batch.methState(i);
+        if (meth_state == msa::MethState::High || meth_state == msa::MethState::Mid) {
+            bam[0]++;
+            bam[1] += kMethUnits.units[batch.ml(i)];
+        }
+        bam[2]++;
+        
+        // 正反鏈都達到覆蓋門檻的位點才納入Level 2
+        if (keep && !keep[i]) {
+            continue;
+        }
+        state.kept_sites++;
+        
+        GroupKey key = packGroupKey(batch, i);
+        if (!group || key != last_key) {
+            uint64_t hash = GroupKeyHash()(key);
+            group = &state.groups[hash >> (64 - kPartitionBits)].findOrInsert(key, hash);
+            last_key = key;
+            read_counted = false;
+        }
+        group->sites++;
+        group->meth_units += kMethUnits.units[batch.ml(i)];
+        if (meth_state == msa::MethState::High || meth_state == msa::MethState::Mid) {
+            group->methylated++;
+        }
+        msa::Strand strand = batch.strand(i);
+        if (strand == msa::Strand::Plus) group->plus_count++;
+        else if (strand == msa::Strand::Minus) group->minus_count++;
+        
+        // 追蹤每個組中唯一的讀段
+        if (!has_read_hash || batch.readHandle(i) != last_read) {
+            last_read = batch.readHandle(i);
+            read_hash = hasher(std::string_view(batch.readName(i)));
+            has_read_hash = true;
+            read_counted = false;
+        }
+        if (!read_counted) {
+            group->reads.insert(read_hash);
+            read_counted = true;
+        }
+    }
+}
+
+/*
+* 甲基化程度的定點總和換算為總和
+* \param units 定點總和
+* \return 甲基化程度總和
+*/
+double MethylationAggregator::unitsToMeth(uint64_t units) {
+    return std::ldexp(static_cast<double>(units), -kMethFractionBits);
+}
+
+/*
+* 合併各執行緒的部分狀態並生成結果
+* \return 聚合結果
+*/
+MethylationAggregator::Result MethylationAggregator::finalize() {
+    using Dictionary = msa::MethylationSiteTable::Dictionary;
+    
+    std::vector<Partial*> parts;
+    for (auto& slot : partials_) {
+        if (slot) {
+            parts.push_back(slot.get());
+        }
+    }
+    
+    // 合併全域指標 (皆為整數累計，與合併順序無關)
+    Result result;
+    GlobalTally& global = result.global;
+    for (Partial* part : parts) {
+        for (const auto& [vcf, count] : part->global.sites_by_vcf) {
+            global.sites_by_vcf[vcf] += count;
+        }
+        global.variant_keys.merge(part->global.variant_keys);
+        for (const auto& [bam, stats] : part->global.meth_by_bam) {
+            auto& total = global.meth_by_bam[bam];
+            for (size_t s = 0; s < total.size(); ++s) {
+                total[s] += stats[s];
+            }
+        }
+        result.kept_sites += part->kept_sites;
+    }
+    
+    // 字典快照，轉換時不需逐項取得鎖
+    std::vector<std::string> chroms = msa::MethylationSiteTable::dictionary(Dictionary::Chrom).snapshot();
+    std::vector<std::string> variant_types = msa::MethylationSiteTable::dictionary(Dictionary::VariantType).snapshot();
+    std::vector<std::string> vcf_sources = msa::MethylationSiteTable::dictionary(Dictionary::VcfSource).snapshot();
+    std::vector<std::string> bam_sources = msa::MethylationSiteTable::dictionary(Dictionary::BamSource).snapshot();
+    std::vector<std::string> haplotypes = msa::MethylationSiteTable::dictionary(Dictionary::Haplotype).snapshot();
+    
+    // 同一分組鍵在每個部分狀態中落在同一分區，各分區獨立合併並生成Level 2摘要，
+    // 連同文字分組鍵 (chrom:pos:variant_type:vcf_source_id:bam_source_id:somatic_allele_type:haplotype_tag)
+    using KeyedSummary = std::pair<std::string, msa::SomaticVariantMethylationSummary>;
+    std::vector<std::vector<KeyedSummary>> keyed_partitions(kPartitions);
+    TaskScheduler::getInstance().parallelFor(kPartitions, 1, [&](size_t first, size_t last) {
+        for (size_t p = first; p < last; ++p) {
+            GroupTable merged;
+            for (Partial* part : parts) {
+                part->groups[p].forEach([&merged](const GroupKey& key, GroupState& group) {
+                    merged[key].merge(std::move(group));
+                });
+                part->groups[p].clear();
+            }
+            
+            std::vector<KeyedSummary>& keyed_summaries = keyed_partitions[p];
+            keyed_summaries.reserve(merged.size());
+            merged.forEach([&](const GroupKey& key, GroupState& group) {
+                // 創建摘要
+                msa::SomaticVariantMethylationSummary summary;
+                summary.chrom = chroms[key.chrom()];
+                summary.somatic_pos = key.somaticPos();
+                summary.variant_type = variant_types[key.variantType()];
+                summary.vcf_source_id = vcf_sources[key.vcfSource()];
+                summary.bam_source_id = bam_sources[key.bamSource()];
+                summary.somatic_allele_type = msa::MethylationSiteTable::alleleTypeName(key.allele());
+                summary.haplotype_tag = haplotypes[key.haplotype()];
+                
+                // 計算支持該摘要的讀段數量
+                summary.supporting_read_count = static_cast<int>(group.reads.size());
+                
+                // 計算甲基化位點數量
+                summary.methyl_sites_count = static_cast<int>(group.sites);
+                summary.methylated_sites_count = static_cast<int>(group.methylated);
+                
+                // 計算平均甲基化水平
+                summary.mean_methylation = static_cast<float>(unitsToMeth(group.meth_units) / static_cast<double>(group.sites));
+                
+                // 確定主要鏈方向
+                if (group.plus_count > group.minus_count && group.plus_count > 0) {
+                    summary.strand = '+';
+                } else if (group.minus_count > group.plus_count && group.minus_count > 0) {
+                    summary.strand = '-';
+                } else {
+                    summary.strand = '.';  // 混合或未知
+                }
+                
+                std::string text_key;
+                text_key.reserve(summary.chrom.size() + summary.variant_type.size() + summary.vcf_source_id.size() +
+                                 summary.bam_source_id.size() + summary.somatic_allele_type.size() +
+                                 summary.haplotype_tag.size() + 16);
+                text_key.append(summary.chrom).append(":").append(std::to_string(summary.somatic_pos)).append(":")
+                        .append(summary.variant_type).append(":").append(summary.vcf_source_id).append(":")
+                        .append(summary.bam_source_id).append(":").append(summary.somatic_allele_type).append(":")
+                        .append(summary.haplotype_tag);
+                keyed_summaries.emplace_back(std::move(text_key), std::move(summary));
+            });
+        }
+    });
+    for (auto& slot : partials_) {
+        slot.reset();
+    }
+    
+    std::vector<KeyedSummary> keyed_summaries;
+    size_t total_groups = 0;
+    for (const auto& partition : keyed_partitions) {
+        total_groups += partition.size();
+    }
+    keyed_summaries.reserve(total_groups);
+    for (auto& partition : keyed_partitions) {
+        std::move(partition.begin(), partition.end(), std::back_inserter(keyed_summaries));
+        std::vector<KeyedSummary>().swap(partition);
+    }
+    
+    // 依文字分組鍵排序，輸出順序與以字串為鍵分組時一致 (分組鍵互不相同，順序與分區方式無關)
+    std::sort(keyed_summaries.begin(), keyed_summaries.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    
+    result.level2_summary.reserve(keyed_summaries.size());
+    for (auto& [text_key, summary] : keyed_summaries) {
+        result.level2_summary.push_back(std::move(summary));
+    }
+    return result;
+}
+
+} // namespace msa::core
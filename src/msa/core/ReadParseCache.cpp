@@ -0,0 +1,165 @@
+#include "msa/core/ReadParseCache.h"
+#include "msa/utils/MemoryGovernor.h"
+#include <functional>
+#include <sstream>
+#include <string_view>
+
+namespace msa::core {
+
+/*
+* 獲取ReadParseCache單例實例
+* \return ReadParseCache單例引用
+*/
+ReadParseCache& ReadParseCache::getInstance() {
+    static ReadParseCache instance;
+    return instance;
+}
+
+/*
+* 設定快取容量並清除現有內容
+* \param capacityBytes 容量 (位元組)
+*/
+void ReadParseCache::configure(size_t capacityBytes) {
+    long long released = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.map.clear();
+        shard.lru.clear();
+        released += static_cast<long long>(shard.bytes);
+        shard.bytes = 0;
+    }
+    msa::utils::MemoryGovernor::getInstance().charge(msa::utils::MemoryGovernor::Subsystem::ReadCache, -released);
+    capacity_ = capacityBytes;
+    shard_capacity_ = capacityBytes / kShards;
+}
+
+/*
+* 建立讀段的快取鍵
+* \param read BAM讀段
+* \param bamSource BAM來源ID
+* \return 快取鍵
+*/
+ReadCacheKey ReadParseCache::makeKey(const bam1_t* read, const std::string& bamSource) {
+    ReadCacheKey key;
+    key.name.reserve(bamSource.size() + 1 + read->core.l_qname);
+    key.name.append(bamSource);
+    key.name.push_back('\0');
+    key.name.append(bam_get_qname(read));
+    key.tid = read->core.tid;
+    key.pos = read->core.pos;
+    key.flag = read->core.flag;
+    key.l_qseq = read->core.l_qseq;
+    
+    // 名稱雜湊與數值欄位混合 (splitmix64終結步驟)
+    uint64_t h = std::hash<std::string_view>()(std::string_view(key.name));
+    for (uint64_t v : {static_cast<uint64_t>(static_cast<uint32_t>(key.tid)), static_cast<uint64_t>(key.pos),
+                       static_cast<uint64_t>(key.flag) << 32 | static_cast<uint32_t>(key.l_qseq)}) {
+        h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    key.hash = h;
+    return key;
+}
+
+/*
+* 查詢快取
+* \param key 快取鍵
+* \return 解析結果，未命中時返回nullptr
+*/
+std::shared_ptr<const CachedReadParse> ReadParseCache::lookup(const ReadCacheKey& key) {
+    Shard& shard = shardFor(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return it->second->parse;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+/*
+* 加入解析結果
+* \param key 快取鍵
+* \param parse 解析結果
+*/
+void ReadParseCache::insert(const ReadCacheKey& key, std::shared_ptr<const CachedReadParse> parse) {
+    size_t bytes = entryBytes(key, *parse);
+    if (bytes > shard_capacity_) {
+        return;
+    }
+    
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    
+    // 其他執行緒可能已加入同一讀段 (例如兩個VCF同時處理相同區域)，保留先加入的結果
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    
+    long long delta = static_cast<long long>(bytes);
+    while (!shard.lru.empty() && shard.bytes + bytes > shard_capacity_) {
+        Entry& victim = shard.lru.back();
+        shard.bytes -= victim.bytes;
+        delta -= static_cast<long long>(victim.bytes);
+        shard.map.erase(victim.key);
+        shard.lru.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    shard.lru.push_front(Entry{key, std::move(parse), bytes});
+    shard.map.emplace(key, shard.lru.begin());
+    shard.bytes += bytes;
+    insertions_.fetch_add(1, std::memory_order_relaxed);
+    msa::utils::MemoryGovernor::getInstance().charge(msa::utils::MemoryGovernor::Subsystem::ReadCache, delta);
+}
+
+/*
+* 估算項目佔用的位元組數
+* \param key 快取鍵
+* \param parse 解析結果
+* \return 位元組數
+*/
+size_t ReadParseCache::entryBytes(const ReadCacheKey& key, const CachedReadParse& parse) {
+    // 鍵存放兩份 (串列項目與雜湊表)，另計串列節點、雜湊表節點與 shared_ptr 控制區塊
+    return 2 * (sizeof(ReadCacheKey) + key.name.capacity()) +
+           sizeof(Entry) + sizeof(CachedReadParse) + 4 * sizeof(void*) + 32 +
+           parse.records.capacity() * sizeof(MethylationRecord) + parse.haplotype.capacity();
+}
+
+/*
+* 獲取快取統計資訊
+* \return 統計信息字串
+*/
+std::string ReadParseCache::getStats() const {
+    size_t entries = 0, bytes = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        entries += shard.lru.size();
+        bytes += shard.bytes;
+    }
+    
+    uint64_t hits = hits_.load(std::memory_order_relaxed);
+    uint64_t misses = misses_.load(std::memory_order_relaxed);
+    std::ostringstream ss;
+    ss << "ReadParseCache狀態: 容量=" << capacity_ / (1024 * 1024) << "MB"
+       << ", 命中=" << hits
+       << ", 未命中=" << misses
+       << ", 命中率=" << (hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0) << "%"
+       << ", 加入=" << insertions_.load(std::memory_order_relaxed)
+       << ", 淘汰=" << evictions_.load(std::memory_order_relaxed)
+       << ", 項目=" << entries
+       << ", 用量=" << bytes / (1024 * 1024) << "MB";
+    return ss.str();
+}
+
+} // namespace msa::core
@@ -5,6 +5,7 @@
 #include <iomanip>
 #include <filesystem>
 #include <algorithm>
+#include <cmath>
 #include <zlib.h>
 
 // 使用正確的命名空間
@@ -40,8 +41,10 @@ bool ReportExporter::exportResults(const msa::AnalysisResults& results, const st
         return false;
     }
     
-    // 匯出Level 1原始甲基化詳情
-    if (!exportLevel1Details(results.level1_details, outputDir)) {
+    // 匯出Level 1原始甲基化詳情 (僅輸出摘要時未保留)
+    if (config_.summary_only) {
+        LOG_INFO("ReportExporter", "僅輸出摘要，不匯出Level 1原始甲基化詳情");
+    } else if (!exportLevel1Details(results.level1_details, outputDir)) {
         LOG_ERROR("ReportExporter", "匯出Level 1原始甲基化詳情失敗");
         return false;
     }
@@ -94,7 +97,7 @@ bool ReportExporter::exportGlobalSummary(const msa::GlobalSummaryMetrics& metric
     return true;
 }
 
-bool ReportExporter::exportLevel1Details(const std::vector<msa::MethylationSiteDetail>& details, const std::string& outputDir) {
+bool ReportExporter::exportLevel1Details(const msa::Level1Details& details, const std::string& outputDir) {
     std::string outputPath = outputDir + "/level1_raw_methylation_details.tsv";
     std::ofstream outFile(outputPath);
     
@@ -110,24 +113,39 @@ bool ReportExporter::exportLevel1Details(const std::vector<msa::MethylationSiteD
             << "somatic_allele_type\tsomatic_base_at_variant\thaplotype_tag\tmeth_call\t"
             << "meth_state\tstrand\tread_id\n";
     
-    // 寫入數據
-    for (const auto& detail : details) {
-        outFile << detail.chrom << "\t"
-                << detail.methyl_pos << "\t"
-                << detail.somatic_pos << "\t"
-                << detail.variant_type << "\t"
-                << detail.vcf_source_id << "\t"
-                << detail.bam_source_id << "\t"
-                << detail.somatic_allele_type << "\t"
-                << detail.somatic_base_at_variant << "\t"
-                << detail.haplotype_tag << "\t"
-                << std::fixed << std::setprecision(4) << detail.meth_call << "\t"
-                << detail.meth_state << "\t"
-                << detail.strand << "\t"
-                << detail.read_id << "\n";
-    }
+    // 字典快照，逐列輸出時不需取得字典的鎖
+    using Dictionary = msa::MethylationSiteTable::Dictionary;
+    std::vector<std::string> chroms = msa::MethylationSiteTable::dictionary(Dictionary::Chrom).snapshot();
+    std::vector<std::string> variant_types = msa::MethylationSiteTable::dictionary(Dictionary::VariantType).snapshot();
+    std::vector<std::string> vcf_sources = msa::MethylationSiteTable::dictionary(Dictionary::VcfSource).snapshot();
+    std::vector<std::string> bam_sources = msa::MethylationSiteTable::dictionary(Dictionary::BamSource).snapshot();
+    std::vector<std::string> haplotypes = msa::MethylationSiteTable::dictionary(Dictionary::Haplotype).snapshot();
+    
+    // 寫入數據 (溢寫的位點依變異順序逐塊讀回)
+    outFile << std::fixed << std::setprecision(4);
+    bool complete = details.forEachBlock([&](const msa::MethylationSiteTable& block) {
+        for (size_t i = 0; i < block.size(); ++i) {
+            outFile << chroms[block.chromId(i)] << "\t"
+                    << block.methylPos(i) << "\t"
+                    << block.somaticPos(i) << "\t"
+                    << variant_types[block.variantTypeId(i)] << "\t"
+                    << vcf_sources[block.vcfSourceId(i)] << "\t"
+                    << bam_sources[block.bamSourceId(i)] << "\t"
+                    << msa::MethylationSiteTable::alleleTypeName(block.alleleType(i)) << "\t"
+                    << block.somaticBase(i) << "\t"
+                    << haplotypes[block.haplotypeId(i)] << "\t"
+                    << block.methCall(i) << "\t"
+                    << msa::MethylationSiteTable::methStateName(block.methState(i)) << "\t"
+                    << msa::MethylationSiteTable::strandChar(block.strand(i)) << "\t"
+                    << block.readName(i) << "\n";
+        }
+    });
     
     outFile.close();
+    if (!complete) {
+        LOG_ERROR("ReportExporter", "無法讀取Level 1溢寫資料，Level 1詳情不完整: " + outputPath);
+        return false;
+    }
     
     // 如果需要gzip壓縮
     if (config_.gzip_output) {
@@ -233,8 +251,49 @@ bool ReportExporter::exportLevel3Stats(const std::vector<msa::AggregatedHaplotyp
     if (vcf_sources.size() >= 2) {
         outFile << "\tdifference\tp_value";
     }
+    const bool resampled = vcf_sources.size() >= 2 && config_.permutations > 0;
+    if (resampled) {
+        outFile << "\tpermutation_p\tpermutations\tdifference_ci_lower\tdifference_ci_upper";
+    }
+    
+    // 所有VCF兩兩比較的檢定欄位 (各分組的配對順序相同)
+    const std::vector<msa::PairwiseMethylationTest>* pair_layout = nullptr;
+    for (const auto& stat : stats) {
+        if (!pair_layout || stat.pairwise_tests.size() > pair_layout->size()) {
+            pair_layout = &stat.pairwise_tests;
+        }
+    }
+    const size_t num_pairs = pair_layout ? pair_layout->size() : 0;
+    for (size_t p = 0; p < num_pairs; ++p) {
+        const std::string prefix = (*pair_layout)[p].vcf_a + "_vs_" + (*pair_layout)[p].vcf_b + "_";
+        outFile << "\t" << prefix << "difference"
+                << "\t" << prefix << "welch_t"
+                << "\t" << prefix << "welch_df"
+                << "\t" << prefix << "welch_p"
+                << "\t" << prefix << "mann_whitney_u"
+                << "\t" << prefix << "mann_whitney_p"
+                << "\t" << prefix << "fisher_p";
+    }
     outFile << "\n";
     
+    // 檢定欄位：無法計算時輸出NA，p值以科學記號保留極小值
+    auto writeValue = [&outFile](double value, int precision) {
+        outFile << "\t";
+        if (std::isnan(value)) {
+            outFile << "NA";
+        } else {
+            outFile << std::fixed << std::setprecision(precision) << value;
+        }
+    };
+    auto writePValue = [&outFile](double value) {
+        outFile << "\t";
+        if (std::isnan(value)) {
+            outFile << "NA";
+        } else {
+            outFile << std::scientific << std::setprecision(6) << value << std::fixed;
+        }
+    };
+    
     // 寫入數據
     for (const auto& stat : stats) {
         outFile << stat.haplotype_group << "\t"
@@ -255,6 +314,27 @@ bool ReportExporter::exportLevel3Stats(const std::vector<msa::AggregatedHaplotyp
             outFile << "\t" << std::fixed << std::setprecision(4) << stat.difference;
             outFile << "\t" << std::fixed << std::setprecision(6) << stat.p_value;
         }
+        if (resampled) {
+            writePValue(stat.permutation_p);
+            outFile << "\t" << stat.permutations_run;
+            writeValue(stat.difference_ci_lower, 4);
+            writeValue(stat.difference_ci_upper, 4);
+        }
+        
+        for (size_t p = 0; p < num_pairs; ++p) {
+            if (p < stat.pairwise_tests.size()) {
+                const auto& test = stat.pairwise_tests[p];
+                writeValue(test.difference, 4);
+                writeValue(test.welch_t, 4);
+                writeValue(test.welch_df, 2);
+                writePValue(test.welch_p);
+                writeValue(test.mann_whitney_u, 1);
+                writePValue(test.mann_whitney_p);
+                writePValue(test.fisher_p);
+            } else {
+                outFile << "\tNA\tNA\tNA\tNA\tNA\tNA\tNA";
+            }
+        }
         
         outFile << "\n";
     }
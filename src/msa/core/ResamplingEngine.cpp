@@ -0,0 +1,220 @@
+#include "msa/core/ResamplingEngine.h"
+#include "msa/utils/FlatHashTable.h"
+#include "msa/utils/Philox.h"
+#include "msa/utils/TaskScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <mutex>
+
+// 使用正確的命名空間
+using namespace msa::utils;
+
+namespace msa::core {
+
+// 每批置換數：批次內並行執行，批次之間檢查序列停止條件
+static constexpr uint64_t kPermutationBatch = 1024;
+
+// 每個任務處理的置換數
+static constexpr size_t kResampleGrain = 32;
+
+// bootstrap 每個區段的重抽樣數 (區段緩衝區大小固定，與 --permutations 無關)
+static constexpr size_t kBootstrapChunk = 16384;
+
+// Besag–Clifford 序列停止門檻：超過觀測差異的置換數達到此值即停止，p值為 h / 已執行置換數
+static constexpr uint64_t kStopExceedances = 20;
+
+// 置換差異與觀測差異的比較容差 (甲基化程度介於0~1，浮點累加誤差遠小於此值)
+static constexpr double kTieTolerance = 1e-12;
+
+// 亂數串流種類 (串流編號的最低位元)
+static constexpr uint64_t kPermutationStream = 0;
+static constexpr uint64_t kBootstrapStream = 1;
+
+/*
+* 構造函數
+* \param permutations 置換數與 bootstrap 重抽樣數
+* \param seed 亂數種子
+*/
+ResamplingEngine::ResamplingEngine(int permutations, uint64_t seed)
+    : permutations_(static_cast<uint64_t>(std::max(0, permutations))),
+      seed_(seed) {
+}
+
+/*
+* 比較兩組數值的平均差異
+* \param a 第一組數值
+* \param b 第二組數值
+* \param group 分組編號
+* \return 置換檢定p值與 bootstrap 信賴區間
+*/
+ResamplingEngine::Result ResamplingEngine::compare(const std::vector<float>& a, const std::vector<float>& b, uint64_t group) const {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    Result result{nan, 0, nan, nan};
+    if (permutations_ == 0 || a.size() < 2 || b.size() < 2) {
+        return result;
+    }
+    
+    const uint64_t key = mixHash64(seed_ ^ mixHash64(group));
+    permutationTest(a, b, key, result);
+    bootstrap(a, b, key, result);
+    return result;
+}
+
+/*
+* 雙尾置換檢定
+* \param a 第一組數值
+* \param b 第二組數值
+* \param key 亂數鍵
+* \param result 寫入p值與置換數
+*/
+void ResamplingEngine::permutationTest(const std::vector<float>& a, const std::vector<float>& b, uint64_t key, Result& result) const {
+    // 合併兩組；每次置換只隨機選出較小一組大小的元素，另一組的總和由總和相減求得
+    std::vector<double> pooled(a.begin(), a.end());
+    pooled.insert(pooled.end(), b.begin(), b.end());
+    const size_t n = pooled.size();
+    const bool pick_a = a.size() <= b.size();
+    const size_t k = pick_a ? a.size() : b.size();
+    const double na = static_cast<double>(a.size());
+    const double nb = static_cast<double>(b.size());
+    double total = 0.0;
+    double sum_a = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        total += pooled[i];
+        if (i < a.size()) {
+            sum_a += pooled[i];
+        }
+    }
+    auto difference = [&](double picked) {
+        double sa = pick_a ? picked : total - picked;
+        return sa / na - (total - sa) / nb;
+    };
+    const double observed = std::abs(difference(pick_a ? sum_a : total - sum_a)) - kTieTolerance;
+    
+    std::vector<uint8_t> exceeds(kPermutationBatch);
+    uint64_t count = 0;
+    for (uint64_t first = 0; first < permutations_; first += kPermutationBatch) {
+        const size_t batch = static_cast<size_t>(std::min(kPermutationBatch, permutations_ - first));
+        TaskScheduler::getInstance().parallelFor(batch, kResampleGrain, [&](size_t begin, size_t end) {
+            // 部分 Fisher–Yates 洗牌後還原交換，每次置換都從相同的排列開始，結果只由置換編號決定
+            std::vector<double> values(pooled);
+            std::vector<uint32_t> swaps(k);
+            for (size_t r = begin; r < end; ++r) {
+                PhiloxStream rng(key, ((first + r) << 1) | kPermutationStream);
+                double picked = 0.0;
+                for (size_t j = 0; j < k; ++j) {
+                    swaps[j] = static_cast<uint32_t>(j + rng.below(static_cast<uint32_t>(n - j)));
+                    std::swap(values[j], values[swaps[j]]);
+                    picked += values[j];
+                }
+                exceeds[r] = std::abs(difference(picked)) >= observed ? 1 : 0;
+                for (size_t j = k; j-- > 0;) {
+                    std::swap(values[j], values[swaps[j]]);
+                }
+            }
+        });
+        
+        // 依置換編號順序檢查停止條件，停止點與批次切分及執行緒數無關
+        for (size_t r = 0; r < batch; ++r) {
+            count += exceeds[r];
+            if (count >= kStopExceedances) {
+                result.permutations = first + r + 1;
+                result.permutation_p = static_cast<double>(count) / static_cast<double>(result.permutations);
+                return;
+            }
+        }
+    }
+    result.permutations = permutations_;
+    result.permutation_p = static_cast<double>(count + 1) / static_cast<double>(permutations_ + 1);
+}
+
+/*
+* 保留最小的 m 個值 (順序不定)
+* \param values 數值
+* \param m 保留數
+*/
+static void keepSmallest(std::vector<double>& values, size_t m) {
+    if (values.size() > m) {
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(m), values.end());
+        values.resize(m);
+    }
+}
+
+/*
+* bootstrap 百分位信賴區間
+* \param a 第一組數值
+* \param b 第二組數值
+* \param key 亂數鍵
+* \param result 寫入信賴區間
+*/
+void ResamplingEngine::bootstrap(const std::vector<float>& a, const std::vector<float>& b, uint64_t key, Result& result) const {
+    // 線性內插的百分位數只需要排序後的第 lo、lo+1 與 hi、hi+1 個值：每個區段在固定大小的緩衝區內計算差異，
+    // 只把兩側尾端併入共用的尾端集合 (依值保留，與合併順序無關)，記憶體與重抽樣數的 2.5% 成正比
+    const size_t total = static_cast<size_t>(permutations_);
+    const double pos_lo = 0.025 * static_cast<double>(total - 1);
+    const double pos_hi = 0.975 * static_cast<double>(total - 1);
+    const size_t rank_lo = static_cast<size_t>(std::floor(pos_lo));
+    const size_t rank_hi = static_cast<size_t>(std::floor(pos_hi));
+    const size_t keep_lo = std::min(total, rank_lo + 2);   // 最小的值: 排序位置 [0, rank_lo + 1]
+    const size_t keep_hi = total - rank_hi;                // 最大的值: 排序位置 [rank_hi, total)
+    
+    std::mutex tails_mutex;
+    std::vector<double> low;    // 最小的 keep_lo 個值
+    std::vector<double> high;   // 最大的 keep_hi 個值 (取負值存放，與 low 共用保留最小值的邏輯)
+    const size_t chunks = (total + kBootstrapChunk - 1) / kBootstrapChunk;
+    TaskScheduler::getInstance().parallelFor(chunks, 1, [&](size_t first, size_t last) {
+        std::vector<double> differences;
+        std::vector<double> negated;
+        differences.reserve(kBootstrapChunk);
+        for (size_t c = first; c < last; ++c) {
+            differences.clear();
+            const size_t end = std::min(total, (c + 1) * kBootstrapChunk);
+            for (size_t r = c * kBootstrapChunk; r < end; ++r) {
+                PhiloxStream rng(key, (static_cast<uint64_t>(r) << 1) | kBootstrapStream);
+                double sum_a = 0.0;
+                for (size_t i = 0; i < a.size(); ++i) {
+                    sum_a += a[rng.below(static_cast<uint32_t>(a.size()))];
+                }
+                double sum_b = 0.0;
+                for (size_t i = 0; i < b.size(); ++i) {
+                    sum_b += b[rng.below(static_cast<uint32_t>(b.size()))];
+                }
+                differences.push_back(sum_a / static_cast<double>(a.size()) - sum_b / static_cast<double>(b.size()));
+            }
+            
+            negated.resize(differences.size());
+            std::transform(differences.begin(), differences.end(), negated.begin(), [](double d) { return -d; });
+            keepSmallest(differences, keep_lo);
+            keepSmallest(negated, keep_hi);
+            
+            std::lock_guard<std::mutex> lock(tails_mutex);
+            low.insert(low.end(), differences.begin(), differences.end());
+            high.insert(high.end(), negated.begin(), negated.end());
+            if (low.size() >= 2 * keep_lo + kBootstrapChunk) {
+                keepSmallest(low, keep_lo);
+            }
+            if (high.size() >= 2 * keep_hi + kBootstrapChunk) {
+                keepSmallest(high, keep_hi);
+            }
+        }
+    });
+    keepSmallest(low, keep_lo);
+    keepSmallest(high, keep_hi);
+    std::sort(low.begin(), low.end());
+    std::sort(high.begin(), high.end(), std::greater<double>());  // 負值遞減 = 原值遞增，high[0] 為排序位置 rank_hi
+    
+    // 排序位置 p 的值：最小端取自 low，最大端取自 high
+    auto sortedAt = [&](size_t position) {
+        return position < keep_lo ? low[position] : -high[position - rank_hi];
+    };
+    auto quantile = [&](double pos) {
+        size_t lo = static_cast<size_t>(std::floor(pos));
+        size_t hi = std::min(lo + 1, total - 1);
+        return sortedAt(lo) + (pos - static_cast<double>(lo)) * (sortedAt(hi) - sortedAt(lo));
+    };
+    result.ci_lower = quantile(pos_lo);
+    result.ci_upper = quantile(pos_hi);
+}
+
+} // namespace msa::core
@@ -1,5 +1,8 @@
 #include "msa/core/SomaticMethylationAnalyzer.h"
+#include "msa/core/ResamplingEngine.h"
+#include "msa/core/TwoSampleTests.h"
 #include "msa/utils/LogManager.h"
+#include "msa/utils/TaskScheduler.h"
 #include <sstream>
 #include <algorithm>
 #include <cmath>
@@ -7,17 +10,18 @@
 #include <set>
 #include <numeric>
 #include <iomanip>
-
-// 使用預處理器檢查是否編譯時啟用了OpenMP
-#ifdef HAVE_OPENMP
-#include <omp.h>  // 添加OpenMP頭文件
-#endif
+#include <functional>
+#include <stdexcept>
+#include <limits>
 
 // 使用正確的命名空間
 using namespace msa::utils;
 
 namespace msa::core {
 
+// 並行累計時每個任務處理的列數
+static constexpr size_t kConsumeGrain = 1 << 16;
+
 /*
 * 構造函數
 * \param config 配置
@@ -26,232 +30,88 @@ SomaticMethylationAnalyzer::SomaticMethylationAnalyzer(const msa::Config& config
     : config_(config) {
 }
 
+/**
+ * @brief 依列順序逐塊掃描Level 1位點
+ * \param level1 甲基化位點
+ * \param fn 處理函數
+ */
+static void scanBlocks(const msa::Level1Details& level1, const std::function<void(const msa::MethylationSiteTable&)>& fn) {
+    if (!level1.forEachBlock(fn)) {
+        throw std::runtime_error("無法讀取Level 1溢寫資料");
+    }
+}
+
 /*
 * 分析甲基化位點
-* \param sites 甲基化位點
+* \param level1 甲基化位點
 * \return 分析結果
 */
-msa::AnalysisResults SomaticMethylationAnalyzer::analyze(const std::vector<msa::MethylationSiteDetail>& sites) {
-    LOG_INFO("SomaticMethylationAnalyzer", "開始分析 " + std::to_string(sites.size()) + " 個甲基化位點");
-    
-    msa::AnalysisResults results;
-    
-    // 保存原始位點詳細資訊
-    results.level1_details = sites;
-    
-    // 過濾雙股覆蓋不足的位點
-    auto filtered_sites = filterSitesByStrandCoverage(sites);
-    LOG_INFO("SomaticMethylationAnalyzer", "雙股覆蓋篩選後保留 " + std::to_string(filtered_sites.size()) + " 個位點");
-    
-    // 生成Level 2摘要統計
-    results.level2_summary = generateLevel2Summary(filtered_sites);
-    LOG_INFO("SomaticMethylationAnalyzer", "生成 " + std::to_string(results.level2_summary.size()) + " 個Level 2摘要記錄");
-    
-    // 生成Level 3聚合統計
-    results.level3_stats = generateLevel3Statistics(results.level2_summary);
-    LOG_INFO("SomaticMethylationAnalyzer", "生成 " + std::to_string(results.level3_stats.size()) + " 個Level 3聚合統計");
-    
-    // 計算全域摘要指標
-    results.global_metrics = calculateGlobalMetrics(sites, results.level2_summary);
-    
+msa::AnalysisResults SomaticMethylationAnalyzer::analyze(msa::Level1Details level1) {
+    LOG_INFO("SomaticMethylationAnalyzer", "開始分析 " + std::to_string(level1.size()) + " 個甲基化位點" +
+             (level1.spilled() ? " (自溢寫區段逐塊讀取)" : ""));
+    
+    MethylationAggregator aggregator(config_);
+    accumulate([&level1](const std::function<void(const msa::MethylationSiteTable&)>& fn) {
+        scanBlocks(level1, fn);
+    }, aggregator);
+    
+    // 保存原始位點詳細資訊 (表格移入結果，不複製)
+    msa::AnalysisResults results = summarize(aggregator);
+    results.level1_details = std::move(level1);
     return results;
 }
 
 /*
-* 過濾雙股覆蓋不足的位點
-* \param sites 甲基化位點
-* \return 過濾後的位點
+* 將掃描函數提供的位點經雙股覆蓋篩選後送入聚合器
+* \param scan 掃描函數
+* \param aggregator 聚合器
 */
-std::vector<msa::MethylationSiteDetail> SomaticMethylationAnalyzer::filterSitesByStrandCoverage(
-    const std::vector<msa::MethylationSiteDetail>& sites) {
-    
-    // 如果min_strand_reads為0，則不需要過濾
-    if (config_.min_strand_reads <= 0) {
-        return sites;
+void SomaticMethylationAnalyzer::accumulate(const BlockScan& scan, MethylationAggregator& aggregator) {
+    // 雙股覆蓋須統計所有位點後才能判斷，先掃描一次累計各唯一位點的正反鏈讀段數 (不需篩選時略過)
+    MethylationAggregator::StrandCoverage coverage;
+    const bool filter = aggregator.filtersStrandCoverage();
+    if (filter) {
+        scan([&](const msa::MethylationSiteTable& block) {
+            coverage.add(block);
+        });
+        coverage.build(config_.min_strand_reads);
     }
     
-    // 統計每個位點在正反鏈上的覆蓋
-    std::map<std::string, std::map<char, int>> position_strand_counts;
-    
-    // 計算位點標識符的輔助函數
-    auto getPositionKey = [](const msa::MethylationSiteDetail& site) {
-        return site.chrom + ":" + std::to_string(site.methyl_pos) + ":" + site.bam_source_id;
-    };
-    
-    // 統計每個位點在正反鏈的覆蓋數 - 這部分不適合並行化，因為需要同時更新計數器
-    for (const auto& site : sites) {
-        std::string pos_key = getPositionKey(site);
-        position_strand_counts[pos_key][site.strand]++;
-    }
-    
-    // 確定哪些位點符合雙股覆蓋要求
-    std::set<std::string> valid_positions;
-    for (const auto& [pos_key, strand_counts] : position_strand_counts) {
-        // 檢查正鏈('+'）覆蓋
-        bool plus_valid = strand_counts.count('+') && strand_counts.at('+') >= config_.min_strand_reads;
-        // 檢查反鏈('-')覆蓋
-        bool minus_valid = strand_counts.count('-') && strand_counts.at('-') >= config_.min_strand_reads;
-        
-        // 同時滿足正反鏈覆蓋要求
-        if (plus_valid && minus_valid) {
-            valid_positions.insert(pos_key);
+    // 逐塊生成保留旗標並並行累計 (各工作執行緒累計到各自的部分狀態，合併結果與列順序無關)
+    std::vector<uint8_t> keep;
+    scan([&](const msa::MethylationSiteTable& block) {
+        if (filter) {
+            coverage.keepFlags(block, keep);
         }
-    }
-    
-    // 過濾出符合要求的位點 - 可以並行處理
-    std::vector<msa::MethylationSiteDetail> filtered_sites;
-    filtered_sites.reserve(sites.size()); // 預分配空間
-
-#ifdef HAVE_OPENMP
-    #pragma omp parallel
-    {
-        // 每個執行緒使用局部向量存儲結果
-        std::vector<msa::MethylationSiteDetail> local_filtered;
-        
-        #pragma omp for nowait
-        for (size_t i = 0; i < sites.size(); ++i) {
-            std::string pos_key = getPositionKey(sites[i]);
-            if (valid_positions.count(pos_key)) {
-                local_filtered.push_back(sites[i]);
-            }
-        }
-        
-        // 合併每個執行緒的結果
-        #pragma omp critical
-        {
-            filtered_sites.insert(filtered_sites.end(), local_filtered.begin(), local_filtered.end());
-        }
-    }
-#else
-    // 非OpenMP模式 - 順序處理
-    for (const auto& site : sites) {
-        std::string pos_key = getPositionKey(site);
-        if (valid_positions.count(pos_key)) {
-            filtered_sites.push_back(site);
-        }
-    }
-#endif
-    
-    return filtered_sites;
+        const uint8_t* flags = filter ? keep.data() : nullptr;
+        TaskScheduler::getInstance().parallelFor(block.size(), kConsumeGrain, [&](size_t begin, size_t end) {
+            aggregator.consume(block, flags, begin, end);
+        });
+    });
 }
 
 /*
-* 生成Level 2摘要
-* \param sites 甲基化位點
-* \return 摘要
+* 由聚合器的累計值生成分析結果
+* \param aggregator 已累計所有位點的聚合器
+* \return 分析結果 (不含Level 1詳情)
 */
-std::vector<msa::SomaticVariantMethylationSummary> SomaticMethylationAnalyzer::generateLevel2Summary(
-    const std::vector<msa::MethylationSiteDetail>& sites) {
-    
-    // 按分組鍵聚合數據
-    std::map<std::string, std::vector<msa::MethylationSiteDetail>> groupedSites;
-    std::map<std::string, std::set<std::string>> groupReadCounts;
-    
-    // 分組鍵格式: chrom:pos:variant_type:vcf_source_id:bam_source_id:somatic_allele_type:haplotype_tag
-    for (const auto& site : sites) {
-        std::ostringstream key;
-        key << site.chrom << ":" << site.somatic_pos << ":" 
-            << site.variant_type << ":" << site.vcf_source_id << ":" 
-            << site.bam_source_id << ":" << site.somatic_allele_type << ":" 
-            << site.haplotype_tag;
-        
-        std::string group_key = key.str();
-        groupedSites[group_key].push_back(site);
-        
-        // 追蹤每個組中唯一的讀段
-        groupReadCounts[group_key].insert(site.read_id);
-    }
-    
-    // 轉換為可並行處理的結構
-    std::vector<std::pair<std::string, std::vector<msa::MethylationSiteDetail>>> groups;
-    std::vector<std::pair<std::string, std::set<std::string>>> read_counts;
-    
-    for (const auto& [key, sites] : groupedSites) {
-        groups.push_back({key, sites});
-    }
-    
-    for (const auto& [key, counts] : groupReadCounts) {
-        read_counts.push_back({key, counts});
-    }
+msa::AnalysisResults SomaticMethylationAnalyzer::summarize(MethylationAggregator& aggregator) {
+    msa::AnalysisResults results;
+    MethylationAggregator::Result aggregated = aggregator.finalize();
+    LOG_INFO("SomaticMethylationAnalyzer", "雙股覆蓋篩選後保留 " + std::to_string(aggregated.kept_sites) + " 個位點");
     
-    // 生成Level 2摘要 - 使用OpenMP並行處理
-    std::vector<msa::SomaticVariantMethylationSummary> summaries(groups.size());
+    // 生成Level 2摘要統計
+    results.level2_summary = std::move(aggregated.level2_summary);
+    LOG_INFO("SomaticMethylationAnalyzer", "生成 " + std::to_string(results.level2_summary.size()) + " 個Level 2摘要記錄");
     
-#ifdef HAVE_OPENMP
-    #pragma omp parallel for schedule(dynamic)
-#endif
-    for (size_t i = 0; i < groups.size(); ++i) {
-        const auto& group_key = groups[i].first;
-        const auto& group_sites = groups[i].second;
-        
-        // 跳過沒有足夠位點的組
-        if (group_sites.empty()) {
-            continue;
-        }
-        
-        // 尋找對應的讀段計數
-        size_t read_count_idx = 0;
-        for (size_t j = 0; j < read_counts.size(); ++j) {
-            if (read_counts[j].first == group_key) {
-                read_count_idx = j;
-                break;
-            }
-        }
-        
-        // 使用第一個站點獲取基本信息
-        const auto& first_site = group_sites[0];
-        
-        // 創建摘要
-        msa::SomaticVariantMethylationSummary summary;
-        summary.chrom = first_site.chrom;
-        summary.somatic_pos = first_site.somatic_pos;
-        summary.variant_type = first_site.variant_type;
-        summary.vcf_source_id = first_site.vcf_source_id;
-        summary.bam_source_id = first_site.bam_source_id;
-        summary.somatic_allele_type = first_site.somatic_allele_type;
-        summary.haplotype_tag = first_site.haplotype_tag;
-        
-        // 計算支持該摘要的讀段數量
-        summary.supporting_read_count = read_counts[read_count_idx].second.size();
-        
-        // 計算甲基化位點數量
-        summary.methyl_sites_count = group_sites.size();
-        
-        // 計算平均甲基化水平
-        double total_meth = 0.0;
-        for (const auto& site : group_sites) {
-            total_meth += site.meth_call;
-        }
-        summary.mean_methylation = group_sites.empty() ? 0.0f : static_cast<float>(total_meth / group_sites.size());
-        
-        // 確定主要鏈方向
-        int plus_count = 0, minus_count = 0;
-        for (const auto& site : group_sites) {
-            if (site.strand == '+') plus_count++;
-            else if (site.strand == '-') minus_count++;
-        }
-        
-        if (plus_count > minus_count && plus_count > 0) {
-            summary.strand = '+';
-        } else if (minus_count > plus_count && minus_count > 0) {
-            summary.strand = '-';
-        } else {
-            summary.strand = '.';  // 混合或未知
-        }
-        
-        summaries[i] = summary;
-    }
+    // 生成Level 3聚合統計
+    results.level3_stats = generateLevel3Statistics(results.level2_summary);
+    LOG_INFO("SomaticMethylationAnalyzer", "生成 " + std::to_string(results.level3_stats.size()) + " 個Level 3聚合統計");
     
-    // 過濾掉未處理的空記錄
-    summaries.erase(
-        std::remove_if(summaries.begin(), summaries.end(), 
-                      [](const msa::SomaticVariantMethylationSummary& s) { 
-                          return s.methyl_sites_count == 0; 
-                      }),
-        summaries.end()
-    );
+    // 計算全域摘要指標
+    results.global_metrics = calculateGlobalMetrics(aggregated.global, results.level2_summary);
     
-    return summaries;
+    return results;
 }
 
 /*
@@ -262,10 +122,23 @@ std::vector<msa::SomaticVariantMethylationSummary> SomaticMethylationAnalyzer::g
 std::vector<msa::AggregatedHaplotypeStats> SomaticMethylationAnalyzer::generateLevel3Statistics(
     const std::vector<msa::SomaticVariantMethylationSummary>& level2Summary) {
     
-    // 按單倍型組、樣本來源和變異類型分組
-    std::map<std::string, std::map<std::string, std::vector<float>>> grouped_methylation;
+    // 每個分組內每個VCF的Level 2平均甲基化與甲基化/非甲基化位點數
+    struct VcfValues {
+        std::vector<float> means;
+        uint64_t methylated = 0;
+        uint64_t unmethylated = 0;
+    };
+    struct Group {
+        std::string haplotype_group;
+        std::string bam_source;
+        std::string variant_type_group;
+        std::map<std::string, VcfValues> vcf_values;
+    };
     
     // 分組鍵格式: haplotype_group:bam_source:variant_type_group
+    std::map<std::string, Group> grouped_methylation;
+    std::set<std::string> vcf_sources;
+    
     for (const auto& summary : level2Summary) {
         // 簡化變異類型分組（例如，合併所有INDELs）
         std::string variant_type_group = summary.variant_type;
@@ -273,101 +146,122 @@ std::vector<msa::AggregatedHaplotypeStats> SomaticMethylationAnalyzer::generateL
             variant_type_group = "INDEL";
         }
         
-        // 創建分組鍵
         std::string group_key = summary.haplotype_tag + ":" + 
                               summary.bam_source_id + ":" + 
                               variant_type_group;
+        Group& group = grouped_methylation[group_key];
+        if (group.vcf_values.empty()) {
+            group.haplotype_group = summary.haplotype_tag;
+            group.bam_source = summary.bam_source_id;
+            group.variant_type_group = variant_type_group;
+        }
         
-        // 將甲基化平均值添加到對應VCF的列表中
-        grouped_methylation[group_key][summary.vcf_source_id].push_back(summary.mean_methylation);
-    }
-    
-    // 獲取唯一VCF來源
-    std::set<std::string> vcf_sources;
-    for (const auto& summary : level2Summary) {
+        auto& values = group.vcf_values[summary.vcf_source_id];
+        values.means.push_back(summary.mean_methylation);
+        values.methylated += static_cast<uint64_t>(summary.methylated_sites_count);
+        values.unmethylated += static_cast<uint64_t>(summary.methyl_sites_count - summary.methylated_sites_count);
         vcf_sources.insert(summary.vcf_source_id);
     }
     
-    // 轉換為可並行處理的結構
-    std::vector<std::tuple<std::string, std::string, std::string, std::map<std::string, std::vector<float>>>> groups;
-    
-    for (const auto& [group_key, vcf_values] : grouped_methylation) {
-        // 解析分組鍵
-        std::string haplotype_group, bam_source, variant_type_group;
-        {
-            std::istringstream ss(group_key);
-            std::getline(ss, haplotype_group, ':');
-            std::getline(ss, bam_source, ':');
-            std::getline(ss, variant_type_group, ':');
+    // 所有VCF兩兩配對 (依VCF來源排序)，每個分組都輸出相同的配對
+    std::vector<std::string> vcf_list(vcf_sources.begin(), vcf_sources.end());
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t a = 0; a < vcf_list.size(); ++a) {
+        for (size_t b = a + 1; b < vcf_list.size(); ++b) {
+            pairs.emplace_back(a, b);
         }
-        
-        groups.push_back(std::make_tuple(haplotype_group, bam_source, variant_type_group, vcf_values));
     }
     
-    // 對每個分組並行生成統計
+    std::vector<Group*> groups;
+    groups.reserve(grouped_methylation.size());
+    for (auto& [group_key, group] : grouped_methylation) {
+        groups.push_back(&group);
+    }
+    
+    // 對每個分組並行生成統計：每個VCF的樣本只整理一次 (動差與排序)，所有配對共用
     std::vector<msa::AggregatedHaplotypeStats> stats(groups.size());
+    const ResamplingEngine resampler(config_.permutations);
     
-#ifdef HAVE_OPENMP
-    #pragma omp parallel for schedule(dynamic)
-#endif
-    for (size_t i = 0; i < groups.size(); ++i) {
-        auto& [haplotype_group, bam_source, variant_type_group, vcf_methyl_values] = groups[i];
-        
-        // 創建聚合統計
-        msa::AggregatedHaplotypeStats stat;
-        stat.haplotype_group = haplotype_group;
-        stat.bam_source = bam_source;
-        stat.variant_type_group = variant_type_group;
-        
-        // 計算每個VCF的平均甲基化
-        for (const auto& vcf_source : vcf_sources) {
-            if (vcf_methyl_values.count(vcf_source) && !vcf_methyl_values.at(vcf_source).empty()) {
-                const auto& values = vcf_methyl_values.at(vcf_source);
-                float mean = std::accumulate(values.begin(), values.end(), 0.0f) / values.size();
-                stat.vcf_methylation_means[vcf_source] = mean;
-            } else {
-                // 此VCF在此分組中沒有數據
-                stat.vcf_methylation_means[vcf_source] = -1.0f;  // 表示缺失值
+    TaskScheduler::getInstance().parallelFor(groups.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Group& group = *groups[i];
+            
+            // 創建聚合統計
+            msa::AggregatedHaplotypeStats& stat = stats[i];
+            stat.haplotype_group = group.haplotype_group;
+            stat.bam_source = group.bam_source;
+            stat.variant_type_group = group.variant_type_group;
+            
+            // 計算每個VCF的平均甲基化
+            std::vector<TwoSampleTests::Sample> samples(vcf_list.size());
+            for (size_t v = 0; v < vcf_list.size(); ++v) {
+                auto found = group.vcf_values.find(vcf_list[v]);
+                if (found != group.vcf_values.end() && !found->second.means.empty()) {
+                    samples[v] = TwoSampleTests::prepare(std::move(found->second.means),
+                                                         found->second.methylated, found->second.unmethylated);
+                    stat.vcf_methylation_means[vcf_list[v]] = static_cast<float>(samples[v].moments.mean);
+                } else {
+                    // 此VCF在此分組中沒有數據
+                    stat.vcf_methylation_means[vcf_list[v]] = -1.0f;  // 表示缺失值
+                }
             }
-        }
-        
-        // 如果有多個VCF，計算它們之間的差異和p值
-        if (vcf_sources.size() >= 2) {
-            std::vector<std::string> vcf_list(vcf_sources.begin(), vcf_sources.end());
-            const std::string& vcf1 = vcf_list[0];
-            const std::string& vcf2 = vcf_list[1];
             
-            // 檢查兩個VCF都有值
-            if (stat.vcf_methylation_means[vcf1] >= 0 && stat.vcf_methylation_means[vcf2] >= 0) {
-                stat.difference = stat.vcf_methylation_means[vcf1] - stat.vcf_methylation_means[vcf2];
-                
-                // 如果有原始數據，計算p值
-                if (vcf_methyl_values.count(vcf1) && vcf_methyl_values.count(vcf2) &&
-                    !vcf_methyl_values.at(vcf1).empty() && !vcf_methyl_values.at(vcf2).empty()) {
-                    stat.p_value = calculatePValue(vcf_methyl_values.at(vcf1), vcf_methyl_values.at(vcf2));
+            // 所有VCF兩兩比較
+            stat.pairwise_tests.reserve(pairs.size());
+            for (const auto& [a, b] : pairs) {
+                msa::PairwiseMethylationTest test;
+                test.vcf_a = vcf_list[a];
+                test.vcf_b = vcf_list[b];
+                const auto& sa = samples[a];
+                const auto& sb = samples[b];
+                if (sa.moments.n > 0 && sb.moments.n > 0) {
+                    test.difference = sa.moments.mean - sb.moments.mean;
+                    TwoSampleTests::Result welch = TwoSampleTests::welch(sa.moments, sb.moments);
+                    test.welch_t = welch.statistic;
+                    test.welch_df = welch.df;
+                    test.welch_p = welch.p_value;
+                    TwoSampleTests::Result mwu = TwoSampleTests::mannWhitney(sa.sorted, sb.sorted);
+                    test.mann_whitney_u = mwu.statistic;
+                    test.mann_whitney_p = mwu.p_value;
+                    test.fisher_p = TwoSampleTests::fisherExact(sa.methylated, sa.unmethylated, sb.methylated, sb.unmethylated);
                 } else {
-                    stat.p_value = 1.0f;  // 無法計算p值
+                    // 任一VCF沒有數據時無法比較
+                    const double na = std::numeric_limits<double>::quiet_NaN();
+                    test.difference = test.welch_t = test.welch_df = test.welch_p = na;
+                    test.mann_whitney_u = test.mann_whitney_p = test.fisher_p = na;
+                }
+                stat.pairwise_tests.push_back(std::move(test));
+            }
+            
+            // 前兩個VCF的差異與p值 (無法計算時差異為0、p值為1)
+            if (!stat.pairwise_tests.empty()) {
+                const auto& first = stat.pairwise_tests.front();
+                stat.difference = std::isnan(first.difference) ? 0.0f : static_cast<float>(first.difference);
+                stat.p_value = std::isnan(first.welch_p) ? 1.0f : static_cast<float>(first.welch_p);
+                
+                // 前兩個VCF差異的置換檢定與 bootstrap 信賴區間 (分組編號決定亂數串流)
+                if (config_.permutations > 0) {
+                    ResamplingEngine::Result resampled = resampler.compare(samples[0].sorted, samples[1].sorted, i);
+                    stat.permutation_p = resampled.permutation_p;
+                    stat.permutations_run = resampled.permutations;
+                    stat.difference_ci_lower = resampled.ci_lower;
+                    stat.difference_ci_upper = resampled.ci_upper;
                 }
-            } else {
-                stat.difference = 0.0f;
-                stat.p_value = 1.0f;
             }
         }
-        
-        stats[i] = stat;
-    }
+    });
     
     return stats;
 }
 
 /*
 * 計算全域摘要指標
-* \param sites 甲基化位點
+* \param tally 全域指標的累計值
 * \param level2Summary Level 2摘要
 * \return 全域摘要指標
 */
 msa::GlobalSummaryMetrics SomaticMethylationAnalyzer::calculateGlobalMetrics(
-    const std::vector<msa::MethylationSiteDetail>& sites,
+    const MethylationAggregator::GlobalTally& tally,
     const std::vector<msa::SomaticVariantMethylationSummary>& level2Summary) {
     
     msa::GlobalSummaryMetrics metrics;
@@ -386,34 +280,21 @@ msa::GlobalSummaryMetrics SomaticMethylationAnalyzer::calculateGlobalMetrics(
     metrics.parameters["min_allele"] = std::to_string(config_.min_allele);
     metrics.parameters["min_strand_reads"] = std::to_string(config_.min_strand_reads);
     metrics.parameters["threads"] = std::to_string(config_.threads);
+    metrics.parameters["permutations"] = std::to_string(config_.permutations);
     
-    // 收集統計指標
-    std::map<std::string, std::map<std::string, int>> vcf_source_stats;  // [vcf_source][metric] = value
-    std::map<std::string, std::map<std::string, double>> bam_source_meth_stats;  // [bam_source][metric] = value
+    // 收集統計指標 (累計值以字典ID為鍵，輸出時再轉為字串)
+    using Dictionary = msa::MethylationSiteTable::Dictionary;
+    std::map<std::string, std::map<std::string, uint64_t>> vcf_source_stats;  // [vcf_source][metric] = value
     
-    // 計算每個VCF源中的變異數
-    std::set<std::string> variant_keys;
-    for (const auto& site : sites) {
-        std::string variant_key = site.vcf_source_id + ":" + site.chrom + ":" + 
-                                std::to_string(site.somatic_pos) + ":" + site.variant_type;
-        variant_keys.insert(variant_key);
-        vcf_source_stats[site.vcf_source_id]["total_variants"]++;
+    // 計算每個VCF源中的位點數
+    const auto& vcf_dict = msa::MethylationSiteTable::dictionary(Dictionary::VcfSource);
+    for (const auto& [vcf_id, count] : tally.sites_by_vcf) {
+        vcf_source_stats[vcf_dict.lookup(vcf_id)]["total_variants"] = count;
     }
     
     // 計算處理的變異數
-    for (const auto& key : variant_keys) {
-        std::string vcf_source = key.substr(0, key.find(':'));
-        vcf_source_stats[vcf_source]["processed_variants"]++;
-    }
-    
-    // 計算甲基化位點數量和平均甲基化
-    for (const auto& site : sites) {
-        // 僅考慮高或中度甲基化的位點
-        if (site.meth_state == "high" || site.meth_state == "mid") {
-            bam_source_meth_stats[site.bam_source_id]["methyl_site_count"]++;
-            bam_source_meth_stats[site.bam_source_id]["total_meth"] += site.meth_call;
-        }
-        bam_source_meth_stats[site.bam_source_id]["total_sites"]++;
+    for (const auto& key : tally.variant_keys) {
+        vcf_source_stats[vcf_dict.lookup(std::get<0>(key))]["processed_variants"]++;
     }
     
     // 將統計數據添加到指標
@@ -422,67 +303,24 @@ msa::GlobalSummaryMetrics SomaticMethylationAnalyzer::calculateGlobalMetrics(
         metrics.numeric_metrics_str[vcf_source + "_processed_variants"] = std::to_string(stats.at("processed_variants"));
     }
     
-    for (const auto& [bam_source, stats] : bam_source_meth_stats) {
+    // 甲基化位點數量和平均甲基化 (僅考慮高或中度甲基化的位點)
+    const auto& bam_dict = msa::MethylationSiteTable::dictionary(Dictionary::BamSource);
+    for (const auto& [bam_id, stats] : tally.meth_by_bam) {
+        const std::string& bam_source = bam_dict.lookup(bam_id);
         std::ostringstream mean_meth_stream;
-        double methyl_site_count = stats.at("methyl_site_count");
-        double total_meth = stats.at("total_meth");
-        double total_sites = stats.at("total_sites");
+        double methyl_site_count = static_cast<double>(stats[0]);
+        double total_meth = MethylationAggregator::unitsToMeth(stats[1]);
         double mean_meth = methyl_site_count > 0 ? total_meth / methyl_site_count : 0.0;
         
         // 格式化浮點數，保留四位小數
         mean_meth_stream << std::fixed << std::setprecision(4) << mean_meth;
         
-        metrics.numeric_metrics_str[bam_source + "_methylated_site_count"] = std::to_string(static_cast<int>(methyl_site_count));
-        metrics.numeric_metrics_str[bam_source + "_total_site_count"] = std::to_string(static_cast<int>(total_sites));
+        metrics.numeric_metrics_str[bam_source + "_methylated_site_count"] = std::to_string(stats[0]);
+        metrics.numeric_metrics_str[bam_source + "_total_site_count"] = std::to_string(stats[2]);
         metrics.numeric_metrics_str[bam_source + "_mean_methylation"] = mean_meth_stream.str();
     }
     
     return metrics;
 }
 
-/*
-* 計算p值
-* \param group1 組1
-* \param group2 組2
-* \return p值
-*/
-float SomaticMethylationAnalyzer::calculatePValue(const std::vector<float>& group1, const std::vector<float>& group2) {
-    // 簡單t檢驗實現
-    // 注意：這是一個非常簡化的t檢驗實現，實際應用中應使用統計庫
-    
-    // 檢查樣本大小
-    if (group1.size() < 2 || group2.size() < 2) {
-        return 1.0f;  // 樣本太小無法計算
-    }
-    
-    // 計算組1的均值和方差
-    float mean1 = std::accumulate(group1.begin(), group1.end(), 0.0f) / group1.size();
-    float var1 = 0.0f;
-    for (float val : group1) {
-        var1 += (val - mean1) * (val - mean1);
-    }
-    var1 /= (group1.size() - 1);
-    
-    // 計算組2的均值和方差
-    float mean2 = std::accumulate(group2.begin(), group2.end(), 0.0f) / group2.size();
-    float var2 = 0.0f;
-    for (float val : group2) {
-        var2 += (val - mean2) * (val - mean2);
-    }
-    var2 /= (group2.size() - 1);
-    
-    // 計算t統計量
-    float t_stat = std::abs(mean1 - mean2) / 
-                  std::sqrt((var1 / group1.size()) + (var2 / group2.size()));
-    
-    // 自由度 (approximation)
-    float df = group1.size() + group2.size() - 2;
-    
-    // 簡化的p值計算 (使用一個近似公式)
-    // 注意：這只是一個粗略的近似值，實際應用中應使用更準確的方法
-    float p_value = 1.0f / (1.0f + t_stat * std::sqrt(df / 2.0f));
-    
-    return p_value;
-}
-
 } // namespace msa::core 
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "msa/core/TwoSampleTests.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace msa::core {
+
+static constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/*
+* 樣本變異數
+* \return 變異數 (n < 2 時為 NaN)
+*/
+double TwoSampleTests::Moments::variance() const {
+    return n < 2 ? kNaN : m2 / static_cast<double>(n - 1);
+}
+
+/*
+* 整理樣本
+* \param values 數值
+* \param methylated 甲基化位點數
+* \param unmethylated 非甲基化位點數
+* \return 整理後的樣本
+*/
+TwoSampleTests::Sample TwoSampleTests::prepare(std::vector<float> values, uint64_t methylated, uint64_t unmethylated) {
+    Sample sample;
+    sample.moments = moments(values.data(), values.size());
+    std::sort(values.begin(), values.end());
+    sample.sorted = std::move(values);
+    sample.methylated = methylated;
+    sample.unmethylated = unmethylated;
+    return sample;
+}
+
+/*
+* 計算動差 (兩次掃描：先求平均值，再求差的平方和，避免大數相減的精度損失)
+* \param values 數值
+* \param n 數量
+* \return 動差
+*/
+TwoSampleTests::Moments TwoSampleTests::moments(const float* values, size_t n) {
+    Moments result;
+    result.n = n;
+    if (n == 0) {
+        return result;
+    }
+    
+    // 四條通道彼此獨立，迴圈可向量化，且結果與執行緒數無關
+    const size_t body = n & ~size_t(3);
+    double sum[4] = {0.0, 0.0, 0.0, 0.0};
+    for (size_t i = 0; i < body; i += 4) {
+        for (size_t k = 0; k < 4; ++k) {
+            sum[k] += values[i + k];
+        }
+    }
+    double total = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    for (size_t i = body; i < n; ++i) {
+        total += values[i];
+    }
+    result.mean = total / static_cast<double>(n);
+    
+    double sq[4] = {0.0, 0.0, 0.0, 0.0};
+    for (size_t i = 0; i < body; i += 4) {
+        for (size_t k = 0; k < 4; ++k) {
+            double d = values[i + k] - result.mean;
+            sq[k] += d * d;
+        }
+    }
+    double m2 = (sq[0] + sq[1]) + (sq[2] + sq[3]);
+    for (size_t i = body; i < n; ++i) {
+        double d = values[i] - result.mean;
+        m2 += d * d;
+    }
+    result.m2 = m2;
+    return result;
+}
+
+/*
+* Welch t 檢定
+* \param a 第一組動差
+* \param b 第二組動差
+* \return t 統計量、自由度與p值
+*/
+TwoSampleTests::Result TwoSampleTests::welch(const Moments& a, const Moments& b) {
+    Result result{kNaN, kNaN, kNaN};
+    if (a.n < 2 || b.n < 2) {
+        return result;
+    }
+    
+    double va = a.variance() / static_cast<double>(a.n);
+    double vb = b.variance() / static_cast<double>(b.n);
+    double se2 = va + vb;
+    if (!(se2 > 0.0)) {
+        return result;  // 兩組皆無變異
+    }
+    
+    // Welch–Satterthwaite 自由度
+    result.statistic = (a.mean - b.mean) / std::sqrt(se2);
+    result.df = se2 * se2 / (va * va / static_cast<double>(a.n - 1) + vb * vb / static_cast<double>(b.n - 1));
+    
+    // 雙尾p值: P(|T| >= |t|) = I_{df/(df+t^2)}(df/2, 1/2)
+    double t2 = result.statistic * result.statistic;
+    result.p_value = incompleteBeta(result.df / 2.0, 0.5, result.df / (result.df + t2));
+    return result;
+}
+
+/*
+* Mann–Whitney U 檢定
+* \param a 第一組遞增排序的數值
+* \param b 第二組遞增排序的數值
+* \return 第一組的 U 統計量與p值
+*/
+TwoSampleTests::Result TwoSampleTests::mannWhitney(const std::vector<float>& a, const std::vector<float>& b) {
+    Result result{kNaN, kNaN, kNaN};
+    const double na = static_cast<double>(a.size());
+    const double nb = static_cast<double>(b.size());
+    if (a.empty() || b.empty()) {
+        return result;
+    }
+    
+    // 合併兩組排序後的數值，同分的數值取平均秩，同時累計同分校正項 sum(t^3 - t)
+    double rank_sum = 0.0;
+    double tie_term = 0.0;
+    double next_rank = 1.0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() || j < b.size()) {
+        float value = (j == b.size() || (i < a.size() && a[i] <= b[j])) ? a[i] : b[j];
+        size_t ta = 0;
+        size_t tb = 0;
+        while (i < a.size() && a[i] == value) {
+            ++i;
+            ++ta;
+        }
+        while (j < b.size() && b[j] == value) {
+            ++j;
+            ++tb;
+        }
+        double t = static_cast<double>(ta + tb);
+        rank_sum += static_cast<double>(ta) * (next_rank + (t - 1.0) / 2.0);
+        tie_term += t * t * t - t;
+        next_rank += t;
+    }
+    
+    const double n = na + nb;
+    result.statistic = rank_sum - na * (na + 1.0) / 2.0;
+    double mu = na * nb / 2.0;
+    double sigma2 = na * nb / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if (!(sigma2 > 0.0)) {
+        result.p_value = kNaN;  // 所有數值相同
+        return result;
+    }
+    
+    // 常態近似，含連續性校正
+    double z = std::max(0.0, std::abs(result.statistic - mu) - 0.5) / std::sqrt(sigma2);
+    result.p_value = std::erfc(z / std::sqrt(2.0));
+    return result;
+}
+
+/*
+* 超幾何分佈取值 x 的對數機率 (不含與 x 無關的常數)
+* \param x 第一組甲基化位點數
+* \param n1 第一組總位點數
+* \param n2 第二組總位點數
+* \param k 甲基化位點總數
+* \return 對數機率 (相差常數)
+*/
+static double hypergeometricLogWeight(double x, double n1, double n2, double k) {
+    return -(std::lgamma(x + 1.0) + std::lgamma(n1 - x + 1.0) +
+             std::lgamma(k - x + 1.0) + std::lgamma(n2 - k + x + 1.0));
+}
+
+/*
+* Fisher 精確檢定
+* \param a 第一組甲基化位點數
+* \param b 第一組非甲基化位點數
+* \param c 第二組甲基化位點數
+* \param d 第二組非甲基化位點數
+* \return 雙尾p值
+*/
+double TwoSampleTests::fisherExact(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    const double n1 = static_cast<double>(a + b);
+    const double n2 = static_cast<double>(c + d);
+    const double k = static_cast<double>(a + c);
+    const double lo = std::max(0.0, k - n2);
+    const double hi = std::min(k, n1);
+    if (lo >= hi) {
+        return 1.0;  // 邊際總和只容許一種表
+    }
+    
+    // 以眾數的機率為1計算相對機率，由眾數向兩側以遞迴比值展開；機率由眾數向兩側單調遞減，
+    // 進入尾端後項值小到不影響尾端總和 (或下溢為0) 時即停止，不需走完整個支撐集
+    const double mode = std::clamp(std::floor((n1 + 1.0) * (k + 1.0) / (n1 + n2 + 2.0)), lo, hi);
+    const double log_mode = hypergeometricLogWeight(mode, n1, n2, k);
+    const double observed = std::exp(hypergeometricLogWeight(static_cast<double>(a), n1, n2, k) - log_mode);
+    const double cutoff = observed * (1.0 + 1e-7);  // 與觀測表機率相同的表 (浮點誤差內) 也計入
+    
+    double total = 1.0;
+    double tail = 1.0 <= cutoff ? 1.0 : 0.0;
+    
+    double term = 1.0;
+    for (double x = mode; x < hi; x += 1.0) {
+        term *= (n1 - x) * (k - x) / ((x + 1.0) * (n2 - k + x + 1.0));
+        total += term;
+        if (term <= cutoff) {
+            tail += term;
+        }
+        if (term == 0.0 || (term <= cutoff && term < tail * 1e-17)) {
+            break;
+        }
+    }
+    term = 1.0;
+    for (double x = mode; x > lo; x -= 1.0) {
+        term *= x * (n2 - k + x) / ((n1 - x + 1.0) * (k - x + 1.0));
+        total += term;
+        if (term <= cutoff) {
+            tail += term;
+        }
+        if (term == 0.0 || (term <= cutoff && term < tail * 1e-17)) {
+            break;
+        }
+    }
+    return std::min(1.0, tail / total);
+}
+
+/*
+* 正規化不完全 beta 函數的連分式 (修正 Lentz 法)
+* \param a 參數 a
+* \param b 參數 b
+* \param x 積分上限
+* \return 連分式值
+*/
+static double incompleteBetaFraction(double a, double b, double x) {
+    static constexpr int kMaxIterations = 10000;  // 收斂所需次數約與 sqrt(max(a, b)) 成正比
+    static constexpr double kEpsilon = 1e-15;
+    static constexpr double kTiny = 1e-300;
+    
+    double qab = a + b;
+    double qap = a + 1.0;
+    double qam = a - 1.0;
+    double c = 1.0;
+    double d = 1.0 - qab * x / qap;
+    if (std::abs(d) < kTiny) d = kTiny;
+    d = 1.0 / d;
+    double h = d;
+    for (int m = 1; m <= kMaxIterations; ++m) {
+        double m2 = 2.0 * m;
+        double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1.0 + aa * d;
+        if (std::abs(d) < kTiny) d = kTiny;
+        c = 1.0 + aa / c;
+        if (std::abs(c) < kTiny) c = kTiny;
+        d = 1.0 / d;
+        h *= d * c;
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1.0 + aa * d;
+        if (std::abs(d) < kTiny) d = kTiny;
+        c = 1.0 + aa / c;
+        if (std::abs(c) < kTiny) c = kTiny;
+        d = 1.0 / d;
+        double delta = d * c;
+        h *= delta;
+        if (std::abs(delta - 1.0) < kEpsilon) {
+            break;
+        }
+    }
+    return h;
+}
+
+/*
+* 正規化不完全 beta 函數
+* \param a 參數 a
+* \param b 參數 b
+* \param x 積分上限
+* \return I_x(a, b)
+*/
+double TwoSampleTests::incompleteBeta(double a, double b, double x) {
+    if (!(x > 0.0)) {
+        return 0.0;
+    }
+    if (!(x < 1.0)) {
+        return 1.0;
+    }
+    
+    double log_front = std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                       a * std::log(x) + b * std::log1p(-x);
+    double front = std::exp(log_front);
+    
+    // 連分式在 x < (a+1)/(a+b+2) 時收斂較快，否則使用對稱關係 I_x(a,b) = 1 - I_{1-x}(b,a)
+    if (x < (a + 1.0) / (a + b + 2.0)) {
+        return front * incompleteBetaFraction(a, b, x) / a;
+    }
+    return 1.0 - front * incompleteBetaFraction(b, a, 1.0 - x) / b;
+}
+
+} // namespace msa::core
@@ -0,0 +1,198 @@
+#include "msa/core/VariantUnion.h"
+#include "msa/utils/LogManager.h"
+#include "msa/utils/MemoryGovernor.h"
+#include <algorithm>
+#include <memory>
+#include <tuple>
+
+// 使用正確的命名空間
+using namespace msa::utils;
+
+namespace msa::core {
+
+// 逐塊溢寫時每個區段累積 Level 1 預算的此比例 (與提取期間的溢寫區段相同)
+static constexpr size_t kSpillRunBudgetDivisor = 8;
+
+/**
+ * @brief VCF來源ID的字典編號
+ * \param vcf_source_id VCF來源ID
+ * \return 字典編號
+ */
+static uint16_t internVcfSource(const std::string& vcf_source_id) {
+    using Dictionary = msa::MethylationSiteTable::Dictionary;
+    return static_cast<uint16_t>(msa::MethylationSiteTable::dictionary(Dictionary::VcfSource).intern(vcf_source_id));
+}
+
+/**
+ * @brief 聯集的去重鍵比較 (與 VcfVariantInfo::operator< 的染色體、位置順序一致)
+ */
+static bool lociLess(const msa::VcfVariantInfo& a, const msa::VcfVariantInfo& b) {
+    return std::tie(a.chrom, a.pos, a.variant_type, a.ref, a.alt) <
+           std::tie(b.chrom, b.pos, b.variant_type, b.ref, b.alt);
+}
+
+/*
+* 建立變異聯集
+* \param per_vcf 每個VCF載入的變異
+* \return 變異聯集
+*/
+VariantUnion VariantUnion::build(const std::vector<std::vector<msa::VcfVariantInfo>>& per_vcf) {
+    VariantUnion result;
+    
+    // (VCF索引, 變異索引) 依去重鍵排序，相同位點相鄰
+    std::vector<std::pair<uint32_t, uint32_t>> order;
+    size_t total = 0;
+    for (const auto& variants : per_vcf) {
+        total += variants.size();
+    }
+    order.reserve(total);
+    for (size_t v = 0; v < per_vcf.size(); ++v) {
+        for (size_t i = 0; i < per_vcf[v].size(); ++i) {
+            order.emplace_back(static_cast<uint32_t>(v), static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(order.begin(), order.end(), [&per_vcf](const auto& a, const auto& b) {
+        const auto& va = per_vcf[a.first][a.second];
+        const auto& vb = per_vcf[b.first][b.second];
+        if (lociLess(va, vb)) return true;
+        if (lociLess(vb, va)) return false;
+        return a < b;
+    });
+    
+    result.vcf_loci_.resize(per_vcf.size());
+    for (size_t v = 0; v < per_vcf.size(); ++v) {
+        result.vcf_loci_[v].resize(per_vcf[v].size());
+    }
+    
+    for (const auto& [v, i] : order) {
+        const auto& variant = per_vcf[v][i];
+        if (result.loci_.empty() || lociLess(result.loci_.back(), variant)) {
+            result.loci_.push_back(variant);
+            result.loci_sources_.emplace_back();
+        }
+        auto& sources = result.loci_sources_.back();
+        if (sources.empty() || sources.back() != v) {
+            sources.push_back(v);
+        }
+        result.vcf_loci_[v][i] = static_cast<uint32_t>(result.loci_.size() - 1);
+    }
+    
+    LOG_INFO("VariantUnion", "VCF聯集: " + std::to_string(total) + " 個變異, " +
+             std::to_string(result.loci_.size()) + " 個唯一位點, " +
+             std::to_string(result.sharedLoci()) + " 個位點由多個VCF共用");
+    
+    return result;
+}
+
+/*
+* 出現於兩個以上VCF的位點數
+* \return 位點數
+*/
+size_t VariantUnion::sharedLoci() const {
+    return static_cast<size_t>(std::count_if(loci_sources_.begin(), loci_sources_.end(),
+                                             [](const auto& sources) { return sources.size() > 1; }));
+}
+
+/*
+* 組出單一VCF的甲基化位點表格
+* \param vcf_index VCF索引
+* \param locus_tables 每個位點的甲基化位點表格
+* \param vcf_source_id VCF來源ID
+* \return 依該VCF變異順序排列的位點表格
+*/
+msa::MethylationSiteTable VariantUnion::fanOut(
+    size_t vcf_index,
+    const std::vector<msa::MethylationSiteTable>& locus_tables,
+    const std::string& vcf_source_id
+) const {
+    uint16_t vcf_source = internVcfSource(vcf_source_id);
+    
+    const auto& loci = vcf_loci_[vcf_index];
+    size_t total_rows = 0;
+    for (uint32_t locus : loci) {
+        total_rows += locus_tables[locus].size();
+    }
+    
+    msa::MethylationSiteTable table;
+    table.reserve(total_rows);
+    for (uint32_t locus : loci) {
+        table.append(locus_tables[locus], vcf_source);
+    }
+    return table;
+}
+
+/*
+* 組出單一VCF的 Level 1 位點，超過 Level 1 預算時逐塊溢寫
+* \param vcf_index VCF索引
+* \param locus_tables 每個位點的甲基化位點表格
+* \param vcf_source_id VCF來源ID
+* \param tmp_dir 溢寫暫存目錄的上層目錄
+* \return 依該VCF變異順序排列的位點
+*/
+msa::Level1Details VariantUnion::fanOutLevel1(
+    size_t vcf_index,
+    const std::vector<msa::MethylationSiteTable>& locus_tables,
+    const std::string& vcf_source_id,
+    const std::string& tmp_dir
+) const {
+    auto& governor = MemoryGovernor::getInstance();
+    const size_t budget = governor.budget(MemoryGovernor::Subsystem::Level1);
+    size_t rows = 0;
+    size_t bytes = 0;
+    for (uint32_t locus : vcf_loci_[vcf_index]) {
+        rows += locus_tables[locus].size();
+        bytes += locus_tables[locus].memoryBytes();
+    }
+    if (budget == 0 || rows == 0 || governor.hasHeadroom(MemoryGovernor::Subsystem::Level1, bytes)) {
+        return msa::Level1Details(fanOut(vcf_index, locus_tables, vcf_source_id));
+    }
+    
+    // 每個區塊約為預算的 1/8 (以位點表格的平均每列位元組數換算)，寫出後立即釋放，記憶體中最多一個區塊
+    const size_t block_rows = std::max<size_t>(1, static_cast<size_t>(
+        static_cast<double>(budget / kSpillRunBudgetDivisor) * static_cast<double>(rows) / static_cast<double>(bytes)));
+    auto spill = std::make_shared<msa::Level1Spill>(tmp_dir);
+    MemoryGovernor::Reservation reservation(MemoryGovernor::Subsystem::Level1);
+    std::vector<msa::MethylationSiteTable> blocks;
+    forEachBlock(vcf_index, locus_tables, vcf_source_id, block_rows, [&](msa::MethylationSiteTable& block) {
+        size_t block_bytes = block.memoryBytes();
+        reservation.add(block_bytes);
+        blocks.push_back(std::move(block));
+        spill->variantsFinished(blocks.size() - 1, blocks.size(), block_bytes);
+        reservation.release(spill->writeRun(blocks));
+    });
+    
+    LOG_INFO("VariantUnion", vcf_source_id + " 的Level 1表格超過記憶體預算，已溢寫: " + std::to_string(spill->rows()) + " 列, " +
+             std::to_string(spill->runs()) + " 個區段, 壓縮後 " + std::to_string(spill->compressedBytes() / (1024 * 1024)) + "MB");
+    return msa::Level1Details(std::shared_ptr<const msa::Level1Spill>(std::move(spill)));
+}
+
+/*
+* 依單一VCF的變異順序逐塊組出位點表格
+* \param vcf_index VCF索引
+* \param locus_tables 每個位點的甲基化位點表格
+* \param vcf_source_id VCF來源ID
+* \param block_rows 每個區塊的目標列數
+* \param fn 處理函數
+*/
+void VariantUnion::forEachBlock(
+    size_t vcf_index,
+    const std::vector<msa::MethylationSiteTable>& locus_tables,
+    const std::string& vcf_source_id,
+    size_t block_rows,
+    const std::function<void(msa::MethylationSiteTable&)>& fn
+) const {
+    uint16_t vcf_source = internVcfSource(vcf_source_id);
+    msa::MethylationSiteTable block;
+    for (uint32_t locus : vcf_loci_[vcf_index]) {
+        block.append(locus_tables[locus], vcf_source);
+        if (block.size() >= block_rows) {
+            fn(block);
+            block.clear();
+        }
+    }
+    if (!block.empty()) {
+        fn(block);
+    }
+}
+
+} // namespace msa::core
@@ -0,0 +1,100 @@
+#include "msa/utils/HtsThreadPool.h"
+#include "msa/utils/LogManager.h"
+
+namespace msa::utils {
+
+/**
+ * @brief 單例實例獲取
+ * \return 執行緒池實例
+ */
+HtsThreadPool& HtsThreadPool::getInstance() {
+    static HtsThreadPool instance;
+    return instance;
+}
+
+/**
+ * @brief 建構函數
+ */
+HtsThreadPool::HtsThreadPool() : pool_{nullptr, 0}, numThreads_(0) {
+}
+
+/**
+ * @brief 解構函數
+ */
+HtsThreadPool::~HtsThreadPool() {
+    shutdown();
+}
+
+/**
+ * @brief 建立執行緒池
+ * \param numThreads 解壓縮執行緒數
+ * \return 是否成功
+ */
+bool HtsThreadPool::initialize(int numThreads) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (pool_.pool) {
+        LOG_WARN("HtsThreadPool", "htslib執行緒池已初始化，忽略重複初始化");
+        return true;
+    }
+    
+    if (numThreads <= 0) {
+        LOG_INFO("HtsThreadPool", "未啟用htslib解壓縮執行緒池");
+        return true;
+    }
+    
+    pool_.pool = hts_tpool_init(numThreads);
+    pool_.qsize = 0;  // 使用htslib預設佇列長度
+    if (!pool_.pool) {
+        LOG_ERROR("HtsThreadPool", "無法建立htslib執行緒池，執行緒數: " + std::to_string(numThreads));
+        return false;
+    }
+    
+    numThreads_ = numThreads;
+    LOG_INFO("HtsThreadPool", "htslib解壓縮執行緒池已建立，執行緒數: " + std::to_string(numThreads));
+    return true;
+}
+
+/**
+ * @brief 將htsFile掛載到共用執行緒池
+ * \param fp htsFile指針
+ * \return 是否已掛載
+ */
+bool HtsThreadPool::attach(htsFile* fp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (!fp || !pool_.pool) {
+        return false;
+    }
+    
+    if (hts_set_thread_pool(fp, &pool_) != 0) {
+        LOG_WARN("HtsThreadPool", "無法將檔案掛載到htslib執行緒池，改用單執行緒解壓縮");
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * @brief 銷毀執行緒池
+ */
+void HtsThreadPool::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (pool_.pool) {
+        hts_tpool_destroy(pool_.pool);
+        pool_.pool = nullptr;
+        numThreads_ = 0;
+    }
+}
+
+/**
+ * @brief 獲取執行緒池大小
+ * \return 執行緒數
+ */
+int HtsThreadPool::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numThreads_;
+}
+
+} // namespace msa::utils
@@ -0,0 +1,224 @@
+#include "msa/utils/MemoryGovernor.h"
+#include "msa/utils/LogManager.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace msa::utils {
+
+// 背壓等待時重新檢查用量的間隔 (用量以寬鬆的原子操作更新，喚醒可能早於等待者看到新值)
+static constexpr std::chrono::milliseconds kWaitRecheckInterval(10);
+
+/**
+ * @brief 以比較交換更新峰值
+ * \param peak 峰值
+ * \param value 目前值
+ */
+template <typename T>
+static void updatePeak(std::atomic<T>& peak, T value) {
+    T current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief 位元組數換算為MB
+ * \param bytes 位元組數
+ * \return MB
+ */
+static long long toMB(long long bytes) {
+    return std::max(0LL, bytes) / (1024 * 1024);
+}
+
+/**
+ * @brief 登記用量
+ * \param bytes 位元組數
+ */
+void MemoryGovernor::Reservation::add(size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    updatePeak(peak_, bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    MemoryGovernor::getInstance().charge(subsystem_, static_cast<long long>(bytes));
+}
+
+/**
+ * @brief 釋放用量
+ * \param bytes 位元組數
+ */
+void MemoryGovernor::Reservation::release(size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    MemoryGovernor::getInstance().charge(subsystem_, -static_cast<long long>(bytes));
+}
+
+/**
+ * @brief 登記用量，超過預算時阻塞
+ * \param bytes 位元組數
+ */
+void MemoryGovernor::Reservation::acquire(size_t bytes) {
+    MemoryGovernor::getInstance().acquire(*this, bytes);
+}
+
+/**
+ * @brief 將用量調整為指定值
+ * \param bytes 位元組數
+ */
+void MemoryGovernor::Reservation::set(size_t bytes) {
+    // 以比較交換取代，子系統只增減本次實際替換掉的用量；同時進行的 add/release 各自回報其差額，
+    // 總用量不會因交錯而重複或遺漏
+    size_t previous = bytes_.load(std::memory_order_relaxed);
+    while (previous != bytes && !bytes_.compare_exchange_weak(previous, bytes, std::memory_order_relaxed)) {
+    }
+    if (previous == bytes) {
+        return;
+    }
+    updatePeak(peak_, bytes);
+    MemoryGovernor::getInstance().charge(subsystem_, static_cast<long long>(bytes) - static_cast<long long>(previous));
+}
+
+/**
+ * @brief 獲取MemoryGovernor單例實例
+ * \return MemoryGovernor單例引用
+ */
+MemoryGovernor& MemoryGovernor::getInstance() {
+    static MemoryGovernor instance;
+    return instance;
+}
+
+/**
+ * @brief 分配各子系統預算
+ * \param limitBytes 總上限
+ * \param readCacheBytes 讀段解析快取容量
+ */
+void MemoryGovernor::configure(size_t limitBytes, size_t readCacheBytes) {
+    limit_ = limitBytes;
+    budgets_[static_cast<int>(Subsystem::BamPool)] = limitBytes / 8;
+    budgets_[static_cast<int>(Subsystem::ReadBatches)] = limitBytes / 4;
+    budgets_[static_cast<int>(Subsystem::ReadCache)] = readCacheBytes;
+    
+    // 其餘為Level 1表格 (快取容量設定過大時仍保留總上限的1/8)
+    size_t reserved = limitBytes / 8 + limitBytes / 4 + readCacheBytes;
+    budgets_[static_cast<int>(Subsystem::Level1)] = std::max(limitBytes / 8, limitBytes > reserved ? limitBytes - reserved : 0);
+    
+    std::ostringstream ss;
+    ss << "記憶體預算: 上限=" << toMB(limitBytes) << "MB";
+    for (int s = 0; s < kSubsystems; ++s) {
+        ss << ", " << subsystemName(static_cast<Subsystem>(s)) << "=" << toMB(budgets_[s]) << "MB";
+    }
+    LOG_INFO("MemoryGovernor", ss.str());
+}
+
+/**
+ * @brief 子系統是否還能容納指定位元組數
+ * \param subsystem 子系統
+ * \param bytes 位元組數
+ * \return 是否能容納
+ */
+bool MemoryGovernor::hasHeadroom(Subsystem subsystem, size_t bytes) const {
+    size_t limit = budget(subsystem);
+    return limit == 0 || usage(subsystem) + bytes <= limit;
+}
+
+/**
+ * @brief 增減子系統用量
+ * \param subsystem 子系統
+ * \param delta 位元組差額
+ */
+void MemoryGovernor::charge(Subsystem subsystem, long long delta) {
+    int s = static_cast<int>(subsystem);
+    long long now = usage_[s].fetch_add(delta, std::memory_order_relaxed) + delta;
+    long long total = total_.fetch_add(delta, std::memory_order_relaxed) + delta;
+    if (delta > 0) {
+        updatePeak(peak_[s], now);
+        updatePeak(total_peak_, total);
+    } else if (waiters_.load() > 0) {
+        // 持有鎖後再通知，避免等待者在檢查條件與進入等待之間錯過喚醒
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        released_cv_.notify_all();
+    }
+}
+
+/**
+ * @brief 為登記增加用量，超過預算時阻塞
+ * \param reservation 登記
+ * \param bytes 位元組數
+ */
+void MemoryGovernor::acquire(Reservation& reservation, size_t bytes) {
+    Subsystem subsystem = reservation.subsystem_;
+    if (reservation.bytes() > 0 && !hasHeadroom(subsystem, bytes)) {
+        auto start = std::chrono::steady_clock::now();
+        waits_.fetch_add(1, std::memory_order_relaxed);
+        waiters_.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            while (!released_cv_.wait_for(lock, kWaitRecheckInterval, [&]() {
+                return reservation.bytes() == 0 || hasHeadroom(subsystem, bytes);
+            })) {
+            }
+        }
+        waiters_.fetch_sub(1);
+        wait_micros_.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+    }
+    reservation.add(bytes);
+}
+
+/**
+ * @brief 目前程序的常駐記憶體
+ * \return 位元組數，無法取得時為0
+ */
+size_t MemoryGovernor::residentBytes() {
+#if defined(__linux__)
+    // /proc/self/statm 第二欄為常駐頁數
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0, resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) {
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief 子系統名稱
+ * \param subsystem 子系統
+ * \return 名稱
+ */
+const char* MemoryGovernor::subsystemName(Subsystem subsystem) {
+    switch (subsystem) {
+        case Subsystem::BamPool: return "記憶體池";
+        case Subsystem::ReadBatches: return "讀段批次";
+        case Subsystem::Level1: return "Level1表格";
+        case Subsystem::ReadCache: return "讀段快取";
+        default: return "未知";
+    }
+}
+
+/**
+ * @brief 獲取記憶體統計資訊
+ * \return 統計信息字串
+ */
+std::string MemoryGovernor::getStats() const {
+    std::ostringstream ss;
+    ss << "MemoryGovernor狀態: 上限=" << toMB(limit_) << "MB"
+       << ", 登記峰值=" << toMB(total_peak_.load(std::memory_order_relaxed)) << "MB"
+       << ", 常駐=" << toMB(residentBytes()) << "MB"
+       << ", 背壓等待=" << waits_.load(std::memory_order_relaxed) << "次/"
+       << wait_micros_.load(std::memory_order_relaxed) / 1000 << "ms";
+    for (int s = 0; s < kSubsystems; ++s) {
+        ss << ", " << subsystemName(static_cast<Subsystem>(s)) << " 目前/峰值/預算="
+           << toMB(usage_[s].load(std::memory_order_relaxed)) << "/"
+           << toMB(peak_[s].load(std::memory_order_relaxed)) << "/"
+           << toMB(budgets_[s]) << "MB";
+    }
+    return ss.str();
+}
+
+} // namespace msa::utils
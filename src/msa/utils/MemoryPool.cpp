@@ -1,16 +1,42 @@
 #include "msa/utils/MemoryPool.h"
 #include "msa/utils/LogManager.h"
+#include "msa/utils/MemoryGovernor.h"
+#include "msa/utils/TaskScheduler.h"
 #include <sstream>
+#include <chrono>
+#include <algorithm>
+
+namespace msa::utils {
+
+// 執行緒彈匣與全域倉庫交換的批次大小；彈匣最多保留兩批物件
+static constexpr size_t kMagazineSize = 32;
+
+// 全域倉庫可存放的批次數 (超過時多餘的物件直接銷毀)
+static constexpr size_t kDepotCapacity = 1 << 15;
+
+// 執行緒累積的位元組差額達到此值才回報全域統計，避免每次借還都寫入共享計數器
+static constexpr long long kBytesPublishThreshold = 1 << 20;
+
+// 阻塞等待時重新檢查倉庫的間隔 (其他執行緒的彈匣可能仍持有閒置物件)
+static constexpr std::chrono::milliseconds kWaitRecheckInterval(10);
 
 /**
- * @brief 使用預處理器檢查是否編譯時啟用了OpenMP
- * \return 如果編譯時啟用了OpenMP則返回true，否則返回false
+ * @brief 執行緒本地彈匣：只有擁有者執行緒會修改物件列表，統計欄位以原子變數供其他執行緒讀取
  */
-#ifdef HAVE_OPENMP
-#include <omp.h>
-#endif
-
-namespace msa::utils {
+struct MemoryPool::ThreadCache {
+    std::vector<bam1_t*> items;            // 閒置物件 (後進先出，較熱的物件優先重用)
+    std::atomic<size_t> cached{0};         // 物件數 (供統計)
+    std::atomic<long long> inUse{0};       // 本執行緒借出減歸還的差額 (供統計)
+    long long pendingBytes = 0;            // 尚未回報的保留位元組差額
+    bool registered = false;               // 是否已登記於記憶體池
+    
+    ~ThreadCache() {
+        // 執行緒結束時將物件交回全域倉庫
+        if (registered) {
+            MemoryPool::getInstance().retireThreadCache(*this);
+        }
+    }
+};
 
 /**
  * @brief 單例實例獲取
@@ -24,7 +50,9 @@ MemoryPool& MemoryPool::getInstance() {
 /**
  * @brief 建構函數
  */
-MemoryPool::MemoryPool() : maxCapacity_(0), totalAllocated_(0), currentlyInUse_(0), initialized_(false) {
+MemoryPool::MemoryPool() : depot_(kDepotCapacity), maxCapacity_(0), totalAllocated_(0) {
+    // 先建立記憶體預算單例，使其晚於記憶體池解構 (解構時仍需回報釋放的位元組)
+    MemoryGovernor::getInstance();
 }
 
 /**
@@ -49,16 +77,34 @@ void MemoryPool::initialize(size_t initialCapacity, size_t maxCapacity) {
     
     maxCapacity_ = maxCapacity;
     
-    // 預先分配指定數量的bam1_t物件
-    for (size_t i = 0; i < initialCapacity; ++i) {
-        availableBam1ts_.push(createNewBam1());
-        totalAllocated_++;
+    // 預先分配指定數量的bam1_t物件，整批放入全域倉庫
+    size_t remaining = initialCapacity;
+    while (remaining > 0) {
+        size_t count = std::min(remaining, kMagazineSize);
+        Magazine* magazine = new Magazine();
+        magazine->items.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            magazine->items.push_back(createNewBam1());
+        }
+        totalAllocated_ += count;
+        remaining -= count;
+        
+        if (depot_.tryPush(magazine)) {
+            depotObjects_ += count;
+        } else {
+            for (auto* b : magazine->items) {
+                bam_destroy1(b);
+            }
+            totalAllocated_ -= count;
+            delete magazine;
+            break;
+        }
     }
     
     initialized_ = true;
     
     std::ostringstream ss;
-    ss << "記憶體池已初始化: 初始容量=" << initialCapacity 
+    ss << "記憶體池已初始化: 初始容量=" << initialCapacity
        << ", 最大容量=" << (maxCapacity == 0 ? "無限制" : std::to_string(maxCapacity));
     LOG_INFO("MemoryPool", ss.str());
 }
@@ -75,106 +121,209 @@ bam1_t* MemoryPool::createNewBam1() {
     return b;
 }
 
+/**
+ * @brief 獲取目前執行緒的彈匣
+ * \return 執行緒本地彈匣
+ */
+MemoryPool::ThreadCache& MemoryPool::localCache() {
+    thread_local ThreadCache cache;
+    
+    if (!cache.registered) {
+        cache.items.reserve(2 * kMagazineSize);
+        
+        std::lock_guard<std::mutex> lock(thread_cache_mutex_);
+        thread_caches_.push_back(&cache);
+        cache.registered = true;
+        
+        LOG_DEBUG("MemoryPool", "為執行緒 " + std::to_string(TaskScheduler::workerIndex()) + " 建立本地彈匣");
+    }
+    
+    return cache;
+}
+
+/**
+ * @brief 執行緒結束時交回彈匣內物件
+ * \param cache 執行緒本地彈匣
+ */
+void MemoryPool::retireThreadCache(ThreadCache& cache) {
+    flushToDepot(cache, cache.items.size());
+    publishBytes(cache, true);
+    
+    std::lock_guard<std::mutex> lock(thread_cache_mutex_);
+    retiredInUse_ += cache.inUse.load(std::memory_order_relaxed);
+    cache.inUse.store(0, std::memory_order_relaxed);
+    thread_caches_.erase(std::remove(thread_caches_.begin(), thread_caches_.end(), &cache), thread_caches_.end());
+    cache.registered = false;
+}
+
+/**
+ * @brief 將彈匣中最舊的一批物件移入全域倉庫
+ * \param cache 執行緒本地彈匣
+ * \param count 移動的物件數
+ */
+void MemoryPool::flushToDepot(ThreadCache& cache, size_t count) {
+    count = std::min(count, cache.items.size());
+    if (count == 0) {
+        return;
+    }
+    
+    // 最舊的物件位於列表前端，較熱的物件留在本執行緒
+    Magazine* magazine = new Magazine();
+    magazine->items.assign(cache.items.begin(), cache.items.begin() + count);
+    cache.items.erase(cache.items.begin(), cache.items.begin() + count);
+    cache.cached.store(cache.items.size(), std::memory_order_relaxed);
+    
+    if (depot_.tryPush(magazine)) {
+        depotObjects_ += count;
+        return;
+    }
+    
+    // 倉庫已滿，直接銷毀這批物件
+    for (auto* b : magazine->items) {
+        cache.pendingBytes -= b->m_data;
+        bam_destroy1(b);
+    }
+    totalAllocated_ -= count;
+    delete magazine;
+}
+
+/**
+ * @brief 從全域倉庫取回一批物件
+ * \param cache 執行緒本地彈匣
+ * \return 是否取得物件
+ */
+bool MemoryPool::refillFromDepot(ThreadCache& cache) {
+    Magazine* magazine = nullptr;
+    if (!depot_.tryPop(magazine)) {
+        return false;
+    }
+    
+    depotObjects_ -= magazine->items.size();
+    cache.items.insert(cache.items.end(), magazine->items.begin(), magazine->items.end());
+    cache.cached.store(cache.items.size(), std::memory_order_relaxed);
+    delete magazine;
+    return true;
+}
+
 /**
  * @brief 獲取一個bam1_t物件
  * \param waitIfEmpty 如果池中沒有可用物件，是否等待
  * \return 獲取的bam1_t物件
  */
 bam1_t* MemoryPool::getBam1(bool waitIfEmpty) {
-    // 先嘗試從執行緒本地緩存獲取
-    auto& localCache = getThreadLocalCache();
-    if (!localCache.empty()) {
-        bam1_t* result = localCache.back();
-        localCache.pop_back();
-        
-        // 重置bam1_t物件的內容，確保沒有殘留數據
-        if (result->data) {
-            free(result->data);
-            result->data = NULL;
-        }
-        result->l_data = 0;
-        result->m_data = 0;
-        result->core.pos = -1;
-        result->core.mpos = -1;
-        result->core.mtid = -1;
-        result->core.tid = -1;
-        result->core.flag = 0;
-        result->core.n_cigar = 0;
-        result->core.l_qname = 0;
-        result->core.isize = 0;
-        result->core.bin = 0;
-        result->core.qual = 0;
-        
-        return result;
+    if (!initialized_.load(std::memory_order_acquire)) {
+        // 如果尚未初始化，則自動初始化
+        initialize();
     }
     
-    // 如果本地緩存為空，則從全域池獲取
-    bam1_t* result = nullptr;
+    // 先從執行緒本地彈匣獲取，彈匣為空時整批向全域倉庫補充
+    ThreadCache& cache = localCache();
+    if (cache.items.empty()) {
+        refillFromDepot(cache);
+    }
     
-    {
+    bam1_t* result = nullptr;
+    if (!cache.items.empty()) {
+        result = cache.items.back();
+        cache.items.pop_back();
+    } else if (waitIfEmpty && maxCapacity_ > 0 && totalAllocated_ >= maxCapacity_) {
+        // 已達最大容量限制，等待直到其他執行緒歸還物件
         std::unique_lock<std::mutex> lock(mutex_);
-        
-        if (!initialized_) {
-            // 如果尚未初始化，則自動初始化
-            lock.unlock();
-            initialize();
-            lock.lock();
-        }
-        
-        if (waitIfEmpty && availableBam1ts_.empty()) {
-            // 如果設置為等待並且池中沒有可用物件，則阻塞直到有物件返回
-            if (maxCapacity_ > 0 && totalAllocated_ >= maxCapacity_) {
-                // 如果已達最大容量限制，等待直到有物件返回
-                availableCondition_.wait(lock, [this]() {
-                    return !availableBam1ts_.empty();
-                });
-            } else {
-                // 如果未達最大容量，則建立新物件並返回
-                result = createNewBam1();
-                totalAllocated_++;
-            }
+        waiters_++;
+        while (!refillFromDepot(cache)) {
+            availableCondition_.wait_for(lock, kWaitRecheckInterval);
         }
-        
-        if (!result) {  // 如果尚未創建新物件
-            if (!availableBam1ts_.empty()) {
-                // 從池中取出一個可用物件
-                result = availableBam1ts_.front();
-                availableBam1ts_.pop();
-            } else {
-                // 如果池為空，且未設置等待，則建立新物件
-                result = createNewBam1();
-                totalAllocated_++;
-            }
-        }
-        
-        // 更新使用計數
-        currentlyInUse_++;
+        waiters_--;
+        result = cache.items.back();
+        cache.items.pop_back();
+    } else {
+        // 池為空且未達上限 (或不等待)，則建立新物件
+        result = createNewBam1();
+        totalAllocated_++;
     }
     
+    cache.cached.store(cache.items.size(), std::memory_order_relaxed);
+    cache.inUse.store(cache.inUse.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    
     // 重置bam1_t物件的內容，確保沒有殘留數據
-    if (result) {
-        // 使用正確的htslib函數來重置，避免使用被棄用的函數
-        if (result->data) {
-            free(result->data);
-            result->data = NULL;
-        }
-        result->l_data = 0;
-        result->m_data = 0;
-        result->core.pos = -1;
-        result->core.mpos = -1;
-        result->core.mtid = -1;
-        result->core.tid = -1;
-        result->core.flag = 0;
-        result->core.n_cigar = 0;
-        result->core.l_qname = 0;
-        result->core.isize = 0;
-        result->core.bin = 0;
-        result->core.qual = 0;
-    }
+    prepareBam1(cache, result);
     
     return result;
 }
 
+/**
+ * @brief 重置借出物件並保留其資料緩衝區
+ * \param cache 執行緒本地彈匣
+ * \param b bam1_t物件
+ */
+void MemoryPool::prepareBam1(ThreadCache& cache, bam1_t* b) {
+    // 物件離開閒置狀態，其緩衝區不再計入保留位元組
+    cache.pendingBytes -= b->m_data;
+    publishBytes(cache, false);
+    
+    // 保留緩衝區 (只清除長度)，讓 sam_itr_next 直接覆寫，讀段較大時才由 sam_itr_next 自行擴充；
+    // 不預先擴充到其他讀段的大小 (借出期間的緩衝區由讀段批次以實際大小登記)
+    b->l_data = 0;
+    b->core.pos = -1;
+    b->core.mpos = -1;
+    b->core.mtid = -1;
+    b->core.tid = -1;
+    b->core.flag = 0;
+    b->core.n_cigar = 0;
+    b->core.l_qname = 0;
+    b->core.l_qseq = 0;
+    b->core.isize = 0;
+    b->core.bin = 0;
+    b->core.qual = 0;
+}
+
+/**
+ * @brief 記錄歸還物件的緩衝區並套用保留上限
+ * \param cache 執行緒本地彈匣
+ * \param b bam1_t物件
+ */
+void MemoryPool::retainBuffer(ThreadCache& cache, bam1_t* b) {
+    // 超過保留上限時釋放緩衝區，只保留物件本身
+    long long retained = retainedBytes_.load(std::memory_order_relaxed) + cache.pendingBytes;
+    if (retainedBytesLimit_ > 0 && retained + static_cast<long long>(b->m_data) > static_cast<long long>(retainedBytesLimit_)) {
+        free(b->data);
+        b->data = NULL;
+        b->m_data = 0;
+        b->l_data = 0;
+        trimmedBuffers_++;
+        return;
+    }
+    
+    cache.pendingBytes += b->m_data;
+    publishBytes(cache, false);
+}
+
+/**
+ * @brief 回報執行緒累積的位元組差額
+ * \param cache 執行緒本地彈匣
+ * \param force 是否強制回報
+ */
+void MemoryPool::publishBytes(ThreadCache& cache, bool force) {
+    if (force || cache.pendingBytes >= kBytesPublishThreshold || cache.pendingBytes <= -kBytesPublishThreshold) {
+        retainedBytes_ += cache.pendingBytes;
+        MemoryGovernor::getInstance().charge(MemoryGovernor::Subsystem::BamPool, cache.pendingBytes);
+        cache.pendingBytes = 0;
+    }
+}
+
+/**
+ * @brief 設定閒置緩衝區保留上限
+ * \param maxBytes 位元組上限，0表示無限制
+ */
+void MemoryPool::setRetainedBytesLimit(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retainedBytesLimit_ = maxBytes;
+    
+    std::ostringstream ss;
+    ss << "記憶體池緩衝區保留上限: " << (maxBytes == 0 ? "無限制" : std::to_string(maxBytes / (1024 * 1024)) + "MB");
+    LOG_INFO("MemoryPool", ss.str());
+}
+
 /**
  * @brief 返回一個bam1_t物件到池中
  * \param b 返回的bam1_t物件
@@ -182,65 +331,39 @@ bam1_t* MemoryPool::getBam1(bool waitIfEmpty) {
 void MemoryPool::returnBam1(bam1_t* b) {
     if (!b) return;
     
-    // 先嘗試返回到執行緒本地緩存
-    auto& localCache = getThreadLocalCache();
-    if (localCache.size() < 50) {  // 本地緩存有上限
-        localCache.push_back(b);
-        return;
+    // 歸還到執行緒本地彈匣，彈匣滿兩批時將較舊的一批移入全域倉庫
+    ThreadCache& cache = localCache();
+    retainBuffer(cache, b);
+    cache.inUse.store(cache.inUse.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    cache.items.push_back(b);
+    cache.cached.store(cache.items.size(), std::memory_order_relaxed);
+    
+    if (cache.items.size() >= 2 * kMagazineSize) {
+        flushToDepot(cache, kMagazineSize);
     }
     
-    // 如果本地緩存已滿，則返回到全域池
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        // 將物件加入可用隊列
-        availableBam1ts_.push(b);
-        
-        // 更新使用計數
-        if (currentlyInUse_ > 0) {
-            currentlyInUse_--;
+    // 有執行緒阻塞等待時，交出全部閒置物件並通知
+    if (waiters_.load(std::memory_order_relaxed) > 0) {
+        flushToDepot(cache, cache.items.size());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
         }
+        availableCondition_.notify_all();
     }
-    
-    // 通知等待中的執行緒
-    availableCondition_.notify_one();
 }
 
 /**
- * @brief 獲取執行緒本地的bam1_t緩存
- * \param capacity 緩存容量
- * \return 執行緒本地的bam1_t緩存
+ * @brief 將目前執行緒彈匣內的閒置物件交回全域倉庫
  */
-std::vector<bam1_t*>& MemoryPool::getThreadLocalCache(size_t capacity) {
-    // 使用執行緒ID作為索引
-    std::thread::id threadId = std::this_thread::get_id();
+void MemoryPool::flushThreadCache() {
+    ThreadCache& cache = localCache();
+    flushToDepot(cache, cache.items.size());
     
-    {
-        std::lock_guard<std::mutex> lock(thread_cache_mutex_);
-        
-        // 如果此執行緒尚未有緩存，則創建一個
-        if (thread_caches_.find(threadId) == thread_caches_.end()) {
-            thread_caches_[threadId] = std::vector<bam1_t*>();
-            thread_caches_[threadId].reserve(capacity);
-            
-            // 預填充部分bam1_t物件
-            for (size_t i = 0; i < capacity / 2; ++i) {
-                bam1_t* b = createNewBam1();
-                thread_caches_[threadId].push_back(b);
-                
-                // 更新全域計數
-                totalAllocated_++;
-                currentlyInUse_++;
-            }
-            
-#ifdef HAVE_OPENMP
-            LOG_DEBUG("MemoryPool", "為執行緒 " + std::to_string(omp_get_thread_num()) + " 創建本地緩存，預分配 " + std::to_string(capacity / 2) + " 個物件");
-#else
-            LOG_DEBUG("MemoryPool", "為執行緒創建本地緩存，預分配 " + std::to_string(capacity / 2) + " 個物件");
-#endif
+    if (waiters_.load(std::memory_order_relaxed) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
         }
-        
-        return thread_caches_[threadId];
+        availableCondition_.notify_all();
     }
 }
 
@@ -248,38 +371,45 @@ std::vector<bam1_t*>& MemoryPool::getThreadLocalCache(size_t capacity) {
  * @brief 釋放所有記憶體池中的物件
  */
 void MemoryPool::releaseAll() {
-    // 先釋放所有執行緒本地緩存
+    long long inUse = retiredInUse_.load();
+    
+    // 先釋放所有執行緒本地彈匣 (須在所有工作執行緒閒置後呼叫)
     {
         std::lock_guard<std::mutex> lock(thread_cache_mutex_);
-        for (auto& [_, cache] : thread_caches_) {
-            for (auto* b : cache) {
+        for (auto* cache : thread_caches_) {
+            for (auto* b : cache->items) {
                 bam_destroy1(b);
             }
-            cache.clear();
+            cache->items.clear();
+            cache->cached.store(0);
+            cache->pendingBytes = 0;
+            inUse += cache->inUse.exchange(0);
         }
-        thread_caches_.clear();
     }
     
-    // 再釋放全域緩存
+    // 再釋放全域倉庫
     std::lock_guard<std::mutex> lock(mutex_);
     
-    // 釋放所有可用物件
-    while (!availableBam1ts_.empty()) {
-        bam1_t* b = availableBam1ts_.front();
-        availableBam1ts_.pop();
-        bam_destroy1(b);
+    Magazine* magazine = nullptr;
+    while (depot_.tryPop(magazine)) {
+        for (auto* b : magazine->items) {
+            bam_destroy1(b);
+        }
+        delete magazine;
     }
     
     // 輸出警告，如果仍有物件未返回
-    if (currentlyInUse_ > 0) {
+    if (inUse > 0) {
         std::ostringstream ss;
-        ss << "記憶體池釋放時仍有 " << currentlyInUse_ << " 個物件未返回，可能導致記憶體洩漏";
+        ss << "記憶體池釋放時仍有 " << inUse << " 個物件未返回，可能導致記憶體洩漏";
         LOG_WARN("MemoryPool", ss.str());
     }
     
     // 重置計數
     totalAllocated_ = 0;
-    currentlyInUse_ = 0;
+    depotObjects_ = 0;
+    retiredInUse_ = 0;
+    MemoryGovernor::getInstance().charge(MemoryGovernor::Subsystem::BamPool, -retainedBytes_.exchange(0));
     initialized_ = false;
     
     LOG_INFO("MemoryPool", "記憶體池已釋放所有物件");
@@ -290,16 +420,12 @@ void MemoryPool::releaseAll() {
  * \return 池中物件數量
  */
 size_t MemoryPool::size() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    size_t totalSize = availableBam1ts_.size();
+    size_t totalSize = depotObjects_.load();
     
-    // 加上所有執行緒本地緩存中的物件數量
-    {
-        std::lock_guard<std::mutex> cacheLock(thread_cache_mutex_);
-        for (const auto& [_, cache] : thread_caches_) {
-            totalSize += cache.size();
-        }
+    // 加上所有執行緒本地彈匣中的物件數量
+    std::lock_guard<std::mutex> lock(thread_cache_mutex_);
+    for (const auto* cache : thread_caches_) {
+        totalSize += cache->cached.load(std::memory_order_relaxed);
     }
     
     return totalSize;
@@ -310,29 +436,32 @@ size_t MemoryPool::size() const {
  * \return 統計資訊字串
  */
 std::string MemoryPool::getStats() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    // 計算執行緒本地緩存的統計
+    // 計算執行緒本地彈匣的統計
     size_t threadCacheCount = 0;
     size_t threadCacheSize = 0;
+    long long inUse = retiredInUse_.load();
     
     {
-        std::lock_guard<std::mutex> cacheLock(thread_cache_mutex_);
+        std::lock_guard<std::mutex> lock(thread_cache_mutex_);
         threadCacheCount = thread_caches_.size();
-        for (const auto& [_, cache] : thread_caches_) {
-            threadCacheSize += cache.size();
+        for (const auto* cache : thread_caches_) {
+            threadCacheSize += cache->cached.load(std::memory_order_relaxed);
+            inUse += cache->inUse.load(std::memory_order_relaxed);
         }
     }
     
     std::ostringstream ss;
-    ss << "MemoryPool狀態: 總分配=" << totalAllocated_ 
-       << ", 使用中=" << currentlyInUse_
-       << ", 全域可用=" << availableBam1ts_.size()
+    ss << "MemoryPool狀態: 總分配=" << totalAllocated_
+       << ", 使用中=" << std::max(0LL, inUse)
+       << ", 全域可用=" << depotObjects_.load()
        << ", 執行緒緩存數=" << threadCacheCount
        << ", 執行緒緩存物件總數=" << threadCacheSize
-       << ", 最大容量=" << (maxCapacity_ == 0 ? "無限制" : std::to_string(maxCapacity_));
+       << ", 最大容量=" << (maxCapacity_ == 0 ? "無限制" : std::to_string(maxCapacity_))
+       << ", 保留緩衝區=" << (std::max(0LL, retainedBytes_.load()) / 1024) << "KB"
+       << ", 保留上限=" << (retainedBytesLimit_ == 0 ? "無限制" : std::to_string(retainedBytesLimit_ / (1024 * 1024)) + "MB")
+       << ", 已釋放緩衝區=" << trimmedBuffers_.load();
     
     return ss.str();
 }
 
-} // namespace msa::utils 
\ No newline at end of file
+} // namespace msa::utils
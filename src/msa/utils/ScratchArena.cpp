@@ -0,0 +1,86 @@
+#include "msa/utils/ScratchArena.h"
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+namespace msa::utils {
+
+/**
+ * @brief 建構函數
+ * \param blockSize 初始區塊大小
+ */
+ScratchArena::ScratchArena(size_t blockSize)
+    : blockSize_(std::max<size_t>(blockSize, 4096)) {
+    addBlock(blockSize_);
+}
+
+/**
+ * @brief 解構函數
+ */
+ScratchArena::~ScratchArena() {
+    for (auto& block : blocks_) {
+        std::free(block.data);
+    }
+}
+
+/**
+ * @brief 新增區塊
+ * \param minBytes 最小位元組數
+ */
+void ScratchArena::addBlock(size_t minBytes) {
+    size_t size = std::max(minBytes, blockSize_);
+    char* data = static_cast<char*>(std::malloc(size));
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    blocks_.push_back({data, size});
+}
+
+/**
+ * @brief 配置記憶體
+ * \param bytes 位元組數
+ * \param alignment 對齊
+ * \return 配置的記憶體
+ */
+void* ScratchArena::allocate(size_t bytes, size_t alignment) {
+    while (true) {
+        Block& block = blocks_[current_];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+        uintptr_t aligned = (base + offset_ + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        size_t start = static_cast<size_t>(aligned - base);
+
+        if (start + bytes <= block.size) {
+            offset_ = start + bytes;
+            used_ += bytes;
+            peak_ = std::max(peak_, used_);
+            return block.data + start;
+        }
+
+        // 目前區塊不足，配置新區塊 (大小至少為請求量)；reset() 前舊區塊保持有效
+        addBlock(bytes + alignment);
+        current_ = blocks_.size() - 1;
+        offset_ = 0;
+    }
+}
+
+/**
+ * @brief 回收所有配置
+ */
+void ScratchArena::reset() {
+    // 曾溢出到多個區塊時合併為單一區塊，之後同樣大小的工作不再需要配置
+    if (blocks_.size() > 1) {
+        size_t total = 0;
+        for (auto& block : blocks_) {
+            total += block.size;
+            std::free(block.data);
+        }
+        blocks_.clear();
+        addBlock(total);
+    }
+
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+} // namespace msa::utils
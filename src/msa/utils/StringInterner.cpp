@@ -0,0 +1,75 @@
+#include "msa/utils/StringInterner.h"
+#include <mutex>
+#include <stdexcept>
+
+namespace msa::utils {
+
+/**
+ * @brief 建構函數
+ * \param maxIds ID數量上限
+ */
+StringInterner::StringInterner(uint32_t maxIds)
+    : maxIds_(maxIds) {
+}
+
+/**
+ * @brief 取得字串的ID，不存在時新增
+ * \param value 字串
+ * \return 字串ID
+ */
+uint32_t StringInterner::intern(std::string_view value) {
+    {
+        // 常見情況：字串已存在，只需共享鎖
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = ids_.find(value);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // 取得獨佔鎖前可能已被其他執行緒加入
+    auto it = ids_.find(value);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    
+    if (strings_.size() >= maxIds_) {
+        throw std::overflow_error("字串字典已達上限 " + std::to_string(maxIds_) + " 個項目，無法加入: " + std::string(value));
+    }
+    
+    uint32_t id = static_cast<uint32_t>(strings_.size());
+    strings_.emplace_back(value);
+    ids_.emplace(std::string_view(strings_.back()), id);
+    return id;
+}
+
+/**
+ * @brief 依ID取得字串
+ * \param id 字串ID
+ * \return 字串
+ */
+const std::string& StringInterner::lookup(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return strings_.at(id);
+}
+
+/**
+ * @brief 複製目前所有字串
+ * \return 字串列表
+ */
+std::vector<std::string> StringInterner::snapshot() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return std::vector<std::string>(strings_.begin(), strings_.end());
+}
+
+/**
+ * @brief 獲取已配置的ID數量
+ * \return ID數量
+ */
+size_t StringInterner::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return strings_.size();
+}
+
+} // namespace msa::utils
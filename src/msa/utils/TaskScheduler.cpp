@@ -0,0 +1,275 @@
+#include "msa/utils/TaskScheduler.h"
+#include "msa/utils/LogManager.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <utility>
+
+namespace msa::utils {
+
+// 目前執行緒的工作執行緒編號 (-1表示非工作執行緒)
+static thread_local int tls_worker_index = -1;
+
+// waitUntil 重新檢查條件的間隔 (條件改變時不會通知排程器)
+static constexpr std::chrono::milliseconds kConditionRecheckInterval(10);
+
+/**
+ * @brief 單例實例獲取
+ * \return 排程器實例
+ */
+TaskScheduler& TaskScheduler::getInstance() {
+    static TaskScheduler instance;
+    return instance;
+}
+
+/**
+ * @brief 解構函數
+ */
+TaskScheduler::~TaskScheduler() {
+    shutdown();
+}
+
+/**
+ * @brief 建立工作執行緒
+ * \param numThreads 工作執行緒總數
+ */
+void TaskScheduler::initialize(int numThreads) {
+    if (!queues_.empty()) {
+        LOG_WARN("TaskScheduler", "排程器已初始化，忽略重複初始化");
+        return;
+    }
+    
+    int n = std::max(1, numThreads);
+    for (int i = 0; i < n; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    stop_ = false;
+    
+    // 呼叫執行緒為0號工作執行緒，等待任務群組時參與執行
+    tls_worker_index = 0;
+    for (int i = 1; i < n; ++i) {
+        threads_.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+    
+    LOG_INFO("TaskScheduler", "工作竊取排程器已建立，執行緒數: " + std::to_string(n));
+}
+
+/**
+ * @brief 停止並回收工作執行緒
+ */
+void TaskScheduler::shutdown() {
+    if (queues_.empty()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    queues_.clear();
+    tls_worker_index = -1;
+}
+
+/**
+ * @brief 目前執行緒的工作執行緒編號
+ * \return 編號，非工作執行緒返回-1
+ */
+int TaskScheduler::workerIndex() {
+    return tls_worker_index;
+}
+
+/**
+ * @brief 提交任務
+ * \param group 任務所屬群組
+ * \param task 任務
+ */
+void TaskScheduler::submit(TaskGroup& group, Task task) {
+    group.pending_.fetch_add(1, std::memory_order_relaxed);
+    QueuedTask item{std::move(task), &group};
+    
+    // 未初始化時直接執行
+    if (queues_.empty()) {
+        runTask(item);
+        return;
+    }
+    
+    // 工作執行緒放入自己的佇列，其他執行緒輪流放入各佇列
+    int index = tls_worker_index;
+    size_t target = index >= 0 ? static_cast<size_t>(index)
+                               : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(std::move(item));
+    }
+    queued_.fetch_add(1);
+    
+    // 持有鎖後再通知，避免閒置執行緒在檢查條件與進入等待之間錯過喚醒
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    sleep_cv_.notify_one();
+}
+
+/**
+ * @brief 等待群組內所有任務完成
+ * \param group 任務群組
+ */
+void TaskScheduler::wait(TaskGroup& group) {
+    int index = tls_worker_index;
+    while (group.pending_.load() > 0) {
+        QueuedTask item;
+        if (index >= 0 && takeTask(index, item)) {
+            runTask(item);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.wait(lock, [&]() {
+            return group.pending_.load() == 0 || (index >= 0 && queued_.load() > 0);
+        });
+    }
+    
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(group.error_mutex_);
+        error = std::exchange(group.error_, nullptr);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * @brief 等待條件成立，工作執行緒等待期間執行其他任務
+ * \param ready 條件
+ */
+void TaskScheduler::waitUntil(const std::function<bool()>& ready) {
+    int index = tls_worker_index;
+    while (!ready()) {
+        QueuedTask item;
+        if (index >= 0 && takeTask(index, item)) {
+            runTask(item);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.wait_for(lock, kConditionRecheckInterval, [&]() { return index >= 0 && queued_.load() > 0; });
+    }
+}
+
+/**
+ * @brief 將 [0, n) 切分為任務並等待完成
+ * \param n 元素數
+ * \param grain 每個任務處理的元素數
+ * \param body 處理函數
+ */
+void TaskScheduler::parallelFor(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    grain = std::max<size_t>(1, grain);
+    TaskGroup group;
+    for (size_t begin = 0; begin < n; begin += grain) {
+        size_t end = std::min(n, begin + grain);
+        submit(group, [&body, begin, end]() { body(begin, end); });
+    }
+    wait(group);
+}
+
+/**
+ * @brief 工作執行緒主迴圈
+ * \param index 工作執行緒編號
+ */
+void TaskScheduler::workerLoop(int index) {
+    tls_worker_index = index;
+    while (true) {
+        QueuedTask item;
+        if (takeTask(index, item)) {
+            runTask(item);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.wait(lock, [&]() { return stop_ || queued_.load() > 0; });
+        if (stop_ && queued_.load() == 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief 取得一個任務
+ * \param index 工作執行緒編號
+ * \param out 取得的任務
+ * \return 是否取得任務
+ */
+bool TaskScheduler::takeTask(int index, QueuedTask& out) {
+    size_t n = queues_.size();
+    
+    // 自己的佇列從尾端取出 (最近提交的任務)
+    {
+        WorkerQueue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            out = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    
+    // 從其他佇列的前端竊取 (最早提交的任務)
+    for (size_t k = 1; k < n; ++k) {
+        WorkerQueue& victim = *queues_[(static_cast<size_t>(index) + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1);
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 執行任務並更新群組計數
+ * \param item 任務
+ */
+void TaskScheduler::runTask(QueuedTask& item) {
+    TaskGroup* group = item.group;
+    try {
+        item.task();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(group->error_mutex_);
+        if (!group->error_) {
+            group->error_ = std::current_exception();
+        }
+    }
+    // 先釋放任務捕獲的資源，群組完成後等待者可能立即銷毀相關物件
+    item.task = nullptr;
+    executed_.fetch_add(1, std::memory_order_relaxed);
+    
+    // 群組計數歸零後不再存取群組 (等待者可能已將其銷毀)
+    if (group->pending_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.notify_all();
+    }
+}
+
+/**
+ * @brief 獲取排程統計資訊
+ * \return 統計信息字串
+ */
+std::string TaskScheduler::getStats() const {
+    std::ostringstream ss;
+    ss << "TaskScheduler狀態: 執行緒=" << queues_.size()
+       << ", 執行任務=" << executed_.load(std::memory_order_relaxed)
+       << ", 竊取任務=" << stolen_.load(std::memory_order_relaxed);
+    return ss.str();
+}
+
+} // namespace msa::utils
@@ -0,0 +1,99 @@
+#include "msa/utils/TimingHistogram.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace msa::utils {
+
+/**
+ * @brief 耗時所屬的桶 (第 k 個桶涵蓋 [2^(k-1), 2^k) 微秒)
+ * \param micros 耗時 (微秒)
+ * \param n_buckets 桶數
+ * \return 桶索引
+ */
+static size_t bucketOf(uint64_t micros, size_t n_buckets) {
+    size_t bucket = 0;
+    while (micros > 0 && bucket + 1 < n_buckets) {
+        micros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+/**
+ * @brief 記錄耗時
+ * \param micros 耗時 (微秒)
+ * \param count 記錄次數
+ */
+void TimingHistogram::record(uint64_t micros, uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+    buckets_[bucketOf(micros, kBuckets)].fetch_add(count, std::memory_order_relaxed);
+    count_.fetch_add(count, std::memory_order_relaxed);
+    uint64_t current = max_.load(std::memory_order_relaxed);
+    while (micros > current && !max_.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief 百分位數的上界
+ * \param fraction 百分位
+ * \return 該百分位所在桶的上界 (微秒)
+ */
+uint64_t TimingHistogram::percentileMicros(double fraction) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t k = 0; k < kBuckets; ++k) {
+        seen += buckets_[k].load(std::memory_order_relaxed);
+        if (seen > target || seen == total) {
+            uint64_t upper = k == 0 ? 0 : (uint64_t(1) << k) - 1;
+            return std::min(upper, maxMicros());
+        }
+    }
+    return maxMicros();
+}
+
+/**
+ * @brief 格式化為日誌字串
+ * \return 直方圖字串
+ */
+std::string TimingHistogram::toString() const {
+    std::ostringstream ss;
+    ss << "n=" << count()
+       << ", p50<=" << formatMicros(percentileMicros(0.50))
+       << ", p90<=" << formatMicros(percentileMicros(0.90))
+       << ", p99<=" << formatMicros(percentileMicros(0.99))
+       << ", max=" << formatMicros(maxMicros())
+       << ", 分佈:";
+    for (size_t k = 0; k < kBuckets; ++k) {
+        uint64_t n = buckets_[k].load(std::memory_order_relaxed);
+        if (n > 0) {
+            ss << " <" << formatMicros(uint64_t(1) << k) << ":" << n;
+        }
+    }
+    return ss.str();
+}
+
+/**
+ * @brief 格式化耗時
+ * \param micros 耗時 (微秒)
+ * \return 耗時字串
+ */
+std::string TimingHistogram::formatMicros(uint64_t micros) {
+    std::ostringstream ss;
+    if (micros < 1000) {
+        ss << micros << "us";
+    } else if (micros < 1000000) {
+        ss << std::fixed << std::setprecision(micros < 10000 ? 1 : 0) << micros / 1000.0 << "ms";
+    } else {
+        ss << std::fixed << std::setprecision(micros < 10000000 ? 1 : 0) << micros / 1000000.0 << "s";
+    }
+    return ss.str();
+}
+
+} // namespace msa::utils
@@ -0,0 +1,161 @@
+#include "msa/utils/MemoryPool.h"
+#include "msa/utils/LogManager.h"
+#include "msa/utils/MpmcRing.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using msa::utils::MemoryPool;
+using msa::utils::MpmcRing;
+
+namespace {
+
+// 每次迭代每個執行緒借出的物件數 (大於執行緒彈匣的兩批，每次迭代都會與全域倉庫交換)
+constexpr size_t kBatch = 96;
+
+// 跨執行緒交接佇列容量
+constexpr size_t kHandoffCapacity = 1 << 16;
+
+// 模擬讀段寫入的資料大小 (位元組)
+constexpr int kReadBytes = 512;
+
+// 跨執行緒交接佇列 (Setup 建立、Teardown 清空)
+std::unique_ptr<MpmcRing<bam1_t*>> handoff;
+
+/**
+ * @brief 模擬 sam_itr_next 寫入讀段 (緩衝區不足時擴充)，讓物件的資料緩衝區經過保留統計
+ */
+void touch(bam1_t* b) {
+    if (b->m_data < static_cast<uint32_t>(kReadBytes)) {
+        uint8_t* data = static_cast<uint8_t*>(realloc(b->data, kReadBytes));
+        if (!data) {
+            return;
+        }
+        b->data = data;
+        b->m_data = kReadBytes;
+    }
+    b->l_data = kReadBytes;
+    b->data[0] = 1;
+}
+
+/**
+ * @brief 每次執行前重建記憶體池：無容量上限，預先配置每個執行緒一批物件
+ */
+void setupUnbounded(const benchmark::State& state) {
+    MemoryPool& pool = MemoryPool::getInstance();
+    pool.releaseAll();
+    pool.initialize(static_cast<size_t>(state.threads()) * kBatch, 0);
+    handoff = std::make_unique<MpmcRing<bam1_t*>>(kHandoffCapacity);
+}
+
+/**
+ * @brief 每次執行前重建記憶體池：容量上限為執行緒數的一半，多數借出需在 waitIfEmpty 路徑等待
+ */
+void setupCapped(const benchmark::State& state) {
+    size_t capacity = std::max<size_t>(1, static_cast<size_t>(state.threads()) / 2);
+    MemoryPool& pool = MemoryPool::getInstance();
+    pool.releaseAll();
+    pool.initialize(capacity, capacity);
+}
+
+/**
+ * @brief 歸還交接佇列中剩餘的物件並釋放記憶體池
+ */
+void teardown(const benchmark::State&) {
+    MemoryPool& pool = MemoryPool::getInstance();
+    if (handoff) {
+        bam1_t* b = nullptr;
+        while (handoff->tryPop(b)) {
+            pool.returnBam1(b);
+        }
+        handoff.reset();
+    }
+    pool.releaseAll();
+}
+
+} // namespace
+
+/*
+* 同一執行緒借出並歸還：彈匣命中為主，每次迭代有一批物件經過全域倉庫
+* 每次 getBam1 與 returnBam1 各計為一次操作
+*/
+static void BM_MemoryPoolLocalReuse(benchmark::State& state) {
+    MemoryPool& pool = MemoryPool::getInstance();
+    std::vector<bam1_t*> held(kBatch);
+    for (auto _ : state) {
+        for (auto& b : held) {
+            b = pool.getBam1();
+            touch(b);
+        }
+        for (auto* b : held) {
+            pool.returnBam1(b);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBatch * 2));
+}
+BENCHMARK(BM_MemoryPoolLocalReuse)
+    ->ThreadRange(1, 128)
+    ->Setup(setupUnbounded)
+    ->Teardown(teardown)
+    ->UseRealTime();
+
+/*
+* 跨執行緒歸還 (讀取執行緒借出、提取任務歸還)：借出的物件放入共用佇列，再歸還其他執行緒放入的物件，
+* 彈匣溢出與補充都經過全域倉庫
+*/
+static void BM_MemoryPoolCrossThread(benchmark::State& state) {
+    MemoryPool& pool = MemoryPool::getInstance();
+    for (auto _ : state) {
+        for (size_t i = 0; i < kBatch; ++i) {
+            bam1_t* b = pool.getBam1();
+            touch(b);
+            if (!handoff->tryPush(b)) {
+                pool.returnBam1(b);
+            }
+        }
+        bam1_t* b = nullptr;
+        for (size_t i = 0; i < kBatch && handoff->tryPop(b); ++i) {
+            pool.returnBam1(b);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * kBatch * 2));
+}
+BENCHMARK(BM_MemoryPoolCrossThread)
+    ->ThreadRange(1, 128)
+    ->Setup(setupUnbounded)
+    ->Teardown(teardown)
+    ->UseRealTime();
+
+/*
+* 達到 maxCapacity 後的 getBam1(waitIfEmpty=true)：物件數少於執行緒數，借出的執行緒歸還後交回全域倉庫，
+* 其他執行緒在條件變數上等待 (每個執行緒等待時不持有物件，不會互相鎖死)
+*/
+static void BM_MemoryPoolCappedWait(benchmark::State& state) {
+    MemoryPool& pool = MemoryPool::getInstance();
+    for (auto _ : state) {
+        bam1_t* b = pool.getBam1(true);
+        touch(b);
+        pool.returnBam1(b);
+        pool.flushThreadCache();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 2));
+}
+BENCHMARK(BM_MemoryPoolCappedWait)
+    ->ThreadRange(1, 128)
+    ->Setup(setupCapped)
+    ->Teardown(teardown)
+    ->UseRealTime();
+
+int main(int argc, char** argv) {
+    // 只輸出警告以上的日誌，避免每次重建記憶體池的訊息混入結果
+    msa::utils::LogManager::getInstance().initialize(msa::utils::LogLevel::WARN_Level);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "msa/core/MethylCallClassifier.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+using msa::core::MethylCallClassifier;
+
+namespace {
+
+/**
+ * @brief 包含全部256種ML值 (其後為隨機值) 的輸入
+ */
+std::vector<uint8_t> makeInput() {
+    std::mt19937 rng(20240611u);
+    std::vector<uint8_t> ml(1024 + 64);
+    for (size_t i = 0; i < ml.size(); ++i) {
+        ml[i] = static_cast<uint8_t>(i < 256 ? i : rng());
+    }
+    return ml;
+}
+
+// (起始偏移, 長度)：0、不足一個向量、剛好整數個向量與加上尾端，涵蓋未對齊的載入
+const std::vector<std::pair<size_t, size_t>> kSpans = {
+    {0, 0}, {0, 1}, {3, 15}, {0, 16}, {1, 17}, {5, 31}, {0, 32}, {7, 33},
+    {0, 63}, {0, 64}, {9, 65}, {0, 256}, {13, 1000}, {0, 1024 + 64}
+};
+
+} // namespace
+
+/*
+* 每個向量核心與純量核心比較所有 (high_cut, low_cut) 組合
+*/
+TEST(MethylCallClassifierTest, KernelsMatchScalarForAllCuts) {
+    const auto kernels = MethylCallClassifier::kernels();
+    ASSERT_FALSE(kernels.empty());
+    const auto& scalar = kernels.front();
+    const std::vector<uint8_t> ml = makeInput();
+
+    std::vector<uint8_t> expected(ml.size());
+    std::vector<uint8_t> actual(ml.size());
+    for (size_t k = 1; k < kernels.size(); ++k) {
+        SCOPED_TRACE(kernels[k].name);
+        int mismatches = 0;
+        for (int high = 0; high < 256; ++high) {
+            for (int low = 0; low < 256; ++low) {
+                for (const auto& span : kSpans) {
+                    const uint8_t* input = ml.data() + span.first;
+                    const size_t n = std::min(span.second, ml.size() - span.first);
+                    scalar.kernel(input, n, expected.data(), static_cast<uint8_t>(high), static_cast<uint8_t>(low));
+
+                    // 輸出緩衝區預先填入標記值，檢查核心沒有寫入超出範圍的位置
+                    std::fill(actual.begin(), actual.end(), uint8_t(0xA5));
+                    kernels[k].kernel(input, n, actual.data(), static_cast<uint8_t>(high), static_cast<uint8_t>(low));
+
+                    bool same = std::equal(expected.begin(), expected.begin() + n, actual.begin()) &&
+                                std::all_of(actual.begin() + n, actual.end(), [](uint8_t v) { return v == 0xA5; });
+                    if (!same && ++mismatches <= 10) {
+                        ADD_FAILURE() << "high_cut=" << high << ", low_cut=" << low
+                                      << ", offset=" << span.first << ", n=" << n;
+                    }
+                }
+            }
+        }
+        EXPECT_EQ(mismatches, 0);
+    }
+}
+
+/*
+* 輸入與輸出為同一陣列 (classify 允許原地分類)
+*/
+TEST(MethylCallClassifierTest, KernelsClassifyInPlace) {
+    const auto kernels = MethylCallClassifier::kernels();
+    const std::vector<uint8_t> ml = makeInput();
+    std::vector<uint8_t> expected(300);
+    kernels.front().kernel(ml.data(), expected.size(), expected.data(), 200, 50);
+
+    for (const auto& kernel : kernels) {
+        SCOPED_TRACE(kernel.name);
+        std::vector<uint8_t> in_place(ml.begin(), ml.begin() + 300);
+        kernel.kernel(in_place.data(), in_place.size(), in_place.data(), 200, 50);
+        EXPECT_EQ(in_place, expected);
+    }
+}
+
+/*
+* 批次分類與逐值分類相同 (包含分界無法以位元組表示、改用分類表的閾值)
+*/
+TEST(MethylCallClassifierTest, BatchMatchesSingleValue) {
+    const std::vector<uint8_t> ml = makeInput();
+    const std::vector<std::pair<float, float>> thresholds = {
+        {0.8f, 0.2f}, {0.5f, 0.5f}, {1.0f, 0.0f}, {0.0f, 1.0f}, {1.5f, -0.5f}, {0.3f, 0.7f}
+    };
+    for (const auto& threshold : thresholds) {
+        SCOPED_TRACE(testing::Message() << "high=" << threshold.first << ", low=" << threshold.second);
+        MethylCallClassifier classifier(threshold.first, threshold.second);
+        std::vector<uint8_t> states(ml.size());
+        classifier.classify(ml.data(), ml.size(), states.data());
+        for (size_t i = 0; i < ml.size(); ++i) {
+            ASSERT_EQ(states[i], static_cast<uint8_t>(classifier.classify(ml[i]))) << "ml=" << int(ml[i]);
+        }
+    }
+}
@@ -0,0 +1,476 @@
+#include "msa/core/MethylTagParser.h"
+#include "msa/core/CigarCursor.h"
+#include <gtest/gtest.h>
+#include <htslib/hts.h>
+#include <htslib/sam.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+using msa::core::BaseModCall;
+using msa::core::MethylTagParser;
+
+namespace {
+
+// 同一位置最多的修飾數 (測試中的修飾組合遠少於此值)
+constexpr int kMaxModsAtPos = 16;
+
+/**
+ * @brief 測試讀段的內容
+ */
+struct ReadSpec {
+    std::string seq;                // 儲存方向的序列
+    bool reverse = false;           // 是否為反向讀段
+    std::vector<uint32_t> cigar;    // CIGAR (空白時為整段比對)
+    std::string mm;                 // MM標籤
+    bool has_ml = true;             // 是否有ML標籤
+    std::vector<uint8_t> ml;        // ML值
+    int64_t mn = -1;                // MN標籤 (-1 表示不加入)
+};
+
+/**
+ * @brief 建立BAM讀段
+ * @param spec 讀段內容
+ * @return bam1_t* 讀段 (由呼叫者以 bam_destroy1 釋放)
+ */
+bam1_t* makeRead(const ReadSpec& spec) {
+    bam1_t* read = bam_init1();
+    std::vector<uint32_t> cigar = spec.cigar;
+    if (cigar.empty()) {
+        cigar.push_back(bam_cigar_gen(spec.seq.size(), BAM_CMATCH));
+    }
+    const char* qname = "read";
+    bam_set1(read, 4, qname, spec.reverse ? BAM_FREVERSE : 0, 0, 1000, 60,
+             cigar.size(), cigar.data(), -1, -1, 0, spec.seq.size(), spec.seq.c_str(), nullptr, 64);
+    bam_aux_append(read, "MM", 'Z', static_cast<int>(spec.mm.size() + 1), reinterpret_cast<const uint8_t*>(spec.mm.c_str()));
+    if (spec.has_ml) {
+        bam_aux_update_array(read, "ML", 'C', static_cast<uint32_t>(spec.ml.size()),
+                             const_cast<uint8_t*>(spec.ml.data()));
+    }
+    if (spec.mn >= 0) {
+        bam_aux_update_int(read, "MN", spec.mn);
+    }
+    return read;
+}
+
+/**
+ * @brief 以htslib的 bam_parse_basemod/bam_next_basemod 解碼整個讀段 (參考結果)
+ * @param read BAM讀段
+ * @param calls 用於存儲有ML值的修飾 (與 MethylTagParser 相同，沒有ML值的修飾不輸出)
+ * @return bool htslib是否成功解碼
+ */
+bool htslibDecode(bam1_t* read, std::vector<BaseModCall>& calls) {
+    calls.clear();
+    hts_base_mod_state* state = hts_base_mod_state_alloc();
+    bool ok = bam_parse_basemod(read, state) >= 0;
+    if (ok) {
+        hts_base_mod mods[kMaxModsAtPos];
+        int pos = 0;
+        int n = 0;
+        while ((n = bam_next_basemod(read, state, mods, kMaxModsAtPos, &pos)) > 0) {
+            for (int i = 0; i < n; ++i) {
+                if (mods[i].qual < 0) {
+                    continue;
+                }
+                BaseModCall call;
+                call.read_pos = pos;
+                call.modified_base = mods[i].modified_base;
+                call.canonical_base = static_cast<char>(mods[i].canonical_base);
+                call.ml = static_cast<uint8_t>(mods[i].qual);
+                call.opposite_strand = mods[i].strand != 0;
+                calls.push_back(call);
+            }
+        }
+        ok = (n == 0);
+    }
+    hts_base_mod_state_free(state);
+    if (!ok) {
+        calls.clear();
+    }
+    return ok;
+}
+
+/**
+ * @brief 修飾的文字表示 (用於失敗訊息)
+ */
+std::string describe(const std::vector<BaseModCall>& calls) {
+    std::string text;
+    for (const auto& call : calls) {
+        text += "(" + std::to_string(call.read_pos) + "," + call.canonical_base + (call.opposite_strand ? "-" : "+") +
+                std::to_string(call.modified_base) + "," + std::to_string(call.ml) + ")";
+    }
+    return text.empty() ? "(無)" : text;
+}
+
+/**
+ * @brief 兩組修飾是否完全相同 (包含順序)
+ */
+bool sameCalls(const std::vector<BaseModCall>& a, const std::vector<BaseModCall>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].read_pos != b[i].read_pos || a[i].modified_base != b[i].modified_base ||
+            a[i].canonical_base != b[i].canonical_base || a[i].ml != b[i].ml ||
+            a[i].opposite_strand != b[i].opposite_strand) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 比較整個讀段的解碼結果與htslib
+ * @param spec 讀段內容
+ * @param parser 解析器
+ */
+void expectFullDecodeMatches(const ReadSpec& spec, MethylTagParser& parser) {
+    SCOPED_TRACE("MM=" + spec.mm + (spec.reverse ? " (反向)" : " (正向)"));
+    bam1_t* read = makeRead(spec);
+    std::vector<BaseModCall> expected;
+    bool expected_ok = htslibDecode(read, expected);
+    bool ok = parser.parse(read, 0, static_cast<int64_t>(spec.seq.size()));
+    EXPECT_EQ(ok, expected_ok);
+    EXPECT_TRUE(sameCalls(parser.calls(), expected))
+        << "實際: " << describe(parser.calls()) << "\nhtslib: " << describe(expected);
+    bam_destroy1(read);
+}
+
+/**
+ * @brief 完整解碼結果中位於 [read_begin, read_end) 的修飾
+ */
+std::vector<BaseModCall> filterWindow(const std::vector<BaseModCall>& calls, int64_t read_begin, int64_t read_end) {
+    std::vector<BaseModCall> filtered;
+    std::copy_if(calls.begin(), calls.end(), std::back_inserter(filtered), [&](const BaseModCall& call) {
+        return call.read_pos >= read_begin && call.read_pos < read_end;
+    });
+    return filtered;
+}
+
+/**
+ * @brief 比較區間解碼結果與htslib完整解碼過濾至 [read_begin, read_end) 的結果
+ * @param read BAM讀段
+ * @param full htslib的完整解碼結果
+ * @param read_begin 區間起點 (含)
+ * @param read_end 區間終點 (不含)
+ * @param parser 解析器
+ */
+void expectWindowMatches(const bam1_t* read, const std::vector<BaseModCall>& full,
+                         int64_t read_begin, int64_t read_end, MethylTagParser& parser) {
+    SCOPED_TRACE(testing::Message() << "區間 [" << read_begin << ", " << read_end << ")");
+    std::vector<BaseModCall> expected = filterWindow(full, read_begin, read_end);
+    EXPECT_TRUE(parser.parse(read, read_begin, read_end));
+    EXPECT_TRUE(sameCalls(parser.calls(), expected))
+        << "實際: " << describe(parser.calls()) << "\n預期: " << describe(expected);
+}
+
+/**
+ * @brief 互補鹼基
+ */
+char complement(char base) {
+    switch (base) {
+        case 'A': return 'T';
+        case 'C': return 'G';
+        case 'G': return 'C';
+        case 'T': return 'A';
+        default:  return base;
+    }
+}
+
+/**
+ * @brief 依原始讀段方向的標準鹼基隨機產生一個修飾組
+ * @param rng 亂數產生器
+ * @param spec 讀段內容 (附加MM與ML)
+ * @param header 修飾組標頭 (例如 "C+mh?")
+ * @param n_codes 修飾代碼數
+ */
+void appendGroup(std::mt19937& rng, ReadSpec& spec, const std::string& header, int n_codes) {
+    std::string original = spec.seq;
+    if (spec.reverse) {
+        original.assign(spec.seq.rbegin(), spec.seq.rend());
+        for (char& base : original) {
+            base = complement(base);
+        }
+    }
+    const char base = header[0];
+    const char target = (header[1] == '-') ? complement(base) : base;
+
+    spec.mm += header;
+    int64_t skipped = 0;
+    for (char b : original) {
+        if (base != 'N' && b != target) {
+            continue;
+        }
+        if (rng() % 3 != 0) {
+            ++skipped;
+            continue;
+        }
+        spec.mm += "," + std::to_string(skipped);
+        skipped = 0;
+        for (int c = 0; c < n_codes; ++c) {
+            spec.ml.push_back(static_cast<uint8_t>(rng()));
+        }
+    }
+    spec.mm += ";";
+}
+
+/**
+ * @brief 隨機序列
+ */
+std::string randomSeq(std::mt19937& rng, size_t length) {
+    static const char kBases[] = {'A', 'C', 'G', 'T'};
+    std::string seq(length, 'A');
+    for (char& base : seq) {
+        base = kBases[rng() % 4];
+    }
+    return seq;
+}
+
+/**
+ * @brief 修飾組標頭與修飾代碼數
+ */
+struct GroupHeader {
+    const char* header;
+    int n_codes;
+};
+
+const GroupHeader kGroupHeaders[] = {
+    {"C+m", 1}, {"C+h", 1}, {"C+mh", 2}, {"C+hm.", 2}, {"C+m?", 1}, {"C+m.", 1},
+    {"C-m", 1}, {"G-m?", 1}, {"A+a", 1}, {"T+17802", 1}, {"C+76792.", 1}, {"N+n", 1}
+};
+
+} // namespace
+
+/*
+* 正反向讀段：單一代碼、C+mh 多代碼組、分開的修飾組、C-m、?/. 模式、空修飾組與無ML
+*/
+TEST(MethylTagParserTest, MatchesHtslibOnNamedCases) {
+    const std::string seq = "ACGTTCGACCGGATCGCGTACGTTAGCCGATCGA";
+    const std::vector<std::pair<std::string, std::vector<uint8_t>>> cases = {
+        {"C+m,0,1,2;", {10, 200, 130}},
+        {"C+mh,1,0,3;", {11, 12, 21, 22, 31, 32}},
+        {"C+h,0,2;C+m,0,1,0;", {1, 2, 3, 4, 5}},
+        {"C-m,0,2,1;", {50, 60, 70}},
+        {"C+m?,1,1;C+h.,0;", {240, 15, 99}},
+        {"C+m.;A+a?,2;", {77}},
+        {"C+76792,3;G-m,1,1;", {9, 8, 7}},
+    };
+    MethylTagParser parser;
+    for (bool reverse : {false, true}) {
+        for (const auto& c : cases) {
+            ReadSpec spec;
+            spec.seq = seq;
+            spec.reverse = reverse;
+            spec.mm = c.first;
+            spec.ml = c.second;
+            expectFullDecodeMatches(spec, parser);
+        }
+        
+        ReadSpec no_ml;
+        no_ml.seq = seq;
+        no_ml.reverse = reverse;
+        no_ml.mm = "C+m,0,1;";
+        no_ml.has_ml = false;
+        expectFullDecodeMatches(no_ml, parser);
+    }
+}
+
+/*
+* ML值少於MM項目數：htslib與解析器皆拒絕
+*/
+TEST(MethylTagParserTest, RejectsTruncatedMl) {
+    MethylTagParser parser;
+    for (bool reverse : {false, true}) {
+        ReadSpec spec;
+        spec.seq = "ACGTTCGACCGGATCGCGTACGTTAGCCGATCGA";
+        spec.reverse = reverse;
+        spec.mm = "C+mh,0,1;";
+        spec.ml = {1, 2, 3};
+        expectFullDecodeMatches(spec, parser);
+        
+        bam1_t* read = makeRead(spec);
+        EXPECT_FALSE(parser.parse(read, 0, static_cast<int64_t>(spec.seq.size())));
+        EXPECT_TRUE(parser.calls().empty());
+        bam_destroy1(read);
+    }
+}
+
+/*
+* MN與序列長度不符 (例如經硬剪切) 時標籤不可用；相符時正常解碼
+*/
+TEST(MethylTagParserTest, ChecksMnLength) {
+    MethylTagParser parser;
+    for (bool reverse : {false, true}) {
+        ReadSpec spec;
+        spec.seq = "ACGTTCGACCGGATCGCGTACGTTAGCCGATCGA";
+        spec.reverse = reverse;
+        spec.mm = "C+m,0;";
+        spec.ml = {200};
+        spec.mn = static_cast<int64_t>(spec.seq.size()) + 5;
+        
+        bam1_t* read = makeRead(spec);
+        EXPECT_FALSE(parser.parse(read, 0, static_cast<int64_t>(spec.seq.size())));
+        EXPECT_TRUE(parser.calls().empty());
+#if HTS_VERSION >= 101700
+        std::vector<BaseModCall> expected;
+        EXPECT_FALSE(htslibDecode(read, expected));
+#endif
+        bam_destroy1(read);
+        
+        spec.mn = static_cast<int64_t>(spec.seq.size());
+        expectFullDecodeMatches(spec, parser);
+    }
+}
+
+/*
+* 隨機序列與隨機修飾組合 (正反向、多代碼、互補鏈、ChEBI代碼、N)
+*/
+TEST(MethylTagParserTest, MatchesHtslibOnRandomReads) {
+    std::mt19937 rng(7u);
+    const size_t n_headers = sizeof(kGroupHeaders) / sizeof(kGroupHeaders[0]);
+    MethylTagParser parser;
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+        ReadSpec spec;
+        spec.seq = randomSeq(rng, 20 + rng() % 180);
+        spec.reverse = (rng() % 2) != 0;
+        int n_groups = 1 + static_cast<int>(rng() % 3);
+        for (int g = 0; g < n_groups; ++g) {
+            const GroupHeader& group = kGroupHeaders[rng() % n_headers];
+            appendGroup(rng, spec, group.header, group.n_codes);
+        }
+        expectFullDecodeMatches(spec, parser);
+        if (HasFailure()) {
+            break;
+        }
+    }
+}
+
+/*
+* 區間起點或終點恰好落在修飾鹼基上 (含與不含該鹼基)，以及相鄰修飾之間的區間
+*/
+TEST(MethylTagParserTest, WindowBoundariesOnModifiedBases) {
+    std::mt19937 rng(12u);
+    const size_t n_headers = sizeof(kGroupHeaders) / sizeof(kGroupHeaders[0]);
+    MethylTagParser parser;
+    for (int iteration = 0; iteration < 300 && !HasFailure(); ++iteration) {
+        ReadSpec spec;
+        spec.seq = randomSeq(rng, 20 + rng() % 120);
+        spec.reverse = (rng() % 2) != 0;
+        int n_groups = 1 + static_cast<int>(rng() % 3);
+        for (int g = 0; g < n_groups; ++g) {
+            const GroupHeader& group = kGroupHeaders[rng() % n_headers];
+            appendGroup(rng, spec, group.header, group.n_codes);
+        }
+        SCOPED_TRACE("MM=" + spec.mm + (spec.reverse ? " (反向)" : " (正向)"));
+        bam1_t* read = makeRead(spec);
+        std::vector<BaseModCall> full;
+        ASSERT_TRUE(htslibDecode(read, full));
+        
+        const int64_t length = static_cast<int64_t>(spec.seq.size());
+        std::vector<int64_t> bounds = {0, length};
+        for (const auto& call : full) {
+            bounds.push_back(call.read_pos);
+            bounds.push_back(call.read_pos + 1);
+        }
+        std::sort(bounds.begin(), bounds.end());
+        bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            for (size_t j = i + 1; j < bounds.size() && j <= i + 3; ++j) {
+                expectWindowMatches(read, full, bounds[i], bounds[j], parser);
+            }
+            expectWindowMatches(read, full, bounds[i], length, parser);
+            expectWindowMatches(read, full, 0, bounds[i], parser);
+        }
+        bam_destroy1(read);
+    }
+}
+
+/*
+* 裁切至讀段範圍後為空的區間：完全在讀段之前或之後、起點等於終點、起點大於終點
+*/
+TEST(MethylTagParserTest, WindowEmptyAfterClipping) {
+    MethylTagParser parser;
+    for (bool reverse : {false, true}) {
+        ReadSpec spec;
+        spec.seq = "ACGTTCGACCGGATCGCGTACGTTAGCCGATCGA";
+        spec.reverse = reverse;
+        spec.mm = "C+mh,0,1,2;G-m,0,3;";
+        spec.ml = {1, 2, 3, 4, 5, 6, 7, 8};
+        SCOPED_TRACE(reverse ? "反向" : "正向");
+        bam1_t* read = makeRead(spec);
+        std::vector<BaseModCall> full;
+        ASSERT_TRUE(htslibDecode(read, full));
+        ASSERT_FALSE(full.empty());
+        
+        const int64_t length = static_cast<int64_t>(spec.seq.size());
+        const std::vector<std::pair<int64_t, int64_t>> windows = {
+            {-20, -5}, {-5, 0}, {length, length + 10}, {length + 5, length + 40},
+            {0, 0}, {10, 10}, {length, length}, {20, 10}, {length + 3, 5}
+        };
+        for (const auto& window : windows) {
+            expectWindowMatches(read, full, window.first, window.second, parser);
+            EXPECT_TRUE(parser.calls().empty());
+        }
+        
+        // 部分超出讀段的區間裁切後與讀段內的部分相同
+        expectWindowMatches(read, full, -7, 12, parser);
+        expectWindowMatches(read, full, 12, length + 7, parser);
+        expectWindowMatches(read, full, -7, length + 7, parser);
+        bam_destroy1(read);
+    }
+}
+
+/*
+* 完全位於軟剪切內的區間 (讀段座標)，以及參考區間經CIGAR轉換後落在軟剪切或比對範圍之外的區間
+*/
+TEST(MethylTagParserTest, WindowInsideSoftClip) {
+    MethylTagParser parser;
+    const std::string seq = "CGCGACGTCCGATCGCGTACGTTAGCCGATCGACGCGTTCGCCG";
+    const int64_t length = static_cast<int64_t>(seq.size());
+    const uint32_t lead_clip = 8;
+    const uint32_t trail_clip = 6;
+    for (bool reverse : {false, true}) {
+        ReadSpec spec;
+        spec.seq = seq;
+        spec.reverse = reverse;
+        spec.cigar = {bam_cigar_gen(lead_clip, BAM_CSOFT_CLIP),
+                      bam_cigar_gen(length - lead_clip - trail_clip, BAM_CMATCH),
+                      bam_cigar_gen(trail_clip, BAM_CSOFT_CLIP)};
+        spec.mm = "C+m,0,0,0,1,0,2,0,0,1,0;C-h,0,1,0,1,0,0;";
+        spec.ml = {10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150, 160};
+        SCOPED_TRACE(reverse ? "反向" : "正向");
+        bam1_t* read = makeRead(spec);
+        std::vector<BaseModCall> full;
+        ASSERT_TRUE(htslibDecode(read, full));
+        
+        // 讀段座標：前端與後端軟剪切內的區間 (軟剪切內有修飾，應照常解碼)
+        ASSERT_FALSE(filterWindow(full, 0, lead_clip).empty());
+        ASSERT_FALSE(filterWindow(full, length - trail_clip, length).empty());
+        expectWindowMatches(read, full, 0, lead_clip, parser);
+        expectWindowMatches(read, full, 2, lead_clip - 1, parser);
+        expectWindowMatches(read, full, length - trail_clip, length, parser);
+        expectWindowMatches(read, full, length - trail_clip + 1, length - 1, parser);
+        
+        // 參考座標：與 MethylHaploExtractor 相同，以CIGAR將參考區間 [ref_lo, ref_hi] (1-based) 轉為讀段區間
+        const int64_t start = read->core.pos;
+        const int64_t aligned = length - lead_clip - trail_clip;
+        const std::vector<std::pair<int64_t, int64_t>> ref_windows = {
+            {start - 20, start - 1},                        // 比對起點之前 (前端軟剪切對應的參考位置)
+            {start + aligned + 1, start + aligned + 20},    // 比對終點之後 (後端軟剪切對應的參考位置)
+            {start - 5, start + 3},                         // 跨越比對起點
+            {start + aligned - 3, start + aligned + 5},     // 跨越比對終點
+            {start + 1, start + aligned}                    // 整個比對範圍
+        };
+        for (const auto& ref : ref_windows) {
+            msa::core::CigarCursor begin_cursor(read);
+            msa::core::CigarCursor end_cursor(read);
+            int64_t read_begin = begin_cursor.readOffsetForRefPos(ref.first - 1);
+            int64_t read_end = end_cursor.readOffsetForRefPos(ref.second);
+            expectWindowMatches(read, full, read_begin, read_end, parser);
+        }
+        bam_destroy1(read);
+    }
+}
+